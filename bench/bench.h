@@ -0,0 +1,99 @@
+#pragma once
+// peshell_bench 的最小基准框架：用 PESH_BENCH 注册用例，用 Reporter 输出指标。
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace bench
+{
+    // 一条指标，供 --json 输出与 --baseline 比较
+    struct Result
+    {
+        std::string case_name;
+        std::string metric;
+        double      value;
+        std::string unit;
+    };
+
+    std::vector<Result>& Results();
+
+    // 指标的好坏方向：-1 越小越好，+1 越大越好，0 不参与比较
+    int Direction(const std::string& unit);
+
+    class Reporter
+    {
+    public:
+        explicit Reporter(std::string case_name) : case_name_(std::move(case_name)) {}
+
+        void Metric(const std::string& name, double value, const char* unit);
+
+        // 正确性断言，失败时 peshell_bench 以非零码退出
+        void Check(bool condition, const std::string& what);
+
+        bool Failed() const
+        {
+            return failed_;
+        }
+
+        // 只记录结果，不打印文本表格 (--json 输出到 stdout 时)
+        static void SetQuiet(bool quiet)
+        {
+            quiet_ = quiet;
+        }
+
+    private:
+        static bool quiet_;
+        std::string case_name_;
+        bool        failed_ = false;
+    };
+
+    using BenchFn = void (*)(Reporter&);
+
+    struct Case
+    {
+        const char* name;
+        BenchFn     fn;
+    };
+
+    std::vector<Case>& Registry();
+
+    struct Registrar
+    {
+        Registrar(const char* name, BenchFn fn)
+        {
+            Registry().push_back({name, fn});
+        }
+    };
+
+    inline double ElapsedSeconds(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // 已排序样本的分位数
+    inline double Percentile(const std::vector<double>& sorted, double p)
+    {
+        if (sorted.empty()) return 0.0;
+        size_t idx = (size_t)(p * (double)(sorted.size() - 1));
+        return sorted[idx];
+    }
+
+    // 由环境变量给出的规模参数 (CI 以此调小)，未设置或不是数字时为 fallback
+    inline size_t EnvOr(const char* name, size_t fallback)
+    {
+        const char* env = std::getenv(name);
+        if (!env) return fallback;
+        char*  end   = nullptr;
+        size_t value = (size_t)std::strtoull(env, &end, 10);
+        return end == env ? fallback : value;
+    }
+}  // namespace bench
+
+#define PESH_BENCH(name)                                                    \
+    static void             pesh_bench_##name(bench::Reporter&);             \
+    static bench::Registrar pesh_bench_reg_##name(#name, pesh_bench_##name); \
+    static void             pesh_bench_##name(bench::Reporter& reporter)
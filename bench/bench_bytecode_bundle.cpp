@@ -0,0 +1,148 @@
+#include "bench.h"
+#include "bytecode_bundle.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    namespace fs = std::filesystem;
+
+    // prelude 的五个模板之后是 LuaJIT 的默认 package.path
+    const char* kTemplates[] = {
+        "?.lua", "?/init.lua", "lib/?.lua", "lib/?/init.lua", "core/?.lua",
+        "/usr/local/share/luajit-2.1/?.lua", "/usr/local/share/lua/5.1/?.lua", "/usr/local/share/lua/5.1/?/init.lua",
+    };
+
+    // 一次冷启动 + 一个插件命令大致会 require 的模块，分布在不同模板下
+    const char* kModules[] = {
+        "prelude",     "ext.ext",       "ext.path",     "ext.cli",          "ext.os",        "ext.table",
+        "ext.string",  "log",           "plugin",       "plugins.process",  "plugins.async", "plugins.shell",
+        "proc_utils_ffi", "ffi.req",    "luaunit",      "plugins.shutdown", "ext.class",     "ext.io",
+    };
+
+    std::string Expand(const fs::path& root, const char* tpl, const std::string& name)
+    {
+        std::string path = name;
+        std::replace(path.begin(), path.end(), '.', '/');
+        std::string t = tpl;
+        t.replace(t.find('?'), 1, path);
+        return t[0] == '/' ? t : (root / t).string();
+    }
+
+    // 文件所在位置：每个模块只放在一个模板下，位置越靠后探测越多
+    fs::path Place(const fs::path& root, size_t i, const std::string& name)
+    {
+        static const size_t kPlaced[] = {0, 2, 3, 4};  // ?.lua / lib/?.lua / lib/?/init.lua / core/?.lua
+        return Expand(root, kTemplates[kPlaced[i % 4]], name);
+    }
+
+    // 改动前 require 的做法：按 package.path 逐个模板 fopen，找到后读出源码
+    size_t LegacyResolve(const fs::path& root, size_t* probes)
+    {
+        size_t bytes = 0;
+        for (const char* name : kModules)
+        {
+            for (const char* tpl : kTemplates)
+            {
+                ++*probes;
+                FILE* f = std::fopen(Expand(root, tpl, name).c_str(), "rb");
+                if (!f) continue;
+                char buf[8192];
+                while (size_t n = std::fread(buf, 1, sizeof(buf), f)) bytes += n;
+                std::fclose(f);
+                break;
+            }
+        }
+        return bytes;
+    }
+}  // namespace
+
+// 启动时的模块解析：沿 package.path 逐个探测松散文件 vs 映射一个字节码包后按哈希查找
+PESH_BENCH(bytecode_bundle)
+{
+    fs::path root = fs::temp_directory_path() / "pesh_bench_bundle";
+    fs::remove_all(root);
+
+    std::vector<BundleModule> modules;
+    std::string               body(6000, 'x');  // 与 plugins/ 下脚本的典型大小相当
+    auto add = [&](const std::string& name, const fs::path& path, std::string bytecode) {
+        fs::create_directories(path.parent_path());
+        std::ofstream(path, std::ios::binary) << body;
+        BundleModule module{name, std::move(bytecode), path.lexically_relative(root).generic_u8string()};
+        StatBundleSource(path, &module.source_size, &module.source_mtime);
+        modules.push_back(std::move(module));
+    };
+    for (size_t i = 0; i < sizeof(kModules) / sizeof(kModules[0]); ++i) add(kModules[i], Place(root, i, kModules[i]), body + kModules[i]);
+    for (int i = 0; i < 200; ++i) add("filler.m" + std::to_string(i), root / "filler" / ("m" + std::to_string(i) + ".lua"), body + std::to_string(i));
+    fs::path    bundle_path = root / "peshell.bundle";
+    std::string error;
+    reporter.Check(WriteBytecodeBundle(bundle_path, modules, &error), "bundle must be written: " + error);
+
+    constexpr int kRounds = 200;
+    size_t        probes  = 0;
+    auto          t0      = std::chrono::steady_clock::now();
+    for (int r = 0; r < kRounds; ++r) LegacyResolve(root, &probes);
+    reporter.Metric("loose_resolve", bench::ElapsedSeconds(t0) * 1e6 / kRounds, "us/start");
+    reporter.Metric("loose_probes", (double)probes / kRounds, "fopen/start");
+
+    size_t found = 0;
+    t0           = std::chrono::steady_clock::now();
+    for (int r = 0; r < kRounds; ++r)
+    {
+        auto bundle = BytecodeBundle::Open(bundle_path, root, &error);  // 每次查找核对源文件，与启动时一致
+        for (const char* name : kModules)
+        {
+            const uint8_t* data;
+            size_t         size;
+            volatile uint8_t sink = 0;
+            if (bundle->Find(name, &data, &size))
+            {
+                for (size_t i = 0; i < size; i += 4096) sink = sink + data[i];  // 触及每一页，与读取源码对等
+                ++found;
+            }
+        }
+    }
+    reporter.Metric("bundle_resolve", bench::ElapsedSeconds(t0) * 1e6 / kRounds, "us/start");
+    reporter.Check(found == kRounds * (sizeof(kModules) / sizeof(kModules[0])), "every module must be found in the bundle");
+
+    // 正确性：未收录的名称、改动过的源文件、重复名称、截断的文件
+    auto           bundle = BytecodeBundle::Open(bundle_path, root, &error);
+    const uint8_t* data;
+    size_t         size;
+    reporter.Check(bundle && bundle->Size() == modules.size(), "bundle must index every module");
+    reporter.Check(bundle && !bundle->Find("plugins.missing", &data, &size), "unknown module must miss");
+    reporter.Check(bundle && bundle->Find("filler.m42", &data, &size) && std::string((const char*)data, size) == body + "42",
+                   "lookup must return the module bytes");
+    std::ofstream(root / "filler" / "m7.lua", std::ios::binary | std::ios::app) << "-- edited\n";
+    fs::remove(root / "filler" / "m8.lua");
+    reporter.Check(bundle && !bundle->Find("filler.m7", &data, &size) && !bundle->Find("filler.m8", &data, &size) && bundle->Stale() == 2,
+                   "modules whose source changed or disappeared must fall through to disk");
+    reporter.Check(bundle && bundle->Find("filler.m9", &data, &size), "unchanged modules must still come from the bundle");
+    bundle.reset();
+
+    // 伪造的槽表：所有槽都指向同一个条目，没有空槽时未命中的查找会一直探测下去
+    {
+        std::vector<BundleModule> one = {modules.front()};
+        fs::path                  forged = root / "forged.bundle";
+        reporter.Check(WriteBytecodeBundle(forged, one, &error), "single-module bundle must be written");
+        std::fstream file(forged, std::ios::binary | std::ios::in | std::ios::out);
+        uint32_t     slot_count = 0;
+        file.seekg(16);
+        file.read(reinterpret_cast<char*>(&slot_count), sizeof(slot_count));
+        std::vector<uint32_t> slots(slot_count, 1);
+        file.seekp(24 + 48);  // Header | Entry[1] | slots
+        file.write(reinterpret_cast<const char*>(slots.data()), (std::streamsize)(slots.size() * sizeof(uint32_t)));
+        file.close();
+        reporter.Check(!BytecodeBundle::Open(forged, {}, &error), "a slot table without empty slots must be rejected");
+    }
+
+    modules.push_back(modules.front());
+    reporter.Check(!WriteBytecodeBundle(root / "dup.bundle", modules, &error), "duplicate names must be rejected");
+    fs::resize_file(bundle_path, fs::file_size(bundle_path) / 2);
+    reporter.Check(!BytecodeBundle::Open(bundle_path, {}, &error), "truncated bundle must be rejected");
+
+    fs::remove_all(root);
+}
@@ -0,0 +1,236 @@
+#include "bench.h"
+#include "command_channel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+#include <process.h>
+#define getpid _getpid
+#else
+#include <signal.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+namespace
+{
+    CommandRequest Request(std::vector<std::string> args)
+    {
+        CommandRequest request;
+        request.cwd  = "/tmp/工作目录";
+        request.args = std::move(args);
+        return request;
+    }
+
+    bool RoundTrips(const CommandRequest& request)
+    {
+        std::string    frame = EncodeCommandRequest(request);
+        CommandRequest decoded;
+        return DecodeCommandRequest(frame.data() + 4, frame.size() - 4, &decoded) && decoded.cwd == request.cwd &&
+               decoded.args == request.args;
+    }
+
+    // 连上端点、只发出半个长度前缀就停住的客户端
+#if defined(_WIN32)
+    using RawClient = HANDLE;
+
+    RawClient ConnectStalled(const std::string& endpoint)
+    {
+        std::wstring name    = L"\\\\.\\pipe\\" + std::wstring(endpoint.begin(), endpoint.end());
+        HANDLE       pipe    = CreateFileW(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        DWORD        written = 0;
+        if (pipe != INVALID_HANDLE_VALUE) WriteFile(pipe, "\x10\x00", 2, &written, nullptr);
+        return pipe;
+    }
+
+    // 服务端断开后 PeekNamedPipe 失败
+    bool HungUpWithin(RawClient client, int ms)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (; bench::ElapsedSeconds(start) * 1e3 < ms; Sleep(10))
+        {
+            if (!PeekNamedPipe(client, nullptr, 0, nullptr, nullptr, nullptr)) return true;
+        }
+        return false;
+    }
+
+    void CloseRaw(RawClient client)
+    {
+        if (client != INVALID_HANDLE_VALUE) CloseHandle(client);
+    }
+#else
+    using RawClient = int;
+
+    RawClient ConnectStalled(const std::string& endpoint)
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path + 1, endpoint.data(), endpoint.size());  // 抽象名字空间，与 command_channel_linux.cpp 一致
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (sockaddr*)&addr, (socklen_t)(offsetof(sockaddr_un, sun_path) + 1 + endpoint.size())) == 0)
+        {
+            (void)!send(fd, "\x10\x00", 2, MSG_NOSIGNAL);
+        }
+        return fd;
+    }
+
+    // 服务端断开后读到 EOF
+    bool HungUpWithin(RawClient client, int ms)
+    {
+        timeval tv{ms / 1000, (ms % 1000) * 1000};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        char byte;
+        return recv(client, &byte, 1, 0) == 0;
+    }
+
+    void CloseRaw(RawClient client)
+    {
+        if (client >= 0) close(client);
+    }
+#endif
+}  // namespace
+
+// 命令转发通道：客户端 -> 常驻实例 -> 应答的往返延迟；没有实例时的探测开销 (每次冷启动都要付出)；
+// 长时间运行的命令和发到一半的请求都不挡住其他客户端；丢弃的应答以退出码 1 结束客户端
+PESH_BENCH(command_channel)
+{
+    CommandReply reply;
+    reporter.Check(RoundTrips(Request({"exec", "--wait", "", "notepad.exe"})), "requests must survive encoding");
+    std::string frame = EncodeCommandRequest(Request({"kill", "1234"}));
+    CommandRequest decoded;
+    reporter.Check(!DecodeCommandRequest(frame.data() + 4, frame.size() - 5, &decoded), "truncated requests must be rejected");
+    frame[4] = '\x7f';  // 伪造的参数个数
+    reporter.Check(!DecodeCommandRequest(frame.data() + 4, frame.size() - 4, &decoded), "forged argument counts must be rejected");
+    std::string reply_frame = EncodeCommandReply({-3, "输出\n"});
+    reporter.Check(DecodeCommandReply(reply_frame.data(), reply_frame.size(), &reply) && reply.exit_code == -3 && reply.output == "输出\n",
+                   "replies must survive encoding");
+
+    std::string endpoint = "peshell-bench-command-" + std::to_string((unsigned long)getpid());
+
+    constexpr int kProbes = 1000;
+    auto          t0      = std::chrono::steady_clock::now();
+    bool          found   = false;
+    for (int i = 0; i < kProbes; ++i) found |= ForwardCommand(endpoint, Request({"kill", "1"}), &reply);
+    reporter.Metric("no_instance_probe", bench::ElapsedSeconds(t0) * 1e6 / kProbes, "us");
+    reporter.Check(!found, "forwarding without a resident instance must fall back to a cold start");
+
+    // 回显：退出码为参数个数，输出为以空格连接的参数。slow 的应答由本线程稍后给出，drop 的应答直接丢弃
+    std::mutex           slow_mutex;
+    CommandServer::Reply slow_reply;
+    std::string          error;
+    auto server = CommandServer::Start(endpoint, [&](CommandRequest request, CommandServer::Reply send) {
+        if (request.args[0] == "slow") {
+            std::lock_guard<std::mutex> lock(slow_mutex);
+            slow_reply = std::move(send);
+            return;
+        }
+        if (request.args[0] == "drop") return;
+        CommandReply echo;
+        echo.exit_code = (int)request.args.size();
+        for (const auto& arg : request.args) echo.output += (echo.output.empty() ? "" : " ") + arg;
+        send(std::move(echo));
+    }, &error);
+    reporter.Check(server != nullptr, "command endpoint must start: " + error);
+    if (!server) return;
+    reporter.Check(!CommandServer::Start(endpoint, [](CommandRequest, CommandServer::Reply) {}, &error),
+                   "a second resident instance must not take over the endpoint");
+
+    constexpr int       kCommands = 2000;
+    std::vector<double> samples;
+    samples.reserve(kCommands);
+    bool echoed = true;
+    for (int i = 0; i < kCommands; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool ok    = ForwardCommand(endpoint, Request({"kill", "--graceful", "explorer.exe"}), &reply);
+        samples.push_back(bench::ElapsedSeconds(start) * 1e6);
+        echoed &= ok && reply.exit_code == 3 && reply.output == "kill --graceful explorer.exe";
+    }
+    std::sort(samples.begin(), samples.end());
+    reporter.Metric("forward_round_trip_p50", bench::Percentile(samples, 0.50), "us");
+    reporter.Metric("forward_round_trip_p99", bench::Percentile(samples, 0.99), "us");
+    reporter.Check(echoed, "every forwarded command must get its own exit code and output");
+
+    // 一个未应答的命令在途时，其他客户端照常完成
+    std::atomic<bool> slow_done{false};
+    CommandReply      slow_result;
+    std::thread       slow_client([&] {
+        ForwardCommand(endpoint, Request({"slow"}), &slow_result);
+        slow_done = true;
+    });
+    for (bool pending = false; !pending; std::this_thread::yield())
+    {
+        std::lock_guard<std::mutex> lock(slow_mutex);
+        pending = slow_reply != nullptr;
+    }
+    reporter.Check(ForwardCommand(endpoint, Request({"exec", "cmd.exe"}), &reply) && reply.exit_code == 2,
+                   "a pending command must not block other clients");
+    reporter.Check(!slow_done.load(), "the pending client must still be waiting");
+    {
+        std::lock_guard<std::mutex> lock(slow_mutex);
+        slow_reply({7, "late"});
+        slow_reply = nullptr;
+    }
+    slow_client.join();
+    reporter.Check(slow_result.exit_code == 7 && slow_result.output == "late", "a deferred reply must reach its client");
+
+    reporter.Check(ForwardCommand(endpoint, Request({"drop"}), &reply) && reply.exit_code == 1,
+                   "a dropped reply must end the client with exit code 1, not a cold retry");
+
+    // 请求发到一半就停住的客户端不挡住其他客户端 (请求在服务线程上非阻塞读取)，并在请求期限到时被断开
+    RawClient stalled      = ConnectStalled(endpoint);
+    auto      stall_start  = std::chrono::steady_clock::now();
+    bool      served       = ForwardCommand(endpoint, Request({"exec", "cmd.exe"}), &reply) && reply.exit_code == 2;
+    double    behind_stall = bench::ElapsedSeconds(stall_start) * 1e3;
+    reporter.Metric("round_trip_behind_stalled_client", behind_stall, "ms");
+    reporter.Check(served && behind_stall < kCommandRequestDeadlineMs / 2, "a client stalled mid-request must not block other clients");
+    reporter.Check(HungUpWithin(stalled, kCommandRequestDeadlineMs * 3), "a stalled client must be dropped at the request deadline");
+    CloseRaw(stalled);
+
+    reporter.Check(server->Accepted() == kCommands + 4, "every request must be accepted exactly once");
+    server.reset();
+    reporter.Check(!ForwardCommand(endpoint, Request({"kill", "1"}), &reply), "a stopped endpoint must refuse connections");
+
+#if !defined(_WIN32)
+    // 其他用户抢先绑定端点：客户端不得把命令交给它 (需要 root 才能在子进程中切换到 nobody)
+    if (geteuid() != 0) return;
+    int ready[2];
+    if (pipe(ready) != 0) return;
+    pid_t child = fork();
+    if (child == 0)
+    {
+        close(ready[0]);
+        if (setuid(65534) != 0) _exit(1);
+        auto squatter = CommandServer::Start(endpoint, [](CommandRequest, CommandServer::Reply send) { send({0, "stolen"}); }, nullptr);
+        char byte     = squatter ? 1 : 0;
+        (void)!write(ready[1], &byte, 1);
+        pause();  // 由父进程结束
+        _exit(0);
+    }
+    close(ready[1]);
+    char byte = 0;
+    bool up   = child > 0 && read(ready[0], &byte, 1) == 1 && byte == 1;
+    close(ready[0]);
+    reporter.Check(up && !ForwardCommand(endpoint, Request({"kill", "1"}), &reply),
+                   "an endpoint owned by another user must be treated as no resident instance");
+    if (child > 0)
+    {
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+    }
+#endif
+}
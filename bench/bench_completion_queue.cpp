@@ -0,0 +1,147 @@
+#include "bench.h"
+#include "mpsc_queue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace
+{
+    constexpr size_t kCompletionsPerProducer = 200000;
+
+    struct Result
+    {
+        void*       co;
+        bool        success;
+        std::string data;
+        std::string error_msg;
+        Result*     mpsc_next = nullptr;
+    };
+
+    // 自动复位事件，语义与 CreateEvent(NULL, FALSE, ...) 相同，并统计 Set 次数
+    class AutoResetEvent
+    {
+    public:
+        void Set()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                signaled_ = true;
+            }
+            sets_.fetch_add(1, std::memory_order_relaxed);
+            cv_.notify_one();
+        }
+
+        void Wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return signaled_; });
+            signaled_ = false;
+        }
+
+        size_t Sets() const
+        {
+            return sets_.load();
+        }
+
+    private:
+        std::mutex              mutex_;
+        std::condition_variable cv_;
+        bool                    signaled_ = false;
+        std::atomic<size_t>     sets_{0};
+    };
+
+    // 旧设计：mutex + std::queue，每个完成都 SetEvent，消费端 swap 后按值复制
+    void RunLegacy(int producers, bench::Reporter& reporter)
+    {
+        std::queue<Result> completed;
+        std::mutex         completed_mutex;
+        AutoResetEvent     event;
+        size_t             total = kCompletionsPerProducer * producers;
+
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&] {
+                for (size_t i = 0; i < kCompletionsPerProducer; ++i)
+                {
+                    std::lock_guard<std::mutex> lock(completed_mutex);
+                    completed.push({nullptr, true, "Copy successful", ""});
+                    event.Set();
+                }
+            });
+        }
+
+        size_t consumed = 0, checksum = 0;
+        while (consumed < total)
+        {
+            event.Wait();
+            std::queue<Result> tasks;
+            {
+                std::lock_guard<std::mutex> lock(completed_mutex);
+                tasks.swap(completed);
+            }
+            while (!tasks.empty())
+            {
+                Result r = tasks.front();
+                tasks.pop();
+                checksum += r.data.size();
+                ++consumed;
+            }
+        }
+        double elapsed = bench::ElapsedSeconds(t0);
+        for (auto& t : threads) t.join();
+
+        reporter.Metric("mutex_queue_p" + std::to_string(producers), (double)total / elapsed, "completions/s");
+        reporter.Metric("mutex_queue_p" + std::to_string(producers) + "_wakeups", (double)event.Sets(), "count");
+    }
+
+    // 新设计：侵入式 MPSC，只有空→非空时 SetEvent，消费端移动结果
+    void RunMpsc(int producers, bench::Reporter& reporter)
+    {
+        MpscQueue<Result> completed;
+        AutoResetEvent    event;
+        size_t            total = kCompletionsPerProducer * producers;
+
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&] {
+                for (size_t i = 0; i < kCompletionsPerProducer; ++i)
+                {
+                    if (completed.Push(new Result{nullptr, true, "Copy successful", ""})) event.Set();
+                }
+            });
+        }
+
+        size_t consumed = 0, checksum = 0;
+        while (consumed < total)
+        {
+            if (completed.Empty()) event.Wait();
+            while (std::unique_ptr<Result> r{completed.Pop()})
+            {
+                checksum += r->data.size();
+                ++consumed;
+            }
+        }
+        double elapsed = bench::ElapsedSeconds(t0);
+        for (auto& t : threads) t.join();
+
+        reporter.Metric("mpsc_p" + std::to_string(producers), (double)total / elapsed, "completions/s");
+        reporter.Metric("mpsc_p" + std::to_string(producers) + "_wakeups", (double)event.Sets(), "count");
+    }
+}  // namespace
+
+PESH_BENCH(completion_queue)
+{
+    for (int producers : {1, 4, 16})
+    {
+        RunLegacy(producers, reporter);
+        RunMpsc(producers, reporter);
+    }
+}
@@ -0,0 +1,210 @@
+#include "bench.h"
+#include "file_buffer.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // 默认 1 GiB，可用 PESH_BENCH_READ_MB 调小
+    size_t InputSizeBytes()
+    {
+        size_t mb = bench::EnvOr("PESH_BENCH_READ_MB", 1024);
+        return (mb ? mb : 1) << 20;
+    }
+
+    uint64_t Checksum(uint64_t sum, const uint8_t* data, size_t size)
+    {
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            sum += word;
+        }
+        for (; i < size; ++i) sum += data[i];
+        return sum;
+    }
+
+    struct ReadResult
+    {
+        bool     ok       = false;
+        double   seconds  = 0;
+        uint64_t checksum = 0;
+    };
+
+    // 现有 read_file_async 路径：工作线程读入 std::string，主线程 lua_pushlstring 再复制一份
+    ReadResult ReadLegacy(const std::filesystem::path& path)
+    {
+        ReadResult r;
+        auto       t0 = std::chrono::steady_clock::now();
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) return r;
+        std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        std::string buffer(size, '\0');
+        if (!file.read(&buffer[0], size)) return r;
+        std::string lua_string(buffer);  // 等价于 lua_pushlstring 的复制，两份同时存活
+        r.checksum = Checksum(0, reinterpret_cast<const uint8_t*>(lua_string.data()), lua_string.size());
+        r.seconds  = bench::ElapsedSeconds(t0);
+        r.ok       = true;
+        return r;
+    }
+
+    ReadResult ReadMapped(const std::filesystem::path& path)
+    {
+        ReadResult   r;
+        auto         t0     = std::chrono::steady_clock::now();
+        pesh_buffer* buffer = MapFileBuffer(path, nullptr);
+        if (!buffer) return r;
+        r.checksum = Checksum(0, buffer->data, buffer->size);
+        buffer->release(buffer);
+        r.seconds = bench::ElapsedSeconds(t0);
+        r.ok      = true;
+        return r;
+    }
+
+    ReadResult ReadChunked(const std::filesystem::path& path)
+    {
+        ReadResult r;
+        auto       t0     = std::chrono::steady_clock::now();
+        auto       reader = ChunkReader::Open(path, 1 << 20, 4, [](std::function<void()> task) { std::thread(task).detach(); },
+                                              nullptr);
+        if (!reader) return r;
+
+        std::mutex              mutex;
+        std::condition_variable cv;
+        while (true)
+        {
+            bool         done  = false;
+            pesh_buffer* chunk = nullptr;
+            std::string  error;
+            reader->Next([&](pesh_buffer* c, std::string e) {
+                std::lock_guard<std::mutex> lock(mutex);
+                chunk = c;
+                error = std::move(e);
+                done  = true;
+                cv.notify_one();
+            });
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return done; });
+            }
+            if (!error.empty()) return r;
+            if (!chunk) break;
+            r.checksum = Checksum(r.checksum, chunk->data, chunk->size);
+            chunk->release(chunk);
+        }
+        reader->Close();
+        r.seconds = bench::ElapsedSeconds(t0);
+        r.ok      = true;
+        return r;
+    }
+
+#if !defined(_WIN32)
+    // 当前常驻集 (MiB)，读 /proc/self/statm 的第二列
+    double CurrentRssMb()
+    {
+        long  pages = 0;
+        FILE* f     = std::fopen("/proc/self/statm", "r");
+        if (!f) return -1;
+        if (std::fscanf(f, "%*ld %ld", &pages) != 1) pages = -1;
+        std::fclose(f);
+        return pages < 0 ? -1 : (double)pages * (double)sysconf(_SC_PAGESIZE) / (1 << 20);
+    }
+#endif
+
+    // Linux 上每种模式在独立子进程中运行，互不干扰；报告的是子进程峰值 RSS 相对 fork 时的增量
+    // (子进程的 ru_maxrss 含从父进程继承的常驻页)。Windows 上只报告吞吐
+    ReadResult RunIsolated(ReadResult (*fn)(const std::filesystem::path&), const std::filesystem::path& path,
+                           double* rss_growth_mb)
+    {
+        *rss_growth_mb = -1;
+#if defined(_WIN32)
+        return fn(path);
+#else
+        struct Message
+        {
+            ReadResult result;
+            double     rss_growth_mb;
+        };
+
+        int fds[2];
+        if (pipe(fds) != 0) return {};
+        std::fflush(stdout);  // 避免子进程退出时重复输出父进程缓冲区
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(fds[0]);
+            double  baseline = CurrentRssMb();
+            Message m{fn(path), -1};
+            rusage  usage{};
+            if (baseline >= 0 && getrusage(RUSAGE_SELF, &usage) == 0)
+                m.rss_growth_mb = std::max(0.0, (double)usage.ru_maxrss / 1024.0 - baseline);
+            (void)!write(fds[1], &m, sizeof(m));
+            _exit(0);
+        }
+        close(fds[1]);
+        Message m{};
+        if (read(fds[0], &m, sizeof(m)) != (ssize_t)sizeof(m)) m.result.ok = false;
+        close(fds[0]);
+
+        int status = 0;
+        if (pid > 0) waitpid(pid, &status, 0);
+        *rss_growth_mb = m.rss_growth_mb;
+        return m.result;
+#endif
+    }
+}  // namespace
+
+// 大文件读取：整文件 std::string (现状) vs 内存映射 vs 1 MiB x 4 分块预读
+// 映射模式的 RSS 是可回收的文件页，不占用匿名内存
+PESH_BENCH(file_read_modes)
+{
+    size_t                size = InputSizeBytes();
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "peshell_bench_read.bin";
+    {
+        std::ofstream     out(path, std::ios::binary | std::ios::trunc);
+        std::vector<char> block(1 << 20);
+        for (size_t i = 0; i < block.size(); ++i) block[i] = (char)(i * 131 + 7);
+        for (size_t written = 0; written < size; written += block.size()) out.write(block.data(), block.size());
+        reporter.Check((bool)out, "failed to create " + path.string());
+    }
+    reporter.Metric("input", (double)(size >> 20), "MiB");
+
+    struct Mode
+    {
+        const char* name;
+        ReadResult (*fn)(const std::filesystem::path&);
+    };
+    const Mode modes[] = {{"legacy_string", ReadLegacy}, {"mapped", ReadMapped}, {"chunked", ReadChunked}};
+
+    uint64_t expected = 0;
+    for (const Mode& mode : modes)
+    {
+        double     rss_growth_mb = -1;
+        ReadResult r             = RunIsolated(mode.fn, path, &rss_growth_mb);
+        reporter.Check(r.ok, std::string(mode.name) + " read failed");
+        if (!r.ok) continue;
+        if (expected == 0) expected = r.checksum;
+        reporter.Check(r.checksum == expected, std::string(mode.name) + " checksum mismatch");
+
+        std::string prefix(mode.name);
+        reporter.Metric(prefix + "_throughput", (double)size / (1 << 20) / r.seconds, "MB/s");
+        if (rss_growth_mb >= 0) reporter.Metric(prefix + "_rss_growth", rss_growth_mb, "MiB");
+    }
+
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
@@ -0,0 +1,152 @@
+#include "bench.h"
+#include "flight_recorder.h"
+#include "mpsc_queue.h"
+#include "trace.h"
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr size_t kCompletions = 2000000;
+
+    struct Result
+    {
+        void*   co;
+        int     code;
+        Result* mpsc_next = nullptr;
+    };
+
+    enum class Recording
+    {
+        Off,
+        OwnClock,    // FlightRecord：每条记录自己读时钟
+        SharedTicks, // FlightRecordAt：复用指标已读的时间，与 WorkerRegistry::RunNext / Scheduler::Resume 一致
+    };
+
+    // 完成热路径：工作线程执行 + 投递，主线程取出 + 恢复，两端各为运行时指标读两次时钟 (与实际路径一致)；
+    // 记录时两端各两条 (worker.run / worker.complete，coroutine.resume / coroutine.return)
+    double CompletionThroughput(Recording recording)
+    {
+        MpscQueue<Result> completed;
+        std::atomic<uint64_t> sink{0};
+        auto record = [recording](uint64_t ticks, FlightEvent event, uint64_t a) {
+            if (recording == Recording::OwnClock) FlightRecord(event, 1, 0, a);
+            else if (recording == Recording::SharedTicks) FlightRecordAt(ticks, event, 1, 0, a);
+        };
+        auto              t0 = std::chrono::steady_clock::now();
+        std::thread       producer([&] {
+            uint64_t elapsed = 0;
+            for (size_t i = 0; i < kCompletions; ++i)
+            {
+                uint64_t run_at = TraceNow();
+                record(run_at, FlightEvent::WorkerRun, i);
+                uint64_t end_at = TraceNow();
+                elapsed += end_at - run_at;
+                record(end_at, FlightEvent::WorkerComplete, i);
+                completed.Push(new Result{nullptr, 0});
+            }
+            sink += elapsed;
+        });
+        size_t   consumed = 0;
+        uint64_t elapsed  = 0;
+        while (consumed < kCompletions)
+        {
+            std::unique_ptr<Result> r{completed.Pop()};
+            if (!r)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            uint64_t begin = TraceNow();
+            record(begin, FlightEvent::CoroutineResume, (uint64_t)(uintptr_t)r.get());
+            uint64_t end = TraceNow();
+            elapsed += end - begin;
+            record(end, FlightEvent::CoroutineReturn, (uint64_t)(uintptr_t)r.get());
+            ++consumed;
+        }
+        producer.join();
+        sink += elapsed;
+        return (double)kCompletions / bench::ElapsedSeconds(t0);
+    }
+}  // namespace
+
+// 飞行记录器：单条记录开销、完成热路径上的吞吐影响，以及转储 / 解码往返
+PESH_BENCH(flight_recorder)
+{
+    constexpr size_t kRecords = 10000000;
+    for (bool enabled : {true, false})
+    {
+        SetFlightRecorderEnabled(enabled);
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kRecords; ++i) FlightRecord(FlightEvent::WorkerDispatch, 1, 7, i);
+        reporter.Metric(enabled ? "record_cost" : "record_cost_disabled", bench::ElapsedSeconds(t0) * 1e9 / kRecords, "ns");
+    }
+    SetFlightRecorderEnabled(true);
+
+    const char* message = "a log line longer than the twenty byte prefix";
+    auto        t0      = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRecords; ++i) FlightRecordText(FlightEvent::Log, 2, message, 45);
+    reporter.Metric("record_text_cost", bench::ElapsedSeconds(t0) * 1e9 / kRecords, "ns");
+
+    t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRecords; ++i) FlightRecordAt(i, FlightEvent::WorkerDispatch, 1, 7, i);
+    reporter.Metric("record_at_cost", bench::ElapsedSeconds(t0) * 1e9 / kRecords, "ns");
+
+    // record_cost 与 record_at_cost 之差基本就是读一次时钟；虚拟机上 rdtsc 可能被截获，这里单独给出
+    uint64_t ticks_sink = 0;
+    t0                  = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRecords; ++i) ticks_sink += TraceNow();
+    reporter.Metric("clock_cost", bench::ElapsedSeconds(t0) * 1e9 / kRecords, "ns");
+    reporter.Check(ticks_sink != 0, "clock must advance");
+
+    double baseline  = CompletionThroughput(Recording::Off);
+    double own_clock = CompletionThroughput(Recording::OwnClock);
+    double recording = CompletionThroughput(Recording::SharedTicks);
+    reporter.Metric("completion_baseline", baseline, "completions/s");
+    reporter.Metric("completion_recording", recording, "completions/s");
+    reporter.Metric("completion_overhead", (baseline / recording - 1.0) * 100.0, "%");
+    // 百分比相对的是没有 Lua 恢复的空完成路径；每次完成多花的绝对时间才是实际路径上的代价
+    reporter.Metric("completion_added", (1.0 / recording - 1.0 / baseline) * 1e9, "ns");
+    reporter.Metric("completion_overhead_own_clock", (baseline / own_clock - 1.0) * 100.0, "%");
+
+    // 4 个并发线程各写满并绕过环形缓冲区，转储后每个线程的最新记录都应能解出
+    std::atomic<int>         finished{0};
+    std::atomic<bool>        release{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t] {
+            for (uint64_t i = 0; i < 10000; ++i) FlightRecord(FlightEvent::TimerSchedule, 0, 0, (uint64_t)t, i);
+            FlightRecordText(FlightEvent::Log, 4, "last words", 10);
+            ++finished;
+            while (!release.load()) std::this_thread::yield();  // 退出前不交还环形缓冲区
+        });
+    }
+    while (finished.load() < 4) std::this_thread::yield();
+    FlightRecord(FlightEvent::WorkerDispatch, 1, 7, 42);
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "peshell_bench.flight";
+    bool                  dumped = !DumpFlightRecorder(FlightDumpReason::OnDemand, path).empty();
+    reporter.Check(dumped, "dump must be written");
+    release = true;
+    for (auto& t : threads) t.join();
+
+    std::ostringstream json;
+    std::string        error;
+    reporter.Check(DecodeFlightDump(path, true, json, &error), "decode failed: " + error);
+    std::string decoded   = json.str();
+    size_t      last_logs = 0;
+    for (size_t pos = 0; (pos = decoded.find("\"message\":\"last words\"", pos)) != std::string::npos; ++pos) ++last_logs;
+    reporter.Check(last_logs == 4, "every thread's newest record must survive wrap-around");
+    reporter.Check(decoded.find("\"event\":\"mark\"") != std::string::npos, "on-demand dump must carry a mark");
+
+    std::ostringstream text;
+    DecodeFlightDump(path, false, text, &error);
+    reporter.Check(text.str().find("worker.dispatch lane=1 worker=7") != std::string::npos, "text decode must name fields");
+    std::filesystem::remove(path);
+}
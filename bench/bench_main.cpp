@@ -0,0 +1,177 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <thread>
+
+namespace bench
+{
+    std::vector<Case>& Registry()
+    {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    std::vector<Result>& Results()
+    {
+        static std::vector<Result> results;
+        return results;
+    }
+
+    bool Reporter::quiet_ = false;
+
+    void Reporter::Metric(const std::string& name, double value, const char* unit)
+    {
+        Results().push_back({case_name_, name, value, unit});
+        if (!quiet_) std::printf("%-28s %-28s %16.3f %s\n", case_name_.c_str(), name.c_str(), value, unit);
+    }
+
+    void Reporter::Check(bool condition, const std::string& what)
+    {
+        if (condition) return;
+        failed_ = true;
+        std::fprintf(stderr, "%s: CHECK FAILED: %s\n", case_name_.c_str(), what.c_str());
+    }
+
+    // 时间与资源占用越小越好 (含 ms/s 这类每秒耗时)，速率与倍数越大越好，count 只作记录
+    int Direction(const std::string& unit)
+    {
+        for (const char* time : {"ns", "us", "ms", "s"})
+        {
+            size_t len = std::strlen(time);
+            if (unit.compare(0, len, time) == 0 && (unit.size() == len || unit[len] == '/')) return -1;
+        }
+        if (unit == "x" || (unit.size() > 2 && unit.compare(unit.size() - 2, 2, "/s") == 0)) return 1;
+        if (unit == "count") return 0;
+        return -1;
+    }
+}  // namespace bench
+
+namespace
+{
+    // 每个结果单独一行，读取基线时按行解析，无需完整的 JSON 解析器
+    std::string FormatJson(const std::vector<bench::Result>& results, bool failed)
+    {
+        std::string out = "{\"suite\":\"peshell_bench\",\"cpus\":" + std::to_string(std::thread::hardware_concurrency()) +
+                          ",\"failed\":" + (failed ? "true" : "false") + ",\"results\":[\n";
+        char line[512];
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const bench::Result& r = results[i];
+            std::snprintf(line, sizeof(line), "{\"case\":\"%s\",\"metric\":\"%s\",\"value\":%.9g,\"unit\":\"%s\"}%s\n",
+                          r.case_name.c_str(), r.metric.c_str(), r.value, r.unit.c_str(), i + 1 < results.size() ? "," : "");
+            out += line;
+        }
+        return out + "]}\n";
+    }
+
+    std::string Field(const std::string& line, const char* key)
+    {
+        std::string needle = std::string("\"") + key + "\":";
+        size_t      pos    = line.find(needle);
+        if (pos == std::string::npos) return {};
+        pos += needle.size();
+        if (line[pos] != '"') return line.substr(pos, line.find_first_of(",}", pos) - pos);
+        return line.substr(pos + 1, line.find('"', pos + 1) - pos - 1);
+    }
+
+    bool LoadBaseline(const char* path, std::map<std::string, bench::Result>* baseline)
+    {
+        std::ifstream in(path);
+        if (!in) return false;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.find("\"case\":") == std::string::npos) continue;
+            bench::Result r{Field(line, "case"), Field(line, "metric"), std::strtod(Field(line, "value").c_str(), nullptr),
+                            Field(line, "unit")};
+            (*baseline)[r.case_name + "/" + r.metric] = r;
+        }
+        return true;
+    }
+
+    // 变差超过 tolerance 百分比的指标记为回退，返回回退个数
+    int Compare(const std::map<std::string, bench::Result>& baseline, double tolerance, FILE* out)
+    {
+        int regressions = 0;
+        std::fprintf(out, "\n%-28s %-28s %14s %14s %9s\n", "case", "metric", "baseline", "current", "change");
+        for (const bench::Result& r : bench::Results())
+        {
+            auto it = baseline.find(r.case_name + "/" + r.metric);
+            int  direction = bench::Direction(r.unit);
+            if (it == baseline.end() || it->second.unit != r.unit || direction == 0 || it->second.value == 0) continue;
+            double change  = (r.value - it->second.value) / it->second.value * 100.0;
+            double worse   = -change * direction;
+            const char* verdict = worse > tolerance ? "  REGRESSED" : (worse < -tolerance ? "  improved" : "");
+            if (worse > tolerance) ++regressions;
+            std::fprintf(out, "%-28s %-28s %14.3f %14.3f %+8.1f%%%s\n", r.case_name.c_str(), r.metric.c_str(), it->second.value, r.value,
+                        change, verdict);
+        }
+        std::fprintf(out, "%d regression(s) beyond %.0f%%\n", regressions, tolerance);
+        return regressions;
+    }
+}  // namespace
+
+// 用法: peshell_bench [--json[=path]] [--baseline=path] [--tolerance=pct] [filter...]
+//   只运行名称包含任一 filter 的用例
+//   --json            以 JSON 代替文本表格输出到 stdout；--json=path 另写入文件
+//   --baseline=path   与先前 --json 保存的结果比较，变差超过 tolerance (默认 15%) 的指标视为回退
+// 退出码: 0 通过，1 有断言失败 (或没有匹配的用例)，2 断言通过但有性能回退
+int main(int argc, char* argv[])
+{
+    const char*              json_path     = nullptr;
+    bool                     json_stdout   = false;
+    const char*              baseline_path = nullptr;
+    double                   tolerance     = 15.0;
+    std::vector<const char*> filters;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--json") == 0) json_stdout = true;
+        else if (std::strncmp(argv[i], "--json=", 7) == 0) json_path = argv[i] + 7;
+        else if (std::strncmp(argv[i], "--baseline=", 11) == 0) baseline_path = argv[i] + 11;
+        else if (std::strncmp(argv[i], "--tolerance=", 12) == 0) tolerance = std::atof(argv[i] + 12);
+        else filters.push_back(argv[i]);
+    }
+
+    std::map<std::string, bench::Result> baseline;
+    if (baseline_path && !LoadBaseline(baseline_path, &baseline))
+    {
+        std::fprintf(stderr, "Cannot read baseline '%s'.\n", baseline_path);
+        return 1;
+    }
+
+    bench::Reporter::SetQuiet(json_stdout);
+    int  ran    = 0;
+    bool failed = false;
+    for (const bench::Case& c : bench::Registry())
+    {
+        bool selected = filters.empty();
+        for (size_t i = 0; i < filters.size() && !selected; ++i) selected = std::strstr(c.name, filters[i]) != nullptr;
+        if (!selected) continue;
+
+        bench::Reporter reporter(c.name);
+        c.fn(reporter);
+        failed = failed || reporter.Failed();
+        ++ran;
+    }
+    if (ran == 0)
+    {
+        std::fprintf(stderr, "No benchmark matched.\n");
+        return 1;
+    }
+
+    std::string json = FormatJson(bench::Results(), failed);
+    if (json_stdout) std::fputs(json.c_str(), stdout);
+    if (json_path)
+    {
+        std::ofstream out(json_path, std::ios::binary);
+        out << json;
+        if (!out) std::fprintf(stderr, "Cannot write '%s'.\n", json_path);
+    }
+    // 比较表不混入 stdout 上的 JSON
+    int regressions = baseline_path ? Compare(baseline, tolerance, json_stdout ? stderr : stdout) : 0;
+    return failed ? 1 : (regressions > 0 ? 2 : 0);
+}
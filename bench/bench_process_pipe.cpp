@@ -0,0 +1,236 @@
+#include "bench.h"
+#include "process_pipe.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <thread>
+
+#if !defined(_WIN32)
+namespace
+{
+    // 把异步回调变成同步等待，模拟 Lua 协程逐块 await
+    template <class T>
+    class Slot
+    {
+    public:
+        void Set(T value)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            value_ = std::move(value);
+            ready_ = true;
+            cv_.notify_one();
+        }
+
+        T Wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return ready_; });
+            ready_ = false;
+            return std::move(value_);
+        }
+
+    private:
+        std::mutex              mutex_;
+        std::condition_variable cv_;
+        T                       value_{};
+        bool                    ready_ = false;
+    };
+
+    std::string ReadChunk(PipedProcess& process, PipeStream stream, size_t max_bytes)
+    {
+        Slot<std::string> slot;
+        process.Read(stream, max_bytes, [&slot](std::string data) { slot.Set(std::move(data)); });
+        return slot.Wait();
+    }
+
+    // 读到 EOF；keep 为 false 时只计字节数
+    uint64_t Drain(PipedProcess& process, PipeStream stream, size_t max_bytes, std::string* keep = nullptr)
+    {
+        uint64_t total = 0;
+        while (true)
+        {
+            std::string chunk = ReadChunk(process, stream, max_bytes);
+            if (chunk.empty()) return total;
+            total += chunk.size();
+            if (keep) keep->append(chunk);
+        }
+    }
+
+    int WaitExit(PipedProcess& process)
+    {
+        Slot<int> slot;
+        process.WaitExit([&slot](int code) { slot.Set(code); });
+        return slot.Wait();
+    }
+
+    double GigabytesPerSecond(uint64_t bytes, double seconds)
+    {
+        return (double)bytes / 1e9 / seconds;
+    }
+}  // namespace
+#endif
+
+// 子进程输出捕获：popen + 阻塞 fread (改动前 io.popen 的做法) vs 反应器流式读取 1 GiB
+// (PESH_BENCH_PIPE_BYTES 可调)；背压、stdin 回显、stderr 分流与合并、Kill
+PESH_BENCH(process_pipe)
+{
+#if defined(_WIN32)
+    (void)reporter;  // 命令依赖 /bin/sh 与 coreutils，仅在 Linux 上运行
+#else
+    size_t      bytes   = bench::EnvOr("PESH_BENCH_PIPE_BYTES", (size_t)1 << 30);
+    std::string produce = "head -c " + std::to_string(bytes) + " /dev/zero";
+
+    std::string error;
+    auto        reactor = PipeReactor::Create(&error);
+    reporter.Check(reactor != nullptr, "PipeReactor::Create: " + error);
+    if (!reactor) return;
+
+    // 1. 基线：popen 同步读取
+    {
+        auto        t0   = std::chrono::steady_clock::now();
+        FILE*       pipe = popen(produce.c_str(), "r");
+        std::string buffer(64 << 10, '\0');
+        uint64_t    total = 0;
+        size_t      n;
+        while ((n = fread(&buffer[0], 1, buffer.size(), pipe)) > 0) total += n;
+        pclose(pipe);
+        reporter.Metric("popen_capture", GigabytesPerSecond(total, bench::ElapsedSeconds(t0)), "GB/s");
+        reporter.Check(total == bytes, "popen must read every byte");
+    }
+
+    // 2. 反应器：每次取 256 KiB，和 Lua 侧 read 的默认块大小一致
+    {
+        PipeSpawnOptions options;
+        options.command = produce;
+        auto t0         = std::chrono::steady_clock::now();
+        auto process    = reactor->Spawn(options, &error);
+        reporter.Check(process != nullptr, "Spawn: " + error);
+        if (!process) return;
+        uint64_t total = Drain(*process, PipeStream::Stdout, 256 << 10);
+        int      code  = WaitExit(*process);
+        reporter.Metric("stream_capture", GigabytesPerSecond(total, bench::ElapsedSeconds(t0)), "GB/s");
+        reporter.Check(total == bytes && process->BytesRead(PipeStream::Stdout) == bytes, "streaming capture must read every byte");
+        reporter.Check(code == 0, "producer must exit with 0");
+    }
+
+    // 3. 背压：不读取时子进程停在 缓冲区 + 管道容量 处，取走后继续直到结束
+    {
+        PipeSpawnOptions options;
+        options.command      = "head -c 67108864 /dev/zero";
+        options.buffer_bytes = 1 << 20;
+        auto process         = reactor->Spawn(options, &error);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        uint64_t stalled = process->BytesRead(PipeStream::Stdout);
+        reporter.Metric("backpressure_buffered", (double)stalled, "count");
+        reporter.Check(stalled == options.buffer_bytes, "an unread stream must stop at the ring capacity");
+
+        uint64_t total = Drain(*process, PipeStream::Stdout, 1 << 20);
+        reporter.Check(total == (64u << 20) && WaitExit(*process) == 0, "a paused stream must resume and finish");
+    }
+
+    // 4. stdin 回显：边写边读 8 MiB，cat 原样返回
+    {
+        PipeSpawnOptions options;
+        options.command    = "cat";
+        options.pipe_stdin = true;
+        auto process       = reactor->Spawn(options, &error);
+
+        std::string payload(8 << 20, '\0');
+        for (size_t i = 0; i < payload.size(); ++i) payload[i] = (char)(i * 31 >> 3);
+
+        auto        t0 = std::chrono::steady_clock::now();
+        Slot<bool>  writes_done;
+        std::thread writer([&] {
+            bool ok = true;
+            for (size_t off = 0; off < payload.size(); off += 64 << 10)
+            {
+                Slot<bool> written;
+                process->Write(payload.substr(off, 64 << 10), [&written](bool w, std::string) { written.Set(w); });
+                ok &= written.Wait();
+            }
+            process->CloseStdin();
+            writes_done.Set(ok);
+        });
+        std::string echoed;
+        Drain(*process, PipeStream::Stdout, 256 << 10, &echoed);
+        writer.join();
+        reporter.Metric("stdin_echo", (double)payload.size() / 1e6 / bench::ElapsedSeconds(t0), "MB/s");
+        reporter.Check(writes_done.Wait() && echoed == payload, "cat must echo stdin unchanged");
+        reporter.Check(WaitExit(*process) == 0, "cat must exit after stdin closes");
+
+        Slot<bool> late;
+        process->Write("x", [&late](bool ok, std::string) { late.Set(ok); });
+        reporter.Check(!late.Wait(), "writing after CloseStdin must fail");
+    }
+
+    // 5. stderr 分流与合并、退出码
+    {
+        PipeSpawnOptions options;
+        options.command = "echo out; echo err >&2; exit 3";
+        auto        split = reactor->Spawn(options, &error);
+        std::string out, err;
+        Drain(*split, PipeStream::Stdout, 0, &out);
+        Drain(*split, PipeStream::Stderr, 0, &err);
+        reporter.Check(out == "out\n" && err == "err\n" && WaitExit(*split) == 3, "stdout and stderr must be captured separately");
+
+        options.merge_stderr = true;
+        auto        merged   = reactor->Spawn(options, &error);
+        std::string both;
+        Drain(*merged, PipeStream::Stdout, 0, &both);
+        reporter.Check(both == "out\nerr\n" && ReadChunk(*merged, PipeStream::Stderr, 0).empty(), "merge_stderr must use one pipe");
+        reporter.Check(WaitExit(*merged) == 3, "exit code must be reported");
+
+        // 先写满 stderr 才写 stdout：只读 stdout 会卡住，ReadAny 两边都能读完
+        options.merge_stderr = false;
+        options.command      = "head -c 8388608 /dev/zero >&2; echo done";
+        auto     both_open   = reactor->Spawn(options, &error);
+        uint64_t err_bytes   = 0;
+        out.clear();
+        while (true)
+        {
+            Slot<std::pair<PipeStream, std::string>> slot;
+            both_open->ReadAny(0, [&slot](PipeStream s, std::string data) { slot.Set({s, std::move(data)}); });
+            auto chunk = slot.Wait();
+            if (chunk.second.empty()) break;
+            if (chunk.first == PipeStream::Stderr) err_bytes += chunk.second.size();
+            else out += chunk.second;
+        }
+        reporter.Check(err_bytes == (8u << 20) && out == "done\n" && WaitExit(*both_open) == 0, "ReadAny must drain both streams");
+    }
+
+    // 6. 短命令往返：启动、读完输出、取得退出码
+    {
+        constexpr int kRuns = 50;
+        PipeSpawnOptions options;
+        options.command = "echo hi";
+        bool ok         = true;
+        auto t0         = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRuns; ++i)
+        {
+            auto        process = reactor->Spawn(options, &error);
+            std::string out;
+            Drain(*process, PipeStream::Stdout, 0, &out);
+            ok &= out == "hi\n" && WaitExit(*process) == 0;
+        }
+        reporter.Metric("short_command", bench::ElapsedSeconds(t0) * 1e3 / kRuns, "ms");
+        reporter.Check(ok, "short commands must report output and exit code");
+    }
+
+    // 7. Kill 结束整个进程组 (sh 与它派生的 sleep)，Discard 后不再阻塞
+    {
+        PipeSpawnOptions options;
+        options.command = "sleep 30 & yes";
+        auto process    = reactor->Spawn(options, &error);
+        process->Discard();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        auto t0 = std::chrono::steady_clock::now();
+        process->Kill();
+        int code = WaitExit(*process);
+        reporter.Check(code == 128 + 9, "Kill must end the process with SIGKILL");
+        reporter.Check(ReadChunk(*process, PipeStream::Stdout, 0).empty(), "reads after Discard must return EOF");
+        while (reactor->Active() > 0 && bench::ElapsedSeconds(t0) < 5) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        reporter.Metric("kill_to_idle", bench::ElapsedSeconds(t0) * 1e3, "ms");
+        reporter.Check(reactor->Active() == 0, "the killed group must close its pipes");
+    }
+#endif
+}
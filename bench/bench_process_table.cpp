@@ -0,0 +1,152 @@
+#include "bench.h"
+#include "process_table.h"
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <signal.h>
+#include <strings.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+#if !defined(_WIN32)
+namespace
+{
+    constexpr size_t kSleepers = 500;
+
+    double CpuMs(clockid_t clock)
+    {
+        timespec ts;
+        clock_gettime(clock, &ts);
+        return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+    }
+
+    pid_t Spawn(const std::string& path)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            execl(path.c_str(), path.c_str(), "1000", (char*)nullptr);
+            _exit(127);
+        }
+        return pid;
+    }
+
+    void Kill(pid_t pid)
+    {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+
+    // 改动前 find_all 的做法：每次全量列举进程并逐个读取名称比较
+    size_t LegacyFindAll(const char* name)
+    {
+        size_t found = 0;
+        DIR*   dir   = opendir("/proc");
+        while (dirent* entry = readdir(dir))
+        {
+            char* end = nullptr;
+            unsigned long pid = std::strtoul(entry->d_name, &end, 10);
+            if (end == entry->d_name || *end) continue;
+            char path[64], target[4096];
+            std::snprintf(path, sizeof(path), "/proc/%lu/exe", pid);
+            ssize_t len = readlink(path, target, sizeof(target) - 1);
+            if (len <= 0) continue;
+            target[len] = 0;
+            const char* base = std::strrchr(target, '/');
+            if (strcasecmp(base ? base + 1 : target, name) == 0) ++found;
+        }
+        closedir(dir);
+        return found;
+    }
+
+    // 等待 Watch 回调，返回从 t0 起的毫秒数；超时返回 -1
+    double WaitFired(std::atomic<int>& fired, std::chrono::steady_clock::time_point t0)
+    {
+        while (!fired.load())
+        {
+            if (bench::ElapsedSeconds(t0) > 5) return -1;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        return bench::ElapsedSeconds(t0) * 1e3;
+    }
+}  // namespace
+#endif
+
+// 守护进程的 "等待同名进程全部退出"：快照轮询 vs 常驻进程表 (事件 / 比对两种模式)，500 个进程
+PESH_BENCH(process_table)
+{
+#if defined(_WIN32)
+    (void)reporter;  // 依赖 fork / /proc，仅在 Linux 上运行
+#else
+    namespace fs = std::filesystem;
+    fs::path sleeper = fs::temp_directory_path() / "pesh_bench_sleeper";
+    fs::path marker  = fs::temp_directory_path() / "pesh_bench_marker";
+    fs::copy_file("/bin/sleep", sleeper, fs::copy_options::overwrite_existing);
+    fs::copy_file("/bin/sleep", marker, fs::copy_options::overwrite_existing);
+
+    std::vector<pid_t> sleepers;
+    for (size_t i = 0; i < kSleepers; ++i) sleepers.push_back(Spawn(sleeper.string()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));  // 等全部完成 exec
+
+    // 旧做法按 200 ms 间隔轮询时每秒的 CPU 开销
+    constexpr int kSnapshots = 20;
+    size_t        found      = 0;
+    double        cpu0       = CpuMs(CLOCK_THREAD_CPUTIME_ID);
+    for (int i = 0; i < kSnapshots; ++i) found = LegacyFindAll("pesh_bench_sleeper");
+    double snapshot_ms = (CpuMs(CLOCK_THREAD_CPUTIME_ID) - cpu0) / kSnapshots;
+    reporter.Check(found == kSleepers, "legacy snapshot must see every sleeper");
+    reporter.Metric("legacy_snapshot_cpu", snapshot_ms, "ms");
+    reporter.Metric("legacy_poll_200ms_cpu", snapshot_ms * 5, "ms/s");
+
+    for (bool use_events : {true, false})
+    {
+        ProcessTableOptions options;
+        options.use_events = use_events;
+        ProcessTable table(options);
+        std::string  prefix = use_events ? "table_events" : "table_scan";
+        if (use_events && std::string(table.BackendName()) != "proc-connector")
+        {
+            reporter.Metric("table_events_unavailable", 1, "flag");  // 无 CAP_NET_ADMIN 或不在初始网络命名空间
+            continue;
+        }
+        reporter.Check(table.Find("PESH_BENCH_SLEEPER").size() == kSleepers, prefix + " index must see every sleeper");
+
+        // 空闲时服务线程的 CPU 开销 (本线程只在睡眠)
+        double idle0 = CpuMs(CLOCK_PROCESS_CPUTIME_ID);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        reporter.Metric(prefix + "_idle_cpu", CpuMs(CLOCK_PROCESS_CPUTIME_ID) - idle0, "ms/s");
+
+        std::atomic<int> appeared{0}, gone{0};
+        table.Watch(ProcessTable::WatchKind::Appeared, "pesh_bench_marker", 5000, [&](bool fired, uint32_t) {
+            if (fired) appeared = 1;
+        });
+        auto  t0  = std::chrono::steady_clock::now();
+        pid_t pid = Spawn(marker.string());
+        reporter.Metric(prefix + "_appeared_latency", WaitFired(appeared, t0), "ms");
+
+        table.Watch(ProcessTable::WatchKind::Gone, "pesh_bench_marker", 5000, [&](bool fired, uint32_t) {
+            if (fired) gone = 1;
+        });
+        t0 = std::chrono::steady_clock::now();
+        Kill(pid);
+        reporter.Metric(prefix + "_gone_latency", WaitFired(gone, t0), "ms");
+        reporter.Check(appeared && gone, prefix + " watches must fire");
+
+        ProcessTable::Stats stats = table.GetStats();
+        reporter.Metric(prefix + "_name_reads", (double)stats.name_reads, "count");
+    }
+
+    for (pid_t pid : sleepers) Kill(pid);
+    fs::remove(sleeper);
+    fs::remove(marker);
+#endif
+}
@@ -0,0 +1,153 @@
+#include "bench.h"
+#include "runtime_metrics.h"
+#include "stats_server.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "worker_registry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr size_t kOps = 200000;
+
+    // 注册表在每个线程池操作上做的指标工作：三次取刻度、四次计数、两次直方图记录
+    void InstrumentOne(RuntimeMetrics& m, uint64_t dispatch_at)
+    {
+        m.workers_dispatched.fetch_add(1, std::memory_order_relaxed);
+        uint64_t run_at = TraceNow();
+        m.workers_started.fetch_add(1, std::memory_order_relaxed);
+        m.worker_queue_wait.Record(run_at - dispatch_at);
+        m.worker_exec.Record(TraceNow() - run_at);
+        m.workers_finished.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // threads 个线程同时做上述工作，返回每个操作的平均开销 (纳秒)
+    double InstrumentationCost(size_t threads)
+    {
+        constexpr size_t         kPerThread = 2000000;
+        RuntimeMetrics&          m          = Metrics();
+        std::atomic<bool>        go{false};
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&] {
+                while (!go.load()) std::this_thread::yield();
+                for (size_t i = 0; i < kPerThread; ++i) InstrumentOne(m, TraceNow());
+            });
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        go      = true;
+        for (auto& w : workers) w.join();
+        return bench::ElapsedSeconds(t0) * 1e9 / kPerThread;
+    }
+}  // namespace
+
+// 运行时指标：直方图精度、派发路径上的计数开销 (单线程 / 多线程竞争)，以及本地查询通道的往返
+PESH_BENCH(runtime_metrics)
+{
+    // 精度：对数正态分布的样本，各分位数与精确值的相对误差不超过 1/16
+    LatencyHistogram             hist;
+    std::vector<uint64_t>        samples(1000000);
+    std::mt19937_64              rng(42);
+    std::lognormal_distribution<> dist(10.0, 1.5);
+    for (auto& v : samples) v = (uint64_t)dist(rng) + 1;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint64_t v : samples) hist.Record(v);
+    reporter.Metric("record_cost", bench::ElapsedSeconds(t0) * 1e9 / (double)samples.size(), "ns");
+    std::sort(samples.begin(), samples.end());
+    LatencyHistogram::Summary summary = hist.Summarize(1.0);
+    double worst = 0;
+    for (auto [q, got] : {std::pair<double, double>{0.5, summary.p50}, {0.9, summary.p90}, {0.99, summary.p99}, {0.999, summary.p999}})
+    {
+        double exact = (double)samples[(size_t)std::ceil(q * (double)samples.size()) - 1];
+        worst        = std::max(worst, std::fabs(got - exact) / exact);
+    }
+    reporter.Metric("percentile_error", worst * 100.0, "%");
+    reporter.Check(summary.count == samples.size(), "histogram must count every sample");
+    reporter.Check(worst <= 1.0 / LatencyHistogram::kSubBuckets, "percentiles must stay within one sub-bucket");
+    reporter.Check(summary.max == (double)samples.back(), "max must be exact");
+    reporter.Check(LatencyHistogram::Bucket(UINT64_MAX) == LatencyHistogram::kBuckets - 1, "buckets must cover uint64");
+
+    // 竞争只在多核上有意义，单核机器上退化为单线程的数字
+    size_t threads   = std::min<size_t>(4, std::max(1u, std::thread::hardware_concurrency()));
+    double single    = InstrumentationCost(1);
+    double contended = threads > 1 ? InstrumentationCost(threads) : single;
+    reporter.Metric("dispatch_metrics_cost", single, "ns/op");
+    reporter.Metric("dispatch_metrics_cost_contended", contended, "ns/op");
+
+    // 实际往返：注册表 + 线程池的空操作，指标常开；开销占比按上面的竞争开销估算
+    int id = WorkerRegistry::Instance().Register(
+        "bench_metrics_noop", {WorkerValueType::Integer},
+        [](const WorkerArgs& args, const WorkerContext&) { return WorkerResult::Ok(args[0]); }, TaskLane::Cpu);
+    std::atomic<size_t> completed{0};
+    ThreadPoolOptions   options;
+    options.cpu_threads = 4;
+    ThreadPool pool(options);
+    WorkerRegistry::Instance().SetHooks(
+        [&pool](std::function<void()> task, TaskLane lane) { pool.Push(std::move(task), lane); },
+        [&completed](void*, WorkerResult) { completed.fetch_add(1, std::memory_order_relaxed); });
+    uint64_t dispatched_before = Metrics().workers_dispatched.load();
+    t0                         = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kOps; ++i) WorkerRegistry::Instance().Dispatch(id, {WorkerValue::Integer((int64_t)i)}, 0, nullptr);
+    while (completed.load() < kOps) std::this_thread::yield();
+    double per_op_ns = bench::ElapsedSeconds(t0) * 1e9 / kOps;
+    reporter.Metric("worker_round_trip", per_op_ns, "ns/op");
+    reporter.Metric("dispatch_metrics_share", contended / per_op_ns * 100.0, "%");
+    reporter.Check(Metrics().workers_dispatched.load() - dispatched_before == kOps, "every dispatch must be counted");
+
+    // 查询通道：另一个进程看到的就是这里的快照
+    MetricsSnapshot local = SnapshotMetrics();
+    std::string     error;
+    auto            server = StatsServer::Start(local.pid, &error);
+    reporter.Check(server != nullptr, "stats endpoint must start: " + error);
+    if (!server) return;
+    std::vector<uint64_t> endpoints = ListStatsEndpoints();
+    reporter.Check(std::find(endpoints.begin(), endpoints.end(), local.pid) != endpoints.end(),
+                   "endpoint must be discoverable");
+    reporter.Check(!StatsServer::Start(local.pid, &error), "a second endpoint for the same pid must be refused");
+
+    constexpr int kQueries = 200;
+    std::string   text, json;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < kQueries; ++i) QueryStats(local.pid, true, &json, &error);
+    reporter.Metric("query_round_trip", bench::ElapsedSeconds(t0) * 1e6 / kQueries, "us");
+    reporter.Check(QueryStats(local.pid, false, &text, &error), "text query failed: " + error);
+    reporter.Check(server->Served() == kQueries + 1, "every query must be served");
+    reporter.Check(json.find("\"workers_dispatched\":") != std::string::npos && json.find("\"worker_queue_wait\":{\"count\":") != std::string::npos,
+                   "json snapshot must carry counters and latencies");
+    reporter.Check(text.find("workers_queued") != std::string::npos && text.find("p99.9") != std::string::npos,
+                   "text snapshot must be a table");
+
+#if !defined(_WIN32)
+    // 其他用户的查询得不到指标 (需要 root 才能在子进程中切换到 nobody)
+    if (geteuid() == 0)
+    {
+        uint64_t served_before = server->Served();
+        pid_t    child         = fork();
+        if (child == 0)
+        {
+            std::string out, err;
+            if (setuid(65534) != 0) _exit(2);
+            _exit(QueryStats(local.pid, false, &out, &err) && !out.empty() ? 1 : 0);
+        }
+        int status = -1;
+        if (child > 0) waitpid(child, &status, 0);
+        reporter.Check(child > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0 && server->Served() == served_before,
+                       "a client running as another user must not be served");
+    }
+#endif
+
+    server.reset();
+    reporter.Check(!QueryStats(local.pid, true, &json, &error), "a stopped endpoint must refuse queries");
+}
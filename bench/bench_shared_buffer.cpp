@@ -0,0 +1,76 @@
+#include "bench.h"
+#include "shared_buffer.h"
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr size_t kPayload   = 64u << 20;
+    constexpr int    kConsumers = 4;
+
+    std::atomic<int> g_adopted_releases{0};
+
+    void CountRelease(pesh_buffer* buffer)
+    {
+        g_adopted_releases.fetch_add(1);
+        delete[] buffer->data;
+        delete buffer;
+    }
+}  // namespace
+
+// 共享缓冲区：把大块数据交给多个 Lua 工作者状态时，复制为字符串 vs 只传引用；多线程 retain / release 的正确性
+PESH_BENCH(shared_buffer)
+{
+    pesh_shared* shared = NewSharedBuffer(kPayload);
+    reporter.Check(shared && shared->size == kPayload && shared->data[kPayload - 1] == 0, "new buffers must be zeroed");
+    if (!shared) return;
+    std::memset(shared->data, 0x5a, kPayload);
+
+    // 旧做法：每个接收方一份字符串副本 (LuaMessage 对字符串的处理)
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < kConsumers; ++i)
+    {
+        std::string copy(reinterpret_cast<const char*>(shared->data), kPayload);
+        reporter.Check(copy.back() == 0x5a, "copy must be complete");
+    }
+    double copy_ms = bench::ElapsedSeconds(t0) * 1e3;
+
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < kConsumers; ++i) shared->retain(shared);
+    for (int i = 0; i < kConsumers; ++i) shared->release(shared);
+    double share_ms = bench::ElapsedSeconds(t0) * 1e3;
+    reporter.Metric("send_64mb_x4_copy", copy_ms, "ms");
+    reporter.Metric("send_64mb_x4_shared", share_ms * 1e3, "us");
+
+    // 多个线程同时增减引用：只有最后一个 release 释放，且恰好一次
+    constexpr int kRounds = 1000000;
+    auto*         data    = new uint8_t[16];
+    pesh_shared*  adopted = AdoptSharedBuffer(new pesh_buffer{data, 16, CountRelease});
+    reporter.Check(adopted->readonly == 1 && adopted->data == data, "adopted buffers must alias the original data");
+    std::vector<std::thread> threads;
+    t0 = std::chrono::steady_clock::now();
+    for (int t = 0; t < kConsumers; ++t)
+    {
+        threads.emplace_back([adopted] {
+            for (int i = 0; i < kRounds; ++i)
+            {
+                adopted->retain(adopted);
+                adopted->release(adopted);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    reporter.Metric("retain_release_contended", bench::ElapsedSeconds(t0) * 1e9 / (kRounds * (double)kConsumers), "ns");
+    reporter.Check(g_adopted_releases.load() == 0 && IsSharedBuffer(adopted), "buffer must survive balanced retains");
+    adopted->release(adopted);
+    reporter.Check(g_adopted_releases.load() == 1, "the last release must release the adopted buffer exactly once");
+    reporter.Check(!IsSharedBuffer(adopted), "released buffers must not validate");
+
+    int on_stack = 0;
+    reporter.Check(!IsSharedBuffer(&on_stack) && !IsSharedBuffer(nullptr), "arbitrary pointers must not validate");
+    shared->release(shared);
+}
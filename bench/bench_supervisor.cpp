@@ -0,0 +1,219 @@
+#include "bench.h"
+#include "supervisor.h"
+
+#if !defined(_WIN32)
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if !defined(_WIN32)
+namespace
+{
+    double CpuMs()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+    }
+
+    // 持续取事件直到监督器销毁
+    class Collector
+    {
+    public:
+        void Arm(Supervisor* supervisor)
+        {
+            supervisor->NextEvent([this, supervisor](const ServiceEvent* event) {
+                if (!event) return;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    events_.push_back(*event);
+                }
+                cv_.notify_all();
+                Arm(supervisor);
+            });
+        }
+
+        // 等到满足条件的事件累计 count 个
+        template <class Pred>
+        bool WaitFor(size_t count, Pred pred, int timeout_ms = 5000)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            return cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] {
+                return (size_t)std::count_if(events_.begin(), events_.end(), pred) >= count;
+            });
+        }
+
+        std::vector<ServiceEvent> Events()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return events_;
+        }
+
+    private:
+        std::mutex                mutex_;
+        std::condition_variable   cv_;
+        std::vector<ServiceEvent> events_;
+    };
+
+    auto IsType(ServiceEvent::Type type)
+    {
+        return [type](const ServiceEvent& event) { return event.type == type; };
+    }
+
+    ServiceSpec Spec(const char* name, const std::string& command)
+    {
+        ServiceSpec spec;
+        spec.name    = name;
+        spec.command = command;
+        return spec;
+    }
+
+    pid_t SpawnShell(const char* command)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            execl("/bin/sh", "sh", "-c", command, (char*)nullptr);
+            _exit(127);
+        }
+        return pid;
+    }
+}  // namespace
+#endif
+
+// 常驻服务的崩溃重启：按 50 ms 轮询退出 (改动前的 wait_for_exit_pump) vs 监督器的 pidfd 等待
+PESH_BENCH(supervisor)
+{
+#if defined(_WIN32)
+    (void)reporter;  // 依赖 fork / pidfd，仅在 Linux 上运行
+#else
+    constexpr int kCycles = 40;
+
+    // 立即退出的服务：一次 "退出 -> 发现 -> 重新启动" 的往返
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < kCycles; ++i)
+        {
+            pid_t pid = SpawnShell("exit 0");
+            int   status;
+            while (waitpid(pid, &status, WNOHANG) == 0) std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        reporter.Metric("legacy_poll_restart_cycle", bench::ElapsedSeconds(t0) * 1e3 / kCycles, "ms");
+    }
+    {
+        ServiceSpec spec        = Spec("flappy", "exit 0");
+        spec.backoff_initial_ms = 0;
+        spec.jitter             = 0;
+        spec.max_restarts       = 0;
+        Collector collector;
+        auto      t0         = std::chrono::steady_clock::now();
+        auto      supervisor = Supervisor::Create({spec});
+        collector.Arm(supervisor.get());
+        bool done = collector.WaitFor(kCycles + 1, IsType(ServiceEvent::Type::Started));
+        reporter.Metric("supervisor_restart_cycle", bench::ElapsedSeconds(t0) * 1e3 / kCycles, "ms");
+        reporter.Check(done, "flapping service must be restarted " + std::to_string(kCycles) + " times");
+    }
+
+    // 20 个常驻服务空闲 1 秒的 CPU 开销
+    constexpr int kIdle = 20;
+    {
+        std::vector<pid_t> pids;
+        for (int i = 0; i < kIdle; ++i) pids.push_back(SpawnShell("exec sleep 1000"));
+        double cpu0 = CpuMs();
+        auto   t0   = std::chrono::steady_clock::now();
+        while (bench::ElapsedSeconds(t0) < 1)
+        {
+            for (pid_t pid : pids) waitpid(pid, nullptr, WNOHANG);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        reporter.Metric("legacy_poll_idle_cpu", CpuMs() - cpu0, "ms/s");
+        for (pid_t pid : pids)
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    {
+        std::vector<ServiceSpec> specs;
+        for (int i = 0; i < kIdle; ++i) specs.push_back(Spec("idle", "exec sleep 1000"));
+        Collector collector;
+        auto      supervisor = Supervisor::Create(specs);
+        collector.Arm(supervisor.get());
+        reporter.Check(collector.WaitFor(kIdle, IsType(ServiceEvent::Type::Started)), "idle services must start");
+        double cpu0 = CpuMs();
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        reporter.Metric("supervisor_idle_cpu", CpuMs() - cpu0, "ms/s");
+    }
+
+    // 退避逐次翻倍，超过频率限制后进入 Failed
+    {
+        ServiceSpec spec        = Spec("crashy", "exit 3");
+        spec.restart            = RestartPolicy::OnFailure;
+        spec.backoff_initial_ms = 10;
+        spec.jitter             = 0;
+        spec.max_restarts       = 4;
+        Collector collector;
+        auto      supervisor = Supervisor::Create({spec});
+        collector.Arm(supervisor.get());
+        bool failed = collector.WaitFor(1, IsType(ServiceEvent::Type::Failed));
+        reporter.Check(failed, "restart limit must mark the service failed");
+
+        std::vector<int64_t> delays;
+        for (const ServiceEvent& event : collector.Events())
+        {
+            if (event.type != ServiceEvent::Type::Exited) continue;
+            delays.push_back(event.delay_ms);
+            reporter.Check(event.exit_code == 3, "exit code must be reported");
+        }
+        reporter.Check(delays == std::vector<int64_t>({10, 20, 40, 80, -1}), "backoff must double until the limit");
+        reporter.Check(supervisor->Status()[0].state == ServiceState::Failed && supervisor->Status()[0].restarts == 4,
+                       "status must show the failed service and its restarts");
+    }
+
+    // 顺序启动、逆序停止；不响应 SIGTERM 的服务在超时后被强制结束
+    {
+        // Started 只说明 sh 已经启动；c 装好 trap 后留下标记，之后才能停止，否则 SIGTERM 可能抢在 trap 之前
+        std::string marker = "/tmp/peshell_bench_trap_" + std::to_string(getpid());
+        unlink(marker.c_str());
+        std::vector<ServiceSpec> specs = {Spec("a", "exec sleep 1000"), Spec("b", "exec sleep 1000"),
+                                          Spec("c", "trap '' TERM; : > " + marker + "; sleep 1000")};
+        specs[2].stop_timeout_ms = 100;
+        Collector collector;
+        auto      supervisor = Supervisor::Create(specs);
+        collector.Arm(supervisor.get());
+        reporter.Check(collector.WaitFor(3, IsType(ServiceEvent::Type::Started)), "services must start");
+        for (int i = 0; i < 500 && access(marker.c_str(), F_OK) != 0; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        unlink(marker.c_str());
+
+        std::atomic<bool> stopped{false};
+        auto              t0 = std::chrono::steady_clock::now();
+        supervisor->Stop([&] { stopped = true; });
+        reporter.Check(collector.WaitFor(3, IsType(ServiceEvent::Type::Stopped)), "services must stop");
+        double stop_ms = bench::ElapsedSeconds(t0) * 1e3;
+        reporter.Metric("ordered_stop", stop_ms, "ms");
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        reporter.Check(stopped.load(), "stop callback must fire");
+
+        std::string order;
+        std::vector<int> codes;
+        for (const ServiceEvent& event : collector.Events())
+        {
+            order += event.service;
+            if (event.type == ServiceEvent::Type::Stopped) codes.push_back(event.exit_code);
+        }
+        reporter.Check(order == "abccba", "start in order, stop in reverse: got " + order);
+        reporter.Check(codes == std::vector<int>({128 + SIGKILL, 128 + SIGTERM, 128 + SIGTERM}),
+                       "stubborn service must be killed, the rest terminated");
+        reporter.Check(stop_ms >= 100, "kill must wait for stop_timeout_ms");
+    }
+#endif
+}
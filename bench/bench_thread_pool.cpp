@@ -0,0 +1,137 @@
+#include "bench.h"
+#include "thread_pool.h"
+
+#include <ctpl_stl.h>
+
+#include <algorithm>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr size_t kSampleEvery = 16;
+
+    struct RunResult
+    {
+        double              seconds = 0;
+        std::vector<double> latency_us;  // 提交到开始执行，已排序
+    };
+
+    // producers 个线程共提交 total 个空任务，每 kSampleEvery 个记录一次排队延迟
+    template <typename PushFn>
+    RunResult Run(size_t producers, size_t total, PushFn push)
+    {
+        std::atomic<size_t> done{0};
+        std::mutex          samples_mutex;
+        RunResult           result;
+        result.latency_us.reserve(total / kSampleEvery + producers);
+
+        auto                     t0 = Clock::now();
+        std::vector<std::thread> threads;
+        for (size_t p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&, p] {
+                size_t count = total / producers + (p < total % producers ? 1 : 0);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (i % kSampleEvery != 0)
+                    {
+                        push([&done] { done.fetch_add(1); });
+                        continue;
+                    }
+                    auto submitted = Clock::now();
+                    push([&, submitted] {
+                        double us = std::chrono::duration<double, std::micro>(Clock::now() - submitted).count();
+                        {
+                            std::lock_guard<std::mutex> lock(samples_mutex);
+                            result.latency_us.push_back(us);
+                        }
+                        done.fetch_add(1);
+                    });
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+        while (done.load() < total) std::this_thread::yield();
+        result.seconds = bench::ElapsedSeconds(t0);
+        std::sort(result.latency_us.begin(), result.latency_us.end());
+        return result;
+    }
+
+    void Report(bench::Reporter& reporter, const std::string& prefix, size_t total, const RunResult& r)
+    {
+        reporter.Metric(prefix + "_throughput", (double)total / r.seconds, "tasks/s");
+        reporter.Metric(prefix + "_latency_p50", bench::Percentile(r.latency_us, 0.50), "us");
+        reporter.Metric(prefix + "_latency_p99", bench::Percentile(r.latency_us, 0.99), "us");
+    }
+}  // namespace
+
+// 任务派发吞吐与排队延迟：ThreadPool (CPU 通道) vs ctpl::thread_pool，1 / 4 / 16 个生产者线程
+PESH_BENCH(thread_pool)
+{
+    size_t total   = bench::EnvOr("PESH_BENCH_POOL_TASKS", 1000000);
+    size_t threads = std::max<unsigned>(1, std::thread::hardware_concurrency());
+
+    for (size_t producers : {(size_t)1, (size_t)4, (size_t)16})
+    {
+        std::string suffix = "_p" + std::to_string(producers);
+        {
+            ctpl::thread_pool pool((int)threads);
+            RunResult         r = Run(producers, total, [&](std::function<void()> task) {
+                pool.push([task](int) { task(); });
+            });
+            Report(reporter, "ctpl" + suffix, total, r);
+            pool.stop(true);
+        }
+        {
+            ThreadPoolOptions options;
+            options.cpu_threads = threads;
+            ThreadPool pool(options);
+            RunResult  r = Run(producers, total, [&](std::function<void()> task) { pool.Push(std::move(task)); });
+            Report(reporter, "pool" + suffix, total, r);
+        }
+    }
+
+    // Stop(true) 执行完排队任务以及任务在停止期间再提交的任务
+    {
+        ThreadPool          pool;
+        std::atomic<size_t> ran{0};
+        for (int i = 0; i < 1000; ++i)
+        {
+            pool.Push([&] {
+                ++ran;
+                pool.Push([&] { ++ran; }, TaskLane::Io);
+            });
+        }
+        pool.Stop(true);
+        reporter.Check(ran.load() == 2000, "Stop(true) must run every queued and nested task");
+        reporter.Check(!pool.Push([] {}), "Push after Stop must be rejected");
+    }
+
+    // 慢速阻塞 I/O 占满常驻 I/O 线程时，I/O 通道扩容、CPU 通道不受影响
+    {
+        ThreadPoolOptions options;
+        options.io_threads     = 2;
+        options.io_max_threads = 8;
+        ThreadPool       pool(options);
+        std::atomic<int> release{0};
+        for (int i = 0; i < 8; ++i)
+        {
+            pool.Push([&] {
+                while (!release.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }, TaskLane::Io);
+        }
+
+        auto             t0 = Clock::now();
+        std::atomic<int> cpu_done{0};
+        pool.Push([&] { ++cpu_done; });
+        while (!cpu_done.load()) std::this_thread::yield();
+        reporter.Metric("cpu_latency_under_io_load", bench::ElapsedSeconds(t0) * 1e6, "us");
+
+        std::atomic<int> io_done{0};
+        pool.Push([&] { ++io_done; }, TaskLane::Io);
+        reporter.Check(pool.IoThreads() == 8, "I/O lane must grow to its limit under blocking load");
+        release = 1;
+        while (!io_done.load()) std::this_thread::yield();
+    }
+}
@@ -0,0 +1,170 @@
+#include "bench.h"
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+
+namespace
+{
+    constexpr size_t kConcurrentTimers = 10000;
+}
+
+// 虚拟时钟下的纯数据结构吞吐：调度 / 到期 / 取消
+PESH_BENCH(timer_wheel_throughput)
+{
+    std::mt19937                            rng(42);
+    std::uniform_int_distribution<uint32_t> delay(1, 60000);
+    TimerWheel                              wheel(0);
+    std::vector<TimerWheel::Expired>        expired;
+    expired.reserve(kConcurrentTimers);
+
+    const int rounds = 20;
+    double    schedule_s = 0, fire_s = 0, cancel_s = 0;
+    uint64_t  now = 0;
+    size_t    fired = 0, early_fires = 0, cancelled = 0;
+    for (int r = 0; r < rounds; ++r)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kConcurrentTimers; ++i) wheel.Schedule(now, delay(rng), nullptr);
+        schedule_s += bench::ElapsedSeconds(t0);
+
+        t0 = std::chrono::steady_clock::now();
+        while (wheel.Size() > 0)
+        {
+            int64_t next = wheel.NextTimeoutMs(now);
+            now += (uint64_t)std::max<int64_t>(next, 1);
+            wheel.Advance(now, expired);
+            if (!expired.empty() && expired.back().deadline_ms > now) ++early_fires;  // 按到期顺序追加，末尾最晚
+        }
+        fire_s += bench::ElapsedSeconds(t0);
+        fired += expired.size();
+        expired.clear();
+
+        std::vector<TimerWheel::TimerId> ids;
+        ids.reserve(kConcurrentTimers);
+        for (size_t i = 0; i < kConcurrentTimers; ++i) ids.push_back(wheel.Schedule(now, delay(rng), nullptr));
+        t0 = std::chrono::steady_clock::now();
+        for (auto id : ids) cancelled += wheel.Cancel(id) ? 1 : 0;
+        cancel_s += bench::ElapsedSeconds(t0);
+    }
+
+    double total = (double)kConcurrentTimers * rounds;
+    reporter.Metric("schedule", total / schedule_s, "ops/s");
+    reporter.Metric("expire", total / fire_s, "ops/s");
+    reporter.Metric("cancel", total / cancel_s, "ops/s");
+    reporter.Check(early_fires == 0, "no timer fires before its deadline");
+    reporter.Check(fired == kConcurrentTimers * rounds, "every scheduled timer fires exactly once");
+    reporter.Check(cancelled == kConcurrentTimers * rounds && wheel.Size() == 0, "every pending timer can be cancelled");
+}
+
+// 真实时钟下 10k 并发定时器的到期误差 (单线程，与事件循环的等待方式一致)
+PESH_BENCH(timer_wheel_accuracy)
+{
+    std::mt19937                            rng(7);
+    std::uniform_int_distribution<uint32_t> delay(1, 2000);
+    uint64_t                                start = MonotonicNowMs();
+    TimerWheel                              wheel(start);
+    for (size_t i = 0; i < kConcurrentTimers; ++i) wheel.Schedule(start, delay(rng), nullptr);
+
+    std::vector<TimerWheel::Expired> expired;
+    std::vector<double>              lateness;
+    lateness.reserve(kConcurrentTimers);
+    size_t wakeups = 0, early = 0, fired = 0;
+    while (wheel.Size() > 0)
+    {
+        int64_t next = wheel.NextTimeoutMs(MonotonicNowMs());
+        if (next > 0) std::this_thread::sleep_for(std::chrono::milliseconds(next));
+        ++wakeups;
+
+        uint64_t now = MonotonicNowMs();
+        expired.clear();
+        wheel.Advance(now, expired);
+        fired += expired.size();
+        for (const auto& e : expired)
+        {
+            if (now < e.deadline_ms) ++early;
+            lateness.push_back((double)now - (double)e.deadline_ms);
+        }
+    }
+
+    std::sort(lateness.begin(), lateness.end());
+    reporter.Metric("lateness_p50", bench::Percentile(lateness, 0.50), "ms");
+    reporter.Metric("lateness_p99", bench::Percentile(lateness, 0.99), "ms");
+    reporter.Metric("lateness_max", lateness.empty() ? 0.0 : lateness.back(), "ms");
+    reporter.Metric("early_fires", (double)early, "count");
+    reporter.Metric("wakeups", (double)wakeups, "count");
+    reporter.Check(early == 0, "no timer fires before its deadline");
+    reporter.Check(fired == kConcurrentTimers, "every scheduled timer fires exactly once");
+}
+
+// 虚拟时钟下跨级别的取消与重新设置：定时器分布在全部 5 级，推进一段 (部分已级联到低级) 后取消一半并以
+// 落在另一级的延迟重新设置。每个定时器只按最后一次设置的 deadline 准时到期一次，被取消的不会到期
+PESH_BENCH(timer_wheel_rearm)
+{
+    // 各级的延迟范围：256 ms / 16 s / 17 min / 18 h / 49 天
+    static const uint64_t kLevelSpan[] = {1ull << 8, 1ull << 14, 1ull << 20, 1ull << 26, 1ull << 32};
+    const size_t          count = 5000;
+
+    std::mt19937 rng(11);
+    auto         level_delay = [&](int level) {
+        uint64_t lo = level == 0 ? 1 : kLevelSpan[level - 1];
+        return std::uniform_int_distribution<uint64_t>(lo, kLevelSpan[level] - 1)(rng);
+    };
+
+    TimerWheel                       wheel(0);
+    std::vector<TimerWheel::TimerId> ids(count);
+    std::vector<uint64_t>            deadline(count);
+    std::vector<int>                 fire_count(count, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        deadline[i] = level_delay((int)(i % 5));
+        ids[i]      = wheel.ScheduleAt(deadline[i], (void*)(uintptr_t)i);
+    }
+
+    // 推进到第 2 级范围中间：第 0/1 级的定时器已到期，更高级的部分已级联
+    std::vector<TimerWheel::Expired> expired;
+    uint64_t                         now = 0;
+    size_t                           early = 0, late = 0;
+    auto                             run_until = [&](uint64_t limit) {
+        while (wheel.Size() > 0)
+        {
+            int64_t next = wheel.NextTimeoutMs(now);
+            if (now + (uint64_t)std::max<int64_t>(next, 1) > limit) break;
+            now += (uint64_t)std::max<int64_t>(next, 1);
+            expired.clear();
+            wheel.Advance(now, expired);
+            for (const auto& e : expired)
+            {
+                size_t i = (size_t)(uintptr_t)e.payload;
+                ++fire_count[i];
+                if (now < deadline[i]) ++early;
+                if (now > deadline[i]) ++late;
+            }
+        }
+    };
+    run_until(1ull << 19);
+
+    size_t rearmed = 0, cancelled_ok = 0;
+    auto   t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i += 2)
+    {
+        if (deadline[i] <= now) continue;
+        cancelled_ok += wheel.Cancel(ids[i]) ? 1 : 0;
+        int level   = (int)((i / 2) % 5);  // 与原来的级别错开
+        deadline[i] = now + level_delay(level);
+        ids[i]      = wheel.ScheduleAt(deadline[i], (void*)(uintptr_t)i);
+        ++rearmed;
+    }
+    double rearm_s = bench::ElapsedSeconds(t0);
+    run_until(UINT64_MAX);
+
+    size_t wrong = 0;
+    for (int c : fire_count) wrong += c == 1 ? 0 : 1;
+    reporter.Metric("rearm", (double)rearmed / rearm_s, "ops/s");
+    reporter.Metric("rearmed", (double)rearmed, "count");
+    reporter.Check(cancelled_ok == rearmed, "every pending timer can be cancelled before re-arming");
+    reporter.Check(wrong == 0, "every timer fires exactly once, cancelled deadlines never");
+    reporter.Check(early == 0 && late == 0, "re-armed timers fire exactly at their new deadline");
+    reporter.Check(wheel.Size() == 0, "the wheel is empty afterwards");
+}
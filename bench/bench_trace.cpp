@@ -0,0 +1,101 @@
+#include "bench.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "worker_registry.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace
+{
+    constexpr size_t kOps = 200000;
+
+    // 经注册表派发到线程池的空操作往返，与 main.cpp 的接线一致，只是完成计数代替调度器投递
+    double WorkerThroughput(int id, const std::atomic<size_t>& completed)
+    {
+        WorkerRegistry& registry = WorkerRegistry::Instance();
+        size_t          target   = completed.load() + kOps;
+        auto            t0       = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kOps; ++i) registry.Dispatch(id, {WorkerValue::Integer((int64_t)i)}, 0, nullptr);
+        while (completed.load() < target) std::this_thread::yield();
+        return (double)kOps / bench::ElapsedSeconds(t0);
+    }
+
+    size_t Count(const std::string& text, const std::string& needle)
+    {
+        size_t count = 0;
+        for (size_t pos = 0; (pos = text.find(needle, pos)) != std::string::npos; pos += needle.size()) ++count;
+        return count;
+    }
+}  // namespace
+
+// 追踪：关闭 / 开启时的单个 span 开销、工作者往返吞吐的影响，以及 Chrome trace JSON 的内容
+PESH_BENCH(trace)
+{
+    constexpr size_t kSpans = 10000000;
+    uint32_t         name   = TraceName("bench span");
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kSpans; ++i) TraceScope span(name, TraceCategory::Lua);
+    reporter.Metric("scope_cost_disabled", bench::ElapsedSeconds(t0) * 1e9 / kSpans, "ns");
+
+    int id = WorkerRegistry::Instance().Register(
+        "bench_trace_noop", {WorkerValueType::Integer},
+        [](const WorkerArgs& args, const WorkerContext&) { return WorkerResult::Ok(args[0]); }, TaskLane::Cpu);
+    ThreadPoolOptions options;
+    options.cpu_threads = 4;
+    std::atomic<size_t> completed{0};  // 比线程池活得久：计数之后工作线程仍在完成回调中
+    ThreadPool          pool(options);
+    WorkerRegistry::Instance().SetHooks(
+        [&pool](std::function<void()> task, TaskLane lane) { pool.Push(std::move(task), lane); },
+        [&completed](void*, WorkerResult) { completed.fetch_add(1, std::memory_order_relaxed); });
+    double baseline = WorkerThroughput(id, completed);
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "peshell_bench.trace.json";
+    StartTracing(true, path);
+    SetTraceThreadName("bench main");
+
+    constexpr size_t kEnabledSpans = 1000000;  // 每线程上限之内
+    t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kEnabledSpans; ++i) TraceScope span(name, TraceCategory::Lua);
+    reporter.Metric("scope_cost", bench::ElapsedSeconds(t0) * 1e9 / kEnabledSpans, "ns");
+
+    double traced = WorkerThroughput(id, completed);
+    reporter.Metric("worker_baseline", baseline, "ops/s");
+    reporter.Metric("worker_traced", traced, "ops/s");
+    reporter.Metric("worker_overhead", (baseline / traced - 1.0) * 100.0, "%");
+
+    // 跨线程的异步 span：在一个线程上开始、另一个线程上结束
+    uint32_t    async_name = TraceName("cross \"thread\"");
+    uint64_t    async_id   = TraceNextId();
+    TraceAsyncBegin(async_name, TraceCategory::Lua, async_id, TraceNow());
+    std::thread([&] { TraceAsyncEnd(async_name, TraceCategory::Lua, async_id, TraceNow()); }).join();
+    StopTracing();
+
+    std::string error;
+    t0 = std::chrono::steady_clock::now();
+    reporter.Check(WriteTrace(&error) == path, "trace must be written: " + error);
+    reporter.Metric("write_time", bench::ElapsedSeconds(t0) * 1e3, "ms");
+    reporter.Metric("trace_size", (double)std::filesystem::file_size(path) / (1024.0 * 1024.0), "MiB");
+
+    std::stringstream content;
+    content << std::ifstream(path, std::ios::binary).rdbuf();
+    std::string json = content.str();
+    reporter.Check(json.rfind("{\"traceEvents\":[", 0) == 0 && json.find("\n],\"displayTimeUnit\"") != std::string::npos,
+                   "output must be a Chrome trace-event document");
+    // 每个操作一对排队 b/e 与一个执行 X，两者分开可见
+    std::string queue  = "{\"name\":\"bench_trace_noop\",\"cat\":\"queue\",\"ph\":\"";
+    std::string worker = "{\"name\":\"bench_trace_noop\",\"cat\":\"worker\",\"ph\":\"X\"";
+    reporter.Check(Count(json, queue + "b\"") == kOps && Count(json, queue + "e\"") == kOps,
+                   "every dispatched op must carry a queue-wait span");
+    reporter.Check(Count(json, worker) == kOps, "every dispatched op must carry an execution span");
+    reporter.Check(Count(json, "\"name\":\"bench span\"") == kEnabledSpans, "scoped spans must all be recorded");
+    reporter.Check(Count(json, "\"name\":\"cross \\\"thread\\\"\"") == 2, "names must be JSON-escaped");
+    reporter.Check(json.find("\"args\":{\"name\":\"bench main\"}") != std::string::npos, "thread names must be emitted");
+    reporter.Check(json.find("\"args\":{\"name\":\"cpu 0\"}") != std::string::npos, "pool threads must be named");
+    std::filesystem::remove(path);
+}
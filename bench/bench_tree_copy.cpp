@@ -0,0 +1,232 @@
+#include "bench.h"
+#include "thread_pool.h"
+#include "tree_copy.h"
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    void WriteFile(const fs::path& path, size_t size, char fill)
+    {
+        std::ofstream     out(path, std::ios::binary | std::ios::trunc);
+        std::vector<char> block(std::min<size_t>(size, 1 << 20), fill);
+        for (size_t written = 0; written < size; written += block.size())
+        {
+            out.write(block.data(), (std::streamsize)std::min(block.size(), size - written));
+        }
+    }
+
+    // 100 个文件一个目录，每 10 个目录再嵌套一层；另附若干大文件
+    uint64_t BuildTree(const fs::path& root, size_t files, size_t small_bytes, size_t large_files, size_t large_bytes)
+    {
+        uint64_t total = 0;
+        fs::remove_all(root);
+        for (size_t i = 0; i < files; ++i)
+        {
+            fs::path dir = root / ("d" + std::to_string(i / 1000)) / ("s" + std::to_string(i / 100 % 10));
+            if (i % 100 == 0) fs::create_directories(dir);
+            WriteFile(dir / ("f" + std::to_string(i) + ".bin"), small_bytes, (char)i);
+            total += small_bytes;
+        }
+        fs::create_directories(root / "large");
+        for (size_t i = 0; i < large_files; ++i)
+        {
+            WriteFile(root / "large" / ("l" + std::to_string(i) + ".bin"), large_bytes, (char)(i + 1));
+            total += large_bytes;
+        }
+        return total;
+    }
+
+    // 等待 on_finished 交出最终快照
+    class Finished
+    {
+    public:
+        TreeCopyJob::ProgressFn Callback()
+        {
+            return [this](const TreeCopyProgress& p) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                result_ = p;
+                done_   = true;
+                cv_.notify_all();
+            };
+        }
+
+        TreeCopyProgress Wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return done_; });
+            return result_;
+        }
+
+    private:
+        std::mutex              mutex_;
+        std::condition_variable cv_;
+        bool                    done_ = false;
+        TreeCopyProgress        result_;
+    };
+
+    void Report(bench::Reporter& reporter, const std::string& prefix, uint64_t files, uint64_t bytes, double seconds)
+    {
+        reporter.Metric(prefix + "_files", (double)files / seconds, "files/s");
+        reporter.Metric(prefix + "_throughput", (double)bytes / (1 << 20) / seconds, "MB/s");
+    }
+}  // namespace
+
+// 合成目录树 (默认 100k x 4 KiB + 4 x 64 MiB，可用 PESH_BENCH_TREE_FILES 调整)：
+// 逐文件 std::filesystem::copy_file (等价于 Lua 中循环 await copy_file_async) vs TreeCopyJob
+PESH_BENCH(tree_copy)
+{
+    size_t   files       = bench::EnvOr("PESH_BENCH_TREE_FILES", 100000);
+    size_t   large_files = bench::EnvOr("PESH_BENCH_TREE_LARGE", 4);
+    fs::path base        = fs::temp_directory_path() / "peshell_bench_tree";
+    fs::path src         = base / "src";
+    uint64_t total_bytes = BuildTree(src, files, 4096, large_files, 64 << 20);
+    uint64_t total_files = files + large_files;
+    reporter.Metric("files", (double)total_files, "count");
+    reporter.Metric("bytes", (double)total_bytes / (1 << 20), "MiB");
+
+    ThreadPoolOptions pool_options;
+    pool_options.io_threads = 8;
+    ThreadPool pool(pool_options);
+    auto       executor = [&pool](std::function<void()> task) { pool.Push(std::move(task), TaskLane::Io); };
+
+    // 1. 单线程逐文件复制
+    {
+        fs::path dst = base / "dst_sequential";
+        fs::remove_all(dst);
+        auto     t0     = std::chrono::steady_clock::now();
+        uint64_t copied = 0;
+        for (auto it = fs::recursive_directory_iterator(src); it != fs::recursive_directory_iterator(); ++it)
+        {
+            fs::path target = dst / fs::relative(it->path(), src);
+            if (it->is_directory()) fs::create_directories(target);
+            else if (fs::create_directories(target.parent_path()), fs::copy_file(it->path(), target)) ++copied;
+        }
+        Report(reporter, "sequential", copied, total_bytes, bench::ElapsedSeconds(t0));
+        reporter.Check(copied == total_files, "sequential copy must copy every file");
+        fs::remove_all(dst);
+    }
+
+    // 2. TreeCopyJob，并发上限 1 / 默认
+    for (size_t concurrency : {(size_t)1, (size_t)8})
+    {
+        fs::path dst = base / "dst_tree";
+        fs::remove_all(dst);
+        TreeCopyOptions options;
+        options.concurrency = concurrency;
+        Finished         finished;
+        auto             t0     = std::chrono::steady_clock::now();
+        auto             job    = TreeCopyJob::Start(src, dst, options, executor, finished.Callback());
+        TreeCopyProgress result = finished.Wait();
+        double           s      = bench::ElapsedSeconds(t0);
+
+        std::string prefix = "tree_c" + std::to_string(concurrency);
+        Report(reporter, prefix, result.files_done, result.bytes_done, s);
+        reporter.Check(result.errors == 0, prefix + " errors: " + result.first_error);
+        reporter.Check(result.files_done == total_files && result.bytes_done == total_bytes,
+                       prefix + " must copy every file and byte");
+        reporter.Check(fs::file_size(dst / "large" / "l0.bin") == (64u << 20), prefix + " large file size");
+        fs::remove_all(dst);
+    }
+
+    // 3. 限速 32 MB/s 复制一个 48 MiB 文件，实测速率不应超过上限
+    {
+        fs::path throttle_src = base / "throttle_src";
+        fs::path dst          = base / "dst_throttled";
+        fs::create_directories(throttle_src);
+        WriteFile(throttle_src / "big.bin", 48 << 20, 'x');
+        TreeCopyOptions options;
+        options.bandwidth_bps        = 32ull << 20;
+        options.progress_interval_ms = 100;
+        auto job = TreeCopyJob::Start(throttle_src, dst, options, executor);
+
+        size_t progress_events = 0;
+        while (true)
+        {
+            std::mutex              mutex;
+            std::condition_variable cv;
+            bool                    done = false;
+            TreeCopyProgress        snap;
+            job->NextProgress([&](const TreeCopyProgress& p) {
+                std::lock_guard<std::mutex> lock(mutex);
+                snap = p;
+                done = true;
+                cv.notify_one();
+            });
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return done; });
+            ++progress_events;
+            if (snap.finished)
+            {
+                double rate = (double)snap.bytes_done / (1 << 20) / ((double)snap.elapsed_ms / 1000.0);
+                reporter.Metric("throttled_throughput", rate, "MB/s");
+                reporter.Check(rate < 32 * 1.15, "bandwidth limit must hold");
+                break;
+            }
+        }
+        reporter.Metric("throttled_progress_events", (double)progress_events, "count");
+        reporter.Check(progress_events > 1, "periodic progress must be delivered");
+    }
+
+    // 4. small_file_bytes = 0：所有非空文件都按大文件切片，空文件仍须完成
+    {
+        fs::path edge_src = base / "edge_src";
+        fs::create_directories(edge_src);
+        WriteFile(edge_src / "empty.bin", 0, 'e');
+        WriteFile(edge_src / "data.bin", 4096, 'd');
+        TreeCopyOptions options;
+        options.small_file_bytes = 0;
+        Finished         finished;
+        auto             job     = TreeCopyJob::Start(edge_src, base / "dst_edge", options, executor, finished.Callback());
+        TreeCopyProgress result  = finished.Wait();
+        reporter.Check(result.errors == 0 && result.files_done == 2 && fs::exists(base / "dst_edge" / "empty.bin"),
+                       "empty files must be copied when every file is treated as large");
+    }
+
+    // 5. 复制期间源文件被截短：限速拉长复制时间，第一份进度到达后截短源文件，必须报错而不是留下补零的目标
+    {
+        fs::path shrink_src = base / "shrink_src";
+        fs::create_directories(shrink_src);
+        WriteFile(shrink_src / "shrinking.bin", 16 << 20, 's');
+        TreeCopyOptions options;
+        options.bandwidth_bps        = 8ull << 20;
+        options.progress_interval_ms = 50;
+        Finished    finished;
+        auto        job = TreeCopyJob::Start(shrink_src, base / "dst_shrink", options, executor, finished.Callback());
+
+        std::mutex              mutex;
+        std::condition_variable cv;
+        bool                    started = false;
+        job->NextProgress([&](const TreeCopyProgress&) {
+            std::lock_guard<std::mutex> lock(mutex);
+            started = true;
+            cv.notify_one();
+        });
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return started; });
+        }
+        fs::resize_file(shrink_src / "shrinking.bin", 1 << 20);
+        TreeCopyProgress result = finished.Wait();
+        reporter.Check(result.errors > 0 && result.files_done == 0 &&
+                           result.first_error.find("source truncated during copy") != std::string::npos,
+                       "a source truncated during copy must fail the file: " + result.first_error);
+    }
+
+    // 6. 开始后立即取消：未派发的任务被丢弃，最终快照标记为已取消
+    {
+        Finished         finished;
+        auto             job    = TreeCopyJob::Start(src, base / "dst_cancel", {}, executor, finished.Callback());
+        job->Cancel();
+        TreeCopyProgress result = finished.Wait();
+        reporter.Check(result.finished && result.cancelled && result.files_done < total_files,
+                       "a cancelled copy must finish early and report cancellation");
+    }
+
+    std::error_code ec;
+    fs::remove_all(base, ec);
+}
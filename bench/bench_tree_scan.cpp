@@ -0,0 +1,185 @@
+#include "bench.h"
+#include "content_hash.h"
+#include "thread_pool.h"
+#include "tree_scan.h"
+
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // 文件内容由序号决定，校验和可以独立算出来对照
+    std::string Content(size_t index, size_t size)
+    {
+        std::string data(size, '\0');
+        for (size_t i = 0; i < size; ++i) data[i] = (char)((index * 131 + i * 7) >> (i % 5));
+        return data;
+    }
+
+    // 100 个文件一个目录，每 10 个目录再嵌套一层
+    void BuildTree(const fs::path& root, size_t files, size_t file_bytes)
+    {
+        fs::remove_all(root);
+        for (size_t i = 0; i < files; ++i)
+        {
+            fs::path dir = root / ("d" + std::to_string(i / 1000)) / ("s" + std::to_string(i / 100 % 10));
+            if (i % 100 == 0) fs::create_directories(dir);
+            std::ofstream out(dir / ("f" + std::to_string(i) + ".bin"), std::ios::binary | std::ios::trunc);
+            std::string   data = Content(i, file_bytes);
+            out.write(data.data(), (std::streamsize)data.size());
+        }
+    }
+
+    struct ScanResult
+    {
+        std::vector<TreeScanEntry> entries;
+        TreeScanSummary            summary;
+        size_t                     batches = 0;
+    };
+
+    // 像 Lua 协程那样逐批取走，直到收到 nullptr
+    ScanResult Drain(const std::shared_ptr<TreeScanJob>& job)
+    {
+        ScanResult result;
+        while (true)
+        {
+            std::mutex                                   mutex;
+            std::condition_variable                      cv;
+            bool                                         done = false;
+            std::shared_ptr<TreeScanJob::Batch>          batch;
+            job->NextBatch([&](std::shared_ptr<TreeScanJob::Batch> b) {
+                std::lock_guard<std::mutex> lock(mutex);
+                batch = std::move(b);
+                done  = true;
+                cv.notify_one();
+            });
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return done; });
+            if (!batch) break;
+            ++result.batches;
+            for (TreeScanEntry& e : *batch) result.entries.push_back(std::move(e));
+        }
+        result.summary = job->Summary();
+        return result;
+    }
+
+    double GigabytesPerSecond(uint64_t bytes, double seconds)
+    {
+        return (double)bytes / 1e9 / seconds;
+    }
+}  // namespace
+
+// 合成目录树 (默认 20k x 16 KiB，可用 PESH_BENCH_SCAN_FILES 调整)：
+// 单线程 recursive_directory_iterator + stat vs TreeScanJob 的条目吞吐；带 CRC32C / XXH3 校验和的扫描吞吐；
+// 内存中的校验和内核吞吐 (与文件读取无关)
+PESH_BENCH(tree_scan)
+{
+    size_t   files      = bench::EnvOr("PESH_BENCH_SCAN_FILES", 20000);
+    size_t   file_bytes = 16 << 10;
+    fs::path root       = fs::temp_directory_path() / "peshell_bench_scan";
+    BuildTree(root, files, file_bytes);
+    size_t dirs = (files + 99) / 100 + (files + 999) / 1000;
+
+    ThreadPoolOptions pool_options;
+    pool_options.io_threads = 8;
+    ThreadPool pool(pool_options);
+    auto       executor = [&pool](std::function<void()> task) { pool.Push(std::move(task), TaskLane::Io); };
+
+    // 1. 内核吞吐：64 MiB 内存缓冲区
+    {
+        std::string data = Content(7, 64 << 20);
+        for (ContentHash hash : {ContentHash::Crc32c, ContentHash::Xxh3})
+        {
+            volatile uint64_t sink = 0;
+            auto              t0   = std::chrono::steady_clock::now();
+            for (int i = 0; i < 4; ++i) sink = sink + ComputeContentHash(hash, data.data(), data.size());
+            reporter.Metric(std::string(ContentHashName(hash)) + "_kernel", GigabytesPerSecond(4 * data.size(), bench::ElapsedSeconds(t0)), "GB/s");
+        }
+        reporter.Check(Crc32c(0, "123456789", 9) == 0xE3069283u, "CRC32C check value");
+        reporter.Check(Xxh3_64("", 0) == 0x2D06800538D394C2ull, "XXH3 of the empty input");
+        reporter.Check(Crc32c(Crc32c(0, data.data(), 1000), data.data() + 1000, 5000) == Crc32c(0, data.data(), 6000),
+                       "CRC32C must continue across pieces");
+    }
+
+    // 2. 单线程遍历，逐条 stat (等价于 fs.list_files 一层层展开)
+    {
+        auto     t0      = std::chrono::steady_clock::now();
+        uint64_t entries = 0, bytes = 0;
+        for (auto it = fs::recursive_directory_iterator(root); it != fs::recursive_directory_iterator(); ++it)
+        {
+            ++entries;
+            if (it->is_regular_file()) bytes += it->file_size();
+            (void)it->last_write_time();
+        }
+        reporter.Metric("sequential_entries", (double)entries / bench::ElapsedSeconds(t0), "entries/s");
+        reporter.Check(entries == files + dirs, "sequential walk must see every entry");
+    }
+
+    // 3. TreeScanJob：只取元数据 / CRC32C / XXH3
+    for (ContentHash hash : {ContentHash::None, ContentHash::Crc32c, ContentHash::Xxh3})
+    {
+        TreeScanOptions options;
+        options.hash      = hash;
+        auto       t0     = std::chrono::steady_clock::now();
+        ScanResult result = Drain(TreeScanJob::Start(root, options, executor));
+        double     s      = bench::ElapsedSeconds(t0);
+
+        std::string prefix = std::string("scan_") + ContentHashName(hash);
+        reporter.Metric(prefix + "_entries", (double)result.entries.size() / s, "entries/s");
+        if (hash != ContentHash::None) reporter.Metric(prefix + "_hash", GigabytesPerSecond(result.summary.hashed_bytes, s), "GB/s");
+        reporter.Check(result.summary.errors == 0, prefix + " errors: " + result.summary.first_error);
+        reporter.Check(result.entries.size() == files + dirs && result.summary.entries == files + dirs,
+                       prefix + " must report every entry exactly once");
+        reporter.Check(result.summary.bytes == (uint64_t)files * file_bytes, prefix + " must sum file sizes");
+
+        bool hashes_ok = true, metadata_ok = true;
+        for (const TreeScanEntry& e : result.entries)
+        {
+            metadata_ok &= e.is_dir ? e.size == 0 : (e.size == file_bytes && e.mtime > 0);
+            if (e.is_dir || hash == ContentHash::None)
+            {
+                hashes_ok &= !e.hashed;
+                continue;
+            }
+            size_t      name  = e.path.rfind('f');
+            size_t      index = (size_t)std::strtoull(e.path.c_str() + name + 1, nullptr, 10);
+            std::string data  = Content(index, file_bytes);
+            hashes_ok &= e.hashed && e.hash == ComputeContentHash(hash, data.data(), data.size());
+        }
+        reporter.Check(metadata_ok, prefix + " entries must carry size and mtime");
+        reporter.Check(hashes_ok, prefix + " hashes must match the file contents");
+    }
+
+    // 4. 背压：不取批次时扫描停在 max_batches 附近；取消后挂起的 NextBatch 以 nullptr 结束
+    {
+        TreeScanOptions options;
+        options.batch_entries = 16;
+        options.max_batches   = 2;
+        options.concurrency   = 2;
+        auto job              = TreeScanJob::Start(root, options, executor);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        TreeScanSummary stalled = job->Summary();
+        reporter.Metric("backpressure_buffered", (double)stalled.entries, "count");
+        reporter.Check(!stalled.finished && stalled.entries < (files + dirs) / 4, "an undrained scan must pause");
+
+        job->Cancel();
+        ScanResult rest = Drain(job);
+        reporter.Check(rest.entries.empty() && rest.summary.cancelled && rest.summary.finished,
+                       "a cancelled scan must end without further batches");
+    }
+
+    // 5. 根目录不存在
+    {
+        ScanResult missing = Drain(TreeScanJob::Start(root / "missing", {}, executor));
+        reporter.Check(missing.summary.errors == 1 && missing.entries.empty(), "a missing root must fail without entries");
+    }
+
+    pool.Stop(true);
+    std::error_code ec;
+    fs::remove_all(root, ec);
+}
@@ -0,0 +1,158 @@
+#include "bench.h"
+#include "wait_set.h"
+
+#include <condition_variable>
+#include <mutex>
+
+#if defined(_WIN32)
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+#else
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr int kHandles = 2000;
+
+#if defined(_WIN32)
+    WaitHandle CreateSignal()
+    {
+        return CreateEventW(NULL, TRUE, FALSE, NULL);
+    }
+    void RaiseSignal(WaitHandle h)
+    {
+        SetEvent(h);
+    }
+    void CloseSignal(WaitHandle h)
+    {
+        CloseHandle(h);
+    }
+    void RaiseFdLimit() {}
+#else
+    WaitHandle CreateSignal()
+    {
+        return eventfd(0, EFD_CLOEXEC);
+    }
+    void RaiseSignal(WaitHandle h)
+    {
+        uint64_t one = 1;
+        (void)!write(h, &one, sizeof(one));
+    }
+    void CloseSignal(WaitHandle h)
+    {
+        close(h);
+    }
+    // 每个注册会 dup 一个 fd，默认 1024 的软限制不够用
+    void RaiseFdLimit()
+    {
+        rlimit lim{};
+        if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max)
+        {
+            lim.rlim_cur = lim.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &lim);
+        }
+    }
+#endif
+
+    struct Wakeup
+    {
+        std::mutex              mutex;
+        std::condition_variable cv;
+        bool                    pending = false;
+
+        void Set()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending = true;
+            }
+            cv.notify_one();
+        }
+
+        bool Wait(int timeout_ms)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            bool ok = cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return pending; });
+            pending = false;
+            return ok;
+        }
+    };
+}  // namespace
+
+// 压力测试：单个操作等待 2000 个句柄，以及 2000 个相互重叠的操作
+PESH_BENCH(wait_set_stress)
+{
+    RaiseFdLimit();
+
+    std::vector<WaitHandle> handles;
+    for (int i = 0; i < kHandles; ++i) handles.push_back(CreateSignal());
+
+    Wakeup  wakeup;
+    WaitSet waits([&] { wakeup.Set(); });
+
+    // 1. 一个操作覆盖全部句柄
+    std::string error;
+    auto        t0 = std::chrono::steady_clock::now();
+    reporter.Check(waits.Add(&waits, handles, &error), "add all handles: " + error);
+    reporter.Metric("single_op_register", bench::ElapsedSeconds(t0) * 1e3, "ms");
+
+    const int target = 1500;
+    t0               = std::chrono::steady_clock::now();
+    RaiseSignal(handles[target - 1]);
+    void* context = nullptr;
+    int   index   = 0;
+    while (!waits.PopSignaled(&context, &index))
+    {
+        if (!wakeup.Wait(5000)) break;
+    }
+    reporter.Metric("single_op_signal_latency", bench::ElapsedSeconds(t0) * 1e6, "us");
+    reporter.Check(context == &waits && index == target, "single op must report index " + std::to_string(target));
+    reporter.Check(waits.Size() == 0, "single op must be released after signal");
+
+    for (WaitHandle h : handles) CloseSignal(h);
+    handles.clear();
+    for (int i = 0; i < kHandles; ++i) handles.push_back(CreateSignal());
+
+    // 2. 每个操作等待两个相邻句柄，所有句柄都被至少两个操作共享
+    std::vector<int> ids(kHandles);
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < kHandles; ++i)
+    {
+        ids[i] = i;
+        reporter.Check(waits.Add(&ids[i], {handles[i], handles[(i + 1) % kHandles]}, &error), "add op: " + error);
+    }
+    double register_s = bench::ElapsedSeconds(t0);
+    reporter.Metric("overlapping_ops", (double)waits.Size(), "count");
+    reporter.Metric("register", (double)kHandles / register_s, "ops/s");
+
+    t0 = std::chrono::steady_clock::now();
+    for (WaitHandle h : handles) RaiseSignal(h);
+
+    std::vector<int> seen(kHandles, 0);
+    int              completed = 0;
+    while (completed < kHandles)
+    {
+        while (waits.PopSignaled(&context, &index))
+        {
+            int id = *static_cast<int*>(context);
+            reporter.Check(index == 1 || index == 2, "index out of range");
+            ++seen[id];
+            ++completed;
+        }
+        if (completed < kHandles && !waits.HasSignaled() && !wakeup.Wait(5000)) break;
+    }
+    double drain_s = bench::ElapsedSeconds(t0);
+    reporter.Metric("complete", (double)completed / drain_s, "ops/s");
+
+    bool exactly_once = true;
+    for (int n : seen) exactly_once = exactly_once && n == 1;
+    reporter.Check(completed == kHandles && exactly_once, "every op must complete exactly once");
+    reporter.Check(waits.Size() == 0, "all ops must be released");
+
+    for (WaitHandle h : handles) CloseSignal(h);
+}
@@ -0,0 +1,207 @@
+#include "bench.h"
+#include "file_buffer.h"
+#include "worker_registry.h"
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace
+{
+    // 最小 FIFO 线程池，与 ThreadPool 解耦以便单独观察注册表的排队顺序
+    class Pool
+    {
+    public:
+        explicit Pool(size_t threads)
+        {
+            for (size_t i = 0; i < threads; ++i) threads_.emplace_back([this] { Loop(); });
+        }
+
+        ~Pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            for (auto& t : threads_) t.join();
+        }
+
+        void Push(std::function<void()> task)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                tasks_.push_back(std::move(task));
+            }
+            cv_.notify_one();
+        }
+
+    private:
+        void Loop()
+        {
+            while (true)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                    if (tasks_.empty()) return;
+                    task = std::move(tasks_.front());
+                    tasks_.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::mutex                         mutex_;
+        std::condition_variable            cv_;
+        std::deque<std::function<void()>>  tasks_;
+        std::vector<std::thread>           threads_;
+        bool                               stop_ = false;
+    };
+
+    std::atomic<int> g_gate{0};  // bench_block 在其为 0 时自旋等待
+    std::atomic<int> g_started{0};
+
+    PESH_REGISTER_WORKER(bench_noop, {WorkerValueType::Integer})
+    {
+        (void)ctx;
+        return WorkerResult::Ok(WorkerValue::Integer(args[0].integer + 1));
+    }
+
+    PESH_REGISTER_WORKER(bench_block, {WorkerValueType::Integer})
+    {
+        ++g_started;
+        while (!g_gate.load() && !ctx.Cancelled()) std::this_thread::yield();
+        return WorkerResult::Ok(WorkerValue::Integer(args[0].integer));
+    }
+
+    // 模拟 file_map 在取消之后才完成映射：等到取消标志置位再映射文件并照常返回缓冲区
+    std::atomic<int> g_released{0};
+    void (*g_map_release)(pesh_buffer*) = nullptr;
+
+    void CountingRelease(pesh_buffer* buffer)
+    {
+        ++g_released;
+        g_map_release(buffer);
+    }
+
+    PESH_REGISTER_WORKER(bench_map_after_cancel, {WorkerValueType::String})
+    {
+        ++g_started;
+        while (!ctx.Cancelled()) std::this_thread::yield();
+        std::string  error;
+        pesh_buffer* buffer = MapFileBuffer(std::filesystem::u8path(args[0].string), &error);
+        if (!buffer) return WorkerResult::Fail(kWorkerFailed, error);
+        g_map_release   = buffer->release;
+        buffer->release = CountingRelease;
+        return WorkerResult::Ok(WorkerValue::Buffer(buffer));
+    }
+
+    WorkerArgs IntArg(int64_t v)
+    {
+        return {WorkerValue::Integer(v)};
+    }
+}  // namespace
+
+// 派发吞吐、优先级顺序与取消语义
+PESH_BENCH(worker_registry)
+{
+    WorkerRegistry& registry = WorkerRegistry::Instance();
+    int             noop     = registry.Find("bench_noop");
+    int             block    = registry.Find("bench_block");
+    reporter.Check(noop >= 0 && block >= 0, "static registration must be visible");
+    reporter.Check(registry.Find("no_such_worker") < 0, "unknown names must not resolve");
+
+    // 1. 4 线程上派发空操作的吞吐
+    {
+        constexpr int    kOps = 200000;
+        Pool             pool(4);
+        std::atomic<int> done{0};
+        std::atomic<int> wrong{0};
+        registry.SetHooks([&](std::function<void()> task, TaskLane) { pool.Push(std::move(task)); },
+                          [&](void* waiter, WorkerResult result) {
+                              if (!result.ok || result.value.integer != (int64_t)(intptr_t)waiter + 1) ++wrong;
+                              ++done;
+                          });
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < kOps; ++i) registry.Dispatch(noop, IntArg(i), 0, (void*)(intptr_t)i);
+        while (done.load() < kOps) std::this_thread::yield();
+        reporter.Metric("dispatch_throughput", kOps / bench::ElapsedSeconds(t0), "ops/s");
+        reporter.Check(wrong.load() == 0, "typed results must round-trip");
+        reporter.Check(registry.Pending() == 0, "no operation may leak");
+    }
+
+    // 2. 单线程执行器被阻塞时，后派发的高优先级操作先于排队中的低优先级操作执行
+    {
+        Pool                 pool(1);
+        std::mutex           mutex;
+        std::vector<int64_t> order;
+        std::atomic<int>     done{0};
+        registry.SetHooks([&](std::function<void()> task, TaskLane) { pool.Push(std::move(task)); },
+                          [&](void*, WorkerResult result) {
+                              std::lock_guard<std::mutex> lock(mutex);
+                              order.push_back(result.value.integer);
+                              ++done;
+                          });
+        g_gate    = 0;
+        g_started = 0;
+        registry.Dispatch(block, IntArg(0), 0, nullptr);
+        while (g_started.load() == 0) std::this_thread::yield();
+        for (int64_t i = 1; i <= 3; ++i) registry.Dispatch(block, IntArg(i), 0, nullptr);
+        for (int64_t i = 10; i <= 12; ++i) registry.Dispatch(block, IntArg(i), 5, nullptr);
+        g_gate = 1;
+        while (done.load() < 7) std::this_thread::yield();
+        reporter.Check(order == std::vector<int64_t>({0, 10, 11, 12, 1, 2, 3}), "priority then FIFO order");
+    }
+
+    // 3. 取消：排队中的立即完成且不执行，执行中的看到取消标志
+    {
+        Pool             pool(1);
+        std::atomic<int> cancelled{0};
+        std::atomic<int> done{0};
+        registry.SetHooks([&](std::function<void()> task, TaskLane) { pool.Push(std::move(task)); },
+                          [&](void*, WorkerResult result) {
+                              if (!result.ok && result.error_code == kWorkerCancelled) ++cancelled;
+                              ++done;
+                          });
+        g_gate           = 0;
+        g_started        = 0;
+        uint64_t running = registry.Dispatch(block, IntArg(0), 0, nullptr);
+        while (g_started.load() == 0) std::this_thread::yield();
+        uint64_t queued = registry.Dispatch(block, IntArg(1), 0, nullptr);
+        reporter.Check(registry.Cancel(queued), "queued op must be cancellable");
+        reporter.Check(done.load() == 1 && cancelled.load() == 1, "queued cancel completes immediately");
+        reporter.Check(registry.Cancel(running), "running op must be cancellable");
+        while (done.load() < 2) std::this_thread::yield();
+        reporter.Check(cancelled.load() == 2, "running op must observe cancellation");
+        reporter.Check(!registry.Cancel(running), "completed op must not be cancellable");
+    }
+
+    // 4. 执行中被取消、工作者仍成功返回映射缓冲区：以取消完成，缓冲区由注册表释放而不是泄漏
+    {
+        std::filesystem::path path = std::filesystem::temp_directory_path() / "peshell_bench_map_cancel.bin";
+        std::ofstream(path, std::ios::binary) << std::string(64 << 10, 'x');
+        Pool             pool(1);
+        std::atomic<int> done{0};
+        WorkerResult     last;
+        registry.SetHooks([&](std::function<void()> task, TaskLane) { pool.Push(std::move(task)); },
+                          [&](void*, WorkerResult result) {
+                              last = std::move(result);
+                              ++done;
+                          });
+        g_started  = 0;
+        g_released = 0;
+        WorkerArgs args{WorkerValue::String(path.u8string())};
+        uint64_t   op = registry.Dispatch(registry.Find("bench_map_after_cancel"), std::move(args), 0, nullptr);
+        while (g_started.load() == 0) std::this_thread::yield();
+        registry.Cancel(op);
+        while (done.load() < 1) std::this_thread::yield();
+        reporter.Check(!last.ok && last.error_code == kWorkerCancelled, "a cancelled map must complete as cancelled");
+        reporter.Check(g_released.load() == 1, "a cancelled map must release its buffer");
+        std::filesystem::remove(path);
+    }
+    registry.SetHooks(nullptr, nullptr);
+}
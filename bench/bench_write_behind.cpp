@@ -0,0 +1,314 @@
+#include "bench.h"
+#include "thread_pool.h"
+#include "write_behind.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // 等待 n 个回调，记录失败
+    class Latch
+    {
+    public:
+        explicit Latch(size_t count) : left_(count) {}
+
+        WriteBehind::DoneFn Callback()
+        {
+            return [this](bool ok, std::string error) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!ok && error_.empty()) error_ = error;
+                if (--left_ == 0) cv_.notify_all();
+            };
+        }
+
+        // 返回第一个错误，全部成功时为空
+        std::string Wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return left_ == 0; });
+            return error_;
+        }
+
+    private:
+        std::mutex              mutex_;
+        std::condition_variable cv_;
+        size_t                  left_;
+        std::string             error_;
+    };
+
+    std::string ReadAll(const fs::path& path)
+    {
+        std::ifstream      in(path, std::ios::binary);
+        std::ostringstream out;
+        out << in.rdbuf();
+        return out.str();
+    }
+
+    std::string LogLine(size_t i)
+    {
+        std::string line = "2026-01-01 00:00:00.000 [info] request " + std::to_string(i) + " handled";
+        line.resize(119, '.');
+        return line + "\n";
+    }
+
+    // fs.write_file / io.open(path, "a") 的做法：每次写入都打开、写、关闭
+    void SyncAppend(const fs::path& path, const std::string& data, bool durable)
+    {
+#if defined(_WIN32)
+        (void)durable;
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out.write(data.data(), (std::streamsize)data.size());
+#else
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (::write(fd, data.data(), data.size()) < 0) return;
+        if (durable) ::fdatasync(fd);
+        ::close(fd);
+#endif
+    }
+
+    // 替换版本 v 的内容：整份由同一个字符组成，读到混合内容即为撕裂
+    std::string Version(size_t v, size_t size)
+    {
+        return std::string(size, (char)('a' + v % 26));
+    }
+
+    bool Torn(const std::string& data, size_t size)
+    {
+        if (data.size() != size) return true;
+        return data.find_first_not_of(data[0]) != std::string::npos;
+    }
+
+    double MicrosPerOp(std::chrono::steady_clock::time_point t0, size_t ops)
+    {
+        return bench::ElapsedSeconds(t0) * 1e6 / (double)ops;
+    }
+}  // namespace
+
+// 大量小追加：每次打开-写入-关闭 vs 合并写入；逐次 fdatasync vs 同批共用一次同步；
+// 配置文件整体替换的原子性与合并；排队中追加与替换的顺序
+PESH_BENCH(write_behind)
+{
+    size_t   count   = bench::EnvOr("PESH_BENCH_WRITE_COUNT", 20000);
+    size_t   durable = bench::EnvOr("PESH_BENCH_WRITE_SYNC_COUNT", 1000);
+    fs::path root    = fs::temp_directory_path() / "peshell_bench_write_behind";
+    fs::remove_all(root);
+    fs::create_directories(root);
+    constexpr size_t kFiles = 4;
+
+    ThreadPoolOptions pool_options;
+    pool_options.io_threads = 4;
+    ThreadPool pool(pool_options);
+    auto       executor = [&pool](std::function<void()> task) { pool.Push(std::move(task), TaskLane::Io); };
+
+    auto log_path = [&root](const char* kind, size_t file) { return root / (std::string(kind) + std::to_string(file) + ".log"); };
+
+    // 1. 基线：每行一次打开-追加-关闭
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) SyncAppend(log_path("sync", i % kFiles), LogLine(i), false);
+        reporter.Metric("sync_append", MicrosPerOp(t0, count), "us");
+    }
+
+    // 2. 合并写入：调用方只排队，写入任务把积攒的行拼成一次 write
+    {
+        WriteBehind writer(executor);
+        Latch       latch(count);
+        auto        t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) writer.Append(log_path("wb", i % kFiles), LogLine(i), false, latch.Callback());
+        double enqueue_us = MicrosPerOp(t0, count);
+        std::string error = latch.Wait();
+        reporter.Metric("write_behind_append", MicrosPerOp(t0, count), "us");
+        reporter.Metric("write_behind_enqueue", enqueue_us, "us");
+
+        WriteBehind::Stats stats = writer.GetStats();
+        reporter.Metric("appends_per_batch", (double)stats.requests / (double)stats.batches, "count");
+        reporter.Check(error.empty(), "appends must succeed: " + error);
+        bool same = true;
+        for (size_t f = 0; f < kFiles; ++f) same &= ReadAll(log_path("wb", f)) == ReadAll(log_path("sync", f));
+        reporter.Check(same, "coalesced appends must keep per-file order and bytes");
+        reporter.Check(stats.pending_bytes == 0 && stats.bytes == stats.requests * 120, "every appended byte must be written once");
+
+        // 未要求同步的文件由 Flush 各同步一次
+        Latch flushed(1);
+        writer.Flush(flushed.Callback());
+        reporter.Check(flushed.Wait().empty() && writer.GetStats().syncs == kFiles, "Flush must sync each written file once");
+        Latch idle(1);
+        writer.Flush(idle.Callback());
+        reporter.Check(idle.Wait().empty() && writer.GetStats().syncs == kFiles, "Flush with nothing unsynced must not sync again");
+    }
+
+    // 2b. 合并上限：写入任务先攒着、追加全部排队后再执行，每个文件只写一批 (调用方开销与写入开销分开计)
+    {
+        std::vector<std::function<void()>> deferred;
+        WriteBehind writer([&deferred](std::function<void()> task) { deferred.push_back(std::move(task)); });
+        auto        t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) writer.Append(log_path("deferred", i % kFiles), LogLine(i), false, nullptr);
+        reporter.Metric("deferred_enqueue", MicrosPerOp(t0, count), "us");
+        t0 = std::chrono::steady_clock::now();
+        for (auto& task : deferred) task();
+        reporter.Metric("deferred_write", MicrosPerOp(t0, count), "us");
+        reporter.Check(writer.GetStats().batches == kFiles && ReadAll(log_path("deferred", 1)) == ReadAll(log_path("sync", 1)),
+                       "appends queued behind a busy writer must coalesce into one batch per file");
+
+        // 同一文件的不同写法共用一个队列，顺序不被拆成两个写入任务打乱
+        deferred.clear();
+        fs::path alias = root / "alias.log";
+        writer.Append(alias, "1;", false, nullptr);
+        writer.Append(root / "sub" / ".." / "." / "alias.log", "2;", false, nullptr);
+        writer.Append(alias, "3;", false, nullptr);
+        for (auto& task : deferred) task();
+        reporter.Check(deferred.size() == 1 && ReadAll(alias) == "1;2;3;", "spellings of one path must share a queue");
+    }
+
+    // 2c. 多个线程同时排队 (各写各的文件)：状态按路径分片加锁，线程之间只在同一分片上竞争
+    {
+        std::mutex                         deferred_mutex;
+        std::vector<std::function<void()>> deferred;
+        WriteBehind writer([&](std::function<void()> task) {
+            std::lock_guard<std::mutex> lock(deferred_mutex);
+            deferred.push_back(std::move(task));
+        });
+        size_t threads = std::max<size_t>(2, std::min<size_t>(8, std::thread::hardware_concurrency()));
+        std::vector<fs::path> paths;
+        for (size_t t = 0; t < threads; ++t) paths.push_back(log_path("concurrent", t));
+        std::vector<std::thread> writers;
+        auto                     t0 = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < threads; ++t)
+        {
+            writers.emplace_back([&, t] {
+                for (size_t i = 0; i < count; ++i) writer.Append(paths[t], LogLine(i), false, nullptr);
+            });
+        }
+        for (auto& thread : writers) thread.join();
+        reporter.Metric("concurrent_enqueue_threads", (double)threads, "count");
+        reporter.Metric("concurrent_enqueue", MicrosPerOp(t0, count * threads), "us");
+        for (auto& task : deferred) task();
+        std::string first = ReadAll(paths[0]);
+        bool        same  = first.size() == count * 120;
+        for (const auto& path : paths) same &= ReadAll(path) == first;
+        reporter.Check(deferred.size() == threads && same, "concurrent appends to separate files must each coalesce into one batch");
+    }
+
+    // 3. 持久追加：逐次 fdatasync vs 同批请求共用一次 (组提交)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < durable; ++i) SyncAppend(log_path("sync_durable", i % kFiles), LogLine(i), true);
+        reporter.Metric("sync_append_fdatasync", MicrosPerOp(t0, durable), "us");
+
+        WriteBehind writer(executor);
+        Latch       latch(durable);
+        t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < durable; ++i) writer.Append(log_path("wb_durable", i % kFiles), LogLine(i), true, latch.Callback());
+        std::string error = latch.Wait();
+        reporter.Metric("write_behind_append_sync", MicrosPerOp(t0, durable), "us");
+        reporter.Metric("syncs_per_1000_appends", (double)writer.GetStats().syncs * 1000.0 / (double)durable, "count");
+        reporter.Check(error.empty(), "durable appends must succeed: " + error);
+        reporter.Check(ReadAll(log_path("wb_durable", 0)) == ReadAll(log_path("sync_durable", 0)), "durable appends must keep order");
+    }
+
+    // 4. 配置文件替换：原地截断重写 (fs.write_file) 会让并发读者读到半份内容，改名替换不会
+    {
+        constexpr size_t kSize     = 64 << 10;
+        constexpr size_t kVersions = 200;
+        fs::path         config    = root / "config.ini";
+
+        auto read_while = [&config](std::atomic<bool>& stop, std::atomic<size_t>& torn) {
+            while (!stop.load())
+                if (Torn(ReadAll(config), kSize)) ++torn;
+        };
+
+        {
+            std::ofstream(config, std::ios::binary) << Version(0, kSize);
+            std::atomic<bool>   stop{false};
+            std::atomic<size_t> torn{0};
+            std::thread         reader(read_while, std::ref(stop), std::ref(torn));
+            auto                t0 = std::chrono::steady_clock::now();
+            for (size_t v = 1; v <= kVersions; ++v)
+            {
+                std::ofstream out(config, std::ios::binary | std::ios::trunc);
+                out << Version(v, kSize);
+            }
+            reporter.Metric("write_file_config", MicrosPerOp(t0, kVersions), "us");
+            stop = true;
+            reader.join();
+            reporter.Metric("write_file_torn_reads", (double)torn.load(), "count");
+        }
+
+        WriteBehind writer(executor);
+        {
+            std::atomic<bool>   stop{false};
+            std::atomic<size_t> torn{0};
+            std::thread         reader(read_while, std::ref(stop), std::ref(torn));
+            bool                ok = true;
+            auto                t0 = std::chrono::steady_clock::now();
+            for (size_t v = 1; v <= kVersions; ++v)
+            {
+                Latch done(1);
+                writer.Replace(config, Version(v, kSize), false, done.Callback());
+                ok &= done.Wait().empty();
+            }
+            reporter.Metric("replace_config", MicrosPerOp(t0, kVersions), "us");
+            stop = true;
+            reader.join();
+            reporter.Check(ok && torn.load() == 0, "readers must never see a partially replaced file");
+        }
+
+        // 未同步的替换由 Flush 补一次同步 (连同目录项)
+        uint64_t syncs_before = writer.GetStats().syncs;
+        Latch    flushed(1);
+        writer.Flush(flushed.Callback());
+        reporter.Check(flushed.Wait().empty() && writer.GetStats().syncs == syncs_before + 1,
+                       "Flush must sync a file replaced without sync");
+
+        // 连续提交时只写最后一份
+        Latch done(kVersions);
+        auto  t0 = std::chrono::steady_clock::now();
+        for (size_t v = 1; v <= kVersions; ++v) writer.Replace(config, Version(v + 7, kSize), true, done.Callback());
+        std::string error = done.Wait();
+        reporter.Metric("replace_config_coalesced", MicrosPerOp(t0, kVersions), "us");
+        reporter.Check(error.empty() && ReadAll(config) == Version(kVersions + 7, kSize), "the last replacement must win");
+
+        size_t stray = 0;
+        for (auto& entry : fs::directory_iterator(root))
+            if (entry.path().filename().string().find(".tmp-") != std::string::npos) ++stray;
+        reporter.Check(stray == 0, "replacement must not leave temporary files");
+    }
+
+    // 5. 顺序：排队中的追加被替换覆盖，替换之后的追加接在新内容后
+    {
+        fs::path    path = root / "order.txt";
+        WriteBehind writer([](std::function<void()> task) { std::thread(std::move(task)).detach(); });
+        std::mutex  gate;
+        std::unique_lock<std::mutex> hold(gate);
+        Latch       latch(5);
+        // 第一个请求的回调卡住写入任务，后面的请求都在排队中合并
+        writer.Append(path, "first;", false, [&gate, &latch](bool ok, std::string error) {
+            std::lock_guard<std::mutex> wait(gate);
+            latch.Callback()(ok, error);
+        });
+        writer.Append(path, "dropped;", false, latch.Callback());
+        writer.Replace(path, "new;", false, latch.Callback());
+        writer.Append(path, "after;", false, latch.Callback());
+        writer.Append(root / "missing" / "x.log", "x", false, [&latch](bool ok, std::string) { latch.Callback()(!ok, ""); });
+        hold.unlock();
+        std::string error = latch.Wait();
+        reporter.Check(error.empty() && ReadAll(path) == "new;after;", "queued appends must follow the latest replacement");
+        reporter.Check(writer.GetStats().errors == 1, "writing into a missing directory must fail");
+    }
+
+    pool.Stop(true);
+    std::error_code ec;
+    fs::remove_all(root, ec);
+}
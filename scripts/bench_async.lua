@@ -0,0 +1,83 @@
+-- scripts/bench_async.lua
+-- spawn + await + complete 往返吞吐：原生协程池 vs 旧的 Lua 侧实现 (coroutine.create + table.pack + 锚定表)
+-- 用法: peshell main scripts/bench_async.lua run_from_main   (任务数可用 PESH_BENCH_ASYNC_TASKS 调整)
+
+if not (_G.arg and _G.arg[1] == "run_from_main") then
+    local log = require("core.log")
+    log.info("This script is designed to be run via 'peshell main scripts/bench_async.lua run_from_main'")
+    return
+end
+
+local log = _G.log
+local pesh = _G.pesh
+local native = _G.pesh_native
+local ffi = require("ffi")
+
+local async = pesh.plugin.load("async")
+
+local task_count = tonumber(os.getenv("PESH_BENCH_ASYNC_TASKS")) or 100000
+
+local now_ms
+if jit.os == "Windows" then
+    ffi.cdef [[ uint64_t GetTickCount64(void); ]]
+    now_ms = function() return tonumber(ffi.C.GetTickCount64()) end
+else
+    ffi.cdef [[
+        typedef struct { long tv_sec; long tv_nsec; } pesh_timespec_t;
+        int clock_gettime(int clk_id, pesh_timespec_t* tp);
+    ]]
+    local ts = ffi.new("pesh_timespec_t")
+    now_ms = function()
+        ffi.C.clock_gettime(1, ts) -- CLOCK_MONOTONIC
+        return tonumber(ts.tv_sec) * 1000 + tonumber(ts.tv_nsec) / 1e6
+    end
+end
+
+-- 改动前 coro_pool.run / await 的做法，作为对照
+local legacy_anchors = {}
+local function legacy_await(provider, ...)
+    local co = coroutine.running()
+    legacy_anchors[co] = true
+    provider(co, ...)
+    local ok, value = coroutine.yield()
+    legacy_anchors[co] = nil
+    if not ok then error(value, 2) end
+    return value
+end
+
+local function legacy_run(func, ...)
+    local args = table.pack(...)
+    local wrapped = function(...)
+        local ok, err = xpcall(func, debug.traceback, ...)
+        if not ok then log.error(err) end
+    end
+    local co = coroutine.create(wrapped)
+    coroutine.resume(co, table.unpack(args, 1, args.n))
+end
+
+-- 启动 task_count 个任务，每个 await 一次 0 ms 定时器 (完整经过派发、锚定、时间轮与恢复)
+local function measure(run, await_fn)
+    local done = 0
+    local start = now_ms()
+    for i = 1, task_count do
+        run(function(n)
+            await_fn(async.sleep, 0)
+            done = done + 1
+        end, i)
+    end
+    while done < task_count do await(async.sleep, 1) end
+    return task_count / ((now_ms() - start) / 1000)
+end
+
+async.run(function()
+    collectgarbage("collect")
+    local legacy = measure(legacy_run, legacy_await)
+    collectgarbage("collect")
+    local pooled = measure(async.run, await)
+    local stats = native.coroutine_stats()
+
+    print(string.format("%-28s %-28s %16.3f %s", "async_roundtrip", "legacy_lua", legacy, "ops/s"))
+    print(string.format("%-28s %-28s %16.3f %s", "async_roundtrip", "native_pool", pooled, "ops/s"))
+    print(string.format("%-28s %-28s %16.3f %s", "async_roundtrip", "native_pool_reused", stats.reused, "count"))
+    native.quit(0)
+end)
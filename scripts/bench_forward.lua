@@ -0,0 +1,137 @@
+-- scripts/bench_forward.lua
+-- 命令延迟：转发给常驻 main 实例 vs 冷启动 (PESHELL_FORWARD=0)
+-- 用法: peshell run share/lua/5.1/bench_forward.lua [每种模式的调用次数，默认 50]
+-- 本机没有常驻实例时先启动一个临时实例 (到点自行退出)。两种模式执行同一条命令：kill 每次新启动的一个休眠进程，
+-- 测的是整个客户端进程的墙钟时间；每次调用后确认休眠进程确实已结束，命令没有执行时直接报错
+
+local log = _G.log
+local ffi = require("ffi")
+local native = _G.pesh_native
+
+local runs = tonumber(_G.arg and _G.arg[1]) or 50
+local is_windows = jit.os == "Windows"
+local exe = _G.PESHELL_EXE_DIR .. (is_windows and "\\peshell.exe" or "/peshell")
+
+local now_ms
+if is_windows then
+    ffi.cdef [[ uint64_t GetTickCount64(void); ]]
+    now_ms = function() return tonumber(ffi.C.GetTickCount64()) end
+else
+    ffi.cdef [[
+        typedef struct { long tv_sec; long tv_nsec; } pesh_timespec_t;
+        int clock_gettime(int clk_id, pesh_timespec_t* tp);
+    ]]
+    local ts = ffi.new("pesh_timespec_t")
+    now_ms = function()
+        ffi.C.clock_gettime(1, ts) -- CLOCK_MONOTONIC
+        return tonumber(ts.tv_sec) * 1000 + tonumber(ts.tv_nsec) / 1e6
+    end
+end
+
+local function command_line(forward, args)
+    if is_windows then
+        return string.format('set PESHELL_FORWARD=%d&& "%s" %s >nul 2>&1', forward, exe, args)
+    end
+    return string.format('PESHELL_FORWARD=%d "%s" %s >/dev/null 2>&1', forward, exe, args)
+end
+
+-- 临时常驻实例：main 模式的初始化脚本只是每 100 ms 看一次停止标记，最多存活 10 分钟
+local function start_resident(stop_file)
+    local script = os.tmpname() .. ".lua"
+    local f = assert(io.open(script, "w"))
+    f:write(string.format([[
+local async = pesh.plugin.load("async")
+async.run(function()
+    for _ = 1, 6000 do
+        local f = io.open(%q, "r")
+        if f then f:close() break end
+        await(async.sleep, 100)
+    end
+    pesh_native.quit(0)
+end)
+]], stop_file))
+    f:close()
+    local before = #native.stats_endpoints()
+    if is_windows then
+        os.execute(string.format('start "" /b "%s" main "%s" >nul 2>&1', exe, script))
+    else
+        os.execute(string.format('"%s" main "%s" >/dev/null 2>&1 &', exe, script))
+    end
+    -- 查询端点在命令端点之前一刻启动，出现后再留一点余量
+    local deadline = now_ms() + 10000
+    while #native.stats_endpoints() <= before and now_ms() < deadline do native.sleep(20) end
+    native.sleep(200)
+    return script
+end
+
+-- 被 kill 的目标：返回 pid 与存活检查函数
+local spawn_sleeper, is_alive
+if is_windows then
+    local process = _G.pesh.plugin.load("process")
+    spawn_sleeper = function()
+        local p = assert(process.exec_async({ command = "ping -n 60 127.0.0.1", show_mode = 0 }))
+        return p.pid
+    end
+    is_alive = function(pid) return process.find(pid) ~= nil end
+else
+    spawn_sleeper = function()
+        local pipe = assert(io.popen("sleep 60 >/dev/null 2>&1 & echo $!"))
+        local pid = tonumber(pipe:read("*l"))
+        pipe:close()
+        return assert(pid, "failed to start the sleeper")
+    end
+    -- 已结束但尚未被回收的进程 (状态 Z) 同样算作已结束
+    is_alive = function(pid)
+        local f = io.open("/proc/" .. pid .. "/stat", "r")
+        if not f then return false end
+        local stat = f:read("*l") or ""
+        f:close()
+        return stat:match("^%d+ %b() (%a)") ~= "Z"
+    end
+end
+
+local function kill_sleeper(forward)
+    local pid = spawn_sleeper()
+    local t0 = now_ms()
+    os.execute(command_line(forward, "kill " .. pid))
+    local elapsed = now_ms() - t0
+    local deadline = now_ms() + 2000
+    while is_alive(pid) and now_ms() < deadline do native.sleep(5) end
+    if is_alive(pid) then error(string.format("kill %d (forward=%d) did not end the sleeper", pid, forward)) end
+    return elapsed
+end
+
+local function measure(forward)
+    kill_sleeper(forward) -- 预热
+    local samples = {}
+    for i = 1, runs do samples[i] = kill_sleeper(forward) end
+    table.sort(samples)
+    return samples[math.floor(#samples / 2) + 1], samples[1]
+end
+
+local resident_script, stop_file = nil, nil
+if #native.stats_endpoints() == 0 then
+    stop_file = os.tmpname() .. ".stop"
+    resident_script = start_resident(stop_file)
+end
+
+local cold_median, cold_min = measure(0)
+local fwd_median, fwd_min = measure(1)
+local function report(name, value, unit)
+    print(string.format("%-28s %-28s %16.3f %s", "lua_forward", name, value, unit))
+end
+report("cold_median", cold_median, "ms")
+report("cold_min", cold_min, "ms")
+report("forwarded_median", fwd_median, "ms")
+report("forwarded_min", fwd_min, "ms")
+report("forward_speedup", cold_median / fwd_median, "x")
+
+if resident_script then
+    local f = io.open(stop_file, "w")
+    if f then f:close() end
+    native.sleep(300)
+    os.remove(stop_file)
+    os.remove(resident_script)
+end
+log.info("bench_forward: ", runs, " runs per mode")
+return 0
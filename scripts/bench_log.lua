@@ -0,0 +1,71 @@
+-- scripts/bench_log.lua
+-- Lua 日志调用吞吐：旧的 tostring + table.concat 路径 vs FFI 级别快速路径 + 原生格式化
+-- 用法: peshell main scripts/bench_log.lua run_from_main   (调用次数可用 PESH_BENCH_LOG_CALLS 调整)
+
+if not (_G.arg and _G.arg[1] == "run_from_main") then
+    local log = require("core.log")
+    log.info("This script is designed to be run via 'peshell main scripts/bench_log.lua run_from_main'")
+    return
+end
+
+local log = _G.log
+local native = _G.pesh_native
+local ffi = require("ffi")
+
+local call_count = tonumber(os.getenv("PESH_BENCH_LOG_CALLS")) or 1000000
+
+local now_ms
+if jit.os == "Windows" then
+    ffi.cdef [[ uint64_t GetTickCount64(void); ]]
+    now_ms = function() return tonumber(ffi.C.GetTickCount64()) end
+else
+    ffi.cdef [[
+        typedef struct { long tv_sec; long tv_nsec; } pesh_timespec_t;
+        int clock_gettime(int clk_id, pesh_timespec_t* tp);
+    ]]
+    local ts = ffi.new("pesh_timespec_t")
+    now_ms = function()
+        ffi.C.clock_gettime(1, ts) -- CLOCK_MONOTONIC
+        return tonumber(ts.tv_sec) * 1000 + tonumber(ts.tv_nsec) / 1e6
+    end
+end
+
+-- 改动前 core/log.lua 的做法，作为对照
+local function pack_and_concat(...)
+    local args = table.pack(...)
+    if args.n == 0 then return "" end
+    for i = 1, args.n do
+        args[i] = tostring(args[i])
+    end
+    return table.concat(args, " ", 1, args.n)
+end
+
+local legacy = {}
+for _, name in ipairs({ "trace", "info" }) do
+    local fn = native["log_" .. name]
+    legacy[name] = function(...) fn(pack_and_concat(...)) end
+end
+
+local function measure(fn, count)
+    collectgarbage("collect")
+    local start = now_ms()
+    for i = 1, count do
+        fn("bench", i, "value", 3.25, true)
+    end
+    return count / ((now_ms() - start) / 1000)
+end
+
+-- 被禁用的级别 (trace，默认级别为 info)：只应付出一次级别判断
+-- 启用的级别 (info)：包含 sink 写入开销，调用次数相应减少
+local enabled_count = math.max(1, math.floor(call_count / 100))
+local results = {
+    { "log_disabled", "legacy_concat", measure(legacy.trace, call_count) },
+    { "log_disabled", "ffi_fast_path", measure(log.trace, call_count) },
+    { "log_enabled", "legacy_concat", measure(legacy.info, enabled_count) },
+    { "log_enabled", "native_format", measure(log.info, enabled_count) },
+}
+
+for _, r in ipairs(results) do
+    print(string.format("%-28s %-28s %16.3f %s", r[1], r[2], r[3], "calls/s"))
+end
+native.quit(0)
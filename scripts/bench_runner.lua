@@ -0,0 +1,134 @@
+-- scripts/bench_runner.lua
+-- 依次以子进程运行各个 Lua 基准脚本，收集统一格式的指标行 ("用例 指标 数值 单位")，
+-- 输出与 peshell_bench --json 相同结构的 JSON，并可与先前保存的结果比较
+-- 用法: peshell run share/lua/5.1/bench_runner.lua [--json=path] [--baseline=path] [--tolerance=pct] [filter...]
+--   只运行名称包含任一 filter 的脚本；退出码同 peshell_bench: 0 通过，1 脚本失败，2 有性能回退
+
+local log = _G.log
+
+local is_windows = jit.os == "Windows"
+local exe = _G.PESHELL_EXE_DIR .. (is_windows and "\\peshell.exe" or "/peshell")
+local script_dir = debug.getinfo(1, "S").source:match("^@(.*[/\\])") or "./"
+
+-- 事件循环类脚本在 main 模式下运行，自行 quit；其余的在 run 模式下运行
+local BENCHES = {
+    { name = "bench_async", mode = "main" },
+    { name = "bench_log", mode = "main" },
+    { name = "bench_parallel", mode = "main" },
+    { name = "bench_startup", mode = "run" },
+    { name = "bench_forward", mode = "run" },
+}
+
+local json_path, baseline_path, tolerance = nil, nil, 15
+local filters = {}
+for _, a in ipairs(_G.arg or {}) do
+    local key, value = a:match("^%-%-(%w+)=(.*)$")
+    if key == "json" then json_path = value
+    elseif key == "baseline" then baseline_path = value
+    elseif key == "tolerance" then tolerance = tonumber(value) or tolerance
+    else filters[#filters + 1] = a end
+end
+
+local function selected(name)
+    if #filters == 0 then return true end
+    for _, f in ipairs(filters) do
+        if name:find(f, 1, true) then return true end
+    end
+    return false
+end
+
+local function command_line(bench)
+    local script = script_dir .. bench.name .. ".lua"
+    local tail = bench.mode == "main" and " run_from_main" or ""
+    local devnull = is_windows and "nul" or "/dev/null"
+    return string.format('"%s" %s "%s"%s 2>%s', exe, bench.mode, script, tail, devnull)
+end
+
+-- 与 bench/bench_main.cpp 的 Direction 一致：-1 越小越好，+1 越大越好，0 不参与比较
+local function direction(unit)
+    for _, t in ipairs({ "ns", "us", "ms", "s" }) do
+        if unit == t or unit:sub(1, #t + 1) == t .. "/" then return -1 end
+    end
+    if unit == "x" or (#unit > 2 and unit:sub(-2) == "/s") then return 1 end
+    if unit == "count" then return 0 end
+    return -1
+end
+
+local results, failed = {}, false
+for _, bench in ipairs(BENCHES) do
+    if selected(bench.name) then
+        local pipe = assert(io.popen(command_line(bench), "r"))
+        local count = 0
+        for line in pipe:lines() do
+            local case, metric, value, unit = line:match("^(%S+)%s+(%S+)%s+(%-?[%d%.]+)%s+(%S+)%s*$")
+            if case then
+                results[#results + 1] = { case = case, metric = metric, value = tonumber(value), unit = unit }
+                count = count + 1
+            end
+            io.write(line, "\n")
+        end
+        local ok, _, code = pipe:close()
+        -- LuaJIT 未开启 5.2 兼容时 close 只返回 true，此时以是否产出指标判断
+        if ok == false or (code and code ~= 0) or count == 0 then
+            failed = true
+            log.error("bench_runner: ", bench.name, " failed (exit ", tostring(code), ", ", count, " metrics)")
+        end
+    end
+end
+
+local function format_json()
+    local out = { string.format('{"suite":"lua","failed":%s,"results":[\n', tostring(failed)) }
+    for i, r in ipairs(results) do
+        out[#out + 1] = string.format('{"case":"%s","metric":"%s","value":%.9g,"unit":"%s"}%s\n', r.case, r.metric,
+            r.value, r.unit, i < #results and "," or "")
+    end
+    out[#out + 1] = "]}\n"
+    return table.concat(out)
+end
+
+if json_path then
+    local f = io.open(json_path, "wb")
+    if f then
+        f:write(format_json())
+        f:close()
+    else
+        log.error("bench_runner: cannot write '", json_path, "'")
+    end
+end
+
+local regressions = 0
+if baseline_path then
+    local f = io.open(baseline_path, "r")
+    if not f then
+        log.error("bench_runner: cannot read baseline '", baseline_path, "'")
+        return 1
+    end
+    local baseline = {}
+    for line in f:lines() do
+        local case, metric = line:match('"case":"([^"]*)"'), line:match('"metric":"([^"]*)"')
+        if case and metric then
+            baseline[case .. "/" .. metric] = { value = tonumber(line:match('"value":([^,}]+)')), unit = line:match('"unit":"([^"]*)"') }
+        end
+    end
+    f:close()
+
+    print(string.format("\n%-28s %-28s %14s %14s %9s", "case", "metric", "baseline", "current", "change"))
+    for _, r in ipairs(results) do
+        local base = baseline[r.case .. "/" .. r.metric]
+        local dir = direction(r.unit)
+        if base and base.unit == r.unit and dir ~= 0 and base.value and base.value ~= 0 then
+            local change = (r.value - base.value) / base.value * 100
+            local worse = -change * dir
+            local verdict = worse > tolerance and "  REGRESSED" or (worse < -tolerance and "  improved" or "")
+            if worse > tolerance then regressions = regressions + 1 end
+            print(string.format("%-28s %-28s %14.3f %14.3f %+8.1f%%%s", r.case, r.metric, base.value, r.value, change, verdict))
+        end
+    end
+    print(string.format("%d regression(s) beyond %.0f%%", regressions, tolerance))
+end
+
+if #results == 0 and not failed then
+    log.error("bench_runner: no benchmark matched")
+    return 1
+end
+return failed and 1 or (regressions > 0 and 2 or 0)
@@ -0,0 +1,64 @@
+-- scripts/bench_startup.lua
+-- 冷启动耗时：松散脚本 (PESHELL_BUNDLE=0) vs 字节码包 (bin/peshell.bundle)
+-- 用法: peshell run share/lua/5.1/bench_startup.lua [每种模式的启动次数，默认 20]
+-- 这里测的是整个子进程的墙钟时间；宿主另在日志中以 info 级别记录 "exe 启动 -> DispatchCommand 返回" 的耗时
+
+local log = _G.log
+local ffi = require("ffi")
+
+local runs = tonumber(_G.arg and _G.arg[1]) or 20
+local is_windows = jit.os == "Windows"
+local exe = _G.PESHELL_EXE_DIR .. (is_windows and "\\peshell.exe" or "/peshell")
+
+local now_ms
+if is_windows then
+    ffi.cdef [[ uint64_t GetTickCount64(void); ]]
+    now_ms = function() return tonumber(ffi.C.GetTickCount64()) end
+else
+    ffi.cdef [[
+        typedef struct { long tv_sec; long tv_nsec; } pesh_timespec_t;
+        int clock_gettime(int clk_id, pesh_timespec_t* tp);
+    ]]
+    local ts = ffi.new("pesh_timespec_t")
+    now_ms = function()
+        ffi.C.clock_gettime(1, ts) -- CLOCK_MONOTONIC
+        return tonumber(ts.tv_sec) * 1000 + tonumber(ts.tv_nsec) / 1e6
+    end
+end
+
+local function command_line(bundle, args)
+    if is_windows then
+        return string.format('set PESHELL_BUNDLE=%d&& "%s" %s >nul 2>&1', bundle, exe, args)
+    end
+    return string.format('PESHELL_BUNDLE=%d "%s" %s >/dev/null 2>&1', bundle, exe, args)
+end
+
+-- help 只走 prelude；flight 额外按需加载一个插件 (缺少参数时返回 1，不影响计时)
+local function measure(bundle, args)
+    local cmd = command_line(bundle, args)
+    os.execute(cmd) -- 预热文件缓存
+    local samples = {}
+    for i = 1, runs do
+        local t0 = now_ms()
+        os.execute(cmd)
+        samples[i] = now_ms() - t0
+    end
+    table.sort(samples)
+    return samples[math.floor(#samples / 2) + 1], samples[1]
+end
+
+local function report(name, value, unit)
+    print(string.format("%-28s %-28s %16.3f %s", "lua_startup", name, value, unit))
+end
+
+for _, args in ipairs({ "help", "flight" }) do
+    local loose_median, loose_min = measure(0, args)
+    local bundle_median, bundle_min = measure(1, args)
+    report(args .. "_loose_median", loose_median, "ms")
+    report(args .. "_loose_min", loose_min, "ms")
+    report(args .. "_bundle_median", bundle_median, "ms")
+    report(args .. "_bundle_min", bundle_min, "ms")
+    report(args .. "_bundle_speedup", loose_median / bundle_median, "x")
+end
+log.info("bench_startup: ", runs, " runs per mode")
+return 0
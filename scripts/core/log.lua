@@ -1,42 +1,52 @@
 -- scripts/core/log.lua
 -- 提供一个简单、统一的日志接口给所有 Lua 脚本
+-- 级别判断在 Lua 侧完成：通过 FFI 直接读取原生层当前生效的级别，被禁用的调用不跨越 Lua/C 边界，
+-- 也不会对参数做 tostring/拼接；启用的调用把参数原样交给原生层，由其直接格式化进日志缓冲区。
 
 local M = {}
 local native = pesh_native
+local ffi = require("ffi")
 
--- 内部辅助函数，使用 table.pack 安全地处理可变参数
-local function pack_and_concat(...)
-    local args = table.pack(...)
-    if args.n == 0 then return "" end
+-- 与 spdlog::level::level_enum 数值一致
+local LEVELS = { trace = 0, debug = 1, info = 2, warn = 3, error = 4, critical = 5 }
 
-    for i = 1, args.n do
-        args[i] = tostring(args[i])
-    end
-    return table.concat(args, " ", 1, args.n)
+-- 原生层 std::atomic<int>，随 config/logging.ini 热更新；volatile 保证每次都重新读取
+local active_level = ffi.cast("const volatile int32_t*", native.log_level_ptr())
+
+-- 指定级别当前是否会被输出，用于在构造昂贵的日志参数前提前判断
+function M.enabled(name)
+    local level = LEVELS[name]
+    return level ~= nil and active_level[0] <= level
 end
 
 function M.trace(...)
-    native.log_trace(pack_and_concat(...))
+    if active_level[0] > 0 then return end
+    native.log_trace(...)
 end
 
 function M.debug(...)
-    native.log_debug(pack_and_concat(...))
+    if active_level[0] > 1 then return end
+    native.log_debug(...)
 end
 
 function M.info(...)
-    native.log_info(pack_and_concat(...))
+    if active_level[0] > 2 then return end
+    native.log_info(...)
 end
 
 function M.warn(...)
-    native.log_warn(pack_and_concat(...))
+    if active_level[0] > 3 then return end
+    native.log_warn(...)
 end
 
 function M.error(...)
-    native.log_error(pack_and_concat(...))
+    if active_level[0] > 4 then return end
+    native.log_error(...)
 end
 
 function M.critical(...)
-    native.log_critical(pack_and_concat(...))
+    if active_level[0] > 5 then return end
+    native.log_critical(...)
 end
 
-return M
\ No newline at end of file
+return M
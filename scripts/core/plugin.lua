@@ -17,7 +17,9 @@ function M.load(plugin_name)
     
     local module_path = "plugins." .. plugin_name:gsub("[/\\]", ".")
     
+    local span, span_name = _G.pesh_native.trace_begin("plugin " .. plugin_name)
     local status, plugin_module = pcall(require, module_path)
+    _G.pesh_native.trace_end(span, span_name)
 
     if not status then
         error("Failed to load plugin '" .. plugin_name .. "': " .. tostring(plugin_module), 2)
@@ -9,8 +9,9 @@ local log = _G.log
 local native = _G.pesh_native
 local coro_pool = pesh.plugin.load("coro_pool")
 
--- 协程锚定表，防止 GC
-local active_anchors = {}
+-- 协程 -> 正在等待的原生操作 id，供 M.cancel 使用
+-- (等待期间的 GC 锚定由原生调度器负责，不需要 Lua 侧的表)
+local pending_ops = setmetatable({}, { __mode = "k" })
 
 -- 全局的 await 函数
 function _G.await(future_provider_func, ...)
@@ -19,27 +20,70 @@ function _G.await(future_provider_func, ...)
         error("await() must be called from within a coroutine, not the main thread.", 2)
     end
 
-    active_anchors[co] = true
-
     future_provider_func(co, ...)
     
-    local resumed_success, resumed_data_or_error = coroutine.yield()
+    local resumed_success, resumed_data_or_error, error_code = coroutine.yield()
     
-    active_anchors[co] = nil
+    pending_ops[co] = nil
     
     if not resumed_success then
         error(resumed_data_or_error, 2)
     end
     
+    return resumed_data_or_error, error_code
+end
+
+-- 与 await 相同，但失败时返回 nil, 错误信息, 错误码 (取消为 -1) 而不是抛出
+function M.try_await(future_provider_func, ...)
+    local co, is_main = coroutine.running()
+    if not co or is_main then
+        error("try_await() must be called from within a coroutine, not the main thread.", 2)
+    end
+
+    future_provider_func(co, ...)
+    local resumed_success, resumed_data_or_error, error_code = coroutine.yield()
+    pending_ops[co] = nil
+
+    if not resumed_success then
+        return nil, resumed_data_or_error, error_code
+    end
     return resumed_data_or_error
 end
 
+-- 与 await 相同，并把从发起到恢复的整段等待记为名为 name 的追踪 span (Lua 分类)；追踪关闭时只多两次原生调用
+-- name 会永久驻留在追踪的名称表中，应为固定字符串
+function M.traced(name, future_provider_func, ...)
+    local span, span_name = native.trace_begin(name)
+    local data, err = M.try_await(future_provider_func, ...)
+    native.trace_end(span, span_name)
+    if err ~= nil then
+        error(err, 2)
+    end
+    return data
+end
+
+-- 按名称解析一次原生工作者，返回可交给 await 的 provider(co, ...)；未知名称立即报错
+-- opts.priority: 数值大者先执行，默认 0
+function M.worker(name, opts)
+    local id = native.worker_id(name)
+    local priority = opts and opts.priority or 0
+    return function(co, ...)
+        local op = native.dispatch(co, id, priority, ...)
+        if op ~= 0 then pending_ops[co] = op end
+    end
+end
+
+-- 取消 co 正在等待的原生操作：排队中的立即以错误码 -1 完成，执行中的由工作者自行尽早放弃
+function M.cancel(co)
+    local op = pending_ops[co]
+    if not op then return false end
+    return native.cancel_worker(op)
+end
+
 M.run = coro_pool.run
 log.info("Async plugin initialized.")
 
-local function sleep_async_impl(co, ms)
-    native.dispatch_worker("timer_worker", ms, co)
-end
+local sleep_async_impl = M.worker("timer")
 
 function M.sleep(co, ms)
     return sleep_async_impl(co, ms)
@@ -0,0 +1,40 @@
+-- scripts/plugins/flight/init.lua
+-- 飞行记录器 (src/flight_recorder.cpp)：按需转储与离线解码
+-- 崩溃或正常退出时转储自动写入 logs/peshell_<pid>_<时间>.flight (崩溃为 .crash.flight)
+-- 用法: peshell flight <dump 文件> [--json]
+
+local log = _G.log
+local native = _G.pesh_native
+local M = {}
+
+-- 把当前进程所有线程的记录写入 path (省略时为本次会话的默认路径)，返回实际路径或 nil, err
+function M.dump(path)
+    return native.flight_dump(path)
+end
+
+-- 返回解码后的文本；json 为 true 时每条记录一行 JSON
+function M.decode(path, json)
+    return native.flight_decode(path, json)
+end
+
+M.__commands = {
+    flight = function(args)
+        local path, json = nil, false
+        for _, a in ipairs(args.cmd) do
+            if a == "--json" then json = true else path = a end
+        end
+        if not path then
+            log.error("flight: Usage: peshell flight <dump file> [--json]")
+            return 1
+        end
+        local text, err = M.decode(path, json)
+        if not text then
+            log.error("flight: ", err)
+            return 1
+        end
+        io.stdout:write(text)
+        return 0
+    end
+}
+
+return M
@@ -1,18 +1,221 @@
 -- scripts/plugins/fs_async/init.lua
 -- 异步文件系统操作插件
 
+local pesh = _G.pesh
 local log = _G.log
 local native = _G.pesh_native
+local async = pesh.plugin.load("async")
+local ffi = require("ffi")
 local M = {}
 
+local file_copy = async.worker("file_copy")
+local file_read = async.worker("file_read")
+local file_map = async.worker("file_map")
+local file_stat = async.worker("file_stat")
+
+-- 与 src/file_buffer.h 中的 pesh_buffer 布局一致
+ffi.cdef [[
+    typedef struct pesh_buffer {
+        const uint8_t* data;
+        size_t size;
+        void (*release)(struct pesh_buffer*);
+    } pesh_buffer_t;
+]]
+
+local buffer_methods = {}
+local live_buffers = setmetatable({}, { __mode = "k" })
+
+-- 立即归还映射/池块，重复调用无副作用；之后不得再访问 data
+function buffer_methods.free(buf)
+    if live_buffers[buf] then
+        live_buffers[buf] = nil
+        ffi.gc(buf, nil)
+        buf.release(buf)
+    end
+end
+
+-- 复制为 Lua 字符串 (可选区间，0 起始偏移)
+function buffer_methods.string(buf, offset, length)
+    offset = offset or 0
+    length = length or (tonumber(buf.size) - offset)
+    return ffi.string(buf.data + offset, length)
+end
+
+ffi.metatype("pesh_buffer_t", {
+    __index = buffer_methods,
+    __len = function(buf) return tonumber(buf.size) end,
+})
+
+-- 交出 buf 的所有权 (例如交给 parallel.share)：此后不再由 GC 或 free 释放；buf 已释放时返回 false
+function M.detach_buffer(buf)
+    if not live_buffers[buf] then return false end
+    live_buffers[buf] = nil
+    ffi.gc(buf, nil)
+    return true
+end
+
+-- 原生层交付的 lightuserdata -> 带 GC 释放的 cdata
+local function wrap_buffer(handle)
+    if handle == nil then return nil end
+    local buf = ffi.cast("pesh_buffer_t*", handle)
+    ffi.gc(buf, buf.release)
+    live_buffers[buf] = true
+    return buf
+end
+
 function M.copy_file_async(co, source_path, dest_path)
     log.debug("Dispatching worker to copy '", source_path, "' to '", dest_path, "'")
-    native.dispatch_worker("file_copy_worker", source_path, dest_path, co)
+    file_copy(co, source_path, dest_path)
 end
 
 function M.read_file_async(co, filepath)
     log.debug("Dispatching worker to read '", filepath, "'")
-    native.dispatch_worker("file_read_worker", filepath, co)
+    file_read(co, filepath)
+end
+
+function M.map_file_async(co, filepath)
+    log.debug("Dispatching worker to map '", filepath, "'")
+    file_map(co, filepath)
+end
+
+-- 结果为 { size, mtime (Unix 秒), is_dir (0/1) }
+function M.stat_file_async(co, filepath)
+    file_stat(co, filepath)
+end
+
+-- 合并写入 (src/write_behind.h)：由后台 I/O 线程执行，同一文件排队中的小追加拼成一次写入，
+-- 要求落盘的请求同批共用一次 fsync。同一文件的请求按提交顺序生效，排队中的追加会被随后的替换覆盖
+--   fs_async.append_file(path, data)                          不等待 (日志类)，失败只记日志
+--   await(fs_async.append_file_async, path, data, { sync = true })  写完 (sync 时落盘) 后返回 true
+--   await(fs_async.replace_file_async, path, data)            写入同目录临时文件后改名替换，读者不会看到半份内容；
+--                                                             默认落盘，opts.sync = false 时只替换
+--   await(fs_async.flush_async)                               此前提交的全部写入落盘后返回 true
+-- co 为 nil 时 append_file_async / replace_file_async 也不等待
+function M.append_file(path, data)
+    native.write_append(nil, path, data, false)
+end
+
+function M.append_file_async(co, path, data, opts)
+    native.write_append(co, path, data, opts ~= nil and opts.sync == true)
+end
+
+function M.replace_file_async(co, path, data, opts)
+    native.write_replace(co, path, data, not (opts and opts.sync == false))
+end
+
+function M.flush_async(co)
+    native.write_flush(co)
+end
+
+-- 零拷贝整文件读取 (须在协程中调用)，返回 pesh_buffer_t*：
+--   buf.data / buf.size / #buf / buf:string([offset, length]) / buf:free()
+-- 未显式 free 的缓冲区在 GC 时释放
+function M.read_file_buffer(filepath)
+    return wrap_buffer(await(M.map_file_async, filepath))
+end
+
+-- 分块流式读取 (co 为当前协程)：
+--   for chunk in fs_async.read_chunks(co, path, 1024 * 1024) do ... end
+-- 后台最多预读 depth 块；chunk 只在本次迭代内有效，需要保留请用 chunk:string()
+function M.read_chunks(co, filepath, chunk_size, depth)
+    local running = coroutine.running()
+    if co ~= running then error("read_chunks() must be called with the running coroutine.", 2) end
+
+    local handle, err = native.chunk_reader_open(filepath, chunk_size or 1024 * 1024, depth or 4)
+    if not handle then error("Chunk reader open failed: " .. tostring(err), 2) end
+
+    -- handle 是带 __gc 的原生 userdata，迭代提前中断时由 GC 关闭读取器
+    local closed = false
+    local previous = nil
+    local function close()
+        if not closed then
+            closed = true
+            native.chunk_reader_close(handle)
+        end
+    end
+
+    return function()
+        if previous then
+            previous:free()
+            previous = nil
+        end
+        if closed then return nil end
+
+        local ok, chunk_or_err = pcall(await, function(c) native.chunk_reader_next(c, handle) end)
+        if not ok then
+            close()
+            error(chunk_or_err, 2)
+        end
+        previous = wrap_buffer(chunk_or_err)
+        if not previous then close() end
+        return previous
+    end
+end
+
+-- 并行目录树复制 (须在协程中调用)，返回最终进度表；有文件失败或被取消时抛出错误
+-- opts: concurrency, bandwidth (字节/秒), progress_interval (毫秒), small_file_bytes, chunk_bytes,
+--       on_progress(p) 周期性回调，p 含 files_done/files_total/bytes_done/bytes_total/elapsed_ms/scanning
+function M.copy_tree(src_dir, dest_dir, opts)
+    opts = opts or {}
+    log.debug("Starting tree copy '", src_dir, "' -> '", dest_dir, "'")
+    -- job 是带 __gc 的原生 userdata，协程被放弃时由 GC 取消任务
+    local job = native.tree_copy_start(src_dir, dest_dir, opts)
+
+    local progress
+    repeat
+        progress = await(function(co) native.tree_copy_next(co, job) end)
+        if opts.on_progress and not progress.finished then opts.on_progress(progress) end
+    until progress.finished
+
+    native.tree_copy_close(job)
+
+    if progress.cancelled then error("Tree copy cancelled", 2) end
+    if progress.errors > 0 then
+        error(string.format("Tree copy failed for %d file(s): %s", progress.errors, tostring(progress.first_error)), 2)
+    end
+    return progress
+end
+
+-- 并行目录扫描 (co 为当前协程)，按批次迭代条目，扫描期间即可处理已到达的批次：
+--   for batch in fs_async.scan_tree(co, root, { hash = "xxh3" }) do
+--       for _, e in ipairs(batch) do print(e.path, e.size, e.mtime, e.hash) end
+--   end
+-- 条目: path (相对 root), size, mtime (Unix 秒), attributes (Windows 文件属性 / Linux st_mode), is_dir,
+--       hash (仅在请求了校验和的普通文件上，十六进制字符串)
+-- opts: hash ("crc32c" | "xxh3"), concurrency, batch (每批条目数), max_batches (未取走批次上限，满时扫描暂停),
+--       on_finish(summary) 结束时回调，summary 含 entries/files/dirs/bytes/hashed_bytes/errors/elapsed_ms；
+--       有条目失败时迭代结束后抛出错误，ignore_errors = true 时只交给 on_finish
+function M.scan_tree(co, root, opts)
+    local running = coroutine.running()
+    if co ~= running then error("scan_tree() must be called with the running coroutine.", 2) end
+    opts = opts or {}
+
+    -- job 是带 __gc 的原生 userdata，迭代提前中断时由 GC 取消扫描
+    local job = native.tree_scan_start(root, opts)
+    local closed = false
+    local function close()
+        if not closed then
+            closed = true
+            native.tree_scan_close(job)
+        end
+    end
+
+    return function()
+        if closed then return nil end
+        local ok, result = pcall(await, function(c) native.tree_scan_next(c, job) end)
+        if not ok then
+            close()
+            error(result, 2)
+        end
+        if not result.finished then return result end
+
+        close()
+        if opts.on_finish then opts.on_finish(result) end
+        if result.errors > 0 and not opts.ignore_errors then
+            error(string.format("Tree scan failed for %d entries: %s", result.errors, tostring(result.first_error)), 2)
+        end
+        return nil
+    end
 end
 
-return M
\ No newline at end of file
+return M
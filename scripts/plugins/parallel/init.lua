@@ -0,0 +1,145 @@
+-- scripts/plugins/parallel/init.lua
+-- 并行 Lua 工作者 (src/lua_workers.cpp)：CPU 密集的脚本任务在线程池上相互隔离的 Lua 状态中执行
+--   local v = parallel.run("mylib.inf", "parse", text)          -- 工作者中执行 require("mylib.inf").parse(text)
+--   local v = parallel.run(function(buf, n) ... end, buf, 42)   -- 不带上值的函数，按字节码传递
+--   local vs = parallel.map(fn, { a, b, c })                    -- 每项一个作业，结果按原顺序返回
+-- 参数与结果 (只取第一个返回值) 在状态间复制：nil / 布尔 / 数值 / 字符串 / 表。
+-- 大块数据请用 parallel.buffer / parallel.share 得到的共享缓冲区，传递时只增加引用，不复制内容；
+-- 工作者收到的缓冲区只在本次作业内有效，需要留给之后的作业时请复制 (parallel.buffer(buf:string()))。
+-- 工作者状态执行同一份 prelude，但只有同步接口 (没有 await 与调度器)，全局变量不与主状态或其他工作者共享。
+
+local native = _G.pesh_native
+local ffi = require("ffi")
+local M = {}
+
+-- 与 src/shared_buffer.h 中的 pesh_shared 布局一致
+ffi.cdef [[
+    typedef struct pesh_shared {
+        uint8_t* data;
+        size_t size;
+        int32_t readonly;
+        void (*retain)(struct pesh_shared*);
+        void (*release)(struct pesh_shared*);
+    } pesh_shared_t;
+]]
+
+local shared_methods = {}
+local live_buffers = setmetatable({}, { __mode = "k" })
+
+-- 立即放弃本状态持有的引用，重复调用无副作用；其他状态中的引用不受影响
+function shared_methods.free(buf)
+    if live_buffers[buf] then
+        live_buffers[buf] = nil
+        ffi.gc(buf, nil)
+        buf.release(buf)
+    end
+end
+
+-- 复制为 Lua 字符串 (可选区间，0 起始偏移)
+function shared_methods.string(buf, offset, length)
+    offset = offset or 0
+    length = length or (tonumber(buf.size) - offset)
+    return ffi.string(buf.data + offset, length)
+end
+
+ffi.metatype("pesh_shared_t", {
+    __index = shared_methods,
+    __len = function(buf) return tonumber(buf.size) end,
+})
+
+-- 原生层交付的 lightuserdata -> cdata。作业参数中的缓冲区是借用的 (borrowed)，只在本次作业内有效，
+-- 不挂 GC 释放；其余情况下原生层已为本状态增加一个引用，由 GC 或 free 归还
+local function wrap(handle, borrowed)
+    local buf = ffi.cast("pesh_shared_t*", handle)
+    if not borrowed then
+        ffi.gc(buf, buf.release)
+        live_buffers[buf] = true
+    end
+    return buf
+end
+native.shared_wrapper(wrap)
+
+-- 是否运行在工作者状态中
+M.is_worker = _G.PESHELL_WORKER == true
+
+-- 新的可写共享缓冲区：size 个零字节，或字符串的副本。buf.data / buf.size / #buf / buf:string() / buf:free()
+function M.buffer(size_or_string)
+    return wrap(native.shared_new(size_or_string))
+end
+
+if M.is_worker then
+    return M
+end
+
+local fs_async = _G.pesh.plugin.load("fs_async")
+
+-- 接管 fs_async.read_file_buffer 得到的映射缓冲区 (只读，readonly 为 1)，原 buf 此后不得再使用
+function M.share(buf)
+    if not fs_async.detach_buffer(buf) then
+        error("share() needs a live pesh_buffer_t", 2)
+    end
+    return wrap(native.shared_adopt(buf))
+end
+
+-- 函数 -> 字节码，按函数缓存；上值无法带到另一个状态
+local chunks = setmetatable({}, { __mode = "k" })
+local function chunk_of(fn)
+    local code = chunks[fn]
+    if not code then
+        if debug.getupvalue(fn, 1) ~= nil then
+            error("parallel functions must not capture upvalues (pass them as arguments)", 3)
+        end
+        code = string.dump(fn)
+        chunks[fn] = code
+    end
+    return code
+end
+
+local function resolve(target, ...)
+    if type(target) == "function" then
+        return chunk_of(target), nil, ...
+    end
+    return target, ...
+end
+
+-- 须在协程中调用；工作者中的错误 (含其调用栈) 在此抛出
+function M.run(target, ...)
+    return await(function(co, ...) native.parallel_submit(co, nil, ...) end, resolve(target, ...))
+end
+
+-- 对 items 的每一项并行执行 target(item) (模块形式为 target, name, items)，结果按 items 的顺序返回；
+-- 任一作业失败时等全部结束后抛出第一个错误
+function M.map(target, ...)
+    local code, name, items
+    if type(target) == "function" then
+        code, items = chunk_of(target), ...
+    else
+        code, name, items = target, ...
+    end
+    local co, is_main = coroutine.running()
+    if not co or is_main then
+        error("map() must be called from within a coroutine, not the main thread.", 2)
+    end
+
+    for i, item in ipairs(items) do
+        native.parallel_submit(co, i, code, name, item)
+    end
+    local results, first_error = {}, nil
+    for _ = 1, #items do
+        local ok, value = coroutine.yield()
+        if ok then
+            results[value[1]] = value[2]
+        elseif first_error == nil then
+            first_error = value
+        end
+    end
+    if first_error ~= nil then error(first_error, 2) end
+    return results
+end
+
+-- { states, idle, queued, completed, failed }
+function M.stats()
+    return native.parallel_stats()
+end
+
+return M
@@ -3,13 +3,49 @@
 -- Version: 10.0
 
 local pesh = _G.pesh
+local native = _G.pesh_native
 local M = {}
 
 local log = _G.log
+
+-- 非 Windows 平台只提供 kill：按 pid 或进程名 (原生进程表) 发送信号，其余命令与 API 依赖 Win32
+if jit.os ~= "Windows" then
+    local ffi = require("ffi")
+    ffi.cdef [[ int kill(int pid, int sig); ]]
+    local SIGTERM, SIGKILL = 15, 9
+
+    function M.find_all(name)
+        return native.process_find(name)
+    end
+
+    M.__commands = {
+        kill = function(args)
+            local graceful, targets = false, {}
+            for _, a in ipairs(args.cmd) do
+                if a == "--graceful" or a == "-g" then graceful = true else targets[#targets + 1] = a end
+            end
+            if #targets == 0 then return 1 end
+
+            local sig = graceful and SIGTERM or SIGKILL
+            local all_ok = true
+            for _, target in ipairs(targets) do
+                local pid = tonumber(target)
+                for _, p in ipairs(pid and { pid } or M.find_all(target)) do
+                    if ffi.C.kill(p, sig) ~= 0 then
+                        args.log.warn("Failed to terminate PID: ", p)
+                        all_ok = false
+                    end
+                end
+            end
+            return all_ok and 0 or 1
+        end
+    }
+    return M
+end
+
 local path = require("ext.path")
 local cli = require("ext.cli")
 local ffi = require("ffi")
-local os_ext = require("ext.os")
 
 local status, proc = pcall(require, "proc_utils_ffi")
 if not status then 
@@ -54,8 +90,20 @@ function M.find(name_or_pid)
     return p_obj
 end
 
+-- 来自原生常驻进程表 (src/process_table.h) 的增量索引，不做系统快照
 function M.find_all(name)
-    return proc.find_all(name)
+    return native.process_find(name)
+end
+
+-- 以下为 await 用的 provider，超时不抛出：
+--   local pid = await(process.wait_appeared, "explorer.exe", 5000)   -- 超时为 nil
+--   local gone = await(process.wait_gone, "explorer.exe", 3000)      -- 超时为 false
+function M.wait_appeared(co, name, timeout_ms)
+    native.process_wait(co, name, "appeared", timeout_ms or -1)
+end
+
+function M.wait_gone(co, name, timeout_ms)
+    native.process_wait(co, name, "gone", timeout_ms or -1)
 end
 
 function M.kill_all_by_name(process_name, use_graceful)
@@ -90,26 +138,14 @@ M.wait_for_exit = function(co, process_obj)
     _G.pesh_native.wait_for_multiple_objects(co, { wait_struct })
 end
 
+-- 阻塞等待进程退出，期间继续分发本线程的窗口消息；超时返回 false。
+-- 单次内核等待 (MsgWaitForMultipleObjectsEx)，不再每 50 ms 醒来轮询；协程中请用 await(process.wait_for_exit, p)
 function M.wait_for_exit_pump(process_obj, timeout_ms)
-    if not process_obj or not process_obj.wait_for_exit then 
-        return false 
-    end
-    timeout_ms = timeout_ms or -1
-    local start_tick = k32.GetTickCount()
-    
-    while true do
-        if process_obj:wait_for_exit(0) then return true end
-        
-        if timeout_ms >= 0 then
-            if (k32.GetTickCount() - start_tick) > timeout_ms then return false end
-        end
-        
-        if os_ext.sleep_pump then
-            os_ext.sleep_pump(50)
-        else
-            _G.pesh_native.sleep(50) 
-        end
+    if not process_obj or not process_obj.handle then
+        return false
     end
+    local wait_struct = ffi.new("struct { void* h; }", { h = process_obj:handle() })
+    return native.wait_for_multiple_objects_blocking({ wait_struct }, timeout_ms or -1, true) == 1
 end
 
 function M.get_self_path()
@@ -189,7 +225,7 @@ M.__commands = {
             if p_obj then
                 if not p_obj:terminate_tree() then all_ok = false end
             else
-                log.warn("Process not found: ", target)
+                args.log.warn("Process not found: ", target)
             end
         end
         return all_ok and 0 or 1
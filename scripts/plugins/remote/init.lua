@@ -0,0 +1,73 @@
+-- scripts/plugins/remote/init.lua
+-- 常驻实例执行其他 peshell 进程转发来的命令 (src/command_channel.h)。
+-- 宿主在 main 模式进入事件循环前调用 serve()；每条命令在自己的协程中经 DispatchCommandArgs 执行，
+-- 互不阻塞。命令经 args.log 报告的消息收集到本命令自己的输出中，连同退出码交回客户端；
+-- 不替换任何全局函数，其他协程的输出与日志照常。
+
+local pesh = _G.pesh
+local log = _G.log
+local native = _G.pesh_native
+local M = {}
+
+local async = pesh.plugin.load("async")
+
+-- 在当前协程中执行 argv = { 命令名, 参数... }，返回退出码与收集到的输出
+function M.execute(argv, cwd)
+    local out = {}
+    local cmd_args = { unpack(argv) }
+    cmd_args.n = #argv
+    local ok, code = pcall(_G.DispatchCommandArgs, cmd_args, {
+        forwarded = true,
+        cwd = cwd,
+        output = function(text) out[#out + 1] = text end,
+    })
+    if not ok then
+        out[#out + 1] = "peshell: " .. tostring(code) .. "\n"
+        code = 1
+    end
+    return tonumber(code) or 0, table.concat(out)
+end
+
+local function run_forwarded(request)
+    local code, output = M.execute(request.args, request.cwd)
+    native.command_reply(request.id, code, output)
+end
+
+-- 主线程同步等待的子进程若再调用 peshell kill，转发回本实例就会互相等待。
+-- 经 os.execute / io.popen 启动的子进程在命令行前加上只对该子进程生效的 PESHELL_FORWARD=0，
+-- 本进程的环境不变 (不在有其他线程运行时修改环境)。Windows 上命令行因此不再以引号开头，
+-- cmd /c 不会剥去最外层的一对引号，命令无需再为此多包一层引号
+local CHILD_PREFIX = jit.os == "Windows" and 'set "PESHELL_FORWARD=0" & ' or "PESHELL_FORWARD=0; export PESHELL_FORWARD; "
+
+local function cold_start_children(spawn)
+    return function(command, ...)
+        if type(command) ~= "string" then return spawn(command, ...) end
+        return spawn(CHILD_PREFIX .. command, ...)
+    end
+end
+
+local serving = false
+
+function M.serving()
+    return serving
+end
+
+function M.serve()
+    if serving then return end
+    serving = true
+    os.execute = cold_start_children(os.execute)
+    io.popen = cold_start_children(io.popen)
+    async.run(function()
+        while true do
+            local request, err = async.try_await(native.command_next)
+            if not request then
+                log.error("remote: command channel failed: ", err)
+                return
+            end
+            async.run(run_forwarded, request)
+        end
+    end)
+    log.info("remote: accepting forwarded commands")
+end
+
+return M
@@ -49,12 +49,13 @@ local function ensure_clean_state(process_name, timeout_ms)
         local pids = process.find_all(process_name)
         
         -- 1. 如果没有找到任何进程，说明环境已干净
-        if not pids or #pids == 0 then
+        if #pids == 0 then
             return true
         end
 
         -- 2. 检查是否超时
-        if (k32.GetTickCount() - start_time) > timeout_ms then
+        local remaining = timeout_ms - (k32.GetTickCount() - start_time)
+        if remaining <= 0 then
             log.error("GUARDIAN: Timeout waiting for '", process_name, "' to die. PIDs remaining: ", #pids)
             return false
         end
@@ -64,8 +65,11 @@ local function ensure_clean_state(process_name, timeout_ms)
         -- 使用 false 参数表示 Force Kill (TerminateProcess)
         process.kill_all_by_name(process_name, false)
 
-        -- 4. 异步等待一小会儿，让内核有时间释放资源
-        await(async.sleep, 200)
+        -- 4. 由进程表在最后一个实例退出时唤醒，而不是固定间隔轮询；
+        --    每 1 秒醒来一次重新补刀，覆盖在此期间又被拉起的实例
+        if await(process.wait_gone, process_name, math.min(remaining, 1000)) then
+            return true
+        end
     end
 end
 
@@ -0,0 +1,58 @@
+-- scripts/plugins/stats/init.lua
+-- 运行时指标 (src/runtime_metrics.cpp)：本进程的快照，以及经本地查询通道读取常驻 main 实例的快照
+-- 用法: peshell stats [--json] [pid]
+
+local log = _G.log
+local native = _G.pesh_native
+local M = {}
+
+-- 本进程的快照: { pid, uptime_s, values = {...}, latency_us = { name = { count, mean, p50, ... } } }
+function M.snapshot()
+    return native.stats()
+end
+
+-- 本机上可查询的实例 pid 列表
+function M.endpoints()
+    return native.stats_endpoints()
+end
+
+-- 读取 pid 的快照文本 (json 为 true 时为一行 JSON)，失败返回 nil, err
+function M.query(pid, json)
+    return native.stats_query(pid, json)
+end
+
+M.__commands = {
+    stats = function(args)
+        local pid, json = nil, false
+        for _, a in ipairs(args.cmd) do
+            if a == "--json" then
+                json = true
+            elseif tonumber(a) then
+                pid = tonumber(a)
+            else
+                log.error("stats: Usage: peshell stats [--json] [pid]")
+                return 1
+            end
+        end
+        if not pid then
+            local pids = M.endpoints()
+            if #pids == 0 then
+                log.error("stats: no running peshell main instance")
+                return 1
+            elseif #pids > 1 then
+                log.error("stats: several instances are running (", table.concat(pids, ", "), "), pass a pid")
+                return 1
+            end
+            pid = pids[1]
+        end
+        local text, err = M.query(pid, json)
+        if not text then
+            log.error("stats: ", err)
+            return 1
+        end
+        io.stdout:write(text)
+        return 0
+    end
+}
+
+return M
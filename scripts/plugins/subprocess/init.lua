@@ -0,0 +1,148 @@
+-- scripts/plugins/subprocess/init.lua
+-- 带管道的子进程 (src/process_pipe.h)：stdout / stderr 由原生反应器线程流式读入有界缓冲区，
+-- 协程逐块或逐行取走；缓冲区满时子进程被阻塞在写入上，不会把整份输出堆在内存里
+--
+--   local proc = subprocess.spawn("git log --oneline", { stderr = "merge" })
+--   for line in proc:lines() do print(line) end
+--   local code = proc:wait()
+--   proc:close()
+--
+--   local r = subprocess.capture("make -j8", { on_stdout = function(chunk) io.write(chunk) end })
+--   print(r.code, r.stderr)
+--
+-- spawn 选项: working_dir, stderr = "pipe" (默认) | "merge" (并入 stdout) | "inherit",
+--             stdin = true 时可 write / close_stdin，否则子进程的 stdin 为空设备；buffer 每个流的缓冲区字节数 (默认 1 MiB)
+-- Linux 上命令交给 /bin/sh -c，Windows 上按 CreateProcess 命令行解析 (不经过 cmd.exe)
+
+local pesh = _G.pesh
+local native = _G.pesh_native
+local async = pesh.plugin.load("async")  -- 提供全局 await
+local M = {}
+
+local Process = {}
+Process.__index = Process
+
+function M.spawn(command, opts)
+    local handle, pid = native.pipe_spawn(command, opts)
+    if not handle then
+        error(string.format("Failed to spawn '%s': %s", command, tostring(pid)), 2)
+    end
+    -- handle 是带 __gc 的原生 userdata，忘记 close 时由 GC 释放；close 之后原生函数拒绝它
+    return setmetatable({ handle = handle, pid = pid, closed = false }, Process)
+end
+
+-- 须在协程中调用；stream 为 "stdout" (默认) 或 "stderr"，EOF 时返回 nil
+function Process:read(stream, max_bytes)
+    if self.closed then return nil end
+    local handle = self.handle
+    return await(function(co) native.pipe_read(co, handle, stream or "stdout", max_bytes) end)
+end
+
+-- 须在协程中调用；返回 (数据, "stdout" | "stderr")，两个流都 EOF 时返回 nil。不与 read / lines 混用
+function Process:read_any(max_bytes)
+    if self.closed then return nil end
+    local handle = self.handle
+    local chunk = await(function(co) native.pipe_read_any(co, handle, max_bytes) end)
+    if not chunk then return nil end
+    return chunk.data, chunk.stream
+end
+
+-- 逐行迭代 (去掉行尾的 \n 与 \r)；最后一行没有换行符时也会返回
+function Process:lines(stream)
+    local pending, pos = "", 1
+    return function()
+        while true do
+            local nl = pending:find("\n", pos, true)
+            if nl then
+                local line = pending:sub(pos, nl - 1)
+                pos = nl + 1
+                return (line:gsub("\r$", ""))
+            end
+            local chunk = self:read(stream)
+            if not chunk then
+                local rest = pending:sub(pos)
+                pending, pos = "", 1
+                if rest == "" then return nil end
+                return (rest:gsub("\r$", ""))
+            end
+            pending, pos = pending:sub(pos) .. chunk, 1
+        end
+    end
+end
+
+-- 须在协程中调用；数据全部写入管道后返回 true，子进程已关闭 stdin 或句柄已 close 时抛出错误
+function Process:write(data)
+    if self.closed then error("Process is closed", 2) end
+    local handle = self.handle
+    return await(function(co) native.pipe_write(co, handle, data) end)
+end
+
+-- 已排队的数据写完后关闭 stdin
+function Process:close_stdin()
+    if not self.closed then native.pipe_close_stdin(self.handle) end
+end
+
+-- 须在协程中调用；返回退出码 (Linux 上被信号结束时为 128 + 信号值)。
+-- 退出码会被缓存，close 之后仍可取得；close 前从未等到退出时抛出错误
+function Process:wait()
+    if self.exit_code == nil then
+        if self.closed then error("Process is closed", 2) end
+        local handle = self.handle
+        self.exit_code = await(function(co) native.pipe_wait(co, handle) end)
+    end
+    return self.exit_code
+end
+
+-- 强制结束 (Linux 上连同 sh -c 派生的整个进程组)
+function Process:kill()
+    if not self.closed then native.pipe_kill(self.handle) end
+end
+
+-- 丢弃未读的输出并释放句柄，子进程继续运行直到自行退出；重复调用无副作用
+function Process:close()
+    if not self.closed then
+        self.closed = true
+        native.pipe_close(self.handle)
+    end
+end
+
+-- 须在协程中调用：运行到结束，返回 { code, stdout, stderr }。
+-- opts 同 spawn，另有 input (写入 stdin 后关闭)、on_stdout(chunk) / on_stderr(chunk) 逐块回调
+-- (给出回调的流不再收集到结果里)
+function M.capture(command, opts)
+    opts = opts or {}
+    local spawn_opts = { working_dir = opts.working_dir, stderr = opts.stderr, buffer = opts.buffer, stdin = opts.input ~= nil }
+    local proc = M.spawn(command, spawn_opts)
+
+    if opts.input then
+        -- 另起协程写入：子进程可能边读边写，等写完再读输出会互相卡住
+        async.run(function()
+            pcall(proc.write, proc, opts.input)
+            proc:close_stdin()
+        end)
+    end
+
+    local handlers = { stdout = opts.on_stdout, stderr = opts.on_stderr }
+    local parts = { stdout = {}, stderr = {} }
+    local ok, err = pcall(function()
+        while true do
+            local data, stream = proc:read_any()
+            if not data then break end
+            local handler = handlers[stream]
+            if handler then handler(data) else table.insert(parts[stream], data) end
+        end
+    end)
+    if not ok then
+        proc:kill()
+        proc:close()
+        error(err, 2)
+    end
+
+    local result = { code = proc:wait() }
+    proc:close()
+    if not handlers.stdout then result.stdout = table.concat(parts.stdout) end
+    if not handlers.stderr then result.stderr = table.concat(parts.stderr) end
+    return result
+end
+
+return M
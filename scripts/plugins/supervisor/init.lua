@@ -0,0 +1,70 @@
+-- scripts/plugins/supervisor/init.lua
+-- 多服务监督器 (src/supervisor.h)：一张服务表由一个原生服务线程管理，
+-- 每个子进程只有一个内核退出等待，退出后按指数退避 + 抖动重启，不轮询
+--
+--   local sup = supervisor.start({
+--       { name = "explorer", command = "explorer.exe", start_delay = 1000 },
+--       { name = "tray", command = "tray.exe", restart = "on-failure", max_restarts = 3 },
+--   })
+--   async.run(function()
+--       for ev in sup:events() do log.info("SUPERVISOR: ", ev.service, " ", ev.type) end
+--   end)
+--   ...
+--   sup:stop()   -- 须在协程中调用：按相反顺序停止并等待全部退出
+--   sup:close()
+--
+-- 服务字段 (时长均为毫秒)：
+--   name, command, working_dir
+--   restart          "always" (默认) | "on-failure" | "never"
+--   backoff_initial  500     backoff_max 30000   backoff_factor 2   jitter 0.2
+--   reset_after      10000   稳定运行超过此时长后退避从初始值重新开始
+--   max_restarts     5       restart_window 60000 内超出即进入 failed，0 表示不限
+--   start_delay      0       启动后等待多久再启动表中的下一个服务
+--   stop_timeout     3000    请求退出后等待多久强制结束
+-- 事件: { type = "started" | "exited" | "failed" | "stopped", service, pid, exit_code, restarts, delay_ms?, error? }
+
+local pesh = _G.pesh
+local native = _G.pesh_native
+pesh.plugin.load("async")  -- 提供全局 await
+local M = {}
+
+local Supervisor = {}
+Supervisor.__index = Supervisor
+
+function M.start(services)
+    -- handle 是带 __gc 的原生 userdata，忘记 close 时由 GC 结束子进程
+    return setmetatable({ handle = native.supervisor_start(services), closed = false }, Supervisor)
+end
+
+-- { { name, state = "pending" | "running" | "backoff" | "failed" | "stopped", pid, restarts, exit_code }, ... }
+function Supervisor:status()
+    if self.closed then return {} end
+    return native.supervisor_status(self.handle)
+end
+
+-- 须在协程中调用；监督器关闭后返回 nil
+function Supervisor:next_event()
+    if self.closed then return nil end
+    local handle = self.handle
+    return await(function(co) native.supervisor_next(co, handle) end)
+end
+
+function Supervisor:events()
+    return function() return self:next_event() end
+end
+
+function Supervisor:stop()
+    if self.closed then return true end
+    local handle = self.handle
+    return await(function(co) native.supervisor_stop(co, handle) end)
+end
+
+-- 强制结束仍在运行的子进程；重复调用无副作用
+function Supervisor:close()
+    if not self.closed then
+        self.closed = true
+        native.supervisor_close(self.handle)
+    end
+end
+
+return M
@@ -2,11 +2,11 @@
 -- PEShell 自动预加载脚本 (Lua-Ext & FFI-Bindings Ready)
 
 -- 1. 设置模块加载路径
+-- 宿主加载了字节码包 (bin/peshell.bundle) 时，包中的模块先于这些路径被找到；
+-- 模板顺序须与 src/main.cpp 中 bundle_build 推导模块名的顺序一致
+local exe_dir = assert(_G.PESHELL_EXE_DIR, "CRITICAL: PESHELL_EXE_DIR not set by host.")
+local scripts_dir = exe_dir:match("(.*[/\\])bin[/\\]?$") .. 'share/lua/5.1'
 do
-    local exe_dir = assert(_G.PESHELL_EXE_DIR, "CRITICAL: PESHELL_EXE_DIR not set by host.")
-    local package_root = exe_dir:match("(.*[/\\])bin[/\\]?$")
-    local scripts_dir = package_root .. 'share/lua/5.1'
-    
     local path_template = {
         scripts_dir .. '/?.lua',
         scripts_dir .. '/?/init.lua',
@@ -15,7 +15,8 @@ do
         scripts_dir .. '/core/?.lua',
     }
     package.path = table.concat(path_template, ';') .. ';' .. package.path
-    package.cpath = exe_dir .. '/?.dll;' .. package.cpath
+    local native_ext = (jit and jit.os == 'Windows') and 'dll' or 'so'
+    package.cpath = exe_dir .. '/?.' .. native_ext .. ';' .. package.cpath
 end
 
 -- 2. 初始化核心环境 (Lua-Ext)
@@ -78,45 +79,99 @@ RegisterCommand("main", function(args)
     return 0 
 end)
 
+-- 把 share/lua/5.1 预编译为字节码包，下次启动起生效 (构建与安装时自动执行)
+RegisterCommand("bundle", function(args)
+    local out = args.cmd[1] or (exe_dir .. '/peshell.bundle')
+    local root = args.cmd[2] or scripts_dir
+    local count, err = _G.pesh_native.bundle_build(out, root)
+    if not count then
+        log.error("bundle: ", err)
+        return 1
+    end
+    log.info("bundle: ", count, " modules from '", root, "' written to '", out, "'")
+    return 0
+end)
+
 -- 7. 核心命令分发器
 function _G.DispatchCommand(...)
     local cmd_args = table.pack(...)
     
     if cmd_args.n == 0 or cmd_args[1] == "help" then
-        print([[
+        print([=[
 PEShell v7.0 (Lua-Ext Edition)
 
-Usage: peshell.exe <command> [arguments...]
+Usage: peshell.exe [--trace[=path]] <command> [arguments...]
 
 Available Commands:
-  run, main, shel, shutdown, exec, kill, killtree, init, help
-]])
+  run, main, shel, shutdown, exec, kill, killtree, init, bundle, stats, help
+
+Options:
+  --trace[=path]  write a Chrome trace (ui.perfetto.dev) on exit, default logs/*.trace.json
+
+kill, killtree and shutdown are handed to a running 'peshell main' instance when there
+is one (no startup cost); set PESHELL_FORWARD=0 to always run them in a new process.
+exec always runs in a new process so the child inherits the caller's environment.
+]=])
         return 0
     end
 
+    return _G.DispatchCommandArgs(cmd_args)
+end
+
+-- 命令的日志：照常写入日志；给出 output 时 (转发执行) 同一条消息按冷启动时控制台的样子
+-- ("[级别] " 加以空格连接的参数) 再交给 output，由常驻实例回传客户端
+local LOG_LEVELS = { "trace", "debug", "info", "warn", "error", "critical" }
+
+-- 命令名与所在插件名不同的命令：延迟加载时按此找到插件
+local COMMAND_PLUGINS = { exec = "process", kill = "process", killtree = "process" }
+
+local function command_log(output)
+    if not output then return log end
+    local proxy = {}
+    for _, level in ipairs(LOG_LEVELS) do
+        proxy[level] = function(...)
+            if log.enabled(level) then
+                local parts = {}
+                for i = 1, select("#", ...) do parts[i] = tostring((select(i, ...))) end
+                output("[" .. level .. "] " .. table.concat(parts, " ") .. "\n")
+            end
+            return log[level](...)
+        end
+    end
+    return setmetatable(proxy, { __index = log })
+end
+
+-- 按 cmd_args = { 命令名, 参数..., n = 个数 } 执行命令；context 的字段原样并入命令的 args 表，
+-- 常驻实例执行转发来的命令时 (scripts/plugins/remote) 以此带上 forwarded = true、客户端的 cwd
+-- 与 output(text)。命令经 args.log 报告结果，转发时这些消息随退出码回到客户端
+function _G.DispatchCommandArgs(cmd_args, context)
+    local clog = command_log(context and context.output)
     local cmd_name = table.remove(cmd_args, 1)
     local command_handler = PESHELL_COMMANDS[cmd_name]
     
     if not command_handler then
         log.debug("Command '", cmd_name, "' not found. Lazy-loading...")
-        local load_ok, err = pcall(pesh.plugin.load, cmd_name)
+        local plugin_name = COMMAND_PLUGINS[cmd_name] or cmd_name
+        local load_ok, err = pcall(pesh.plugin.load, plugin_name)
         if load_ok then
             command_handler = PESHELL_COMMANDS[cmd_name]
         else
-            log.error("Failed to load plugin '", cmd_name, "': ", err)
+            clog.error("Failed to load plugin '", plugin_name, "': ", err)
         end
     end
     
     if not command_handler then
-        log.error("Unknown command '", cmd_name, "'.")
+        clog.error("Unknown command '", cmd_name, "'.")
         return 1
     end
     
-    local args_table = { cmd = { table.unpack(cmd_args, 1, cmd_args.n) } }
+    local args_table = { cmd = { table.unpack(cmd_args, 1, cmd_args.n - 1) } }
+    for key, value in pairs(context or {}) do args_table[key] = value end
+    args_table.log = clog
     local status, retcode = pcall(command_handler, args_table)
     
     if not status then
-        log.error("Error executing command '", cmd_name, "': ", tostring(retcode))
+        clog.error("Error executing command '", cmd_name, "': ", tostring(retcode))
         return 1
     end
     
@@ -38,7 +38,7 @@ local function main_task()
     local test_content = "Async content!"
     fs_ext.writefile(source_file, test_content)
 
-    log.info("\n[1/4] Testing await on async file copy...")
+    log.info("\n[1/6] Testing await on async file copy...")
     local status, msg = pcall(await, fs_async.copy_file_async, source_file, dest_file)
     lu.assertTrue(status, "await(copy) should not throw an error. Got: " .. tostring(msg))
     log.info("  -> SUCCESS: Async copy completed.")
@@ -46,13 +46,13 @@ local function main_task()
     await(async.sleep, 50)
     lu.assertEquals(fs_ext.readfile(dest_file), test_content, "Copied content must match.")
 
-    log.info("\n[2/4] Testing await on async file read...")
+    log.info("\n[2/6] Testing await on async file read...")
     local read_status, content_or_err = pcall(await, fs_async.read_file_async, source_file)
     lu.assertTrue(read_status, "await(read) should not throw an error. Got: " .. tostring(content_or_err))
     lu.assertEquals(content_or_err, test_content, "Asynchronously read content must match source.")
     log.info("  -> SUCCESS: Async read completed and content verified.")
 
-    log.info("\n[3/4] Testing await on process exit...")
+    log.info("\n[3/6] Testing await on process exit...")
     local proc = process.exec_async({ command = "notepad.exe" })
     lu.assertNotIsNil(proc, "Failed to start notepad.exe")
     
@@ -65,7 +65,7 @@ local function main_task()
     lu.assertTrue(status, "await(process.wait_for_exit) should succeed. Got: " .. tostring(msg))
     log.info("  -> SUCCESS: Awaited process exit.")
     
-    log.info("\n[4/4] Demonstrating concurrency...")
+    log.info("\n[4/6] Demonstrating concurrency...")
     log.info("  -> Starting a long-running async copy in the background...")
     async.run(function() 
         local status_bg, msg_bg = pcall(function()
@@ -81,6 +81,50 @@ local function main_task()
     
     await(async.sleep, 50)
     log.info("  -> This proves the main flow was not blocked.")
+
+    log.info("\n[5/6] Testing many concurrent timers...")
+    local timer_count, fired = 2000, 0
+    local started = os.clock()
+    for i = 1, timer_count do
+        async.run(function()
+            await(async.sleep, 100 + (i % 50))
+            fired = fired + 1
+        end)
+    end
+    await(async.sleep, 300)
+    lu.assertEquals(fired, timer_count, "All concurrent timers must fire.")
+    log.info("  -> SUCCESS: ", timer_count, " timers fired (", string.format("%.3f", os.clock() - started), "s CPU).")
+
+    log.info("\n[6/6] Testing wait on 1000+ handles...")
+    require("ffi.req")("Windows.sdk.kernel32")
+    local k32 = ffi.load("kernel32")
+    local handle_count = 1200
+    local events, wrapped = {}, {}
+    for i = 1, handle_count do
+        events[i] = k32.CreateEventW(nil, 1, 0, nil)
+        wrapped[i] = ffi.new("struct { void* h; }", { h = events[i] })
+    end
+
+    async.run(function()
+        await(async.sleep, 20)
+        k32.SetEvent(events[1000])
+    end)
+    local signaled = await(_G.pesh_native.wait_for_multiple_objects, wrapped)
+    lu.assertEquals(signaled, 1000, "Wait on all handles must report the signaled index.")
+
+    local woken = 0
+    for i = 1, handle_count do
+        async.run(function()
+            await(_G.pesh_native.wait_for_multiple_objects, { wrapped[i] })
+            woken = woken + 1
+        end)
+    end
+    for i = 1, handle_count do k32.SetEvent(events[i]) end
+    await(async.sleep, 200)
+    lu.assertEquals(woken, handle_count, "Every single-handle waiter must be resumed.")
+
+    for i = 1, handle_count do k32.CloseHandle(events[i]) end
+    log.info("  -> SUCCESS: ", handle_count, " handles supervised from one instance.")
     
     log.info("\n==============================================")
     log.info("  Asynchronous Test Suite Finished")
@@ -0,0 +1,482 @@
+-- scripts/test_event_loop.lua
+-- 事件循环后端的跨平台无头测试 (Windows: MsgWait 泵 / Linux: epoll)
+-- 用法: peshell main scripts/test_event_loop.lua run_from_main (CI 中由 ctest 调用)
+
+if not (_G.arg and _G.arg[1] == "run_from_main") then
+    local log = require("core.log")
+    log.info("This script is designed to be run via 'peshell main scripts/test_event_loop.lua run_from_main'")
+    return
+end
+
+local lu = require("luaunit")
+local log = _G.log
+local pesh = _G.pesh
+local native = _G.pesh_native
+local ffi = require("ffi")
+
+local async = pesh.plugin.load("async")
+local fs_async = pesh.plugin.load("fs_async")
+
+local is_windows = jit.os == "Windows"
+local sep = is_windows and "\\" or "/"
+local temp_dir = os.getenv("TEMP") or os.getenv("TMPDIR") or "/tmp"
+
+-- 可等待的内核对象: Windows 手动重置事件 / Linux eventfd
+local kernel = {}
+if is_windows then
+    require("ffi.req")("Windows.sdk.kernel32")
+    local k32 = ffi.load("kernel32")
+    function kernel.create() return k32.CreateEventW(nil, 1, 0, nil) end
+    function kernel.signal(h) k32.SetEvent(h) end
+    function kernel.close(h) k32.CloseHandle(h) end
+else
+    ffi.cdef [[
+        int eventfd(unsigned int initval, int flags);
+        long write(int fd, const void* buf, unsigned long count);
+        int close(int fd);
+    ]]
+    local one = ffi.new("uint64_t[1]", 1)
+    function kernel.create() return ffi.cast("void*", ffi.C.eventfd(0, 0)) end
+    function kernel.signal(h) ffi.C.write(ffi.cast("intptr_t", h), one, 8) end
+    function kernel.close(h) ffi.C.close(ffi.cast("intptr_t", h)) end
+end
+
+local function write_file(file, content)
+    local f = assert(io.open(file, "wb"))
+    f:write(content)
+    f:close()
+end
+
+local function read_file(file)
+    local f = assert(io.open(file, "rb"))
+    local content = f:read("*a")
+    f:close()
+    return content
+end
+
+local function main_task()
+    log.info("[event_loop] backend test starting")
+
+    log.info("[1/15] fs_async copy + read...")
+    local source_file = temp_dir .. sep .. "_peshell_event_loop_src.txt"
+    local dest_file = temp_dir .. sep .. "_peshell_event_loop_dst.txt"
+    local content = "event loop content"
+    write_file(source_file, content)
+
+    lu.assertTrue(await(fs_async.copy_file_async, source_file, dest_file), "Copy must return true.")
+    lu.assertEquals(read_file(dest_file), content, "Copied content must match.")
+    lu.assertEquals(await(fs_async.read_file_async, source_file), content, "Async read must match.")
+    lu.assertFalse(pcall(await, fs_async.read_file_async, source_file .. ".missing"), "Reading a missing file must raise.")
+    os.remove(dest_file)
+
+    -- 注册表：类型化结果、错误码、未知名称
+    local stat = await(fs_async.stat_file_async, source_file)
+    lu.assertEquals(stat[1], #content, "Stat size must match.")
+    lu.assertEquals(stat[3], 0, "A file is not a directory.")
+    local value, err, code = async.try_await(fs_async.stat_file_async, source_file .. ".missing")
+    lu.assertNil(value)
+    lu.assertNotEquals(code, 0, "A failed stat must carry an error code (" .. tostring(err) .. ").")
+    lu.assertFalse(pcall(async.worker, "no_such_worker"), "Resolving an unknown worker must raise.")
+    lu.assertFalse(pcall(native.dispatch_worker, "no_such_worker", coroutine.running()), "Legacy dispatch of an unknown worker must raise.")
+    lu.assertFalse(async.cancel(coroutine.running()), "Nothing is pending after completion.")
+
+    log.info("[2/15] zero-copy buffer + chunked reads...")
+    local buf = fs_async.read_file_buffer(source_file)
+    lu.assertEquals(#buf, #content, "Mapped buffer size must match.")
+    lu.assertEquals(buf:string(), content, "Mapped buffer content must match.")
+    lu.assertEquals(buf:string(6, 4), "loop", "Sub-range must match.")
+    buf:free()
+    buf:free()
+
+    local big = string.rep("0123456789abcdef", 64 * 1024 + 3)
+    write_file(source_file, big)
+    local parts, chunks = {}, 0
+    for chunk in fs_async.read_chunks(coroutine.running(), source_file, 64 * 1024, 2) do
+        lu.assertTrue(#chunk <= 64 * 1024, "Chunk must not exceed chunk_size.")
+        parts[#parts + 1] = chunk:string()
+        chunks = chunks + 1
+    end
+    lu.assertEquals(chunks, 17, "1 MiB + 48 B in 64 KiB chunks is 17 chunks.")
+    lu.assertEquals(table.concat(parts), big, "Chunked content must match.")
+    for _ in fs_async.read_chunks(coroutine.running(), source_file, 4096) do break end
+    local reader = native.chunk_reader_open(source_file, 4096)
+    native.chunk_reader_close(reader)
+    native.chunk_reader_close(reader)
+    local next_ok, next_err = pcall(native.chunk_reader_next, coroutine.running(), reader)
+    lu.assertFalse(next_ok, "A closed chunk reader must be rejected.")
+    lu.assertStrContains(tostring(next_err), "closed")
+    lu.assertFalse(pcall(native.chunk_reader_next, coroutine.running(), ffi.new("char[1]")), "Foreign handles must be rejected.")
+    native.chunk_reader_open(source_file, 4096)  -- 未 close 的句柄交给 __gc
+    collectgarbage()
+    lu.assertFalse(pcall(fs_async.read_file_buffer, source_file .. ".missing"), "Mapping a missing file must raise.")
+    os.remove(source_file)
+
+    log.info("[3/15] parallel tree copy...")
+    local tree_src = temp_dir .. sep .. "_peshell_tree_src"
+    local tree_dst = temp_dir .. sep .. "_peshell_tree_dst"
+    local mkdir = is_windows and "mkdir " or "mkdir -p "
+    local file_count, large = 0, string.rep("x", 3 * 1024 * 1024 + 17)
+    for d = 1, 4 do
+        local dir = tree_src .. sep .. "d" .. d .. sep .. "sub"
+        os.execute(mkdir .. '"' .. dir .. '"')
+        for f = 1, 50 do
+            write_file(dir .. sep .. "f" .. f .. ".txt", "file " .. d .. "/" .. f)
+            file_count = file_count + 1
+        end
+    end
+    write_file(tree_src .. sep .. "large.bin", large)
+    file_count = file_count + 1
+
+    local updates = 0
+    local result = fs_async.copy_tree(tree_src, tree_dst, {
+        concurrency = 4,
+        chunk_bytes = 1024 * 1024,
+        small_file_bytes = 64 * 1024,
+        progress_interval = 10,
+        on_progress = function() updates = updates + 1 end,
+    })
+    lu.assertEquals(result.files_done, file_count, "Every file must be copied.")
+    lu.assertEquals(result.errors, 0)
+    lu.assertEquals(read_file(tree_dst .. sep .. "d3" .. sep .. "sub" .. sep .. "f7.txt"), "file 3/7")
+    lu.assertEquals(read_file(tree_dst .. sep .. "large.bin"), large, "Chunked large file must match.")
+    lu.assertFalse(pcall(fs_async.copy_tree, tree_src .. "_missing", tree_dst), "Missing source must raise.")
+    local copy_job = native.tree_copy_start(tree_src .. "_missing", tree_dst)
+    native.tree_copy_close(copy_job)
+    native.tree_copy_close(copy_job)
+    lu.assertFalse(pcall(native.tree_copy_next, coroutine.running(), copy_job), "A closed copy job must be rejected.")
+    os.execute((is_windows and 'rmdir /s /q "' or 'rm -rf "') .. tree_src .. '"')
+    os.execute((is_windows and 'rmdir /s /q "' or 'rm -rf "') .. tree_dst .. '"')
+    log.info("  -> ", result.files_done, " files in ", result.elapsed_ms, " ms, ", updates, " progress updates")
+
+    log.info("[4/15] timer ordering...")
+    local order = {}
+    for _, delay in ipairs({ 60, 20, 40 }) do
+        async.run(function()
+            await(async.sleep, delay)
+            order[#order + 1] = delay
+        end)
+    end
+    await(async.sleep, 120)
+    lu.assertEquals(order, { 20, 40, 60 }, "Timers must fire in deadline order.")
+
+    log.info("[5/15] concurrent sleeps...")
+    local timer_count, fired = 2000, 0
+    for i = 1, timer_count do
+        async.run(function()
+            await(async.sleep, 50 + (i % 50))
+            fired = fired + 1
+        end)
+    end
+    await(async.sleep, 300)
+    lu.assertEquals(fired, timer_count, "All concurrent timers must fire.")
+
+    -- 原生协程池：结束的线程被复用，出错的任务只记日志、不影响后续任务
+    collectgarbage("collect")
+    local before = native.coroutine_stats()
+    for _ = 1, 100 do async.run(function() await(async.sleep, 1) end) end
+    async.run(function() error("intentional task failure") end)
+    await(async.sleep, 50)
+    local after = native.coroutine_stats()
+    lu.assertTrue(after.reused > before.reused, "Finished coroutines must be reused.")
+    lu.assertEquals(after.failed, before.failed + 1, "A failing task must be counted, not propagated.")
+
+    log.info("[6/15] wait on 1000+ handles...")
+    local handle_count = 1200
+    local handles, wrapped = {}, {}
+    for i = 1, handle_count do
+        handles[i] = kernel.create()
+        wrapped[i] = ffi.new("struct { void* h; }", { h = handles[i] })
+    end
+
+    async.run(function()
+        await(async.sleep, 20)
+        kernel.signal(handles[1000])
+    end)
+    lu.assertEquals(await(native.wait_for_multiple_objects, wrapped), 1000, "Wait must report the signaled index.")
+
+    local woken = 0
+    for i = 1, handle_count do
+        async.run(function()
+            await(native.wait_for_multiple_objects, { wrapped[i] })
+            woken = woken + 1
+        end)
+    end
+    for i = 1, handle_count do kernel.signal(handles[i]) end
+    await(async.sleep, 200)
+    lu.assertEquals(woken, handle_count, "Every single-handle waiter must be resumed.")
+
+    for i = 1, handle_count do kernel.close(handles[i]) end
+
+    log.info("[7/15] process table events...")
+    -- 复制一个系统程序到唯一的名称下，出现与退出只可能来自本测试
+    local probe_name = "_peshell_proc_probe" .. (is_windows and ".exe" or "")
+    local probe_path = temp_dir .. sep .. probe_name
+    local launch
+    if is_windows then
+        write_file(probe_path, read_file(os.getenv("SystemRoot") .. "\\System32\\ping.exe"))
+        launch = 'start "" /b "' .. probe_path .. '" -n 2 127.0.0.1 >nul'
+    else
+        write_file(probe_path, read_file("/bin/sleep"))
+        os.execute('chmod +x "' .. probe_path .. '"')
+        launch = '"' .. probe_path .. '" 0.5 &'
+    end
+
+    lu.assertNil(await(native.process_wait, probe_name, "appeared", 50), "Appeared must time out before launch.")
+    lu.assertTrue(await(native.process_wait, probe_name, "gone", 0), "Gone must resolve at once when nothing runs.")
+    os.execute(launch)
+    local pid = await(native.process_wait, probe_name, "appeared", 5000)
+    lu.assertNotNil(pid, "The probe process must be reported as appeared.")
+    lu.assertEquals(native.process_find(probe_name:upper())[1], pid, "Lookup must be case-insensitive.")
+    lu.assertTrue(await(native.process_wait, probe_name, "gone", 5000), "The probe must be reported as gone.")
+    lu.assertEquals(#native.process_find(probe_name), 0)
+    log.info("  -> ", native.process_table_stats().backend, " backend")
+    os.remove(probe_path)
+
+    log.info("[8/15] supervisor restarts + ordered stop...")
+    local supervisor = pesh.plugin.load("supervisor")
+    local sup = supervisor.start({
+        { name = "daemon", command = is_windows and "ping -n 30 127.0.0.1" or "sleep 30", stop_timeout = 200 },
+        { name = "crashy", command = is_windows and "cmd /c exit 2" or "exit 2", restart = "on-failure",
+          backoff_initial = 10, jitter = 0, max_restarts = 2 },
+    })
+    local seen = {}
+    while true do
+        local ev = sup:next_event()
+        seen[#seen + 1] = ev.service .. ":" .. ev.type .. (ev.delay_ms and ("+" .. ev.delay_ms) or "")
+        if ev.type == "failed" then break end
+    end
+    lu.assertEquals(seen, {
+        "daemon:started", "crashy:started", "crashy:exited+10", "crashy:started", "crashy:exited+20",
+        "crashy:started", "crashy:exited", "crashy:failed",
+    })
+    local status = sup:status()
+    lu.assertEquals(status[1].state, "running")
+    lu.assertEquals(status[2].state, "failed")
+    lu.assertEquals(status[2].exit_code, 2)
+    lu.assertTrue(sup:stop(), "Stop must resolve once every service is down.")
+    lu.assertEquals(sup:next_event().type, "stopped")
+    lu.assertEquals(sup:status()[1].state, "stopped")
+    sup:close()
+    sup:close()
+    lu.assertTrue(sup:stop(), "Stopping a closed supervisor is a no-op.")
+    native.supervisor_close(sup.handle)
+    lu.assertFalse(pcall(native.supervisor_status, sup.handle), "A closed supervisor handle must be rejected.")
+    lu.assertFalse(pcall(native.supervisor_status, {}), "Foreign handles must be rejected.")
+
+    log.info("[9/15] traced await...")
+    lu.assertEquals(async.traced("sleep", async.sleep, 5), "Timer expired", "traced must pass the awaited value through.")
+    local span, span_name = native.trace_begin("test span")
+    if native.trace_enabled() then
+        lu.assertTrue(span > 0)
+        local again, again_name = native.trace_begin("test span")
+        lu.assertTrue(again ~= span)
+        lu.assertEquals(again_name, span_name, "Equal names must share one interned id.")
+        native.trace_end(again, again_name)
+    else
+        lu.assertEquals(span, 0, "Spans must be free when tracing is off.")
+    end
+    native.trace_end(span, span_name)
+    native.trace_end(0)
+
+    log.info("[10/15] runtime metrics...")
+    local stats = pesh.plugin.load("stats")
+    local snap = stats.snapshot()
+    lu.assertTrue(snap.values.workers_dispatched > 0, "Earlier fs_async steps must be counted.")
+    lu.assertTrue(snap.latency_us.resume.count > 0)
+    lu.assertTrue(snap.latency_us.worker_exec.p99 >= snap.latency_us.worker_exec.p50)
+    local text, err = stats.query(snap.pid, true)
+    lu.assertNotNil(text, err)
+    lu.assertStrContains(text, '"workers_dispatched":')
+    lu.assertNil(stats.query(0, false), "Querying a missing instance must fail.")
+
+    log.info("[11/15] parallel Lua workers...")
+    local parallel = pesh.plugin.load("parallel")
+    lu.assertEquals(parallel.run("string", "rep", "ab", 3), "ababab")
+    _G.PESH_TEST_MAIN_ONLY = true
+    local shared = parallel.buffer(64)
+    local seen = parallel.run(function(buf, value)
+        for i = 0, tonumber(buf.size) - 1 do buf.data[i] = value end
+        return { size = tonumber(buf.size), worker = PESHELL_WORKER, leaked = PESH_TEST_MAIN_ONLY }
+    end, shared, 7)
+    lu.assertEquals(seen, { size = 64, worker = true }, "Worker states must not see main-state globals.")
+    lu.assertEquals(shared.data[63], 7, "Writes in a worker must land in the same shared memory.")
+    lu.assertEquals(parallel.map(function(x) return x * x end, { 1, 2, 3, 4, 5 }), { 1, 4, 9, 16, 25 })
+    local ok, err = pcall(parallel.run, function() error("worker boom") end)
+    lu.assertFalse(ok)
+    lu.assertStrContains(tostring(err), "worker boom")
+    ok, err = pcall(parallel.run, "test_worker_raise", "never")
+    lu.assertFalse(ok, "A module raising a table must fail the job, not the pool thread.")
+    lu.assertStrContains(tostring(err), "(non-string error)")
+    lu.assertError(parallel.run, function() return print end)
+    local upvalue = 1
+    lu.assertError(parallel.run, function() return upvalue end)
+    local pstats = parallel.stats()
+    lu.assertTrue(pstats.states >= 1 and pstats.failed == 3 and pstats.queued == 0)
+
+    log.info("[12/15] forwarded command execution...")
+    local remote = pesh.plugin.load("remote")
+    local real_print, real_run = print, async.run
+    local bystander_ran = false
+    RegisterCommand("pesh_test_forward", function(args)
+        args.log.error("from the command")
+        args.log.warn("joined", 2, true)
+        log.info("plain log stays local")
+        await(async.sleep, 10)
+        args.log.warn("cwd=", args.cwd, "forwarded=", args.forwarded)
+        return 3
+    end)
+    -- 命令等待期间其他协程的输出不属于该命令，也不经过任何替换过的全局函数
+    async.run(function()
+        await(async.sleep, 2)
+        lu.assertIs(print, real_print)
+        bystander_ran = true
+    end)
+    local code, output = remote.execute({ "pesh_test_forward", "world" }, "/client/dir")
+    lu.assertEquals(code, 3)
+    lu.assertTrue(bystander_ran)
+    lu.assertStrContains(output, "[error] from the command\n")
+    lu.assertStrContains(output, "[warn] joined 2 true\n")
+    lu.assertStrContains(output, "[warn] cwd= /client/dir forwarded= true\n")
+    lu.assertNotStrContains(output, "plain log")
+    lu.assertIs(async.run, real_run, "Forwarded commands must not patch globals.")
+    code, output = remote.execute({ "pesh_test_no_such_command" })
+    lu.assertEquals(code, 1)
+    lu.assertStrContains(output, "Unknown command")
+    if not is_windows and remote.serving() then
+        -- serve() 之后 os.execute / io.popen 的子进程带 PESHELL_FORWARD=0，本进程的环境不变
+        local env_before = os.getenv("PESHELL_FORWARD")
+        local pipe = io.popen('echo "$PESHELL_FORWARD"')
+        local child_value = pipe:read("*l")
+        pipe:close()
+        lu.assertEquals(child_value, "0", "Children of the resident instance must cold-start their commands.")
+        lu.assertEquals(os.getenv("PESHELL_FORWARD"), env_before)
+    end
+
+    log.info("[13/15] parallel tree scan + content hashes...")
+    local scan_root = temp_dir .. sep .. "_peshell_scan"
+    for d = 1, 3 do
+        os.execute(mkdir .. '"' .. scan_root .. sep .. "d" .. d .. '"')
+        for f = 1, 40 do write_file(scan_root .. sep .. "d" .. d .. sep .. "f" .. f .. ".txt", "peshell scan") end
+    end
+    local bytes = {}
+    for i = 0, 1572868 do bytes[#bytes + 1] = string.char(i % 251) end
+    write_file(scan_root .. sep .. "large.bin", table.concat(bytes)) -- 超过映射阈值，走映射路径
+    bytes = nil
+
+    local seen, dirs, batches, summary = {}, 0, 0, nil
+    for batch in fs_async.scan_tree(coroutine.running(), scan_root, {
+        hash = "xxh3", batch = 16, on_finish = function(s) summary = s end }) do
+        batches = batches + 1
+        for _, e in ipairs(batch) do
+            lu.assertNil(seen[e.path], "Each entry must be reported once.")
+            seen[e.path] = e
+            if e.is_dir then dirs = dirs + 1 else lu.assertTrue(e.mtime > 0) end
+        end
+    end
+    local small = seen["d2" .. sep .. "f7.txt"]
+    lu.assertEquals(small.size, 12)
+    lu.assertEquals(small.hash, "5ec55ee1a81eaa0f")
+    lu.assertEquals(seen["large.bin"].hash, "c26fd8a0fac99755")
+    lu.assertNil(seen["d1"].hash)
+    lu.assertEquals(dirs, 3)
+    lu.assertEquals(summary.entries, 124)
+    lu.assertTrue(batches > 1, "Entries must arrive in batches.")
+    for batch in fs_async.scan_tree(coroutine.running(), scan_root, { hash = "crc32c" }) do
+        for _, e in ipairs(batch) do
+            if e.path == "d3" .. sep .. "f1.txt" then lu.assertEquals(e.hash, "ec304d66") end
+        end
+    end
+    for _ in fs_async.scan_tree(coroutine.running(), scan_root, { batch = 1 }) do break end -- 提前中断由 GC 取消
+    lu.assertError(fs_async.scan_tree, coroutine.running(), scan_root, { hash = "md5" })
+    local scan_job = native.tree_scan_start(scan_root, { batch = 1 })
+    native.tree_scan_close(scan_job)
+    native.tree_scan_close(scan_job)
+    lu.assertFalse(pcall(native.tree_scan_next, coroutine.running(), scan_job), "A closed scan job must be rejected.")
+    lu.assertFalse(pcall(function()
+        for _ in fs_async.scan_tree(coroutine.running(), scan_root .. "_missing") do end
+    end), "A missing root must raise.")
+    os.execute((is_windows and 'rmdir /s /q "' or 'rm -rf "') .. scan_root .. '"')
+    log.info("  -> ", summary.entries, " entries in ", summary.elapsed_ms, " ms")
+
+    log.info("[14/15] piped process streaming...")
+    local subprocess = pesh.plugin.load("subprocess")
+    local function split_lines(s)
+        local out = {}
+        for line in s:gmatch("([^\n]*)\n") do out[#out + 1] = line:gsub("\r$", "") end
+        return out
+    end
+    local r = subprocess.capture(is_windows and 'cmd /c "echo out& echo err 1>&2& exit /b 3"' or "echo out; echo err >&2; exit 3")
+    lu.assertEquals(r.code, 3)
+    lu.assertEquals(split_lines(r.stdout), { "out" })
+    lu.assertEquals(split_lines(r.stderr), { "err" })
+
+    local count = 20000
+    local counter = subprocess.spawn(is_windows and ("cmd /c for /l %i in (1,1," .. count .. ") do @echo %i") or ("seq 1 " .. count),
+        { buffer = 4096 })  -- 小缓冲区：迭代期间反复暂停、恢复
+    local n = 0
+    for line in counter:lines() do
+        n = n + 1
+        if tonumber(line) ~= n then error("Line " .. n .. " arrived as '" .. line .. "'") end
+    end
+    lu.assertEquals(n, count)
+    lu.assertEquals(counter:wait(), 0)
+    counter:close()
+
+    local chunks = 0
+    local echoed = subprocess.capture(is_windows and 'findstr "^"' or "cat", {
+        input = "b\na\n",
+        on_stdout = function() chunks = chunks + 1 end,
+    })
+    lu.assertTrue(chunks > 0 and echoed.stdout == nil, "on_stdout must receive the output instead of the result.")
+    lu.assertEquals(echoed.code, 0)
+
+    local sleeper = subprocess.spawn(is_windows and "ping -n 30 127.0.0.1" or "sleep 30", { stdin = true })
+    lu.assertTrue(sleeper.pid > 0)
+    lu.assertTrue(sleeper:write("ignored\n"))
+    sleeper:kill()
+    lu.assertEquals(sleeper:wait(), is_windows and 1 or 137)
+    lu.assertFalse(pcall(sleeper.write, sleeper, "late"), "Writing to an exited process must raise.")
+    sleeper:close()
+    sleeper:close()
+    lu.assertEquals(sleeper:wait(), is_windows and 1 or 137, "wait() after close must return the cached exit code.")
+    lu.assertFalse(pcall(sleeper.write, sleeper, "closed"), "Writing to a closed process must raise.")
+    lu.assertFalse(pcall(native.pipe_kill, sleeper.handle), "Native calls on a closed handle must raise.")
+    local unwaited = subprocess.spawn(is_windows and "cmd /c exit 0" or "true")
+    unwaited:close()
+    lu.assertFalse(pcall(unwaited.wait, unwaited), "wait() on a process closed before exiting must raise.")
+    lu.assertFalse(pcall(subprocess.capture, "", { stderr = "bogus" }), "Unknown stderr modes must raise.")
+    log.info("  -> ", n, " lines streamed")
+
+    log.info("[15/15] coalesced appends + atomic replace...")
+    local log_file = temp_dir .. sep .. "pesh_write_behind.log"
+    local config_file = temp_dir .. sep .. "pesh_write_behind.ini"
+    os.remove(log_file)
+    local lines = {}
+    for i = 1, 5000 do
+        lines[i] = "line " .. i .. "\n"
+        fs_async.append_file(log_file, lines[i])
+    end
+    lu.assertTrue(await(fs_async.append_file_async, log_file, "tail\n", { sync = true }))
+    lu.assertEquals(read_file(log_file), table.concat(lines) .. "tail\n", "Appends must land in submission order.")
+
+    write_file(config_file, "old")
+    for i = 1, 20 do fs_async.replace_file_async(nil, config_file, "version=" .. i) end
+    lu.assertTrue(await(fs_async.replace_file_async, config_file, "version=final"))
+    lu.assertEquals(read_file(config_file), "version=final")
+    lu.assertTrue(await(fs_async.flush_async))
+    lu.assertFalse(pcall(await, fs_async.append_file_async, temp_dir .. sep .. "missing_dir" .. sep .. "x.log", "x"),
+        "Appending into a missing directory must raise.")
+    os.remove(log_file)
+    os.remove(config_file)
+end
+
+async.run(function()
+    local success, err = pcall(main_task)
+    if not success then
+        log.critical("Event loop test failed: \n", debug.traceback(tostring(err), 2))
+        native.quit(1)
+    else
+        log.info("All event loop tests passed on backend.")
+        native.quit(0)
+    end
+end)
@@ -0,0 +1,4 @@
+-- scripts/test_worker_raise.lua
+-- test_event_loop 的并行工作者用例：require 时抛出非字符串错误
+
+error({ reason = "module refuses to load" })
@@ -0,0 +1,260 @@
+#include "bytecode_bundle.h"
+
+#if defined(_WIN32)
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+#else
+#include <sys/stat.h>
+#endif
+
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    constexpr char     kMagic[8] = {'P', 'E', 'S', 'H', 'B', 'C', 'B', '1'};
+    constexpr uint32_t kVersion  = 2;  // 2: 条目记录源文件
+
+    struct Header
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t entry_count;
+        uint32_t slot_count;
+        uint32_t reserved;
+    };
+}  // namespace
+
+struct BytecodeBundle::Entry
+{
+    uint64_t hash;
+    uint32_t name_offset;  // 相对文件开头
+    uint32_t name_size;
+    uint32_t data_offset;
+    uint32_t data_size;
+    uint32_t source_offset;
+    uint32_t source_size;   // 路径长度
+    uint64_t file_size;     // 源文件
+    int64_t  file_mtime;
+};
+static_assert(sizeof(BytecodeBundle::Entry) == 48, "bundle entries are read in place");
+
+// 每次 require 都要核对，只用一次系统调用
+bool StatBundleSource(const std::filesystem::path& path, uint64_t* size, int64_t* mtime)
+{
+#if defined(_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &info)) return false;
+    *size  = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    *mtime = (int64_t)(((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    *size  = (uint64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+uint64_t BundleHash(std::string_view name)
+{
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : name)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool WriteBytecodeBundle(const std::filesystem::path& path, const std::vector<BundleModule>& modules, std::string* error)
+{
+    using Entry = BytecodeBundle::Entry;
+
+    // 装载因子不超过 1/2，未命中的查找也只需探测很少的槽
+    uint32_t slot_count = 16;
+    while (slot_count < modules.size() * 2) slot_count <<= 1;
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version     = kVersion;
+    header.entry_count = (uint32_t)modules.size();
+    header.slot_count  = slot_count;
+
+    std::vector<Entry>            entries(modules.size());
+    std::vector<uint32_t>         slots(slot_count, 0);
+    std::vector<std::string_view> blobs;  // 按写入顺序排列的名称与数据
+    std::unordered_map<std::string_view, uint32_t> shared;  // 同一文件有多个模块名时字节码只存一份
+    uint64_t offset = sizeof(Header) + sizeof(Entry) * entries.size() + sizeof(uint32_t) * slot_count;
+    for (size_t i = 0; i < modules.size(); ++i)
+    {
+        Entry& entry      = entries[i];
+        entry.hash        = BundleHash(modules[i].name);
+        entry.name_offset = (uint32_t)offset;
+        entry.name_size   = (uint32_t)modules[i].name.size();
+        blobs.push_back(modules[i].name);
+        offset += entry.name_size;
+
+        entry.source_offset = (uint32_t)offset;
+        entry.source_size   = (uint32_t)modules[i].source.size();
+        entry.file_size     = modules[i].source_size;
+        entry.file_mtime    = modules[i].source_mtime;
+        blobs.push_back(modules[i].source);
+        offset += entry.source_size;
+
+        std::string_view bytecode = modules[i].bytecode;
+        entry.data_size           = (uint32_t)bytecode.size();
+        auto existing             = shared.find(bytecode);
+        if (existing != shared.end()) entry.data_offset = existing->second;
+        else
+        {
+            entry.data_offset = (uint32_t)offset;
+            shared.emplace(bytecode, entry.data_offset);
+            blobs.push_back(bytecode);
+            offset += entry.data_size;
+        }
+        if (offset > UINT32_MAX)
+        {
+            if (error) *error = "bundle exceeds 4 GiB";
+            return false;
+        }
+
+        uint32_t slot = (uint32_t)entry.hash & (slot_count - 1);
+        while (slots[slot] != 0)
+        {
+            const BundleModule& other = modules[slots[slot] - 1];
+            if (other.name == modules[i].name)
+            {
+                if (error) *error = "duplicate module '" + other.name + "'";
+                return false;
+            }
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = (uint32_t)i + 1;
+    }
+
+    std::filesystem::path temp = path;
+    temp += ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entries.data()), (std::streamsize)(sizeof(Entry) * entries.size()));
+        out.write(reinterpret_cast<const char*>(slots.data()), (std::streamsize)(sizeof(uint32_t) * slots.size()));
+        for (std::string_view blob : blobs) out.write(blob.data(), (std::streamsize)blob.size());
+        if (!out.good())
+        {
+            if (error) *error = "failed to write " + temp.string();
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec)
+    {
+        if (error) *error = "failed to replace " + path.string() + ": " + ec.message();
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<BytecodeBundle> BytecodeBundle::Open(const std::filesystem::path& path, std::filesystem::path source_root,
+                                                     std::string* error)
+{
+    pesh_buffer* buffer = MapFileBuffer(path, error);
+    if (!buffer) return nullptr;
+    std::unique_ptr<BytecodeBundle> bundle(new BytecodeBundle(buffer));
+    bundle->source_root_ = std::move(source_root);
+
+    auto fail = [&](const char* what) {
+        if (error) *error = path.string() + ": " + what;
+        return nullptr;
+    };
+    if (buffer->size < sizeof(Header)) return fail("truncated header");
+
+    Header header;
+    std::memcpy(&header, buffer->data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) return fail("not a bytecode bundle");
+    if (header.version != kVersion) return fail("unsupported bundle version");
+    if (header.slot_count == 0 || (header.slot_count & (header.slot_count - 1)) != 0 ||
+        header.slot_count <= header.entry_count)
+    {
+        return fail("corrupt slot table");
+    }
+
+    uint64_t tables = sizeof(Header) + (uint64_t)sizeof(Entry) * header.entry_count +
+                      (uint64_t)sizeof(uint32_t) * header.slot_count;
+    if (tables > buffer->size) return fail("truncated index");
+
+    // 一次性校验所有区间，之后的查找不再做边界检查
+    bundle->entries_ = reinterpret_cast<const Entry*>(buffer->data + sizeof(Header));
+    bundle->slots_   = reinterpret_cast<const uint32_t*>(bundle->entries_ + header.entry_count);
+    for (uint32_t i = 0; i < header.entry_count; ++i)
+    {
+        const Entry& entry = bundle->entries_[i];
+        if ((uint64_t)entry.name_offset + entry.name_size > buffer->size ||
+            (uint64_t)entry.data_offset + entry.data_size > buffer->size ||
+            (uint64_t)entry.source_offset + entry.source_size > buffer->size)
+        {
+            return fail("entry out of bounds");
+        }
+    }
+    // 每个条目恰好占一个槽：空槽至少还剩 slot_count - entry_count 个，未命中的查找一定能停下
+    std::vector<bool> seen(header.entry_count);
+    uint32_t          used = 0;
+    for (uint32_t i = 0; i < header.slot_count; ++i)
+    {
+        uint32_t index = bundle->slots_[i];
+        if (index == 0) continue;
+        if (index > header.entry_count || seen[index - 1]) return fail("corrupt slot table");
+        seen[index - 1] = true;
+        ++used;
+    }
+    if (used != header.entry_count) return fail("corrupt slot table");
+    bundle->entry_count_ = header.entry_count;
+    bundle->slot_mask_   = header.slot_count - 1;
+    return bundle;
+}
+
+BytecodeBundle::~BytecodeBundle()
+{
+    buffer_->release(buffer_);
+}
+
+bool BytecodeBundle::Find(std::string_view name, const uint8_t** data, size_t* size) const
+{
+    uint64_t hash = BundleHash(name);
+    for (uint32_t slot = (uint32_t)hash & slot_mask_;; slot = (slot + 1) & slot_mask_)
+    {
+        uint32_t index = slots_[slot];
+        if (index == 0) return false;
+        const Entry& entry = entries_[index - 1];
+        if (entry.hash != hash || entry.name_size != name.size() ||
+            std::memcmp(buffer_->data + entry.name_offset, name.data(), name.size()) != 0)
+        {
+            continue;
+        }
+        if (!source_root_.empty())
+        {
+            std::string_view source(reinterpret_cast<const char*>(buffer_->data) + entry.source_offset, entry.source_size);
+            uint64_t         file_size;
+            int64_t          file_mtime;
+            if (!StatBundleSource(source_root_ / std::filesystem::u8path(source), &file_size, &file_mtime) ||
+                file_size != entry.file_size || file_mtime != entry.file_mtime)
+            {
+                stale_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        *data = buffer_->data + entry.data_offset;
+        *size = entry.data_size;
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+}
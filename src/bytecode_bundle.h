@@ -0,0 +1,81 @@
+#pragma once
+// 字节码包：把 share/lua/5.1 下的脚本预编译成一个文件，启动时整体映射，
+// 模块按名称哈希一次查找，不再沿 package.path 的各个模板逐个探测文件系统。
+// 布局 (小端)：
+//   Header | Entry[entry_count] | uint32_t slots[slot_count] | 名称与字节码数据
+// slots 为开放寻址 (线性探测) 的哈希表，值为 Entry 下标 + 1，0 表示空槽；slot_count 为 2 的幂。
+// 每个条目记下源文件的相对路径、大小与修改时间：源文件改动或删除后该模块不再从包中取，交给磁盘上的搜索。
+// 字节码由写入它的同一个 LuaJIT 生成，不跨版本使用。本文件不依赖 Lua。
+
+#include "file_buffer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct BundleModule
+{
+    std::string name;  // require 使用的模块名，如 "plugins.shell"
+    std::string bytecode;
+    std::string source;            // 相对脚本根目录的路径，UTF-8 (generic 分隔符)
+    uint64_t    source_size  = 0;
+    int64_t     source_mtime = 0;  // 由 StatBundleSource 在编译前读取 (Windows: FILETIME，Linux: 纳秒)
+};
+
+// 供写入方填写 source_size / source_mtime；文件不存在时返回 false
+bool StatBundleSource(const std::filesystem::path& path, uint64_t* size, int64_t* mtime);
+
+// 先写临时文件再替换，正在使用旧包的进程不受影响
+bool WriteBytecodeBundle(const std::filesystem::path& path, const std::vector<BundleModule>& modules, std::string* error);
+
+uint64_t BundleHash(std::string_view name);  // FNV-1a 64
+
+class BytecodeBundle
+{
+public:
+    // 格式或边界校验失败时返回 nullptr。source_root 为空时不核对源文件
+    static std::unique_ptr<BytecodeBundle> Open(const std::filesystem::path& path, std::filesystem::path source_root,
+                                                std::string* error);
+    ~BytecodeBundle();
+
+    BytecodeBundle(const BytecodeBundle&)            = delete;
+    BytecodeBundle& operator=(const BytecodeBundle&) = delete;
+
+    // 返回的 data 在包的生命周期内有效。源文件与记录的大小或修改时间不一致时返回 false (计入 Stale)
+    bool Find(std::string_view name, const uint8_t** data, size_t* size) const;
+
+    size_t Size() const
+    {
+        return entry_count_;
+    }
+
+    // 命中次数，用于启动日志
+    size_t Hits() const
+    {
+        return hits_.load(std::memory_order_relaxed);
+    }
+
+    // 因源文件已改动而放弃的查找次数
+    size_t Stale() const
+    {
+        return stale_.load(std::memory_order_relaxed);
+    }
+
+    struct Entry;
+
+private:
+    explicit BytecodeBundle(pesh_buffer* buffer) : buffer_(buffer) {}
+
+    pesh_buffer*                buffer_;
+    std::filesystem::path       source_root_;
+    const Entry*                entries_     = nullptr;
+    const uint32_t*             slots_       = nullptr;
+    uint32_t                    entry_count_ = 0;
+    uint32_t                    slot_mask_   = 0;
+    mutable std::atomic<size_t> hits_{0};  // Lua 工作者状态在线程池上并发查找
+    mutable std::atomic<size_t> stale_{0};
+};
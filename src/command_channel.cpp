@@ -0,0 +1,114 @@
+#include "command_channel.h"
+
+#include <cstring>
+
+namespace
+{
+    void PutU32(std::string* out, uint32_t value)
+    {
+        out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    bool GetU32(const char*& cursor, const char* end, uint32_t* value)
+    {
+        if ((size_t)(end - cursor) < sizeof(*value)) return false;
+        std::memcpy(value, cursor, sizeof(*value));
+        cursor += sizeof(*value);
+        return true;
+    }
+
+    void PutString(std::string* out, const std::string& str)
+    {
+        PutU32(out, (uint32_t)str.size());
+        out->append(str);
+    }
+
+    bool GetString(const char*& cursor, const char* end, std::string* str)
+    {
+        uint32_t len;
+        if (!GetU32(cursor, end, &len) || (size_t)(end - cursor) < len) return false;
+        str->assign(cursor, len);
+        cursor += len;
+        return true;
+    }
+}  // namespace
+
+std::string EncodeCommandRequest(const CommandRequest& request)
+{
+    std::string out;
+    PutU32(&out, 0);  // 长度前缀，最后回填
+    PutU32(&out, (uint32_t)request.args.size() + 1);
+    PutString(&out, request.cwd);
+    for (const auto& arg : request.args) PutString(&out, arg);
+    uint32_t payload = (uint32_t)(out.size() - sizeof(uint32_t));
+    std::memcpy(&out[0], &payload, sizeof(payload));
+    return out;
+}
+
+bool DecodeCommandRequest(const char* data, size_t size, CommandRequest* request)
+{
+    const char* cursor = data;
+    const char* end    = data + size;
+    uint32_t    count;
+    // 每个字符串至少占 4 字节长度，先据此拒绝伪造的个数，不按它预分配
+    if (!GetU32(cursor, end, &count) || count == 0 || count > size / sizeof(uint32_t)) return false;
+    if (!GetString(cursor, end, &request->cwd)) return false;
+    request->args.resize(count - 1);
+    for (auto& arg : request->args)
+    {
+        if (!GetString(cursor, end, &arg)) return false;
+    }
+    return cursor == end && !request->args.empty();
+}
+
+std::string EncodeCommandReply(const CommandReply& reply)
+{
+    std::string out;
+    int32_t     code = reply.exit_code;
+    out.append(reinterpret_cast<const char*>(&code), sizeof(code));
+    PutString(&out, reply.output);
+    return out;
+}
+
+bool DecodeCommandReply(const char* data, size_t size, CommandReply* reply)
+{
+    const char* cursor = data;
+    const char* end    = data + size;
+    int32_t     code;
+    if (size < sizeof(code)) return false;
+    std::memcpy(&code, cursor, sizeof(code));
+    cursor += sizeof(code);
+    reply->exit_code = code;
+    return GetString(cursor, end, &reply->output) && cursor == end;
+}
+
+char* CommandRequestReader::Buffer()
+{
+    if (got_ < sizeof(size_)) return reinterpret_cast<char*>(&size_) + got_;
+    return &payload_[got_ - sizeof(size_)];
+}
+
+size_t CommandRequestReader::Wanted() const
+{
+    if (got_ < sizeof(size_)) return sizeof(size_) - got_;
+    return sizeof(size_) + size_ - got_;
+}
+
+bool CommandRequestReader::Advance(size_t bytes)
+{
+    got_ += bytes;
+    if (got_ != sizeof(size_)) return true;
+    if (size_ > kMaxCommandFrame) return false;
+    payload_.resize(size_);  // 前缀刚读完才按它分配
+    return true;
+}
+
+bool CommandRequestReader::Complete() const
+{
+    return got_ >= sizeof(size_) && got_ == sizeof(size_) + size_;
+}
+
+bool CommandRequestReader::Decode(CommandRequest* request) const
+{
+    return Complete() && DecodeCommandRequest(payload_.data(), payload_.size(), request);
+}
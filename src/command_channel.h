@@ -0,0 +1,89 @@
+#pragma once
+// 常驻实例的命令转发通道：kill / shutdown 等短命令不再各自冷启动 (spdlog、Lua 状态、prelude)，
+// 而是由客户端进程把 argv 交给已在运行的 `peshell main` 实例，由它的 DispatchCommand 执行并回传退出码与输出。
+//   Windows: 命名管道 \\.\pipe\peshell-command-<会话 ID>，每个连接一个管道实例，拒绝远程客户端；
+//            客户端只连接同一用户 SID 运行的服务端
+//   Linux:   抽象 Unix 套接字 @peshell-command-<uid>，两端都用 SO_PEERCRED 要求对端为同一 uid
+// 端点被其他用户占用时 ForwardCommand 返回 false，调用方按没有常驻实例冷启动。
+// 帧格式 (本机字节序)：请求 u32 长度 + [u32 个数][u32 长度 + 字节]...，首个字符串为客户端工作目录；
+// 应答 i32 退出码 + u32 长度 + 输出。
+// 服务线程只负责接受连接和读取请求；应答可以在任意线程、任意时刻写回，长时间运行的命令不会挡住其他客户端。
+// 请求在服务线程上以非阻塞方式读取，多个连接交替推进：迟迟不发完请求的客户端在整体期限到时被断开，
+// 期间不影响接受和读取其他连接。
+// 本文件不依赖 Lua。
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct CommandRequest
+{
+    std::string              cwd;
+    std::vector<std::string> args;  // 不含程序名，args[0] 为命令名
+};
+
+struct CommandReply
+{
+    int         exit_code = 0;
+    std::string output;
+};
+
+class CommandServer
+{
+public:
+    // 每个请求恰好调用一次；析构或释放时仍未调用的应答直接断开连接 (客户端得到退出码 1)
+    using Reply   = std::function<void(CommandReply reply)>;
+    using Handler = std::function<void(CommandRequest request, Reply reply)>;
+
+    // handler 在服务线程上调用，应尽快返回。同名端点已被其他实例占用时返回 nullptr
+    static std::unique_ptr<CommandServer> Start(const std::string& endpoint, Handler handler, std::string* error);
+    ~CommandServer();
+
+    CommandServer(const CommandServer&)            = delete;
+    CommandServer& operator=(const CommandServer&) = delete;
+
+    uint64_t Accepted() const;
+
+    struct Impl;
+
+private:
+    explicit CommandServer(std::unique_ptr<Impl> impl);
+
+    std::unique_ptr<Impl> impl_;
+};
+
+// 当前用户 (Linux) / 会话 (Windows) 的常驻实例端点名
+std::string DefaultCommandEndpoint();
+
+// 没有实例在监听时立即返回 false，由调用方照常冷启动执行。
+// 一旦请求已送出就返回 true：此后的失败写入 reply (退出码 1)，不能再冷启动重试，以免命令执行两次。
+bool ForwardCommand(const std::string& endpoint, const CommandRequest& request, CommandReply* reply);
+
+// 以下为两端共用的编解码。请求的编码结果含长度前缀，解码的输入不含 (服务端先读前缀)；应答两端一致
+constexpr uint32_t kMaxCommandFrame = 1u << 20;
+// 从接受连接起读完整个请求的期限 (不是单次读取的超时)
+constexpr int kCommandRequestDeadlineMs = 1000;
+
+std::string EncodeCommandRequest(const CommandRequest& request);
+bool        DecodeCommandRequest(const char* data, size_t size, CommandRequest* request);
+std::string EncodeCommandReply(const CommandReply& reply);
+bool        DecodeCommandReply(const char* data, size_t size, CommandReply* reply);
+
+// 服务端逐段读取一个请求帧：向 Buffer() 读入至多 Wanted() 字节后以实际字节数调用 Advance。
+// 长度前缀超过 kMaxCommandFrame 时 Advance 返回 false；Complete() 之后由 Decode 解出请求
+class CommandRequestReader
+{
+public:
+    char*  Buffer();
+    size_t Wanted() const;
+    bool   Advance(size_t bytes);
+    bool   Complete() const;
+    bool   Decode(CommandRequest* request) const;
+
+private:
+    uint32_t    size_ = 0;
+    size_t      got_  = 0;  // 含长度前缀
+    std::string payload_;
+};
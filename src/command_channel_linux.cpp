@@ -0,0 +1,227 @@
+#include "command_channel.h"
+
+#include "unix_socket.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // 正在读取请求的连接
+    struct Incoming
+    {
+        int                                   fd;
+        std::chrono::steady_clock::time_point deadline;
+        CommandRequestReader                  reader;
+    };
+
+    enum class ReadState
+    {
+        kPending,
+        kComplete,
+        kFailed,
+    };
+
+    // 读到暂无数据为止，不阻塞
+    ReadState ReadAvailable(Incoming* in)
+    {
+        while (!in->reader.Complete())
+        {
+            ssize_t n = recv(in->fd, in->reader.Buffer(), in->reader.Wanted(), MSG_DONTWAIT);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return ReadState::kPending;
+            if (n <= 0 || !in->reader.Advance((size_t)n)) return ReadState::kFailed;
+        }
+        return ReadState::kComplete;
+    }
+
+    // 一个已读完请求、等待应答的连接；最后一个引用 (通常就是应答函数) 释放时关闭
+    struct Connection
+    {
+        int               fd;
+        std::atomic<bool> replied{false};
+
+        explicit Connection(int fd) : fd(fd) {}
+        ~Connection()
+        {
+            close(fd);
+        }
+
+        void Send(const CommandReply& reply)
+        {
+            if (replied.exchange(true)) return;
+            SendAll(fd, EncodeCommandReply(reply));
+            shutdown(fd, SHUT_WR);  // 客户端读到 EOF 即结束，不必等到应答函数被销毁
+        }
+    };
+}  // namespace
+
+struct CommandServer::Impl
+{
+    int                   listen_fd = -1;
+    int                   wake_fd   = -1;
+    Handler               handler;
+    std::thread           thread;
+    std::atomic<uint64_t> accepted{0};
+
+    // 同时读取请求的连接数上限；达到上限时暂停 accept，新连接留在监听队列中
+    static constexpr size_t kMaxIncoming = 64;
+
+    void Dispatch(const Incoming& in)
+    {
+        CommandRequest request;
+        if (!in.reader.Decode(&request))
+        {
+            close(in.fd);
+            return;
+        }
+        accepted.fetch_add(1, std::memory_order_relaxed);
+        auto connection = std::make_shared<Connection>(in.fd);
+        handler(std::move(request), [connection](CommandReply reply) { connection->Send(reply); });
+    }
+
+    // 接受连接与读取请求都在本线程上以 poll 推进，单个慢客户端最多占住自己的期限，不挡住其他连接
+    void Loop()
+    {
+        using Clock = std::chrono::steady_clock;
+        std::vector<Incoming> incoming;
+        std::vector<pollfd>   fds;
+        while (true)
+        {
+            Clock::time_point now     = Clock::now();
+            int               timeout = -1;
+            fds.clear();
+            fds.push_back({listen_fd, (short)(incoming.size() < kMaxIncoming ? POLLIN : 0), 0});
+            fds.push_back({wake_fd, POLLIN, 0});
+            for (const auto& in : incoming)
+            {
+                fds.push_back({in.fd, POLLIN, 0});
+                int left = (int)std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(in.deadline - now).count() + 1);
+                timeout  = timeout < 0 ? left : std::min(timeout, left);
+            }
+            if (poll(fds.data(), fds.size(), timeout) < 0)
+            {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (fds[1].revents) break;
+
+            now = Clock::now();
+            std::vector<Incoming> reading;
+            for (size_t i = 0; i < incoming.size(); ++i)
+            {
+                Incoming& in    = incoming[i];
+                ReadState state = fds[i + 2].revents ? ReadAvailable(&in) : ReadState::kPending;
+                if (state == ReadState::kComplete) Dispatch(in);
+                else if (state == ReadState::kPending && now < in.deadline) reading.push_back(std::move(in));
+                else close(in.fd);
+            }
+            incoming.swap(reading);
+
+            if (!(fds[0].revents & POLLIN)) continue;
+            int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) continue;
+            if (!PeerIsSameUser(client))
+            {
+                close(client);
+                continue;
+            }
+            // 应答的写入在 Connection::Send 中，同样不会无限阻塞
+            SetSocketTimeouts(client, -1, 1000);
+            // 客户端通常在连接后立即写完请求，先读一次，不必再等一轮 poll
+            Incoming  in{client, now + std::chrono::milliseconds(kCommandRequestDeadlineMs), {}};
+            ReadState state = ReadAvailable(&in);
+            if (state == ReadState::kComplete) Dispatch(in);
+            else if (state == ReadState::kPending) incoming.push_back(std::move(in));
+            else close(client);
+        }
+        for (const auto& in : incoming) close(in.fd);
+    }
+};
+
+CommandServer::CommandServer(std::unique_ptr<Impl> impl) : impl_(std::move(impl))
+{
+    impl_->thread = std::thread([impl = impl_.get()] { impl->Loop(); });
+}
+
+CommandServer::~CommandServer()
+{
+    uint64_t one = 1;
+    (void)!write(impl_->wake_fd, &one, sizeof(one));
+    if (impl_->thread.joinable()) impl_->thread.join();
+    close(impl_->listen_fd);
+    close(impl_->wake_fd);
+}
+
+std::unique_ptr<CommandServer> CommandServer::Start(const std::string& endpoint, Handler handler, std::string* error)
+{
+    auto impl       = std::make_unique<Impl>();
+    impl->handler   = std::move(handler);
+    impl->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    impl->wake_fd   = eventfd(0, EFD_CLOEXEC);
+    sockaddr_un addr;
+    socklen_t   len = AbstractSocketAddress(endpoint, &addr);
+    if (impl->listen_fd < 0 || impl->wake_fd < 0 || bind(impl->listen_fd, (sockaddr*)&addr, len) < 0 ||
+        listen(impl->listen_fd, 16) < 0)
+    {
+        if (error) *error = std::string("command endpoint: ") + std::strerror(errno);
+        if (impl->listen_fd >= 0) close(impl->listen_fd);
+        if (impl->wake_fd >= 0) close(impl->wake_fd);
+        return nullptr;
+    }
+    return std::unique_ptr<CommandServer>(new CommandServer(std::move(impl)));
+}
+
+uint64_t CommandServer::Accepted() const
+{
+    return impl_->accepted.load(std::memory_order_relaxed);
+}
+
+std::string DefaultCommandEndpoint()
+{
+    return "peshell-command-" + std::to_string(getuid());
+}
+
+bool ForwardCommand(const std::string& endpoint, const CommandRequest& request, CommandReply* reply)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    sockaddr_un addr;
+    socklen_t   len = AbstractSocketAddress(endpoint, &addr);
+    // 端点被其他用户抢先绑定时不转发 (argv 与工作目录不能交给他人)，按没有常驻实例处理
+    if (connect(fd, (sockaddr*)&addr, len) < 0 || !PeerIsSameUser(fd))
+    {
+        close(fd);
+        return false;
+    }
+
+    // 命令本身可能运行很久 (常驻实例在协程中等待)，读取应答不设超时；只有写入请求受限
+    SetSocketTimeouts(fd, -1, 2000);
+    std::string response;
+    bool        sent = SendAll(fd, EncodeCommandRequest(request));
+    char        buf[4096];
+    while (sent)
+    {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        response.append(buf, (size_t)n);
+    }
+    close(fd);
+
+    if (!sent || !DecodeCommandReply(response.data(), response.size(), reply))
+    {
+        reply->exit_code = 1;
+        reply->output    = "peshell: the resident instance (" + endpoint + ") did not complete the command\n";
+    }
+    return true;
+}
@@ -0,0 +1,333 @@
+#include "command_channel.h"
+
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    std::wstring PipeName(const std::string& endpoint)
+    {
+        return L"\\\\.\\pipe\\" + std::wstring(endpoint.begin(), endpoint.end());  // 端点名只含 ASCII
+    }
+
+    // 每个连接一个实例；默认安全描述符只给创建者、管理员与 SYSTEM 写权限，其他账户无法提交命令
+    HANDLE CreateInstance(const std::wstring& name, bool first)
+    {
+        DWORD open_mode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+        return CreateNamedPipeW(name.c_str(), open_mode, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                PIPE_UNLIMITED_INSTANCES, 64 * 1024, 64 * 1024, 0, nullptr);
+    }
+
+    // 重叠 I/O 等待 timeout_ms，超时则取消；返回传输的字节数，失败为 -1
+    long Transfer(HANDLE pipe, OVERLAPPED* ov, BOOL started, DWORD timeout_ms)
+    {
+        DWORD bytes = 0;
+        if (!started && GetLastError() != ERROR_IO_PENDING) return -1;
+        if (WaitForSingleObject(ov->hEvent, timeout_ms) != WAIT_OBJECT_0)
+        {
+            CancelIo(pipe);
+            GetOverlappedResult(pipe, ov, &bytes, TRUE);
+            return -1;
+        }
+        if (!GetOverlappedResult(pipe, ov, &bytes, FALSE)) return -1;
+        return (long)bytes;
+    }
+
+    // buf 接收 TOKEN_USER 及其后的 SID
+    bool TokenUserOf(HANDLE process, void* buf, DWORD buf_size)
+    {
+        HANDLE token = nullptr;
+        if (!OpenProcessToken(process, TOKEN_QUERY, &token)) return false;
+        DWORD size = 0;
+        BOOL  ok   = GetTokenInformation(token, TokenUser, buf, buf_size, &size);
+        CloseHandle(token);
+        return ok != FALSE;
+    }
+
+    // 管道名可以被其他账户抢先创建：只把命令交给与本进程同一用户运行的服务端
+    bool ServerIsSameUser(HANDLE pipe)
+    {
+        ULONG server_pid = 0;
+        if (!GetNamedPipeServerProcessId(pipe, &server_pid)) return false;
+        HANDLE server = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, server_pid);
+        if (!server) return false;
+        alignas(TOKEN_USER) BYTE theirs[256];
+        alignas(TOKEN_USER) BYTE ours[256];
+        bool same = TokenUserOf(server, theirs, sizeof(theirs)) && TokenUserOf(GetCurrentProcess(), ours, sizeof(ours)) &&
+                    EqualSid(reinterpret_cast<TOKEN_USER*>(theirs)->User.Sid, reinterpret_cast<TOKEN_USER*>(ours)->User.Sid);
+        CloseHandle(server);
+        return same;
+    }
+
+    struct Connection
+    {
+        HANDLE            pipe;
+        HANDLE            event;
+        std::atomic<bool> replied{false};
+
+        Connection(HANDLE pipe, HANDLE event) : pipe(pipe), event(event) {}
+        // 直接关闭而不 DisconnectNamedPipe：已写入的应答仍可被客户端读完，随后它读到断开
+        ~Connection()
+        {
+            CloseHandle(pipe);
+            CloseHandle(event);
+        }
+
+        void Send(const CommandReply& reply)
+        {
+            if (replied.exchange(true)) return;
+            std::string data = EncodeCommandReply(reply);
+            OVERLAPPED  ov{};
+            ov.hEvent = event;
+            Transfer(pipe, &ov, WriteFile(pipe, data.data(), (DWORD)data.size(), nullptr, &ov), 1000);
+        }
+    };
+
+    // 正在读取请求的连接；读取进行中 OVERLAPPED 不能移动，因此按指针保存
+    struct Incoming
+    {
+        HANDLE                                pipe  = INVALID_HANDLE_VALUE;
+        HANDLE                                event = nullptr;
+        OVERLAPPED                            ov{};
+        bool                                  reading = false;
+        std::chrono::steady_clock::time_point deadline;
+        CommandRequestReader                  reader;
+
+        // 取回已完成的一次读取
+        bool Finish()
+        {
+            DWORD bytes = 0;
+            reading     = false;
+            return GetOverlappedResult(pipe, &ov, &bytes, FALSE) && bytes > 0 && reader.Advance(bytes);
+        }
+
+        // 推进读取直到需要等待；返回 false 表示连接出错或请求非法
+        bool Pump()
+        {
+            if (reading && WaitForSingleObject(event, 0) == WAIT_OBJECT_0 && !Finish()) return false;
+            while (!reading && !reader.Complete())
+            {
+                ov        = OVERLAPPED{};
+                ov.hEvent = event;
+                if (!ReadFile(pipe, reader.Buffer(), (DWORD)reader.Wanted(), nullptr, &ov) && GetLastError() != ERROR_IO_PENDING) return false;
+                reading = true;
+                if (WaitForSingleObject(event, 0) == WAIT_OBJECT_0 && !Finish()) return false;
+            }
+            return true;
+        }
+
+        void Abandon()
+        {
+            if (reading)
+            {
+                CancelIo(pipe);
+                DWORD bytes;
+                GetOverlappedResult(pipe, &ov, &bytes, TRUE);
+            }
+            CloseHandle(pipe);
+            CloseHandle(event);
+        }
+    };
+}  // namespace
+
+struct CommandServer::Impl
+{
+    std::wstring          name;
+    HANDLE                pending       = INVALID_HANDLE_VALUE;  // 等待下一个客户端的实例
+    HANDLE                stop_event    = nullptr;
+    HANDLE                connect_event = nullptr;
+    Handler               handler;
+    std::thread           thread;
+    std::atomic<uint64_t> accepted{0};
+
+    std::vector<std::unique_ptr<Incoming>> incoming;
+
+    // 同时读取请求的连接数上限 (连同 stop_event 与 connect_event 不超过 WaitForMultipleObjects 的上限)；
+    // 达到上限时暂不接受，已完成的连接留在实例中等待
+    static constexpr size_t kMaxIncoming = MAXIMUM_WAIT_OBJECTS - 2;
+
+    // 返回 false 表示连接已结束 (请求已交给 handler 或连接已关闭)
+    bool Advance(Incoming* in)
+    {
+        if (in->Pump() && !in->reader.Complete()) return true;
+        CommandRequest request;
+        if (!in->reader.Decode(&request))
+        {
+            in->Abandon();
+            return false;
+        }
+        accepted.fetch_add(1, std::memory_order_relaxed);
+        auto connection = std::make_shared<Connection>(in->pipe, in->event);
+        handler(std::move(request), [connection](CommandReply reply) { connection->Send(reply); });
+        return false;
+    }
+
+    void Accept(DWORD error)
+    {
+        // 先备好下一个实例再处理当前连接，客户端不会因管道忙而等待
+        HANDLE pipe  = pending;
+        pending      = CreateInstance(name, false);
+        auto in      = std::make_unique<Incoming>();
+        in->pipe     = pipe;
+        in->event    = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        in->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kCommandRequestDeadlineMs);
+        if ((error != ERROR_SUCCESS && error != ERROR_PIPE_CONNECTED) || !in->event)
+        {
+            if (in->event) CloseHandle(in->event);
+            CloseHandle(pipe);
+            return;
+        }
+        if (Advance(in.get())) incoming.push_back(std::move(in));
+    }
+
+    // 等待下一个客户端与读取请求都在本线程上以重叠 I/O 推进，单个慢客户端最多占住自己的期限，不挡住其他连接
+    void Loop()
+    {
+        using Clock = std::chrono::steady_clock;
+        OVERLAPPED          connect_ov{};
+        bool                connecting = false;
+        std::vector<HANDLE> events;
+        while (pending != INVALID_HANDLE_VALUE)
+        {
+            if (!connecting)
+            {
+                connect_ov        = OVERLAPPED{};
+                connect_ov.hEvent = connect_event;
+                BOOL  connected   = ConnectNamedPipe(pending, &connect_ov);
+                DWORD error       = connected ? ERROR_SUCCESS : GetLastError();
+                if (error != ERROR_IO_PENDING)
+                {
+                    Accept(error);
+                    continue;
+                }
+                connecting = true;
+            }
+
+            Clock::time_point now     = Clock::now();
+            DWORD             timeout = INFINITE;
+            bool              listen  = incoming.size() < kMaxIncoming;
+            events.assign({stop_event});
+            if (listen) events.push_back(connect_event);
+            for (const auto& in : incoming)
+            {
+                events.push_back(in->event);
+                int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(in->deadline - now).count() + 1;
+                timeout      = std::min<DWORD>(timeout, (DWORD)std::max<int64_t>(left, 0));
+            }
+            DWORD result = WaitForMultipleObjects((DWORD)events.size(), events.data(), FALSE, timeout);
+            if (result == WAIT_OBJECT_0 || result == WAIT_FAILED) break;
+
+            // 多个事件可能同时置位，逐个检查而不只看返回的最小下标
+            now = Clock::now();
+            std::vector<std::unique_ptr<Incoming>> reading;
+            for (auto& in : incoming)
+            {
+                if (!Advance(in.get())) continue;
+                if (now < in->deadline) reading.push_back(std::move(in));
+                else in->Abandon();
+            }
+            incoming.swap(reading);
+
+            if (listen && WaitForSingleObject(connect_event, 0) == WAIT_OBJECT_0)
+            {
+                DWORD bytes;
+                connecting = false;
+                Accept(GetOverlappedResult(pending, &connect_ov, &bytes, FALSE) ? ERROR_SUCCESS : GetLastError());
+            }
+        }
+        if (connecting)
+        {
+            CancelIo(pending);
+            DWORD bytes;
+            GetOverlappedResult(pending, &connect_ov, &bytes, TRUE);
+        }
+        for (auto& in : incoming) in->Abandon();
+        incoming.clear();
+    }
+};
+
+CommandServer::CommandServer(std::unique_ptr<Impl> impl) : impl_(std::move(impl))
+{
+    impl_->thread = std::thread([impl = impl_.get()] { impl->Loop(); });
+}
+
+CommandServer::~CommandServer()
+{
+    SetEvent(impl_->stop_event);
+    if (impl_->thread.joinable()) impl_->thread.join();
+    if (impl_->pending != INVALID_HANDLE_VALUE) CloseHandle(impl_->pending);
+    CloseHandle(impl_->stop_event);
+    CloseHandle(impl_->connect_event);
+}
+
+std::unique_ptr<CommandServer> CommandServer::Start(const std::string& endpoint, Handler handler, std::string* error)
+{
+    auto impl     = std::make_unique<Impl>();
+    impl->name    = PipeName(endpoint);
+    impl->handler = std::move(handler);
+    impl->pending = CreateInstance(impl->name, true);
+    if (impl->pending == INVALID_HANDLE_VALUE)
+    {
+        if (error) *error = "command endpoint: CreateNamedPipe failed (" + std::to_string(GetLastError()) + ")";
+        return nullptr;
+    }
+    impl->stop_event    = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    impl->connect_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    return std::unique_ptr<CommandServer>(new CommandServer(std::move(impl)));
+}
+
+uint64_t CommandServer::Accepted() const
+{
+    return impl_->accepted.load(std::memory_order_relaxed);
+}
+
+// 命名管道的名字空间跨会话共享，按会话区分，另一个登录会话中的实例不会接到本会话的命令
+std::string DefaultCommandEndpoint()
+{
+    DWORD session = 0;
+    ProcessIdToSessionId(GetCurrentProcessId(), &session);
+    return "peshell-command-" + std::to_string(session);
+}
+
+bool ForwardCommand(const std::string& endpoint, const CommandRequest& request, CommandReply* reply)
+{
+    std::wstring name = PipeName(endpoint);
+    HANDLE       pipe = INVALID_HANDLE_VALUE;
+    // 服务端在交出一个实例后才创建下一个，这个短暂窗口内可能遇到管道忙
+    for (int attempt = 0; attempt < 3 && pipe == INVALID_HANDLE_VALUE; ++attempt)
+    {
+        pipe = CreateFileW(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (pipe == INVALID_HANDLE_VALUE && (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeW(name.c_str(), 1000))) break;
+    }
+    if (pipe == INVALID_HANDLE_VALUE) return false;
+    if (!ServerIsSameUser(pipe))
+    {
+        CloseHandle(pipe);
+        return false;
+    }
+
+    std::string data    = EncodeCommandRequest(request);
+    DWORD       written = 0;
+    bool        sent    = WriteFile(pipe, data.data(), (DWORD)data.size(), &written, nullptr) && written == data.size();
+    std::string response;
+    char        buf[4096];
+    DWORD       read = 0;
+    while (sent && ReadFile(pipe, buf, sizeof(buf), &read, nullptr) && read > 0) response.append(buf, read);
+    CloseHandle(pipe);
+
+    if (!sent || !DecodeCommandReply(response.data(), response.size(), reply))
+    {
+        reply->exit_code = 1;
+        reply->output    = "peshell: the resident instance (" + endpoint + ") did not complete the command\n";
+    }
+    return true;
+}
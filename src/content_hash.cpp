@@ -0,0 +1,439 @@
+#include "content_hash.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PESH_HASH_X86 1
+#include <emmintrin.h>
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PESH_HASH_SSE2 1  // x86-64 的基线指令集
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PESH_TARGET_SSE42 __attribute__((target("sse4.2")))
+#else
+#define PESH_TARGET_SSE42
+#endif
+
+namespace
+{
+    inline uint32_t Read32(const uint8_t* p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;  // 只支持小端平台
+    }
+
+    inline uint64_t Read64(const uint8_t* p)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    // ========================================================================
+    // CRC32C
+    // ========================================================================
+
+    struct Crc32cTable
+    {
+        uint32_t t[8][256];
+
+        Crc32cTable()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t crc = i;
+                for (int k = 0; k < 8; ++k) crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+                t[0][i] = crc;
+            }
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                for (int k = 1; k < 8; ++k) t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+    };
+
+    uint32_t Crc32cTableUpdate(uint32_t crc, const uint8_t* p, size_t size)
+    {
+        static const Crc32cTable table;
+        const auto&              t = table.t;
+        for (; size >= 8; p += 8, size -= 8)
+        {
+            uint32_t lo = Read32(p) ^ crc;
+            uint32_t hi = Read32(p + 4);
+            crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^ t[3][hi & 0xFF] ^
+                  t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        }
+        while (size--) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+        return crc;
+    }
+
+#if defined(PESH_HASH_X86)
+    PESH_TARGET_SSE42 uint32_t Crc32cSse42Update(uint32_t crc, const uint8_t* p, size_t size)
+    {
+#if defined(__x86_64__) || defined(_M_X64)
+        uint64_t crc64 = crc;
+        for (; size >= 8; p += 8, size -= 8) crc64 = _mm_crc32_u64(crc64, Read64(p));
+        crc = (uint32_t)crc64;
+#endif
+        for (; size >= 4; p += 4, size -= 4) crc = _mm_crc32_u32(crc, Read32(p));
+        while (size--) crc = _mm_crc32_u8(crc, *p++);
+        return crc;
+    }
+
+    bool CpuHasSse42()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 20)) != 0;
+#else
+        return __builtin_cpu_supports("sse4.2");
+#endif
+    }
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+    uint32_t Crc32cArmUpdate(uint32_t crc, const uint8_t* p, size_t size)
+    {
+        for (; size >= 8; p += 8, size -= 8) crc = __crc32cd(crc, Read64(p));
+        while (size--) crc = __crc32cb(crc, *p++);
+        return crc;
+    }
+#endif
+
+    using Crc32cUpdateFn = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+    struct Crc32cKernel
+    {
+        Crc32cUpdateFn update;
+        const char*    name;
+    };
+
+    Crc32cKernel SelectCrc32c()
+    {
+#if defined(PESH_HASH_X86)
+        if (CpuHasSse42()) return {Crc32cSse42Update, "sse4.2"};
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+        return {Crc32cArmUpdate, "armv8-crc"};
+#else
+        return {Crc32cTableUpdate, "table"};
+#endif
+    }
+
+    const Crc32cKernel& Crc32cImpl()
+    {
+        static const Crc32cKernel kernel = SelectCrc32c();
+        return kernel;
+    }
+
+    // ========================================================================
+    // XXH3-64 (seed 0)
+    // ========================================================================
+
+    constexpr uint64_t kPrime32_1 = 0x9E3779B1u;
+    constexpr uint64_t kPrime32_2 = 0x85EBCA77u;
+    constexpr uint64_t kPrime32_3 = 0xC2B2AE3Du;
+    constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ull;
+    constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ull;
+    constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ull;
+    constexpr uint64_t kPrimeMx1  = 0x165667919E3779F9ull;
+    constexpr uint64_t kPrimeMx2  = 0x9FB21C651E98DF25ull;
+
+    constexpr size_t kSecretSize  = 192;
+    constexpr size_t kStripeLen   = 64;
+    constexpr size_t kSecretStep  = 8;
+    constexpr size_t kStripes     = (kSecretSize - kStripeLen) / kSecretStep;
+    constexpr size_t kBlockLen    = kStripeLen * kStripes;
+    constexpr size_t kMidSizeMax  = 240;
+
+    alignas(64) const uint8_t kSecret[kSecretSize] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+
+    inline uint64_t Rotl64(uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    inline uint64_t Swap64(uint64_t x)
+    {
+        x = ((x & 0x00000000FFFFFFFFull) << 32) | (x >> 32);
+        x = ((x & 0x0000FFFF0000FFFFull) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFull);
+        return ((x & 0x00FF00FF00FF00FFull) << 8) | ((x >> 8) & 0x00FF00FF00FF00FFull);
+    }
+
+    // 64x64 -> 128 位乘积的高低两半异或
+    inline uint64_t Mul128Fold64(uint64_t a, uint64_t b)
+    {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 product = (unsigned __int128)a * b;
+        return (uint64_t)product ^ (uint64_t)(product >> 64);
+#elif defined(_M_X64)
+        uint64_t high;
+        uint64_t low = _umul128(a, b, &high);
+        return low ^ high;
+#else
+        uint64_t lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+        uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFF);
+        uint64_t lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+        uint64_t hi_hi = (a >> 32) * (b >> 32);
+        uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+        uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+        uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+        return lower ^ upper;
+#endif
+    }
+
+    inline uint64_t Xxh64Avalanche(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= kPrime64_2;
+        h ^= h >> 29;
+        h *= kPrime64_3;
+        return h ^ (h >> 32);
+    }
+
+    inline uint64_t Xxh3Avalanche(uint64_t h)
+    {
+        h ^= h >> 37;
+        h *= kPrimeMx1;
+        return h ^ (h >> 32);
+    }
+
+    inline uint64_t Rrmxmx(uint64_t h, uint64_t len)
+    {
+        h ^= Rotl64(h, 49) ^ Rotl64(h, 24);
+        h *= kPrimeMx2;
+        h ^= (h >> 35) + len;
+        h *= kPrimeMx2;
+        return h ^ (h >> 28);
+    }
+
+    inline uint64_t Mix16(const uint8_t* p, const uint8_t* secret)
+    {
+        return Mul128Fold64(Read64(p) ^ Read64(secret), Read64(p + 8) ^ Read64(secret + 8));
+    }
+
+    uint64_t Xxh3Short(const uint8_t* p, size_t len)
+    {
+        if (len > 8)
+        {
+            uint64_t lo  = Read64(p) ^ (Read64(kSecret + 24) ^ Read64(kSecret + 32));
+            uint64_t hi  = Read64(p + len - 8) ^ (Read64(kSecret + 40) ^ Read64(kSecret + 48));
+            uint64_t acc = len + Swap64(lo) + hi + Mul128Fold64(lo, hi);
+            return Xxh3Avalanche(acc);
+        }
+        if (len >= 4)
+        {
+            uint64_t input  = Read32(p + len - 4) + ((uint64_t)Read32(p) << 32);
+            uint64_t keyed  = input ^ (Read64(kSecret + 8) ^ Read64(kSecret + 16));
+            return Rrmxmx(keyed, len);
+        }
+        if (len > 0)
+        {
+            uint32_t combined = ((uint32_t)p[0] << 16) | ((uint32_t)p[len >> 1] << 24) | (uint32_t)p[len - 1] | ((uint32_t)len << 8);
+            uint64_t bitflip  = Read32(kSecret) ^ Read32(kSecret + 4);
+            return Xxh64Avalanche(combined ^ bitflip);
+        }
+        return Xxh64Avalanche(Read64(kSecret + 56) ^ Read64(kSecret + 64));
+    }
+
+    uint64_t Xxh3Medium(const uint8_t* p, size_t len)
+    {
+        uint64_t acc = len * kPrime64_1;
+        if (len <= 128)
+        {
+            if (len > 32)
+            {
+                if (len > 64)
+                {
+                    if (len > 96)
+                    {
+                        acc += Mix16(p + 48, kSecret + 96);
+                        acc += Mix16(p + len - 64, kSecret + 112);
+                    }
+                    acc += Mix16(p + 32, kSecret + 64);
+                    acc += Mix16(p + len - 48, kSecret + 80);
+                }
+                acc += Mix16(p + 16, kSecret + 32);
+                acc += Mix16(p + len - 32, kSecret + 48);
+            }
+            acc += Mix16(p, kSecret);
+            acc += Mix16(p + len - 16, kSecret + 16);
+            return Xxh3Avalanche(acc);
+        }
+
+        size_t rounds = len / 16;
+        for (size_t i = 0; i < 8; ++i) acc += Mix16(p + 16 * i, kSecret + 16 * i);
+        acc = Xxh3Avalanche(acc);
+        for (size_t i = 8; i < rounds; ++i) acc += Mix16(p + 16 * i, kSecret + 16 * (i - 8) + 3);
+        acc += Mix16(p + len - 16, kSecret + 136 - 17);
+        return Xxh3Avalanche(acc);
+    }
+
+    // 一个 64 字节条带累加进 8 个 64 位累加器
+    inline void Accumulate512(uint64_t* acc, const uint8_t* p, const uint8_t* secret)
+    {
+#if defined(PESH_HASH_SSE2)
+        __m128i* xacc = reinterpret_cast<__m128i*>(acc);
+        for (int i = 0; i < 4; ++i)
+        {
+            __m128i data     = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p) + i);
+            __m128i key      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i);
+            __m128i data_key = _mm_xor_si128(data, key);
+            __m128i product  = _mm_mul_epu32(data_key, _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)));
+            __m128i swapped  = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            xacc[i]          = _mm_add_epi64(product, _mm_add_epi64(xacc[i], swapped));
+        }
+#else
+        for (int i = 0; i < 8; ++i)
+        {
+            uint64_t data     = Read64(p + 8 * i);
+            uint64_t data_key = data ^ Read64(secret + 8 * i);
+            acc[i ^ 1] += data;
+            acc[i] += (data_key & 0xFFFFFFFF) * (data_key >> 32);
+        }
+#endif
+    }
+
+    inline void Scramble(uint64_t* acc, const uint8_t* secret)
+    {
+#if defined(PESH_HASH_SSE2)
+        __m128i*      xacc  = reinterpret_cast<__m128i*>(acc);
+        const __m128i prime = _mm_set1_epi32((int)kPrime32_1);
+        for (int i = 0; i < 4; ++i)
+        {
+            __m128i value    = _mm_xor_si128(xacc[i], _mm_srli_epi64(xacc[i], 47));
+            __m128i data_key = _mm_xor_si128(value, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i));
+            __m128i lo       = _mm_mul_epu32(data_key, prime);
+            __m128i hi       = _mm_mul_epu32(_mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            xacc[i]          = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+        }
+#else
+        for (int i = 0; i < 8; ++i)
+        {
+            uint64_t value = acc[i];
+            value ^= value >> 47;
+            value ^= Read64(secret + 8 * i);
+            acc[i] = value * kPrime32_1;
+        }
+#endif
+    }
+
+    uint64_t Xxh3Long(const uint8_t* p, size_t len)
+    {
+        alignas(16) uint64_t acc[8] = {kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3,
+                                       kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1};
+        size_t blocks = (len - 1) / kBlockLen;
+        for (size_t b = 0; b < blocks; ++b)
+        {
+            const uint8_t* block = p + b * kBlockLen;
+            for (size_t s = 0; s < kStripes; ++s) Accumulate512(acc, block + s * kStripeLen, kSecret + s * kSecretStep);
+            Scramble(acc, kSecret + kSecretSize - kStripeLen);
+        }
+
+        size_t         stripes = ((len - 1) - blocks * kBlockLen) / kStripeLen;
+        const uint8_t* tail    = p + blocks * kBlockLen;
+        for (size_t s = 0; s < stripes; ++s) Accumulate512(acc, tail + s * kStripeLen, kSecret + s * kSecretStep);
+        Accumulate512(acc, p + len - kStripeLen, kSecret + kSecretSize - kStripeLen - 7);
+
+        uint64_t result = len * kPrime64_1;
+        for (int i = 0; i < 4; ++i)
+        {
+            const uint8_t* secret = kSecret + 11 + 16 * i;
+            result += Mul128Fold64(acc[2 * i] ^ Read64(secret), acc[2 * i + 1] ^ Read64(secret + 8));
+        }
+        return Xxh3Avalanche(result);
+    }
+}  // namespace
+
+bool ParseContentHash(const std::string& name, ContentHash* out)
+{
+    if (name == "none") *out = ContentHash::None;
+    else if (name == "crc32c") *out = ContentHash::Crc32c;
+    else if (name == "xxh3") *out = ContentHash::Xxh3;
+    else return false;
+    return true;
+}
+
+const char* ContentHashName(ContentHash hash)
+{
+    switch (hash)
+    {
+    case ContentHash::Crc32c: return "crc32c";
+    case ContentHash::Xxh3: return "xxh3";
+    default: return "none";
+    }
+}
+
+uint32_t Crc32c(uint32_t crc, const void* data, size_t size)
+{
+    return ~Crc32cImpl().update(~crc, static_cast<const uint8_t*>(data), size);
+}
+
+uint64_t Xxh3_64(const void* data, size_t size)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    if (size <= 16) return Xxh3Short(p, size);
+    if (size <= kMidSizeMax) return Xxh3Medium(p, size);
+    return Xxh3Long(p, size);
+}
+
+uint64_t ComputeContentHash(ContentHash hash, const void* data, size_t size)
+{
+    switch (hash)
+    {
+    case ContentHash::Crc32c: return Crc32c(0, data, size);
+    case ContentHash::Xxh3: return Xxh3_64(data, size);
+    default: return 0;
+    }
+}
+
+std::string FormatContentHash(ContentHash hash, uint64_t value)
+{
+    static const char kDigits[] = "0123456789abcdef";
+    int               digits    = hash == ContentHash::Crc32c ? 8 : 16;
+    std::string       out(digits, '0');
+    for (int i = digits - 1; i >= 0; --i, value >>= 4) out[i] = kDigits[value & 0xF];
+    return out;
+}
+
+const char* ContentHashKernel(ContentHash hash)
+{
+    switch (hash)
+    {
+    case ContentHash::Crc32c: return Crc32cImpl().name;
+#if defined(PESH_HASH_SSE2)
+    case ContentHash::Xxh3: return "sse2";
+#else
+    case ContentHash::Xxh3: return "scalar";
+#endif
+    default: return "none";
+    }
+}
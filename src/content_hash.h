@@ -0,0 +1,35 @@
+#pragma once
+// 文件内容校验和。两种算法，按 CPU 能力在运行时选择实现：
+//   CRC32C (Castagnoli): x86 SSE4.2 crc32 指令 / ARMv8 CRC 扩展，否则查表 (slicing-by-8)
+//   XXH3-64 (seed 0, 默认密钥): 与 xxHash 0.8 的 XXH3_64bits 结果一致；长输入的累加在 x86-64 上用 SSE2
+// 本文件不依赖 Lua。
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class ContentHash
+{
+    None,
+    Crc32c,
+    Xxh3,
+};
+
+// 名称 "crc32c" / "xxh3" / "none"；无法识别时返回 false
+bool ParseContentHash(const std::string& name, ContentHash* out);
+
+const char* ContentHashName(ContentHash hash);
+
+// crc 为先前分片的结果，首片传 0
+uint32_t Crc32c(uint32_t crc, const void* data, size_t size);
+
+uint64_t Xxh3_64(const void* data, size_t size);
+
+// 一次性计算整段数据的校验和
+uint64_t ComputeContentHash(ContentHash hash, const void* data, size_t size);
+
+// 小写十六进制，CRC32C 为 8 位，XXH3 为 16 位
+std::string FormatContentHash(ContentHash hash, uint64_t value);
+
+// 当前 CPU 上实际使用的实现，如 "sse4.2" / "armv8-crc" / "table"、"sse2" / "scalar"
+const char* ContentHashKernel(ContentHash hash);
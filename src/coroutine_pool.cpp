@@ -0,0 +1,70 @@
+#include "coroutine_pool.h"
+
+#include "flight_recorder.h"
+
+#include <lua.hpp>
+#include <spdlog/spdlog.h>
+
+void CoroutinePool::Spawn(lua_State* L, int nargs)
+{
+    lua_State* co;
+    int        ref;
+    bool       idle_reused = !idle_.empty();
+    if (idle_reused)
+    {
+        co  = idle_.back().first;
+        ref = idle_.back().second;
+        idle_.pop_back();
+        ++reused_;
+    }
+    else
+    {
+        co  = lua_newthread(L);
+        ref = luaL_ref(L, LUA_REGISTRYINDEX);  // 同时弹出线程
+        ++created_;
+    }
+    lua_xmove(L, co, nargs + 1);
+    running_.emplace(co, ref);
+    FlightRecord(FlightEvent::CoroutineSpawn, idle_reused, 0, (uint64_t)(uintptr_t)co);
+    int status = lua_resume(co, nargs);
+    FlightRecord(FlightEvent::CoroutineReturn, (uint8_t)status, 0, (uint64_t)(uintptr_t)co);
+    AfterResume(co, status);
+}
+
+void CoroutinePool::AfterResume(lua_State* co, int status)
+{
+    if (status == LUA_YIELD) return;
+
+    if (status != 0)
+    {
+        ++failed_;
+        luaL_traceback(co, co, lua_tostring(co, -1), 0);
+        spdlog::error("Coroutine failed: {}", lua_tostring(co, -1));
+    }
+
+    auto it = running_.find(co);
+    if (it == running_.end()) return;  // Lua 侧自行创建的协程
+    int ref = it->second;
+    running_.erase(it);
+
+    if (status == 0 && idle_.size() < max_idle_)
+    {
+        lua_settop(co, 0);
+        idle_.emplace_back(co, ref);
+    }
+    else
+    {
+        luaL_unref(L_, LUA_REGISTRYINDEX, ref);  // 此后 co 可被回收，不再访问
+    }
+}
+
+CoroutinePool::Stats CoroutinePool::GetStats() const
+{
+    Stats stats;
+    stats.created = created_;
+    stats.reused  = reused_;
+    stats.failed  = failed_;
+    stats.running = running_.size();
+    stats.idle    = idle_.size();
+    return stats;
+}
@@ -0,0 +1,46 @@
+#pragma once
+// 原生协程池：async.run 的任务在池中的 Lua 线程上运行。
+//   - 线程在任务期间由注册表引用锚定，挂起等待期间不会被 GC 回收
+//   - 正常结束的线程清空栈后直接复用 (LuaJIT 允许对 status 为 0 的线程再次 lua_resume)，出错的线程丢弃
+//   - 所有 lua_resume 的返回值都经过 AfterResume，出错时记录带协程调用栈的日志
+// 仅限主线程使用。
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct lua_State;
+
+class CoroutinePool
+{
+public:
+    struct Stats
+    {
+        uint64_t created = 0;
+        uint64_t reused  = 0;
+        uint64_t failed  = 0;
+        size_t   running = 0;
+        size_t   idle    = 0;
+    };
+
+    // L 为主 Lua 状态，用于释放注册表引用
+    explicit CoroutinePool(lua_State* L, size_t max_idle = 64) : L_(L), max_idle_(max_idle) {}
+
+    // L 栈顶为函数及其后 nargs 个参数，全部弹出后在池线程上开始执行
+    void Spawn(lua_State* L, int nargs);
+
+    // status 为 lua_resume(co, ...) 的返回值；co 结束时归还池中
+    void AfterResume(lua_State* co, int status);
+
+    Stats GetStats() const;
+
+private:
+    lua_State*                              L_;
+    size_t                                  max_idle_;
+    std::unordered_map<lua_State*, int>     running_;  // 执行中的池线程 -> 注册表引用
+    std::vector<std::pair<lua_State*, int>> idle_;
+    uint64_t                                created_ = 0;
+    uint64_t                                reused_  = 0;
+    uint64_t                                failed_  = 0;
+};
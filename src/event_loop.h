@@ -0,0 +1,36 @@
+#pragma once
+// 事件循环后端：只负责 "睡到被唤醒 / 超时 / 收到平台消息"。
+// 调度逻辑 (完成队列、等待、定时器、协程恢复) 在 Scheduler 中，与平台无关。
+//   Windows: 自动复位事件 + MsgWaitForMultipleObjects + 消息泵
+//   Linux:   epoll + eventfd
+
+#include <cstdint>
+#include <memory>
+
+class EventLoop
+{
+public:
+    static std::unique_ptr<EventLoop> Create();
+
+    virtual ~EventLoop() = default;
+
+    // 任意线程调用
+    virtual void Wakeup() = 0;
+
+    // 以下仅限事件循环线程调用
+
+    // timeout_ms < 0 表示无限等待；返回 false 表示收到退出请求
+    virtual bool Wait(int64_t timeout_ms) = 0;
+
+    virtual void Quit(int exit_code) = 0;
+
+    virtual const char* Name() const = 0;
+
+    int ExitCode() const
+    {
+        return exit_code_;
+    }
+
+protected:
+    int exit_code_ = 0;
+};
@@ -0,0 +1,77 @@
+#include "event_loop.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+
+namespace
+{
+    class EpollEventLoop : public EventLoop
+    {
+    public:
+        EpollEventLoop()
+        {
+            epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+            wake_fd_  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+            epoll_event ev{};
+            ev.events  = EPOLLIN;
+            ev.data.fd = wake_fd_;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+        }
+
+        ~EpollEventLoop() override
+        {
+            close(wake_fd_);
+            close(epoll_fd_);
+        }
+
+        void Wakeup() override
+        {
+            uint64_t one = 1;
+            (void)!write(wake_fd_, &one, sizeof(one));
+        }
+
+        bool Wait(int64_t timeout_ms) override
+        {
+            if (quit_) return false;
+
+            int         timeout = timeout_ms < 0 ? -1 : (int)std::min<int64_t>(timeout_ms, INT_MAX);
+            epoll_event events[8];
+            int         n = epoll_wait(epoll_fd_, events, 8, timeout);
+            for (int i = 0; i < n; ++i)
+            {
+                if (events[i].data.fd != wake_fd_) continue;
+                uint64_t value;
+                (void)!read(wake_fd_, &value, sizeof(value));
+            }
+            return !quit_;
+        }
+
+        void Quit(int exit_code) override
+        {
+            exit_code_ = exit_code;
+            quit_      = true;
+            Wakeup();
+        }
+
+        const char* Name() const override
+        {
+            return "epoll";
+        }
+
+    private:
+        int  epoll_fd_ = -1;
+        int  wake_fd_  = -1;
+        bool quit_     = false;
+    };
+}  // namespace
+
+std::unique_ptr<EventLoop> EventLoop::Create()
+{
+    return std::make_unique<EpollEventLoop>();
+}
@@ -0,0 +1,67 @@
+#include "event_loop.h"
+
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+
+#include <algorithm>
+
+namespace
+{
+    class Win32EventLoop : public EventLoop
+    {
+    public:
+        Win32EventLoop() : wake_event_(CreateEventW(NULL, FALSE, FALSE, NULL)) {}
+
+        ~Win32EventLoop() override
+        {
+            if (wake_event_) CloseHandle(wake_event_);
+        }
+
+        void Wakeup() override
+        {
+            SetEvent(wake_event_);
+        }
+
+        bool Wait(int64_t timeout_ms) override
+        {
+            DWORD timeout_dw = timeout_ms < 0 ? INFINITE : (DWORD)std::min<int64_t>(timeout_ms, INFINITE - 1);
+            DWORD res        = MsgWaitForMultipleObjects(1, &wake_event_, FALSE, timeout_dw, QS_ALLINPUT);
+            if (res == WAIT_OBJECT_0 + 1)
+            {
+                MSG msg;
+                while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+                {
+                    if (msg.message == WM_QUIT)
+                    {
+                        exit_code_ = (int)msg.wParam;
+                        return false;
+                    }
+                    TranslateMessage(&msg);
+                    DispatchMessage(&msg);
+                }
+            }
+            return true;
+        }
+
+        // 与脚本直接调用 user32.PostQuitMessage 等价
+        void Quit(int exit_code) override
+        {
+            PostQuitMessage(exit_code);
+        }
+
+        const char* Name() const override
+        {
+            return "win32";
+        }
+
+    private:
+        HANDLE wake_event_;
+    };
+}  // namespace
+
+std::unique_ptr<EventLoop> EventLoop::Create()
+{
+    return std::make_unique<Win32EventLoop>();
+}
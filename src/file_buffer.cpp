@@ -0,0 +1,383 @@
+#include "file_buffer.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    struct MappedBuffer : pesh_buffer
+    {
+        void* base = nullptr;
+    };
+
+#if defined(_WIN32)
+    constexpr intptr_t kInvalidFile = (intptr_t)INVALID_HANDLE_VALUE;
+
+    std::string LastErrorText(const char* what)
+    {
+        return std::string(what) + " failed: " + std::to_string(GetLastError());
+    }
+
+    intptr_t OpenForRead(const std::filesystem::path& path, std::string* error)
+    {
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE && error) *error = LastErrorText("CreateFile");
+        return (intptr_t)file;
+    }
+
+    void CloseFile(intptr_t file)
+    {
+        CloseHandle((HANDLE)file);
+    }
+
+    bool ReadSome(intptr_t file, uint8_t* dst, size_t size, size_t* got, std::string* error)
+    {
+        DWORD n = 0;
+        if (!ReadFile((HANDLE)file, dst, (DWORD)std::min<size_t>(size, 1u << 30), &n, NULL))
+        {
+            *error = LastErrorText("ReadFile");
+            return false;
+        }
+        *got = n;
+        return true;
+    }
+
+    void ReleaseMapped(pesh_buffer* buffer)
+    {
+        auto* mapped = static_cast<MappedBuffer*>(buffer);
+        if (mapped->base) UnmapViewOfFile(mapped->base);
+        delete mapped;
+    }
+
+    bool MapWhole(intptr_t file, MappedBuffer* mapped, std::string* error)
+    {
+        LARGE_INTEGER size{};
+        if (!GetFileSizeEx((HANDLE)file, &size))
+        {
+            *error = LastErrorText("GetFileSizeEx");
+            return false;
+        }
+        if ((uint64_t)size.QuadPart > SIZE_MAX)
+        {
+            *error = "File too large to map";
+            return false;
+        }
+        if (size.QuadPart == 0) return true;
+
+        HANDLE mapping = CreateFileMappingW((HANDLE)file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping)
+        {
+            *error = LastErrorText("CreateFileMapping");
+            return false;
+        }
+        // 视图会保持映射对象存活，句柄可以立即关闭
+        mapped->base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (!mapped->base)
+        {
+            *error = LastErrorText("MapViewOfFile");
+            return false;
+        }
+        mapped->data = static_cast<const uint8_t*>(mapped->base);
+        mapped->size = (size_t)size.QuadPart;
+        return true;
+    }
+#else
+    constexpr intptr_t kInvalidFile = -1;
+
+    std::string LastErrorText(const char* what)
+    {
+        return std::string(what) + " failed: " + strerror(errno);
+    }
+
+    intptr_t OpenForRead(const std::filesystem::path& path, std::string* error)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            if (error) *error = LastErrorText("open");
+            return -1;
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        return fd;
+    }
+
+    void CloseFile(intptr_t file)
+    {
+        close((int)file);
+    }
+
+    bool ReadSome(intptr_t file, uint8_t* dst, size_t size, size_t* got, std::string* error)
+    {
+        ssize_t n;
+        do
+        {
+            n = read((int)file, dst, size);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0)
+        {
+            *error = LastErrorText("read");
+            return false;
+        }
+        *got = (size_t)n;
+        return true;
+    }
+
+    void ReleaseMapped(pesh_buffer* buffer)
+    {
+        auto* mapped = static_cast<MappedBuffer*>(buffer);
+        if (mapped->base) munmap(mapped->base, mapped->size);
+        delete mapped;
+    }
+
+    bool MapWhole(intptr_t file, MappedBuffer* mapped, std::string* error)
+    {
+        struct stat st{};
+        if (fstat((int)file, &st) != 0)
+        {
+            *error = LastErrorText("fstat");
+            return false;
+        }
+        if ((uint64_t)st.st_size > SIZE_MAX)
+        {
+            *error = "File too large to map";
+            return false;
+        }
+        if (st.st_size == 0) return true;
+
+        void* base = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, (int)file, 0);
+        if (base == MAP_FAILED)
+        {
+            *error = LastErrorText("mmap");
+            return false;
+        }
+        madvise(base, (size_t)st.st_size, MADV_SEQUENTIAL);
+        mapped->base = base;
+        mapped->data = static_cast<const uint8_t*>(base);
+        mapped->size = (size_t)st.st_size;
+        return true;
+    }
+#endif
+
+    // 读满 size 字节，只有 EOF 才会返回更少
+    bool ReadFull(intptr_t file, uint8_t* dst, size_t size, size_t* got, std::string* error)
+    {
+        *got = 0;
+        while (*got < size)
+        {
+            size_t n = 0;
+            if (!ReadSome(file, dst + *got, size - *got, &n, error)) return false;
+            if (n == 0) break;
+            *got += n;
+        }
+        return true;
+    }
+}  // namespace
+
+pesh_buffer* MapFileBuffer(const std::filesystem::path& path, std::string* error)
+{
+    intptr_t file = OpenForRead(path, error);
+    if (file == kInvalidFile) return nullptr;
+
+    auto* mapped    = new MappedBuffer;
+    mapped->data    = nullptr;
+    mapped->size    = 0;
+    mapped->release = ReleaseMapped;
+
+    std::string map_error;
+    bool        ok = MapWhole(file, mapped, &map_error);
+    CloseFile(file);  // 映射建立后不再需要文件句柄
+    if (!ok)
+    {
+        if (error) *error = map_error;
+        delete mapped;
+        return nullptr;
+    }
+    return mapped;
+}
+
+// ============================================================================
+// ChunkReader
+// ============================================================================
+
+struct ChunkReader::Chunk : pesh_buffer
+{
+    ChunkReader*                 reader;
+    std::unique_ptr<uint8_t[]>   storage;
+    std::shared_ptr<ChunkReader> owner;  // 仅在交给调用方期间持有，保证释放时 reader 仍然存活
+};
+
+std::shared_ptr<ChunkReader> ChunkReader::Open(const std::filesystem::path& path, size_t chunk_size, size_t depth,
+                                               Executor executor, std::string* error)
+{
+    if (chunk_size == 0 || depth == 0)
+    {
+        if (error) *error = "chunk_size and depth must be positive";
+        return nullptr;
+    }
+    intptr_t file = OpenForRead(path, error);
+    if (file == kInvalidFile) return nullptr;
+    return std::shared_ptr<ChunkReader>(new ChunkReader(file, chunk_size, depth, std::move(executor)));
+}
+
+ChunkReader::ChunkReader(intptr_t file, size_t chunk_size, size_t depth, Executor executor)
+    : file_(file), chunk_size_(chunk_size), depth_(depth), executor_(std::move(executor))
+{
+}
+
+ChunkReader::~ChunkReader()
+{
+    CloseFile(file_);
+}
+
+void ChunkReader::Next(Callback callback)
+{
+    Callback     ready_callback;
+    pesh_buffer* chunk = nullptr;
+    std::string  error;
+    bool         start;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ = std::move(callback);
+        TakeResultLocked(&ready_callback, &chunk, &error);
+        start = StartReadLocked();
+    }
+    if (start) executor_([self = shared_from_this()] { self->ReadAhead(); });
+    if (ready_callback) ready_callback(chunk, std::move(error));
+}
+
+void ChunkReader::Close()
+{
+    Callback     callback;
+    pesh_buffer* chunk = nullptr;
+    std::string  error;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        for (Chunk* c : ready_) free_.push_back(c);
+        ready_.clear();
+        TakeResultLocked(&callback, &chunk, &error);
+    }
+    if (callback) callback(chunk, std::move(error));
+}
+
+void ChunkReader::ReleaseChunk(pesh_buffer* buffer)
+{
+    auto* chunk = static_cast<Chunk*>(buffer);
+    chunk->reader->Recycle(chunk);
+}
+
+void ChunkReader::Recycle(Chunk* chunk)
+{
+    std::shared_ptr<ChunkReader> keep_alive;
+    bool                         start;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        keep_alive = std::move(chunk->owner);
+        free_.push_back(chunk);
+        start = StartReadLocked();  // 归还的额度可能让停下的预读继续
+    }
+    if (start) executor_([self = keep_alive] { self->ReadAhead(); });
+}
+
+bool ChunkReader::StartReadLocked()
+{
+    if (reading_ || eof_ || closed_ || !error_.empty()) return false;
+    if (free_.empty() && pool_.size() >= depth_) return false;
+    reading_ = true;
+    return true;
+}
+
+bool ChunkReader::TakeResultLocked(Callback* out_callback, pesh_buffer** out_chunk, std::string* out_error)
+{
+    if (!pending_) return false;
+    if (!ready_.empty())
+    {
+        Chunk* chunk = ready_.front();
+        ready_.pop_front();
+        chunk->owner = shared_from_this();
+        *out_chunk   = chunk;
+    }
+    else if (closed_)
+    {
+        *out_error = "Reader closed";
+    }
+    else if (!error_.empty())
+    {
+        *out_error = error_;
+    }
+    else if (!eof_)
+    {
+        return false;
+    }
+    *out_callback = std::move(pending_);
+    pending_      = nullptr;
+    return true;
+}
+
+// 单个预读任务顺序填充空闲块，直到池耗尽或到达 EOF；同一时刻只有一个任务在读文件
+void ChunkReader::ReadAhead()
+{
+    while (true)
+    {
+        Chunk* chunk;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_ || eof_ || !error_.empty() || (free_.empty() && pool_.size() >= depth_))
+            {
+                reading_ = false;
+                return;
+            }
+            if (free_.empty())
+            {
+                auto fresh     = std::make_unique<Chunk>();
+                fresh->release = ReleaseChunk;
+                fresh->reader  = this;
+                fresh->storage.reset(new uint8_t[chunk_size_]);
+                fresh->data = fresh->storage.get();
+                free_.push_back(fresh.get());
+                pool_.push_back(std::move(fresh));
+            }
+            chunk = free_.back();
+            free_.pop_back();
+        }
+
+        size_t      got = 0;
+        std::string read_error;
+        bool        ok = ReadFull(file_, chunk->storage.get(), chunk_size_, &got, &read_error);
+
+        Callback     callback;
+        pesh_buffer* out_chunk = nullptr;
+        std::string  out_error;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!ok) error_ = read_error;
+            if (got > 0 && !closed_)
+            {
+                chunk->size = got;
+                ready_.push_back(chunk);
+            }
+            else
+            {
+                free_.push_back(chunk);
+            }
+            if (ok && got < chunk_size_) eof_ = true;
+            TakeResultLocked(&callback, &out_chunk, &out_error);
+        }
+        if (callback) callback(out_chunk, std::move(out_error));
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+// 零拷贝文件缓冲区，以 LuaJIT cdata (指针 + 长度 + 释放函数) 的形式交给 Lua，
+// 绕开 std::string -> 完成队列 -> lua_pushlstring 的多次复制与字符串驻留。
+//   MapFileBuffer: 整文件只读内存映射 (Windows: MapViewOfFile / Linux: mmap)
+//   ChunkReader:   顺序分块预读，块缓冲区来自固定深度的池，常驻内存 <= depth * chunk_size
+// pesh_buffer 的布局必须与 scripts/plugins/fs_async 中的 ffi.cdef 保持一致。
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+    struct pesh_buffer
+    {
+        const uint8_t* data;
+        size_t         size;
+        void (*release)(struct pesh_buffer*);  // 任意线程调用一次，之后不得再访问 data
+    };
+}
+
+// 映射整个文件；空文件得到 size 为 0 的缓冲区。失败返回 nullptr
+pesh_buffer* MapFileBuffer(const std::filesystem::path& path, std::string* error);
+
+class ChunkReader : public std::enable_shared_from_this<ChunkReader>
+{
+public:
+    using Executor = std::function<void(std::function<void()>)>;
+    // chunk 为 nullptr 且 error 为空表示 EOF；可能在任意线程上调用
+    using Callback = std::function<void(pesh_buffer* chunk, std::string error)>;
+
+    static std::shared_ptr<ChunkReader> Open(const std::filesystem::path& path, size_t chunk_size, size_t depth,
+                                             Executor executor, std::string* error);
+    ~ChunkReader();
+
+    ChunkReader(const ChunkReader&)            = delete;
+    ChunkReader& operator=(const ChunkReader&) = delete;
+
+    // 同一时刻至多一个未完成的 Next；已有预读块时回调在当前线程立即执行
+    void Next(Callback callback);
+
+    // 丢弃预读块并让挂起的 Next 以错误结束；已交出的块仍可安全释放
+    void Close();
+
+private:
+    struct Chunk;
+
+    ChunkReader(intptr_t file, size_t chunk_size, size_t depth, Executor executor);
+
+    static void ReleaseChunk(pesh_buffer* buffer);
+    void        Recycle(Chunk* chunk);
+    void        ReadAhead();
+    bool        StartReadLocked();  // 返回 true 时由调用方在锁外提交 ReadAhead
+    bool        TakeResultLocked(Callback* out_callback, pesh_buffer** out_chunk, std::string* out_error);
+
+    const intptr_t file_;  // Windows: HANDLE / Linux: fd
+    const size_t   chunk_size_;
+    const size_t   depth_;
+    Executor       executor_;
+
+    std::mutex                          mutex_;
+    std::deque<Chunk*>                  ready_;
+    std::vector<std::unique_ptr<Chunk>> pool_;   // 全部块，数量不超过 depth_
+    std::vector<Chunk*>                 free_;
+    Callback                            pending_;
+    std::string                         error_;
+    bool                                reading_ = false;
+    bool                                eof_     = false;
+    bool                                closed_  = false;
+};
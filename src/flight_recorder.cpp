@@ -0,0 +1,544 @@
+#include "flight_recorder.h"
+#include "trace.h"
+
+#if defined(_WIN32)
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t kRingSize    = 4096;  // 每线程 128 KB，须为 2 的幂
+    constexpr size_t   kMaxRings    = 256;
+    constexpr size_t   kPayloadSize = 20;
+    constexpr uint32_t kVersion     = 1;
+    constexpr char     kMagic[8]    = {'P', 'E', 'S', 'H', 'F', 'L', 'T', '\0'};
+
+    struct Entry
+    {
+        uint64_t ticks;
+        uint8_t  event;
+        uint8_t  tag;
+        uint16_t size;
+        uint8_t  payload[kPayloadSize];  // u32 + a + b，或 Log 的消息前缀
+    };
+    static_assert(sizeof(Entry) == 32, "flight entries must stay 32 bytes");
+
+    struct Ring
+    {
+        std::atomic<uint64_t> head{0};
+        std::atomic<int>      in_use{1};
+        Entry                 entries[kRingSize];
+    };
+
+    // 转储文件：DumpHeader，随后每个环形缓冲区依次为 uint64 head 与 kRingSize 条 Entry
+    // ticks 换算为时间：ns = ns0 + (ticks - ticks0) * (ns1 - ns0) / (ticks1 - ticks0)
+    struct DumpHeader
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t entry_size;
+        uint32_t ring_size;
+        uint32_t ring_count;
+        uint32_t reason;
+        uint32_t reserved;
+        uint64_t pid;
+        uint64_t ticks0, ns0;  // 进程启动时
+        uint64_t ticks1, ns1;  // 转储时
+    };
+
+#if defined(_WIN32)
+    using NativeChar = wchar_t;
+#else
+    using NativeChar = char;
+#endif
+    constexpr size_t kMaxPath = 1024;
+
+    std::atomic<bool>  g_enabled{true};
+    std::atomic<Ring*> g_rings[kMaxRings];
+    std::atomic<size_t> g_ring_count{0};
+    std::atomic<bool>  g_crashed{false};
+    NativeChar         g_default_path[kMaxPath];  // 崩溃时不能分配内存，路径提前准备好
+    NativeChar         g_crash_path[kMaxPath];
+
+    // 与追踪时钟相同 (x86 为 TSC，其他平台为 steady_clock 纳秒)，调用方已读过的刻度可以直接传给 FlightRecordAt
+    inline uint64_t ReadTicks()
+    {
+        return TraceNow();
+    }
+
+    // Unix 纪元起的纳秒数；异步信号安全
+    uint64_t WallNs()
+    {
+#if defined(_WIN32)
+        FILETIME ft;
+        GetSystemTimePreciseAsFileTime(&ft);
+        uint64_t t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+        return (t - 116444736000000000ULL) * 100;
+#else
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+    }
+
+    uint64_t CurrentThreadId()
+    {
+#if defined(_WIN32)
+        return GetCurrentThreadId();
+#else
+        return (uint64_t)syscall(SYS_gettid);
+#endif
+    }
+
+    uint64_t CurrentProcessId()
+    {
+#if defined(_WIN32)
+        return GetCurrentProcessId();
+#else
+        return (uint64_t)getpid();
+#endif
+    }
+
+    const uint64_t g_ticks0 = ReadTicks();
+    const uint64_t g_ns0    = WallNs();
+
+    // 线程退出时交还环形缓冲区。记录路径只读平凡的 t_ring (带析构函数的 thread_local 每次访问都要检查初始化)，
+    // t_release 只在取得环形缓冲区时触碰一次以登记析构
+    struct ThreadRing
+    {
+        Ring* ring = nullptr;
+        ~ThreadRing()
+        {
+            if (ring) ring->in_use.store(0, std::memory_order_release);
+        }
+    };
+    thread_local Ring*      t_ring = nullptr;
+    thread_local ThreadRing t_release;
+
+    inline void Append(Ring* ring, uint64_t ticks, FlightEvent event, uint8_t tag, uint16_t size, const void* payload, size_t len)
+    {
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        Entry&   e    = ring->entries[head & (kRingSize - 1)];
+        e.ticks       = ticks;
+        e.event       = (uint8_t)event;
+        e.tag         = tag;
+        e.size        = size;
+        std::memcpy(e.payload, payload, len);
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    Ring* AcquireRing()
+    {
+        Ring*  ring  = nullptr;
+        size_t count = std::min(g_ring_count.load(std::memory_order_acquire), kMaxRings);
+        for (size_t i = 0; i < count && !ring; ++i)
+        {
+            Ring* candidate = g_rings[i].load(std::memory_order_acquire);
+            int   expected  = 0;
+            if (candidate && candidate->in_use.compare_exchange_strong(expected, 1)) ring = candidate;
+        }
+        if (!ring)
+        {
+            size_t index = g_ring_count.fetch_add(1);
+            if (index >= kMaxRings) return nullptr;  // 超出上限的线程不记录
+            ring = new Ring;                          // 永不释放：崩溃转储时必须仍然可读
+            g_rings[index].store(ring, std::memory_order_release);
+        }
+        t_ring         = ring;
+        t_release.ring   = ring;
+
+        uint8_t  payload[kPayloadSize] = {};
+        uint64_t tid                   = CurrentThreadId();
+        std::memcpy(payload + 4, &tid, sizeof(tid));
+        Append(ring, ReadTicks(), FlightEvent::ThreadStart, 0, 0, payload, sizeof(payload));
+        return ring;
+    }
+
+    inline Ring* ThisThreadRing()
+    {
+        Ring* ring = t_ring;
+        return ring ? ring : AcquireRing();
+    }
+
+    template <size_t N>
+    void CopyPath(NativeChar (&dest)[N], const std::filesystem::path& path)
+    {
+        const auto& native = path.native();
+        size_t      len    = std::min(native.size(), N - 1);
+        std::copy(native.begin(), native.begin() + len, dest);
+        dest[len] = 0;
+    }
+
+    // 只使用系统调用，崩溃处理中可以安全调用
+    bool WriteDump(const NativeChar* path, FlightDumpReason reason)
+    {
+        if (!path || !path[0]) return false;
+
+        DumpHeader header = {};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version    = kVersion;
+        header.entry_size = sizeof(Entry);
+        header.ring_size  = kRingSize;
+        header.ring_count = (uint32_t)std::min(g_ring_count.load(std::memory_order_acquire), kMaxRings);
+        header.reason     = (uint32_t)reason;
+        header.pid        = CurrentProcessId();
+        header.ticks0     = g_ticks0;
+        header.ns0        = g_ns0;
+        header.ticks1     = ReadTicks();
+        header.ns1        = WallNs();
+
+#if defined(_WIN32)
+        HANDLE file = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        auto write_all = [file](const void* data, size_t size) {
+            DWORD written = 0;
+            return WriteFile(file, data, (DWORD)size, &written, NULL) && written == size;
+        };
+#else
+        int file = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (file < 0) return false;
+        auto write_all = [file](const void* data, size_t size) {
+            const char* p = static_cast<const char*>(data);
+            while (size > 0)
+            {
+                ssize_t n = write(file, p, size);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return false;
+                p += n;
+                size -= (size_t)n;
+            }
+            return true;
+        };
+#endif
+
+        bool ok = write_all(&header, sizeof(header));
+        for (uint32_t i = 0; ok && i < header.ring_count; ++i)
+        {
+            static const Entry kEmpty[kRingSize] = {};
+            Ring*              ring              = g_rings[i].load(std::memory_order_acquire);
+            uint64_t           head              = ring ? ring->head.load(std::memory_order_acquire) : 0;
+            ok = write_all(&head, sizeof(head)) && write_all(ring ? ring->entries : kEmpty, sizeof(kEmpty));
+        }
+
+#if defined(_WIN32)
+        CloseHandle(file);
+#else
+        close(file);
+#endif
+        return ok;
+    }
+
+    void DumpOnCrash()
+    {
+        if (!g_crashed.exchange(true)) WriteDump(g_crash_path, FlightDumpReason::Crash);
+    }
+
+    std::terminate_handler g_previous_terminate = nullptr;
+
+    void OnTerminate()
+    {
+        DumpOnCrash();
+        if (g_previous_terminate) g_previous_terminate();
+        std::abort();
+    }
+
+#if defined(_WIN32)
+    LPTOP_LEVEL_EXCEPTION_FILTER g_previous_filter = nullptr;
+
+    LONG WINAPI OnUnhandledException(EXCEPTION_POINTERS* info)
+    {
+        DumpOnCrash();
+        return g_previous_filter ? g_previous_filter(info) : EXCEPTION_CONTINUE_SEARCH;
+    }
+
+    void OnAbortSignal(int)
+    {
+        DumpOnCrash();
+    }
+
+    void InstallCrashHandlers()
+    {
+        g_previous_filter    = SetUnhandledExceptionFilter(OnUnhandledException);
+        g_previous_terminate = std::set_terminate(OnTerminate);
+        std::signal(SIGABRT, OnAbortSignal);
+    }
+#else
+    // SA_RESETHAND 先恢复默认处理，转储后重新触发信号，进程照常终止 (并生成 core)
+    void OnCrashSignal(int sig)
+    {
+        DumpOnCrash();
+        raise(sig);
+    }
+
+    void InstallCrashHandlers()
+    {
+        struct sigaction action = {};
+        action.sa_handler       = OnCrashSignal;
+        action.sa_flags         = SA_RESETHAND | SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+        for (int sig : {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT}) sigaction(sig, &action, nullptr);
+        g_previous_terminate = std::set_terminate(OnTerminate);
+    }
+#endif
+
+    // ---- 离线解码 ----
+
+    struct EventInfo
+    {
+        const char* name;
+        const char* tag;  // 以下为各字段在输出中的名称，nullptr 表示该事件不使用
+        const char* u32;
+        const char* a;
+        const char* b;
+    };
+
+    const EventInfo* Describe(uint8_t event)
+    {
+        static const EventInfo kEvents[] = {
+            {"thread.start", nullptr, nullptr, "tid", nullptr},
+            {"worker.dispatch", "lane", "worker", "op", nullptr},
+            {"worker.run", nullptr, "worker", "op", nullptr},
+            {"worker.complete", "ok", "code", "op", nullptr},
+            {"coroutine.spawn", "reused", nullptr, "co", nullptr},
+            {"coroutine.resume", "nargs", nullptr, "co", nullptr},
+            {"coroutine.return", "status", nullptr, "co", nullptr},
+            {"wait.register", nullptr, "handles", "co", nullptr},
+            {"timer.schedule", nullptr, nullptr, "co", "delay_ms"},
+            {"log", "level", nullptr, nullptr, nullptr},
+            {"mark", nullptr, nullptr, nullptr, nullptr},
+        };
+        if (event < 1 || event > std::size(kEvents)) return nullptr;
+        return &kEvents[event - 1];
+    }
+
+    const char* LevelName(uint8_t level)
+    {
+        static const char* kLevels[] = {"trace", "debug", "info", "warn", "error", "critical"};
+        return level < std::size(kLevels) ? kLevels[level] : "off";
+    }
+
+    const char* ReasonName(uint32_t reason)
+    {
+        switch ((FlightDumpReason)reason)
+        {
+        case FlightDumpReason::OnDemand: return "on-demand";
+        case FlightDumpReason::Shutdown: return "shutdown";
+        case FlightDumpReason::Crash:    return "crash";
+        }
+        return "unknown";
+    }
+
+    void WriteJsonString(std::ostream& out, const char* text, size_t size)
+    {
+        static const char* HEX = "0123456789abcdef";
+        out << '"';
+        for (size_t i = 0; i < size; ++i)
+        {
+            unsigned char c = (unsigned char)text[i];
+            if (c == '"' || c == '\\') out << '\\' << (char)c;
+            else if (c < 0x20) out << "\\u00" << HEX[c >> 4] << HEX[c & 0xF];
+            else out << (char)c;
+        }
+        out << '"';
+    }
+
+    struct Decoded
+    {
+        uint64_t ticks;
+        uint64_t tid;
+        Entry    entry;
+    };
+}  // namespace
+
+void InstallFlightRecorder(const std::filesystem::path& path_stem)
+{
+    std::filesystem::path default_path = path_stem;
+    std::filesystem::path crash_path   = path_stem;
+    default_path += ".flight";
+    crash_path += ".crash.flight";
+    CopyPath(g_default_path, default_path);
+    CopyPath(g_crash_path, crash_path);
+    InstallCrashHandlers();
+}
+
+void SetFlightRecorderEnabled(bool enabled)
+{
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void FlightRecord(FlightEvent event, uint8_t tag, uint32_t u32, uint64_t a, uint64_t b)
+{
+    if (!g_enabled.load(std::memory_order_relaxed)) return;
+    FlightRecordAt(ReadTicks(), event, tag, u32, a, b);
+}
+
+void FlightRecordAt(uint64_t ticks, FlightEvent event, uint8_t tag, uint32_t u32, uint64_t a, uint64_t b)
+{
+    if (!g_enabled.load(std::memory_order_relaxed)) return;
+    Ring* ring = ThisThreadRing();
+    if (!ring) return;
+    uint8_t payload[kPayloadSize];
+    std::memcpy(payload, &u32, 4);
+    std::memcpy(payload + 4, &a, 8);
+    std::memcpy(payload + 12, &b, 8);
+    Append(ring, ticks, event, tag, 0, payload, sizeof(payload));
+}
+
+void FlightRecordText(FlightEvent event, uint8_t tag, const char* text, size_t size)
+{
+    if (!g_enabled.load(std::memory_order_relaxed)) return;
+    Ring* ring = ThisThreadRing();
+    if (!ring) return;
+    uint8_t payload[kPayloadSize] = {};
+    std::memcpy(payload, text, std::min(size, kPayloadSize));
+    Append(ring, ReadTicks(), event, tag, (uint16_t)std::min<size_t>(size, UINT16_MAX), payload, sizeof(payload));
+}
+
+std::filesystem::path DumpFlightRecorder(FlightDumpReason reason, const std::filesystem::path& path)
+{
+    if (reason == FlightDumpReason::OnDemand) FlightRecord(FlightEvent::Mark, 0, 0, 0);
+    std::filesystem::path target = path.empty() ? std::filesystem::path(g_default_path) : path;
+    if (target.empty() || !WriteDump(target.c_str(), reason)) return {};
+    return target;
+}
+
+bool DecodeFlightDump(const std::filesystem::path& path, bool json, std::ostream& out, std::string* error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        if (error) *error = "Cannot open " + path.string();
+        return false;
+    }
+    DumpHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0)
+    {
+        if (error) *error = "Not a flight recorder dump";
+        return false;
+    }
+    if (header.version != kVersion || header.entry_size != sizeof(Entry) || header.ring_size == 0 ||
+        (header.ring_size & (header.ring_size - 1)) != 0)
+    {
+        if (error) *error = "Unsupported dump version " + std::to_string(header.version);
+        return false;
+    }
+
+    std::vector<Decoded> records;
+    std::vector<Entry>   entries(header.ring_size);
+    for (uint32_t r = 0; r < header.ring_count; ++r)
+    {
+        uint64_t head = 0;
+        if (!file.read(reinterpret_cast<char*>(&head), sizeof(head)) ||
+            !file.read(reinterpret_cast<char*>(entries.data()), (std::streamsize)(entries.size() * sizeof(Entry))))
+        {
+            if (error) *error = "Truncated dump";
+            return false;
+        }
+        uint64_t count = std::min<uint64_t>(head, header.ring_size);
+        uint64_t tid   = 0;  // 最早的记录可能早于被覆盖的 ThreadStart
+        for (uint64_t i = head - count; i < head; ++i)
+        {
+            const Entry& e = entries[i & (header.ring_size - 1)];
+            if (e.event == (uint8_t)FlightEvent::ThreadStart) std::memcpy(&tid, e.payload + 4, 8);
+            records.push_back({e.ticks, tid, e});
+        }
+    }
+    std::stable_sort(records.begin(), records.end(),
+                     [](const Decoded& x, const Decoded& y) { return x.ticks < y.ticks; });
+
+    double ns_per_tick =
+        header.ticks1 > header.ticks0 ? (double)(header.ns1 - header.ns0) / (double)(header.ticks1 - header.ticks0) : 1.0;
+    auto to_ns = [&](uint64_t ticks) {
+        return (double)header.ns0 + ((double)ticks - (double)header.ticks0) * ns_per_tick;
+    };
+    double origin_ns = records.empty() ? (double)header.ns1 : to_ns(records.front().ticks);
+
+    if (!json)
+    {
+        out << "# peshell flight dump: pid " << header.pid << ", reason " << ReasonName(header.reason) << ", "
+            << header.ring_count << " threads, " << records.size() << " records, start unix_ns "
+            << (uint64_t)origin_ns << "\n";
+    }
+
+    char line[64];
+    for (const Decoded& d : records)
+    {
+        const EventInfo* info = Describe(d.entry.event);
+        if (!info) continue;
+        uint32_t u32;
+        uint64_t a, b;
+        std::memcpy(&u32, d.entry.payload, 4);
+        std::memcpy(&a, d.entry.payload + 4, 8);
+        std::memcpy(&b, d.entry.payload + 12, 8);
+        double t_ns = to_ns(d.ticks);
+
+        auto field = [&](const char* name, uint64_t value) {
+            if (!name) return;
+            bool pointer = std::strcmp(name, "co") == 0;
+            if (pointer) std::snprintf(line, sizeof(line), "0x%llx", (unsigned long long)value);
+            else std::snprintf(line, sizeof(line), "%llu", (unsigned long long)value);
+            if (json) out << ",\"" << name << "\":" << (pointer ? "\"" : "") << line << (pointer ? "\"" : "");
+            else out << ' ' << name << '=' << line;
+        };
+
+        if (json)
+        {
+            out << "{\"t\":";
+            std::snprintf(line, sizeof(line), "%.6f", (t_ns - origin_ns) / 1e9);
+            out << line << ",\"unix_ns\":" << (uint64_t)t_ns << ",\"thread\":" << d.tid << ",\"event\":\""
+                << info->name << '"';
+        }
+        else
+        {
+            std::snprintf(line, sizeof(line), "+%.6f [%llu] ", (t_ns - origin_ns) / 1e9, (unsigned long long)d.tid);
+            out << line << info->name;
+        }
+
+        if (d.entry.event == (uint8_t)FlightEvent::Log)
+        {
+            const char* text = reinterpret_cast<const char*>(d.entry.payload);
+            size_t      len  = std::min<size_t>(d.entry.size, kPayloadSize);
+            if (json)
+            {
+                out << ",\"level\":\"" << LevelName(d.entry.tag) << "\",\"size\":" << d.entry.size << ",\"message\":";
+                WriteJsonString(out, text, len);
+            }
+            else
+            {
+                out << ' ' << LevelName(d.entry.tag) << ' ';
+                out.write(text, (std::streamsize)len);
+                if (d.entry.size > kPayloadSize) out << "...";
+            }
+        }
+        else
+        {
+            field(info->tag, d.entry.tag);
+            field(info->u32, u32);
+            field(info->a, a);
+            field(info->b, b);
+        }
+        out << (json ? "}\n" : "\n");
+    }
+    return true;
+}
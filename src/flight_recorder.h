@@ -0,0 +1,57 @@
+#pragma once
+// 常开的崩溃飞行记录器：每个线程一个无锁环形缓冲区，记录 32 字节的紧凑二进制事件
+// (工作派发/完成、协程恢复、等待注册、所有级别的 Lua 日志调用)。
+//   - 写入只由所属线程进行：取时间戳 + 填一条记录 + 一次 release store，不加锁、不分配
+//   - 线程退出后环形缓冲区留给之后的新线程继续使用，旧记录保留到被覆盖为止
+//   - 崩溃 (信号 / 未处理异常 / std::terminate)、ShutdownLogger 或按需时整体转储到 logs/，
+//     DecodeFlightDump 离线解码为文本或 JSON 行
+// 按需转储时其他线程仍在写入，个别记录可能不完整。本文件不依赖 Lua 与 spdlog。
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+
+enum class FlightEvent : uint8_t
+{
+    ThreadStart = 1,  // a = 线程 ID；此后的记录属于该线程
+    WorkerDispatch,   // tag = 通道，u32 = 工作 ID，a = 操作 ID (内联工作为 0)
+    WorkerRun,        // u32 = 工作 ID，a = 操作 ID
+    WorkerComplete,   // tag = 成功，u32 = 错误码，a = 操作 ID
+    CoroutineSpawn,   // tag = 是否复用，a = 协程
+    CoroutineResume,  // tag = 参数个数，a = 协程
+    CoroutineReturn,  // tag = lua_resume 返回值，a = 协程
+    WaitRegister,     // u32 = 句柄数，a = 协程
+    TimerSchedule,    // a = 协程，b = 延迟 (毫秒)
+    Log,              // tag = 级别，size = 原消息长度，payload = 消息前 20 字节
+    Mark,             // 按需转储时写入的标记
+};
+
+enum class FlightDumpReason : uint32_t
+{
+    OnDemand,
+    Shutdown,
+    Crash,
+};
+
+// 安装崩溃处理并设置转储路径：path_stem + ".flight" (关闭 / 按需) 与 path_stem + ".crash.flight"
+void InstallFlightRecorder(const std::filesystem::path& path_stem);
+
+// 关闭时记录调用几乎没有开销；转储仍然可用
+void SetFlightRecorderEnabled(bool enabled);
+
+void FlightRecord(FlightEvent event, uint8_t tag, uint32_t u32, uint64_t a, uint64_t b = 0);
+
+// ticks 为调用方刚读过的 TraceNow() (同一时钟)：读时钟占单条记录开销的大半，
+// 完成路径 (工作执行、协程恢复) 本就为运行时指标读了时间，记录复用它而不再读一次
+void FlightRecordAt(uint64_t ticks, FlightEvent event, uint8_t tag, uint32_t u32, uint64_t a, uint64_t b = 0);
+
+// 只保存 text 的前 20 字节与原始长度
+void FlightRecordText(FlightEvent event, uint8_t tag, const char* text, size_t size);
+
+// path 为空时写入安装时的默认路径；返回实际路径，失败返回空
+std::filesystem::path DumpFlightRecorder(FlightDumpReason reason, const std::filesystem::path& path = {});
+
+// 按时间合并所有线程的记录；json 为 true 时每条记录输出一行 JSON
+bool DecodeFlightDump(const std::filesystem::path& path, bool json, std::ostream& out, std::string* error);
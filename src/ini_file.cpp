@@ -0,0 +1,58 @@
+#include "ini_file.h"
+
+#include <cstdlib>
+#include <fstream>
+
+namespace
+{
+    void Trim(std::string& s)
+    {
+        s.erase(0, s.find_first_not_of(" \t\r\n"));
+        s.erase(s.find_last_not_of(" \t\r\n") + 1);
+    }
+}  // namespace
+
+IniValues ReadIniFile(const std::filesystem::path& path)
+{
+    IniValues     values;
+    std::ifstream file(path);
+    std::string   line;
+    std::string   section;
+    while (std::getline(file, line))
+    {
+        size_t comment_pos = line.find(';');
+        if (comment_pos != std::string::npos) line.erase(comment_pos);
+        Trim(line);
+        if (line.empty()) continue;
+        if (line[0] == '[')
+        {
+            size_t end = line.find(']');
+            section    = line.substr(1, end == std::string::npos ? std::string::npos : end - 1);
+            Trim(section);
+            continue;
+        }
+        size_t equals_pos = line.find('=');
+        if (equals_pos == std::string::npos) continue;
+        std::string key   = line.substr(0, equals_pos);
+        std::string value = line.substr(equals_pos + 1);
+        Trim(key);
+        Trim(value);
+        values[section.empty() ? key : section + "." + key] = value;
+    }
+    return values;
+}
+
+std::string IniString(const IniValues& values, const std::string& key, const std::string& fallback)
+{
+    auto it = values.find(key);
+    return it == values.end() ? fallback : it->second;
+}
+
+int64_t IniInt(const IniValues& values, const std::string& key, int64_t fallback)
+{
+    auto it = values.find(key);
+    if (it == values.end() || it->second.empty()) return fallback;
+    char*   end   = nullptr;
+    int64_t value = std::strtoll(it->second.c_str(), &end, 10);
+    return *end == '\0' ? value : fallback;
+}
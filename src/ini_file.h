@@ -0,0 +1,17 @@
+#pragma once
+// config/*.ini 的最小解析：";" 起始注释，键名形如 "节.键"，首个节之前的键不带前缀。
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+using IniValues = std::unordered_map<std::string, std::string>;
+
+// 文件不存在或无法打开时返回空表
+IniValues ReadIniFile(const std::filesystem::path& path);
+
+std::string IniString(const IniValues& values, const std::string& key, const std::string& fallback);
+
+// 缺失或不是整数时返回 fallback
+int64_t IniInt(const IniValues& values, const std::string& key, int64_t fallback);
@@ -1,11 +1,29 @@
 #include "logging.h"
 
+#include "flight_recorder.h"
+#include "ini_file.h"
+#include "trace.h"
+
+#if defined(_WIN32)
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+#else
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
 #include <spdlog/async.h>
 #include <spdlog/pattern_formatter.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <filesystem>
@@ -20,12 +38,55 @@
 namespace
 {
     std::atomic<bool> g_shutdown_flag(false);
+    std::atomic<int>  g_active_level((int)spdlog::level::info);
+    std::atomic<int>  g_flight_level((int)spdlog::level::trace);
     std::thread       g_config_monitor_thread;
+#if defined(_WIN32)
     std::wstring      g_config_dir_wstr;
     HANDLE            g_hConfigDirHandle = INVALID_HANDLE_VALUE;
+#else
+    std::string       g_config_dir_str;
+    int               g_config_wake_fd = -1;
+#endif
 
     const char* PLAIN_LOG_PATTERN = "[%Y-%m-%d %H:%M:%S.%f] [pid:%P] [thread:%t] [%^%l%$] %v";
-    const char* JSON_LOG_PATTERN = R"({"timestamp":"%Y-%m-%d %H:%M:%S.%f","level":"%l","thread":%t,"pid":%P,"message":"%v"})";
+    // %* 为 JsonEscapedMessage，消息体中的引号、反斜杠与控制字符不会破坏 JSON 行
+    const char* JSON_LOG_PATTERN = R"({"timestamp":"%Y-%m-%d %H:%M:%S.%f","level":"%l","thread":%t,"pid":%P,"message":"%*"})";
+
+    class JsonEscapedMessage : public spdlog::custom_flag_formatter
+    {
+    public:
+        void format(const spdlog::details::log_msg& msg, const std::tm&, spdlog::memory_buf_t& dest) override
+        {
+            static const char* HEX = "0123456789abcdef";
+            const char* begin = msg.payload.data();
+            const char* end   = begin + msg.payload.size();
+            const char* run   = begin;  // 无需转义的连续片段整体追加
+            for (const char* p = begin; p != end; ++p)
+            {
+                unsigned char c = (unsigned char)*p;
+                if (c >= 0x20 && c != '"' && c != '\\') continue;
+                dest.append(run, p);
+                run = p + 1;
+                char escaped[6] = {'\\', 0, '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+                switch (c) {
+                case '"':  escaped[1] = '"'; break;
+                case '\\': escaped[1] = '\\'; break;
+                case '\n': escaped[1] = 'n'; break;
+                case '\r': escaped[1] = 'r'; break;
+                case '\t': escaped[1] = 't'; break;
+                default:   escaped[1] = 'u'; break;
+                }
+                dest.append(escaped, escaped + (escaped[1] == 'u' ? 6 : 2));
+            }
+            dest.append(run, end);
+        }
+
+        std::unique_ptr<custom_flag_formatter> clone() const override
+        {
+            return std::make_unique<JsonEscapedMessage>();
+        }
+    };
 
     spdlog::level::level_enum level_from_string(const std::string& level_str)
     {
@@ -40,37 +101,26 @@ namespace
 
     void apply_log_settings(const std::filesystem::path& config_path)
     {
-        std::string level_str  = "info";
-        std::string format_str = "plain";
+        // 兼容不带 [Logging] 节的旧配置
+        IniValues   config     = ReadIniFile(config_path);
+        std::string level_str  = IniString(config, "Logging.level", IniString(config, "level", "info"));
+        std::string format_str = IniString(config, "Logging.format", IniString(config, "format", "plain"));
 
-        std::ifstream config_file(config_path);
-        if (config_file.is_open())
-        {
-            std::string line;
-            while (std::getline(config_file, line))
-            {
-                size_t comment_pos = line.find(';');
-                if (comment_pos != std::string::npos) line = line.substr(0, comment_pos);
-                line.erase(0, line.find_first_not_of(" \t\r\n"));
-                line.erase(line.find_last_not_of(" \t\r\n") + 1);
-                if (line.empty() || line[0] == '[') continue;
-                size_t equals_pos = line.find('=');
-                if (equals_pos != std::string::npos) {
-                    std::string key = line.substr(0, equals_pos);
-                    key.erase(key.find_last_not_of(" \t") + 1);
-                    std::string value = line.substr(equals_pos + 1);
-                    value.erase(0, value.find_first_not_of(" \t"));
-                    if (key == "level") level_str = value;
-                    else if (key == "format") format_str = value;
-                }
-            }
-        }
+        // 飞行记录器只进内存，默认捕获全部级别；与输出级别分开配置
+        std::string flight_str   = IniString(config, "FlightRecorder.level", "trace");
+        bool        flight_on    = IniInt(config, "FlightRecorder.enabled", 1) != 0;
+        auto        flight_level = flight_on ? level_from_string(flight_str) : spdlog::level::off;
+        SetFlightRecorderEnabled(flight_on);
 
         auto level = level_from_string(level_str);
         spdlog::apply_all([&](std::shared_ptr<spdlog::logger> l) { l->set_level(level); });
+        g_flight_level.store((int)flight_level, std::memory_order_relaxed);
+        g_active_level.store(std::min((int)level, (int)flight_level), std::memory_order_relaxed);
 
         if (format_str == "json") {
-            spdlog::default_logger()->set_formatter(std::make_unique<spdlog::pattern_formatter>(JSON_LOG_PATTERN, spdlog::pattern_time_type::local));
+            auto formatter = std::make_unique<spdlog::pattern_formatter>();
+            formatter->add_flag<JsonEscapedMessage>('*').set_pattern(JSON_LOG_PATTERN);
+            spdlog::default_logger()->set_formatter(std::move(formatter));
         } else {
             spdlog::default_logger()->set_formatter(std::make_unique<spdlog::pattern_formatter>(PLAIN_LOG_PATTERN, spdlog::pattern_time_type::local));
         }
@@ -80,6 +130,7 @@ namespace
         }
     }
 
+#if defined(_WIN32)
     void monitor_config_thread_func(std::filesystem::path config_path)
     {
         g_hConfigDirHandle = CreateFileW(g_config_dir_wstr.c_str(), FILE_LIST_DIRECTORY,
@@ -116,16 +167,52 @@ namespace
         g_hConfigDirHandle = INVALID_HANDLE_VALUE;
         spdlog::trace("Config monitor thread shut down.");
     }
+#else
+    void monitor_config_thread_func(std::filesystem::path config_path)
+    {
+        int inotify_fd = inotify_init1(IN_CLOEXEC);
+        if (inotify_fd < 0 || inotify_add_watch(inotify_fd, g_config_dir_str.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+            spdlog::error("Failed to watch config dir. Error: {}", errno);
+            if (inotify_fd >= 0) close(inotify_fd);
+            return;
+        }
+
+        char buffer[4096];
+        while (!g_shutdown_flag)
+        {
+            pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {g_config_wake_fd, POLLIN, 0}};
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (g_shutdown_flag || (fds[1].revents & POLLIN)) break;
+            if (fds[0].revents & POLLIN) {
+                (void)!read(inotify_fd, buffer, sizeof(buffer));
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                spdlog::info("Config change detected, reloading...");
+                apply_log_settings(config_path);
+            }
+        }
+        close(inotify_fd);
+        spdlog::trace("Config monitor thread shut down.");
+    }
+#endif
 }
 
-void InitializeLogger(const std::string& package_root_dir, DWORD pid, int argc, char* argv[])
+void InitializeLogger(const std::string& package_root_dir, unsigned long pid, int argc, char* argv[])
 {
+    PESH_TRACE_SCOPE("InitializeLogger", TraceCategory::Boot);
     try
     {
         std::filesystem::path config_dir = std::filesystem::path(package_root_dir) / "config";
         std::filesystem::create_directories(config_dir);
         std::filesystem::path config_path = config_dir / "logging.ini";
+#if defined(_WIN32)
         g_config_dir_wstr = config_path.parent_path().wstring();
+#else
+        g_config_dir_str = config_path.parent_path().string();
+        g_config_wake_fd = eventfd(0, EFD_CLOEXEC);
+#endif
 
         auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
         auto placeholder_logger = std::make_shared<spdlog::logger>("placeholder", console_sink);
@@ -134,7 +221,14 @@ void InitializeLogger(const std::string& package_root_dir, DWORD pid, int argc,
         if (!std::filesystem::exists(config_path)) {
             std::ofstream default_config(config_path);
             if (default_config.is_open()) {
-                default_config << "[Logging]\nlevel = info\nformat = plain\n";
+                default_config << "[Logging]\nlevel = info\nformat = plain\n\n"
+                                  "[FlightRecorder]\n"
+                                  "; 内存环形缓冲区，崩溃或退出时转储到 logs/*.flight；level 独立于上面的输出级别\n"
+                                  "enabled = 1\nlevel = trace\n\n"
+                                  "[Trace]\n"
+                                  "; 退出时写出 Chrome trace JSON (ui.perfetto.dev 打开)；也可用命令行 peshell --trace[=path] <命令> 临时开启\n"
+                                  "; path 相对于安装目录，留空为 logs/peshell_<pid>_<时间>.trace.json\n"
+                                  "enabled = 0\npath =\n";
             }
         }
 
@@ -146,13 +240,26 @@ void InitializeLogger(const std::string& package_root_dir, DWORD pid, int argc,
         auto in_time_t = std::chrono::system_clock::to_time_t(now);
         std::stringstream timestamp_ss;
         tm tm_buf;
+#if defined(_WIN32)
         localtime_s(&tm_buf, &in_time_t);
+#else
+        localtime_r(&in_time_t, &tm_buf);
+#endif
         timestamp_ss << std::put_time(&tm_buf, "%Y%m%d%H%M%S");
 
         std::filesystem::path log_dir = std::filesystem::path(package_root_dir) / "logs";
         std::filesystem::create_directories(log_dir);
         std::string log_filename = fmt::format("peshell_{}_{}.log", pid, timestamp_ss.str());
         std::filesystem::path file_path = log_dir / log_filename;
+        std::filesystem::path session_stem = log_dir / fmt::format("peshell_{}_{}", pid, timestamp_ss.str());
+        InstallFlightRecorder(session_stem);
+        {
+            IniValues   config     = ReadIniFile(config_path);
+            std::string trace_path = IniString(config, "Trace.path", "");
+            ConfigureTracing(IniInt(config, "Trace.enabled", 0) != 0,
+                             trace_path.empty() ? std::filesystem::path(session_stem.string() + ".trace.json")
+                                                : std::filesystem::path(package_root_dir) / trace_path);
+        }
 
         auto rotating_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(file_path.string(), 5 * 1024 * 1024, 10);
         sinks.push_back(rotating_sink);
@@ -179,7 +286,34 @@ void ShutdownLogger()
 {
     spdlog::info("Logger shutdown requested.");
     g_shutdown_flag = true;
+#if defined(_WIN32)
     if (g_hConfigDirHandle != INVALID_HANDLE_VALUE) CancelIoEx(g_hConfigDirHandle, NULL);
+#else
+    if (g_config_wake_fd >= 0) {
+        uint64_t one = 1;
+        (void)!write(g_config_wake_fd, &one, sizeof(one));
+    }
+#endif
     if (g_config_monitor_thread.joinable()) g_config_monitor_thread.join();
+    std::filesystem::path flight_path = DumpFlightRecorder(FlightDumpReason::Shutdown);
+    if (!flight_path.empty()) spdlog::debug("Flight recorder dumped to {}", flight_path.string());
+    std::string           trace_error;
+    std::filesystem::path trace_path = WriteTrace(&trace_error);
+    if (!trace_path.empty()) spdlog::info("Trace written to {}", trace_path.string());
+    else if (!trace_error.empty()) spdlog::warn("Failed to write trace: {}", trace_error);
+#if !defined(_WIN32)
+    if (g_config_wake_fd >= 0) close(g_config_wake_fd);
+    g_config_wake_fd = -1;
+#endif
     spdlog::shutdown();
-}
\ No newline at end of file
+}
+
+const std::atomic<int>* ActiveLogLevel()
+{
+    return &g_active_level;
+}
+
+int FlightLogLevel()
+{
+    return g_flight_level.load(std::memory_order_relaxed);
+}
@@ -1,9 +1,13 @@
 #pragma once
+#include <atomic>
 #include <string>
 
-#if defined(_WIN32)
-#include <windows.h>
-#endif
+void InitializeLogger(const std::string& package_root_dir, unsigned long pid, int argc, char* argv[]);
+void ShutdownLogger();
 
-void InitializeLogger(const std::string& package_root_dir, DWORD pid, int argc, char* argv[]);
-void ShutdownLogger();
\ No newline at end of file
+// 当前生效的最低日志级别 (spdlog::level::level_enum 的数值)：输出级别与飞行记录器级别中较低者，
+// 随 config/logging.ini 热更新。Lua 通过 FFI 直接读取它，两者都不需要的调用不进入原生层。
+const std::atomic<int>* ActiveLogLevel();
+
+// 飞行记录器捕获日志调用的最低级别，关闭时为 spdlog::level::off
+int FlightLogLevel();
@@ -0,0 +1,350 @@
+#include "lua_workers.h"
+
+#include "trace.h"
+
+#include <lua.hpp>
+#include <spdlog/spdlog.h>
+
+#ifndef LUA_TCDATA
+#define LUA_TCDATA 10
+#endif
+
+namespace
+{
+    constexpr int kMaxDepth = 32;
+
+    // 注册表中的键：共享缓冲区包装函数、字节码 -> 函数的缓存
+    char kSharedWrapperKey;
+    char kChunkCacheKey;
+
+    int AbsIndex(lua_State* L, int idx)
+    {
+        return (idx < 0 && idx > LUA_REGISTRYINDEX) ? lua_gettop(L) + idx + 1 : idx;
+    }
+
+    // 栈顶的错误对象；error({}) 之类的非字符串错误没有文本
+    std::string ErrorText(lua_State* L)
+    {
+        const char* message = lua_tostring(L, -1);
+        return message ? message : "(non-string error)";
+    }
+}  // namespace
+
+LuaMessage::~LuaMessage()
+{
+    Reset();
+}
+
+LuaMessage::LuaMessage(LuaMessage&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+LuaMessage& LuaMessage::operator=(LuaMessage&& other) noexcept
+{
+    if (this == &other) return *this;
+    Reset();
+    type_         = other.type_;
+    boolean_      = other.boolean_;
+    number_       = other.number_;
+    string_       = std::move(other.string_);
+    shared_       = other.shared_;
+    table_        = std::move(other.table_);
+    other.type_   = Type::Nil;
+    other.shared_ = nullptr;
+    return *this;
+}
+
+void LuaMessage::Reset()
+{
+    if (shared_) shared_->release(shared_);
+    shared_ = nullptr;
+    type_   = Type::Nil;
+    string_.clear();
+    table_.clear();
+}
+
+bool LuaMessage::FromLua(lua_State* L, int idx, LuaMessage* out, std::string* error)
+{
+    out->Reset();
+    return out->Copy(L, AbsIndex(L, idx), 0, error);
+}
+
+bool LuaMessage::Copy(lua_State* L, int idx, int depth, std::string* error)
+{
+    switch (lua_type(L, idx))
+    {
+    case LUA_TNIL: type_ = Type::Nil; return true;
+    case LUA_TBOOLEAN:
+        type_    = Type::Boolean;
+        boolean_ = lua_toboolean(L, idx) != 0;
+        return true;
+    case LUA_TNUMBER:
+        type_   = Type::Number;
+        number_ = lua_tonumber(L, idx);
+        return true;
+    case LUA_TSTRING:
+    {
+        size_t      len = 0;
+        const char* str = lua_tolstring(L, idx, &len);
+        type_           = Type::String;
+        string_.assign(str, len);
+        return true;
+    }
+    case LUA_TCDATA:
+    {
+        // 指针类 cdata 的负载就是指针本身；只接受仍存活的共享缓冲区
+        void* ptr = *static_cast<void* const*>(lua_topointer(L, idx));
+        if (!ptr || !IsSharedBuffer(ptr))
+        {
+            *error = "only shared buffers (parallel.buffer) can be sent as cdata";
+            return false;
+        }
+        type_   = Type::Shared;
+        shared_ = static_cast<pesh_shared*>(ptr);
+        shared_->retain(shared_);
+        return true;
+    }
+    case LUA_TTABLE:
+    {
+        if (depth >= kMaxDepth)
+        {
+            *error = "table nested too deeply (cycles cannot be sent)";
+            return false;
+        }
+        type_ = Type::Table;
+        // 也在工作线程上的保护调用之外执行，不能用会抛出 Lua 错误的 luaL_checkstack
+        if (!lua_checkstack(L, 2))
+        {
+            *error = "Lua stack overflow";
+            return false;
+        }
+        lua_pushnil(L);
+        while (lua_next(L, idx) != 0)
+        {
+            LuaMessage key, value;
+            if (!key.Copy(L, lua_gettop(L) - 1, depth + 1, error) || !value.Copy(L, lua_gettop(L), depth + 1, error))
+            {
+                lua_pop(L, 2);
+                return false;
+            }
+            table_.emplace_back(std::move(key), std::move(value));
+            lua_pop(L, 1);
+        }
+        return true;
+    }
+    default:
+        *error = std::string("cannot send a ") + luaL_typename(L, idx) + " to another Lua state";
+        return false;
+    }
+}
+
+void LuaMessage::Push(lua_State* L, bool borrow) const
+{
+    switch (type_)
+    {
+    case Type::Boolean: lua_pushboolean(L, boolean_); break;
+    case Type::Number: lua_pushnumber(L, number_); break;
+    case Type::String: lua_pushlstring(L, string_.data(), string_.size()); break;
+    case Type::Shared:
+        lua_pushlightuserdata(L, &kSharedWrapperKey);
+        lua_rawget(L, LUA_REGISTRYINDEX);
+        if (!lua_isfunction(L, -1))
+        {
+            // 没有包装函数就无法让对方的 GC 释放引用，宁可不交付
+            lua_pop(L, 1);
+            lua_pushnil(L);
+            break;
+        }
+        // 借用时引用仍归本消息所有，cdata 不挂 GC 释放；否则为新的 cdata 增加一个引用
+        if (!borrow) shared_->retain(shared_);
+        lua_pushlightuserdata(L, shared_);
+        lua_pushboolean(L, borrow);
+        lua_call(L, 2, 1);
+        break;
+    case Type::Table:
+        lua_checkstack(L, 3);  // 深度已由 kMaxDepth 限制
+        lua_createtable(L, 0, (int)table_.size());
+        for (const auto& entry : table_)
+        {
+            entry.first.Push(L, borrow);
+            entry.second.Push(L, borrow);
+            lua_rawset(L, -3);
+        }
+        break;
+    default: lua_pushnil(L); break;
+    }
+}
+
+void LuaMessage::SetSharedWrapper(lua_State* L)
+{
+    lua_pushlightuserdata(L, &kSharedWrapperKey);
+    lua_insert(L, -2);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+}
+
+LuaWorkerPool::LuaWorkerPool(StateFactory factory, Executor executor, size_t max_states)
+    : factory_(std::move(factory)), executor_(std::move(executor)), max_states_(max_states ? max_states : 1)
+{
+}
+
+LuaWorkerPool::~LuaWorkerPool()
+{
+    for (lua_State* L : idle_) lua_close(L);
+    for (LuaJob& job : queue_) job.complete(false, LuaMessage(), "Lua worker pool stopped");
+}
+
+void LuaWorkerPool::Submit(LuaJob job)
+{
+    bool spawn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(job));
+        spawn = runners_ < max_states_;
+        if (spawn) ++runners_;
+    }
+    if (spawn) executor_([this] { RunOne(); });
+}
+
+LuaWorkerPool::Stats LuaWorkerPool::GetStats() const
+{
+    Stats                       stats;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.states    = states_;
+    stats.idle      = idle_.size();
+    stats.queued    = queue_.size();
+    stats.completed = completed_.load(std::memory_order_relaxed);
+    stats.failed    = failed_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void LuaWorkerPool::RunOne()
+{
+    LuaJob     job;
+    lua_State* L = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty())
+        {
+            --runners_;
+            return;
+        }
+        job = std::move(queue_.front());
+        queue_.pop_front();
+        // 每个执行中的 RunOne 至多持有一个状态，状态数因此不超过 max_states_
+        if (!idle_.empty())
+        {
+            L = idle_.back();
+            idle_.pop_back();
+        }
+        else
+        {
+            ++states_;
+        }
+    }
+
+    if (!L)
+    {
+        PESH_TRACE_SCOPE("lua state", TraceCategory::Worker);
+        std::string error;
+        L = factory_(&error);
+        if (!L)
+        {
+            spdlog::error("Lua worker state creation failed: {}", error);
+            failed_.fetch_add(1, std::memory_order_relaxed);
+            job.complete(false, LuaMessage(), "Lua worker state creation failed: " + error);
+        }
+    }
+    if (L) Run(L, job);
+
+    bool again;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (L) idle_.push_back(L);
+        else --states_;
+        again = !queue_.empty();
+        if (!again) --runners_;
+    }
+    if (again) executor_([this] { RunOne(); });
+}
+
+void LuaWorkerPool::Run(lua_State* L, LuaJob& job)
+{
+    PESH_TRACE_SCOPE("lua job", TraceCategory::Worker);
+    lua_settop(L, 0);
+    lua_getglobal(L, "debug");
+    lua_getfield(L, -1, "traceback");
+    lua_remove(L, -2);
+    const int traceback = 1;
+
+    std::string error;
+    if (job.name.empty())
+    {
+        // 同一函数的字节码每次相同，按字节码缓存加载结果
+        lua_pushlightuserdata(L, &kChunkCacheKey);
+        lua_rawget(L, LUA_REGISTRYINDEX);
+        if (lua_isnil(L, -1))
+        {
+            lua_pop(L, 1);
+            lua_newtable(L);
+            lua_pushlightuserdata(L, &kChunkCacheKey);
+            lua_pushvalue(L, -2);
+            lua_rawset(L, LUA_REGISTRYINDEX);
+        }
+        lua_pushlstring(L, job.target.data(), job.target.size());
+        lua_rawget(L, -2);
+        if (lua_isnil(L, -1))
+        {
+            lua_pop(L, 1);
+            if (luaL_loadbuffer(L, job.target.data(), job.target.size(), "=parallel") != 0)
+            {
+                error = ErrorText(L);
+            }
+            else
+            {
+                lua_pushlstring(L, job.target.data(), job.target.size());
+                lua_pushvalue(L, -2);
+                lua_rawset(L, -4);
+            }
+        }
+        lua_remove(L, -2);  // 缓存表
+    }
+    else
+    {
+        lua_getglobal(L, "require");
+        lua_pushlstring(L, job.target.data(), job.target.size());
+        if (lua_pcall(L, 1, 1, traceback) != 0)
+        {
+            error = ErrorText(L);
+        }
+        else
+        {
+            if (lua_istable(L, -1)) lua_getfield(L, -1, job.name.c_str());
+            else lua_pushnil(L);
+            lua_remove(L, -2);
+            if (!lua_isfunction(L, -1)) error = "module '" + job.target + "' has no function '" + job.name + "'";
+        }
+    }
+
+    LuaMessage result;
+    bool       ok = error.empty();
+    if (ok)
+    {
+        lua_checkstack(L, (int)job.args.size() + 1);
+        for (const LuaMessage& arg : job.args) arg.Push(L, true);
+        if (lua_pcall(L, (int)job.args.size(), 1, traceback) != 0)
+        {
+            error = ErrorText(L);
+            ok    = false;
+        }
+        else
+        {
+            ok = LuaMessage::FromLua(L, -1, &result, &error);
+        }
+    }
+    lua_settop(L, 0);
+    job.args.clear();  // 借出的共享缓冲区到此失效
+
+    (ok ? completed_ : failed_).fetch_add(1, std::memory_order_relaxed);
+    job.complete(ok, std::move(result), std::move(error));
+}
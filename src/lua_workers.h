@@ -0,0 +1,118 @@
+#pragma once
+// 并行 Lua 工作者：若干相互隔离的 lua_State 在线程池 CPU 通道上执行 CPU 密集的脚本任务。
+//   - 状态由宿主提供的工厂创建 (同一份 prelude 与 package.path)，与主状态及彼此之间不共享全局变量
+//   - 状态按需创建，最多 max_states 个；空闲状态保留复用，模块经 require 缓存在各自的状态中
+//   - 每个线程池任务只执行一个作业，之后把状态还回空闲表，排队作业再另行提交，不长期占住池线程
+//   - 参数与结果以 LuaMessage 在状态间复制 (nil/布尔/数值/字符串/表)；共享缓冲区 (src/shared_buffer.h)
+//     只传引用，不复制内容。作业参数中的缓冲区借给工作者到作业结束，作为结果返回的则交给主状态的 GC
+// 作业的提交与 LuaMessage 的构造 / 压栈都在拥有对应状态的线程上进行；LuaWorkerPool 本身线程安全。
+
+#include "shared_buffer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct lua_State;
+
+// 与状态无关的 Lua 值树。持有其中共享缓冲区的各一个引用
+class LuaMessage
+{
+public:
+    LuaMessage() = default;
+    ~LuaMessage();
+
+    LuaMessage(LuaMessage&& other) noexcept;
+    LuaMessage& operator=(LuaMessage&& other) noexcept;
+    LuaMessage(const LuaMessage&)            = delete;
+    LuaMessage& operator=(const LuaMessage&) = delete;
+
+    // 复制 L 栈上 idx 处的值；函数、协程、其他 cdata 或嵌套过深时返回 false 并写入 error
+    static bool FromLua(lua_State* L, int idx, LuaMessage* out, std::string* error);
+
+    // 在 L 上压入恰好一个值；共享缓冲区经 SetSharedWrapper 登记的函数包装为 cdata (未登记时为 nil)。
+    // borrow 为 true 时 cdata 只在本消息存活期间有效 (作业参数)，不经对方 GC，也就不必在作业后强制回收
+    void Push(lua_State* L, bool borrow = false) const;
+
+    // 栈顶的函数 fn(lightuserdata, borrowed) -> cdata 登记为 L 的包装函数并弹出；
+    // borrowed 为 false 时 cdata 已持有一个引用，应挂上 GC 释放
+    static void SetSharedWrapper(lua_State* L);
+
+private:
+    enum class Type : uint8_t
+    {
+        Nil,
+        Boolean,
+        Number,
+        String,
+        Shared,
+        Table,
+    };
+
+    bool Copy(lua_State* L, int idx, int depth, std::string* error);
+    void Reset();
+
+    Type                                           type_    = Type::Nil;
+    bool                                           boolean_ = false;
+    double                                         number_  = 0;
+    std::string                                    string_;
+    pesh_shared*                                   shared_  = nullptr;
+    std::vector<std::pair<LuaMessage, LuaMessage>> table_;
+};
+
+struct LuaJob
+{
+    std::string             target;  // 模块名；name 为空时为 string.dump 得到的字节码
+    std::string             name;    // 模块中的函数名
+    std::vector<LuaMessage> args;
+    // 在工作线程上调用一次；失败时 error 含 Lua 调用栈
+    std::function<void(bool ok, LuaMessage result, std::string error)> complete;
+};
+
+class LuaWorkerPool
+{
+public:
+    using StateFactory = std::function<lua_State*(std::string* error)>;
+    using Executor     = std::function<void(std::function<void()>)>;
+
+    struct Stats
+    {
+        size_t   states    = 0;  // 已创建的状态 (含执行中)
+        size_t   idle      = 0;
+        size_t   queued    = 0;
+        uint64_t completed = 0;
+        uint64_t failed    = 0;
+    };
+
+    LuaWorkerPool(StateFactory factory, Executor executor, size_t max_states);
+    ~LuaWorkerPool();  // 须在执行器停止之后；关闭空闲状态，丢弃仍在排队的作业
+
+    LuaWorkerPool(const LuaWorkerPool&)            = delete;
+    LuaWorkerPool& operator=(const LuaWorkerPool&) = delete;
+
+    void Submit(LuaJob job);
+
+    Stats GetStats() const;
+
+private:
+    void RunOne();
+    void Run(lua_State* L, LuaJob& job);
+
+    StateFactory factory_;
+    Executor     executor_;
+    size_t       max_states_;
+
+    mutable std::mutex      mutex_;
+    std::deque<LuaJob>      queue_;
+    std::vector<lua_State*> idle_;
+    size_t                  states_  = 0;
+    size_t                  runners_ = 0;  // 已提交到执行器、尚未结束的 RunOne
+    std::atomic<uint64_t>   completed_{0};
+    std::atomic<uint64_t>   failed_{0};
+};
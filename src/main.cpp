@@ -1,221 +1,1497 @@
+#include "bytecode_bundle.h"
+#include "command_channel.h"
+#include "file_buffer.h"
+#include "flight_recorder.h"
+#include "ini_file.h"
 #include "logging.h"
+#include "lua_workers.h"
+#include "process_pipe.h"
+#include "process_table.h"
+#include "runtime_metrics.h"
+#include "scheduler.h"
+#include "shared_buffer.h"
+#include "stats_server.h"
+#include "supervisor.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "tree_copy.h"
+#include "tree_scan.h"
+#include "worker_registry.h"
+#include "write_behind.h"
 
+#if defined(_WIN32)
 // clang-format off
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include <shellapi.h>
 #include <timeapi.h>
 // clang-format on
+#else
+#include <poll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
 
-#include <ctpl_stl.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
 #include <filesystem>
-#include <fstream> 
+#include <fstream>
 #include <iostream>
 #include <lua.hpp>
 #include <map>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
-#ifndef LUA_TCDATA
-#define LUA_TCDATA 10
-#endif
+#ifndef LUA_TCDATA
+#define LUA_TCDATA 10
+#endif
+
+#if defined(LUA_JITLIBNAME) && defined(OPENRESTY_LUAJIT)
+#define HAVE_LUA_RESETTHREAD 1
+#endif
+
+std::unique_ptr<Scheduler>  g_scheduler;
+std::unique_ptr<ThreadPool> g_thread_pool;
+std::unique_ptr<ProcessTable> g_process_table;  // 首次使用时创建，不用进程表的命令不启动服务线程
+std::unique_ptr<PipeReactor> g_pipe_reactor;  // 首个 pipe_spawn 时创建
+std::unique_ptr<WriteBehind> g_write_behind;  // 首个合并写入请求时创建
+std::unordered_set<std::shared_ptr<Supervisor>*> g_supervisors;  // 未 close 的监督器句柄 (userdata 内)，退出时先于调度器清空
+std::unique_ptr<BytecodeBundle> g_bundle;  // bin/peshell.bundle，缺失或 PESHELL_BUNDLE=0 时为空
+std::unique_ptr<LuaWorkerPool> g_lua_workers;  // 并行 Lua 工作者状态，首个作业时才创建状态
+std::unique_ptr<CommandServer> g_command_server;  // main 模式下接收其他 peshell 进程转发来的命令
+
+// 转发来的命令：服务线程放入，主线程上的 remote 插件经 command_next 逐个取出执行，再以 command_reply 应答
+struct CommandInbox
+{
+    std::mutex                                         mutex;
+    std::deque<std::pair<uint64_t, CommandRequest>>    queue;
+    std::unordered_map<uint64_t, CommandServer::Reply> replies;
+    lua_State*                                         waiter  = nullptr;
+    uint64_t                                           next_id = 0;
+};
+static CommandInbox g_command_inbox;
+
+lua_State* InitializeLuaState(const std::string& package_root_dir);
+
+#if defined(_WIN32)
+std::wstring Utf8ToWide(const std::string& str);
+
+static std::filesystem::path Utf8Path(const std::string& str)
+{
+    return std::filesystem::path(Utf8ToWide(str));
+}
+#else
+static std::filesystem::path Utf8Path(const std::string& str)
+{
+    return std::filesystem::path(str);
+}
+#endif
+
+static void PostCompletion(lua_State* co, bool success, std::string data, std::string error_msg)
+{
+    g_scheduler->PostCompletion(co, success, std::move(data), std::move(error_msg));
+}
+
+namespace LuaBindings
+{
+    // Lua 端的 struct { void* h; }；Linux 上 h 中存放的是 fd
+    struct SafeHandle { void* h; };
+
+    static WaitHandle ToWaitHandle(void* h)
+    {
+#if defined(_WIN32)
+        return h;
+#else
+        return (WaitHandle)(intptr_t)h;
+#endif
+    }
+
+    static void CollectHandles(lua_State* L, int table_idx, std::vector<WaitHandle>& handles)
+    {
+        lua_pushnil(L);
+        while (lua_next(L, table_idx) != 0) {
+            if (lua_type(L, -1) == LUA_TCDATA) {
+                auto* handle_obj = static_cast<SafeHandle*>(const_cast<void*>(lua_topointer(L, -1)));
+                if (handle_obj && handle_obj->h) handles.push_back(ToWaitHandle(handle_obj->h));
+            }
+            lua_pop(L, 1);
+        }
+    }
+
+    static int pesh_sleep(lua_State* L)
+    {
+        int duration_ms = (int)luaL_checkinteger(L, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+        return 0;
+    }
+
+    // 工作者结果 -> 恰好一个 Lua 值 (Buffer 走 PostBuffer，不经过这里)
+    static void PushWorkerValue(lua_State* L, const WorkerValue& v)
+    {
+        switch (v.type) {
+        case WorkerValueType::Boolean: lua_pushboolean(L, v.boolean); break;
+        case WorkerValueType::Integer: lua_pushinteger(L, (lua_Integer)v.integer); break;
+        case WorkerValueType::Number:  lua_pushnumber(L, v.number); break;
+        case WorkerValueType::String:  lua_pushlstring(L, v.string.data(), v.string.size()); break;
+        case WorkerValueType::Numbers:
+            lua_createtable(L, (int)v.numbers.size(), 0);
+            for (size_t i = 0; i < v.numbers.size(); ++i) { lua_pushnumber(L, v.numbers[i]); lua_rawseti(L, -2, (int)i + 1); }
+            break;
+        case WorkerValueType::Buffer:  lua_pushlightuserdata(L, v.buffer); break;
+        case WorkerValueType::Pointer: lua_pushlightuserdata(L, v.pointer); break;
+        default: lua_pushnil(L); break;
+        }
+    }
+
+    // 按签名一次性把 Lua 参数转换为 WorkerArgs，类型不符时抛出参数错误
+    static WorkerArgs CheckWorkerArgs(lua_State* L, int first, const std::vector<WorkerValueType>& signature)
+    {
+        WorkerArgs args(signature.size());
+        for (size_t i = 0; i < signature.size(); ++i) {
+            int idx = first + (int)i;
+            args[i].type = signature[i];
+            switch (signature[i]) {
+            case WorkerValueType::Boolean: args[i].boolean = lua_toboolean(L, idx) != 0; break;
+            case WorkerValueType::Integer: args[i].integer = (int64_t)luaL_checkinteger(L, idx); break;
+            case WorkerValueType::Number:  args[i].number = luaL_checknumber(L, idx); break;
+            case WorkerValueType::String: {
+                size_t len = 0;
+                const char* str = luaL_checklstring(L, idx, &len);
+                args[i].string.assign(str, len);
+                break;
+            }
+            case WorkerValueType::Numbers:
+                luaL_checktype(L, idx, LUA_TTABLE);
+                for (int n = 1, count = (int)lua_objlen(L, idx); n <= count; ++n) {
+                    lua_rawgeti(L, idx, n);
+                    args[i].numbers.push_back(lua_tonumber(L, -1));
+                    lua_pop(L, 1);
+                }
+                break;
+            case WorkerValueType::Buffer:
+            case WorkerValueType::Pointer:
+                if (!lua_islightuserdata(L, idx)) luaL_argerror(L, idx, "lightuserdata expected");
+                args[i].pointer = lua_touserdata(L, idx);
+                args[i].buffer  = static_cast<pesh_buffer*>(args[i].pointer);
+                break;
+            default: break;
+            }
+        }
+        return args;
+    }
+
+    // 名称 -> 整数 id，Lua 端解析一次后缓存；未知名称直接报错，而不是留下永远等不到完成的协程
+    static int pesh_worker_id(lua_State* L)
+    {
+        const char* name = luaL_checkstring(L, 1);
+        int id = WorkerRegistry::Instance().Find(name);
+        if (id < 0) return luaL_error(L, "Unknown worker '%s'", name);
+        lua_pushinteger(L, id);
+        return 1;
+    }
+
+    // dispatch(co, id, priority, ...)：返回操作 id，可传给 cancel_worker；完成时以 (true, value) 或 (false, msg, code) 恢复 co
+    static int pesh_dispatch(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_argerror(L, 1, "coroutine expected");
+        int id = (int)luaL_checkinteger(L, 2);
+        int priority = (int)luaL_optinteger(L, 3, 0);
+        const std::vector<WorkerValueType>* signature = WorkerRegistry::Instance().Signature(id);
+        if (!signature) return luaL_argerror(L, 2, "unknown worker id");
+
+        WorkerArgs args = CheckWorkerArgs(L, 4, *signature);
+        g_scheduler->Anchor(L, 1);
+        lua_pushinteger(L, (lua_Integer)WorkerRegistry::Instance().Dispatch(id, std::move(args), priority, co));
+        return 1;
+    }
+
+    static int pesh_cancel_worker(lua_State* L)
+    {
+        lua_pushboolean(L, WorkerRegistry::Instance().Cancel((uint64_t)luaL_checkinteger(L, 1)));
+        return 1;
+    }
+
+    // 旧接口 dispatch_worker("xxx_worker", args..., co)，按名称解析后走注册表
+    static int pesh_dispatch_worker(lua_State* L)
+    {
+        std::string name(luaL_checkstring(L, 1));
+        const std::string suffix = "_worker";
+        if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+            name.resize(name.size() - suffix.size());
+
+        int id = WorkerRegistry::Instance().Find(name);
+        if (id < 0) return luaL_error(L, "Unknown worker '%s'", name.c_str());
+        const std::vector<WorkerValueType>* signature = WorkerRegistry::Instance().Signature(id);
+        int co_idx = 2 + (int)signature->size();
+        lua_State* co = lua_tothread(L, co_idx);
+        if (!co) return luaL_argerror(L, co_idx, "coroutine expected");
+
+        WorkerArgs args = CheckWorkerArgs(L, 2, *signature);
+        g_scheduler->Anchor(L, co_idx);
+        lua_pushinteger(L, (lua_Integer)WorkerRegistry::Instance().Dispatch(id, std::move(args), 0, co));
+        return 1;
+    }
+
+    static int pesh_wait_for_multiple_objects_async(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
+        if (!lua_istable(L, 2)) return luaL_error(L, "Arg 2 must be a table of FFI SafeHandles");
+
+        std::vector<WaitHandle> handles;
+        CollectHandles(L, 2, handles);
+        g_scheduler->Anchor(L, 1);
+
+        // 调用方协程此时仍在运行，失败结果经完成队列在它 yield 之后送达
+        if (handles.empty()) {
+            PostCompletion(co, false, "", "No valid handles provided.");
+            return 0;
+        }
+
+        std::string error;
+        if (!g_scheduler->WaitAsync(co, handles, &error)) PostCompletion(co, false, "", "Wait registration failed: " + error);
+        return 0;
+    }
+
+    // wait_for_multiple_objects_blocking(handles, [timeout_ms], [pump])
+    // pump 为真时等待期间继续分发本线程的窗口消息 (取代 sleep_pump 轮询)，Linux 上忽略
+    static int pesh_wait_for_multiple_objects_blocking(lua_State* L)
+    {
+        if (!lua_istable(L, 1)) return luaL_error(L, "Arg 1 must be table");
+        int timeout_ms = (int)luaL_optinteger(L, 2, -1);
+        bool pump = lua_toboolean(L, 3) != 0;
+
+        std::vector<WaitHandle> handles;
+        CollectHandles(L, 1, handles);
+
+        if (handles.empty()) { lua_pushnil(L); lua_pushstring(L, "No handles"); return 2; }
+
+#if defined(_WIN32)
+        DWORD count = (DWORD)handles.size();
+        DWORD res;
+        if (pump) {
+            ULONGLONG deadline = GetTickCount64() + (ULONGLONG)std::max(timeout_ms, 0);
+            while (true) {
+                ULONGLONG now = GetTickCount64();
+                DWORD wait = timeout_ms < 0 ? INFINITE : (DWORD)(deadline > now ? deadline - now : 0);
+                res = MsgWaitForMultipleObjectsEx(count, handles.data(), wait, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+                if (res != WAIT_OBJECT_0 + count) break;
+                MSG msg;
+                while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE)) {
+                    if (msg.message == WM_QUIT) {
+                        PostQuitMessage((int)msg.wParam);  // 留给事件循环处理
+                        lua_pushnil(L); lua_pushstring(L, "Quit"); return 2;
+                    }
+                    TranslateMessage(&msg);
+                    DispatchMessageW(&msg);
+                }
+            }
+        } else {
+            res = WaitForMultipleObjects(count, handles.data(), FALSE, timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms);
+        }
+        if (res >= WAIT_OBJECT_0 && res < (WAIT_OBJECT_0 + handles.size())) {
+            lua_pushinteger(L, res - WAIT_OBJECT_0 + 1);
+            return 1;
+        } else if (res == WAIT_TIMEOUT) {
+            lua_pushnil(L); lua_pushstring(L, "Timeout"); return 2;
+        }
+#else
+        (void)pump;  // 没有窗口消息队列
+        std::vector<pollfd> fds;
+        for (WaitHandle fd : handles) fds.push_back({fd, POLLIN, 0});
+        int res = poll(fds.data(), (nfds_t)fds.size(), timeout_ms < 0 ? -1 : timeout_ms);
+        if (res > 0) {
+            for (size_t i = 0; i < fds.size(); ++i) {
+                if (fds[i].revents & (POLLIN | POLLHUP)) { lua_pushinteger(L, (lua_Integer)i + 1); return 1; }
+            }
+        } else if (res == 0) {
+            lua_pushnil(L); lua_pushstring(L, "Timeout"); return 2;
+        }
+#endif
+        lua_pushnil(L); lua_pushstring(L, "Failed"); return 2;
+    }
+
+    // 任务句柄是带 __gc 的完整 userdata，内部为 shared_ptr：close 之后为空，再传给原生函数时报错
+    template <class T>
+    static std::shared_ptr<T>* ToHandle(lua_State* L, int idx, const char* type)
+    {
+        return static_cast<std::shared_ptr<T>*>(luaL_checkudata(L, idx, type));
+    }
+
+    template <class T>
+    static std::shared_ptr<T>& CheckHandle(lua_State* L, int idx, const char* type)
+    {
+        auto* handle = ToHandle<T>(L, idx, type);
+        if (!*handle) luaL_argerror(L, idx, lua_pushfstring(L, "%s is closed", type));
+        return *handle;
+    }
+
+    template <class T>
+    static std::shared_ptr<T>* PushHandle(lua_State* L, const char* type, std::shared_ptr<T> value)
+    {
+        auto* handle = new (lua_newuserdata(L, sizeof(std::shared_ptr<T>))) std::shared_ptr<T>(std::move(value));
+        luaL_getmetatable(L, type);
+        lua_setmetatable(L, -2);
+        return handle;
+    }
+
+    static void RegisterHandleType(lua_State* L, const char* type, lua_CFunction gc)
+    {
+        luaL_newmetatable(L, type);
+        lua_pushcfunction(L, gc);
+        lua_setfield(L, -2, "__gc");
+        lua_pop(L, 1);
+    }
+
+    // 分块流式读取：chunk_reader_close 停止预读并释放句柄，忘记 close 时由 __gc 完成
+    static const char* const kChunkReaderType = "pesh.ChunkReader";
+
+    static int pesh_chunk_reader_open(lua_State* L)
+    {
+        std::string filepath(luaL_checkstring(L, 1));
+        lua_Integer chunk_size = luaL_optinteger(L, 2, 1 << 20);
+        lua_Integer depth      = luaL_optinteger(L, 3, 4);
+        if (chunk_size <= 0 || depth <= 0) return luaL_error(L, "chunk_size and depth must be positive");
+
+        std::string error;
+        auto reader = ChunkReader::Open(Utf8Path(filepath), (size_t)chunk_size, (size_t)depth,
+                                        [](std::function<void()> task) { g_thread_pool->Push(std::move(task), TaskLane::Io); }, &error);
+        if (!reader) { lua_pushnil(L); lua_pushstring(L, error.c_str()); return 2; }
+        PushHandle(L, kChunkReaderType, std::move(reader));
+        return 1;
+    }
+
+    // 以 (true, chunk 或 nil) 恢复 co，nil 表示 EOF
+    static int pesh_chunk_reader_next(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
+        auto& reader = CheckHandle<ChunkReader>(L, 2, kChunkReaderType);
+
+        g_scheduler->Anchor(L, 1);
+        reader->Next([co](pesh_buffer* chunk, std::string error) {
+            if (error.empty()) g_scheduler->PostBuffer(co, chunk);
+            else PostCompletion(co, false, "", "Chunk read failed: " + error);
+        });
+        return 0;
+    }
+
+    static int pesh_chunk_reader_close(lua_State* L)
+    {
+        auto* reader = ToHandle<ChunkReader>(L, 1, kChunkReaderType);
+        if (!*reader) return 0;
+        // 退出阶段调度器先于 lua_close 销毁，之后 (lua_close 触发的 GC) 只释放句柄
+        if (g_scheduler) (*reader)->Close();
+        reader->reset();
+        return 0;
+    }
+
+    static int pesh_chunk_reader_gc(lua_State* L)
+    {
+        pesh_chunk_reader_close(L);
+        ToHandle<ChunkReader>(L, 1, kChunkReaderType)->~shared_ptr();
+        return 0;
+    }
+
+    // 目录树复制：start 立即返回任务句柄，next 以进度表恢复 co，close 取消未完成的任务并释放句柄
+    static const char* const kTreeCopyType = "pesh.TreeCopyJob";
+
+    static lua_Integer OptField(lua_State* L, int idx, const char* key, lua_Integer fallback)
+    {
+        if (!lua_istable(L, idx)) return fallback;
+        lua_getfield(L, idx, key);
+        lua_Integer value = lua_isnumber(L, -1) ? lua_tointeger(L, -1) : fallback;
+        lua_pop(L, 1);
+        return value;
+    }
+
+    static int pesh_tree_copy_start(lua_State* L)
+    {
+        std::string src(luaL_checkstring(L, 1));
+        std::string dst(luaL_checkstring(L, 2));
+
+        TreeCopyOptions options;
+        options.concurrency          = (size_t)std::max<lua_Integer>(1, OptField(L, 3, "concurrency", (lua_Integer)options.concurrency));
+        options.bandwidth_bps        = (uint64_t)std::max<lua_Integer>(0, OptField(L, 3, "bandwidth", 0));
+        options.progress_interval_ms = (uint32_t)std::max<lua_Integer>(10, OptField(L, 3, "progress_interval", options.progress_interval_ms));
+        options.small_file_bytes     = (uint64_t)std::max<lua_Integer>(0, OptField(L, 3, "small_file_bytes", (lua_Integer)options.small_file_bytes));
+        options.chunk_bytes          = (uint64_t)std::max<lua_Integer>(0, OptField(L, 3, "chunk_bytes", (lua_Integer)options.chunk_bytes));
+
+        // 遍历与复制任务都在 I/O 通道上执行，同时占用的线程不超过 concurrency
+        spdlog::debug("Tree copy '{}' -> '{}' started", src, dst);
+        std::shared_ptr<TreeCopyJob> job = TreeCopyJob::Start(
+            Utf8Path(src), Utf8Path(dst), options,
+            [](std::function<void()> task) { g_thread_pool->Push(std::move(task), TaskLane::Io); },
+            [src, dst](const TreeCopyProgress& result) {
+                spdlog::info("Tree copy '{}' -> '{}': {} files, {} bytes, {} errors in {} ms", src, dst, result.files_done,
+                             result.bytes_done, result.errors, result.elapsed_ms);
+            });
+        PushHandle(L, kTreeCopyType, std::move(job));
+        return 1;
+    }
+
+    static void PushTreeCopyProgress(lua_State* L, const TreeCopyProgress& p)
+    {
+        lua_createtable(L, 0, 11);
+        lua_pushnumber(L, (lua_Number)p.files_done);  lua_setfield(L, -2, "files_done");
+        lua_pushnumber(L, (lua_Number)p.files_total); lua_setfield(L, -2, "files_total");
+        lua_pushnumber(L, (lua_Number)p.bytes_done);  lua_setfield(L, -2, "bytes_done");
+        lua_pushnumber(L, (lua_Number)p.bytes_total); lua_setfield(L, -2, "bytes_total");
+        lua_pushnumber(L, (lua_Number)p.dirs);        lua_setfield(L, -2, "dirs");
+        lua_pushnumber(L, (lua_Number)p.errors);      lua_setfield(L, -2, "errors");
+        lua_pushnumber(L, (lua_Number)p.elapsed_ms);  lua_setfield(L, -2, "elapsed_ms");
+        lua_pushboolean(L, p.scanning);               lua_setfield(L, -2, "scanning");
+        lua_pushboolean(L, p.finished);               lua_setfield(L, -2, "finished");
+        lua_pushboolean(L, p.cancelled);              lua_setfield(L, -2, "cancelled");
+        if (!p.first_error.empty()) { lua_pushstring(L, p.first_error.c_str()); lua_setfield(L, -2, "first_error"); }
+    }
+
+    static int pesh_tree_copy_next(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
+        auto& job = CheckHandle<TreeCopyJob>(L, 2, kTreeCopyType);
+
+        g_scheduler->Anchor(L, 1);
+        job->NextProgress([co](const TreeCopyProgress& p) {
+            g_scheduler->PostValue(co, [p](lua_State* target) { PushTreeCopyProgress(target, p); });
+        });
+        return 0;
+    }
+
+    static int pesh_tree_copy_close(lua_State* L)
+    {
+        auto* job = ToHandle<TreeCopyJob>(L, 1, kTreeCopyType);
+        if (!*job) return 0;
+        if (g_scheduler) (*job)->Cancel();  // 已结束的任务上无副作用；退出阶段只释放句柄
+        job->reset();
+        return 0;
+    }
+
+    static int pesh_tree_copy_gc(lua_State* L)
+    {
+        pesh_tree_copy_close(L);
+        ToHandle<TreeCopyJob>(L, 1, kTreeCopyType)->~shared_ptr();
+        return 0;
+    }
+
+    // 目录扫描：start 立即返回任务句柄，next 以一批条目恢复 co (扫描结束时为带 finished = true 的汇总表)，
+    // close 取消未完成的扫描并释放句柄
+    static const char* const kTreeScanType = "pesh.TreeScanJob";
+
+    static int pesh_tree_scan_start(lua_State* L)
+    {
+        std::string root(luaL_checkstring(L, 1));
+
+        TreeScanOptions options;
+        options.concurrency   = (size_t)std::max<lua_Integer>(1, OptField(L, 2, "concurrency", (lua_Integer)options.concurrency));
+        options.batch_entries = (size_t)std::max<lua_Integer>(1, OptField(L, 2, "batch", (lua_Integer)options.batch_entries));
+        options.max_batches   = (size_t)std::max<lua_Integer>(1, OptField(L, 2, "max_batches", (lua_Integer)options.max_batches));
+        if (lua_istable(L, 2))
+        {
+            lua_getfield(L, 2, "hash");
+            if (!lua_isnil(L, -1) && !ParseContentHash(luaL_checkstring(L, -1), &options.hash))
+                return luaL_error(L, "Unknown hash '%s' (expected crc32c, xxh3 or none)", lua_tostring(L, -1));
+            lua_pop(L, 1);
+        }
+
+        auto job = TreeScanJob::Start(Utf8Path(root), options,
+                                      [](std::function<void()> task) { g_thread_pool->Push(std::move(task), TaskLane::Io); });
+        PushHandle(L, kTreeScanType, std::move(job));
+        return 1;
+    }
+
+    static void PushTreeScanBatch(lua_State* L, const TreeScanJob::Batch& batch, ContentHash hash)
+    {
+        lua_createtable(L, (int)batch.size(), 0);
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            const TreeScanEntry& e = batch[i];
+            lua_createtable(L, 0, 6);
+            lua_pushlstring(L, e.path.data(), e.path.size()); lua_setfield(L, -2, "path");
+            lua_pushnumber(L, (lua_Number)e.size);            lua_setfield(L, -2, "size");
+            lua_pushnumber(L, (lua_Number)e.mtime);           lua_setfield(L, -2, "mtime");
+            lua_pushnumber(L, (lua_Number)e.attributes);      lua_setfield(L, -2, "attributes");
+            lua_pushboolean(L, e.is_dir);                     lua_setfield(L, -2, "is_dir");
+            if (e.hashed) { lua_pushstring(L, FormatContentHash(hash, e.hash).c_str()); lua_setfield(L, -2, "hash"); }
+            lua_rawseti(L, -2, (int)i + 1);
+        }
+    }
+
+    static void PushTreeScanSummary(lua_State* L, const TreeScanSummary& s)
+    {
+        lua_createtable(L, 0, 10);
+        lua_pushnumber(L, (lua_Number)s.entries);      lua_setfield(L, -2, "entries");
+        lua_pushnumber(L, (lua_Number)s.files);        lua_setfield(L, -2, "files");
+        lua_pushnumber(L, (lua_Number)s.dirs);         lua_setfield(L, -2, "dirs");
+        lua_pushnumber(L, (lua_Number)s.bytes);        lua_setfield(L, -2, "bytes");
+        lua_pushnumber(L, (lua_Number)s.hashed_bytes); lua_setfield(L, -2, "hashed_bytes");
+        lua_pushnumber(L, (lua_Number)s.errors);       lua_setfield(L, -2, "errors");
+        lua_pushnumber(L, (lua_Number)s.elapsed_ms);   lua_setfield(L, -2, "elapsed_ms");
+        lua_pushboolean(L, s.finished);                lua_setfield(L, -2, "finished");
+        lua_pushboolean(L, s.cancelled);               lua_setfield(L, -2, "cancelled");
+        if (!s.first_error.empty()) { lua_pushstring(L, s.first_error.c_str()); lua_setfield(L, -2, "first_error"); }
+    }
+
+    static int pesh_tree_scan_next(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
+        auto& job = CheckHandle<TreeScanJob>(L, 2, kTreeScanType);
+        ContentHash hash = job->Hash();
+
+        g_scheduler->Anchor(L, 1);
+        std::weak_ptr<TreeScanJob> weak = job;
+        job->NextBatch([co, hash, weak](std::shared_ptr<TreeScanJob::Batch> batch) {
+            if (batch)
+            {
+                g_scheduler->PostValue(co, [batch, hash](lua_State* target) { PushTreeScanBatch(target, *batch, hash); });
+                return;
+            }
+            TreeScanSummary summary;
+            if (auto job = weak.lock()) summary = job->Summary();
+            summary.finished = true;
+            g_scheduler->PostValue(co, [summary](lua_State* target) { PushTreeScanSummary(target, summary); });
+        });
+        return 0;
+    }
+
+    static int pesh_tree_scan_close(lua_State* L)
+    {
+        auto* job = ToHandle<TreeScanJob>(L, 1, kTreeScanType);
+        if (!*job) return 0;
+        if (g_scheduler) (*job)->Cancel();  // 已结束的扫描上无副作用；退出阶段只释放句柄
+        job->reset();
+        return 0;
+    }
+
+    static int pesh_tree_scan_gc(lua_State* L)
+    {
+        pesh_tree_scan_close(L);
+        ToHandle<TreeScanJob>(L, 1, kTreeScanType)->~shared_ptr();
+        return 0;
+    }
+
+    static int pesh_set_resume_budget(lua_State* L)
+    {
+        lua_Integer budget = luaL_checkinteger(L, 1);
+        g_scheduler->SetResumeBudget(budget > 0 ? (size_t)budget : 0);
+        return 0;
+    }
+
+    // 请求退出持久循环，退出码即进程返回值 (Windows 上等价于 PostQuitMessage)
+    static int pesh_quit(lua_State* L)
+    {
+        g_scheduler->Quit((int)luaL_optinteger(L, 1, 0));
+        return 0;
+    }
+
+    // spawn(func, ...)：在原生协程池的线程上运行 func，线程在整个任务期间被锚定
+    static int pesh_spawn(lua_State* L)
+    {
+        luaL_checktype(L, 1, LUA_TFUNCTION);
+        g_scheduler->Coroutines().Spawn(L, lua_gettop(L) - 1);
+        return 0;
+    }
+
+    static ProcessTable& Processes()
+    {
+        if (!g_process_table) {
+            g_process_table = std::make_unique<ProcessTable>();
+            spdlog::debug("Process table started ({} backend).", g_process_table->BackendName());
+        }
+        return *g_process_table;
+    }
+
+    // process_find(name) -> { pid, ... }，来自常驻索引，不做系统快照
+    static int pesh_process_find(lua_State* L)
+    {
+        std::vector<uint32_t> pids = Processes().Find(luaL_checkstring(L, 1));
+        lua_createtable(L, (int)pids.size(), 0);
+        for (size_t i = 0; i < pids.size(); ++i) {
+            lua_pushinteger(L, (lua_Integer)pids[i]);
+            lua_rawseti(L, -2, (int)i + 1);
+        }
+        return 1;
+    }
+
+    // process_wait(co, name, "appeared" | "gone", [timeout_ms])
+    // 以 (true, pid) / (true, true) 恢复 co；超时以 (true, nil) / (true, false) 恢复，不抛出
+    static int pesh_process_wait(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
+        std::string name = luaL_checkstring(L, 2);
+        const char* kind_str = luaL_checkstring(L, 3);
+        int64_t timeout_ms = (int64_t)luaL_optnumber(L, 4, -1);
+
+        ProcessTable::WatchKind kind;
+        if (strcmp(kind_str, "appeared") == 0) kind = ProcessTable::WatchKind::Appeared;
+        else if (strcmp(kind_str, "gone") == 0) kind = ProcessTable::WatchKind::Gone;
+        else return luaL_argerror(L, 3, "expected 'appeared' or 'gone'");
+
+        g_scheduler->Anchor(L, 1);
+        Processes().Watch(kind, name, timeout_ms, [co, kind](bool fired, uint32_t pid) {
+            g_scheduler->PostValue(co, [kind, fired, pid](lua_State* target) {
+                if (kind == ProcessTable::WatchKind::Gone) lua_pushboolean(target, fired);
+                else if (fired) lua_pushinteger(target, (lua_Integer)pid);
+                else lua_pushnil(target);
+            });
+        });
+        return 0;
+    }
+
+    static int pesh_process_table_stats(lua_State* L)
+    {
+        ProcessTable::Stats stats = Processes().GetStats();
+        lua_createtable(L, 0, 6);
+        lua_pushstring(L, Processes().BackendName());  lua_setfield(L, -2, "backend");
+        lua_pushnumber(L, (lua_Number)stats.events);     lua_setfield(L, -2, "events");
+        lua_pushnumber(L, (lua_Number)stats.rescans);    lua_setfield(L, -2, "rescans");
+        lua_pushnumber(L, (lua_Number)stats.name_reads); lua_setfield(L, -2, "name_reads");
+        lua_pushnumber(L, (lua_Number)stats.processes);  lua_setfield(L, -2, "processes");
+        lua_pushnumber(L, (lua_Number)stats.watches);    lua_setfield(L, -2, "watches");
+        return 1;
+    }
+
+    // 多服务监督器：start 以服务表数组创建并开始按顺序启动，next 以事件表恢复 co (监督器关闭时为 nil)，
+    // stop 按逆序停止全部服务后以 (true, true) 恢复 co，close 强制结束剩余子进程并释放句柄
+    static std::string OptStringField(lua_State* L, int idx, const char* key)
+    {
+        lua_getfield(L, idx, key);
+        std::string value = lua_isstring(L, -1) ? lua_tostring(L, -1) : "";
+        lua_pop(L, 1);
+        return value;
+    }
+
+    static double OptNumberField(lua_State* L, int idx, const char* key, double fallback)
+    {
+        lua_getfield(L, idx, key);
+        double value = lua_isnumber(L, -1) ? (double)lua_tonumber(L, -1) : fallback;
+        lua_pop(L, 1);
+        return value;
+    }
+
+    static const char* const kSupervisorType = "pesh.Supervisor";
+
+    static int pesh_supervisor_start(lua_State* L)
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        std::vector<ServiceSpec> specs;
+        for (int i = 1;; ++i) {
+            lua_rawgeti(L, 1, i);
+            if (lua_isnil(L, -1)) { lua_pop(L, 1); break; }
+            if (!lua_istable(L, -1)) return luaL_error(L, "service #%d must be a table", i);
+            int idx = lua_gettop(L);
+
+            ServiceSpec spec;
+            spec.name        = OptStringField(L, idx, "name");
+            spec.command     = OptStringField(L, idx, "command");
+            spec.working_dir = OptStringField(L, idx, "working_dir");
+            if (spec.command.empty()) return luaL_error(L, "service #%d has no command", i);
+            if (spec.name.empty()) spec.name = spec.command;
+
+            std::string restart = OptStringField(L, idx, "restart");
+            if (restart == "on-failure") spec.restart = RestartPolicy::OnFailure;
+            else if (restart == "never") spec.restart = RestartPolicy::Never;
+            else if (!restart.empty() && restart != "always") return luaL_error(L, "service '%s': bad restart policy '%s'", spec.name.c_str(), restart.c_str());
+
+            auto ms = [&](const char* key, uint32_t fallback) {
+                return (uint32_t)std::max<lua_Integer>(0, OptField(L, idx, key, (lua_Integer)fallback));
+            };
+            spec.backoff_initial_ms = ms("backoff_initial", spec.backoff_initial_ms);
+            spec.backoff_max_ms     = ms("backoff_max", spec.backoff_max_ms);
+            spec.reset_after_ms     = ms("reset_after", spec.reset_after_ms);
+            spec.max_restarts       = ms("max_restarts", spec.max_restarts);
+            spec.restart_window_ms  = ms("restart_window", spec.restart_window_ms);
+            spec.start_delay_ms     = ms("start_delay", spec.start_delay_ms);
+            spec.stop_timeout_ms    = ms("stop_timeout", spec.stop_timeout_ms);
+            spec.backoff_factor     = std::max(1.0, OptNumberField(L, idx, "backoff_factor", spec.backoff_factor));
+            spec.jitter             = std::min(1.0, std::max(0.0, OptNumberField(L, idx, "jitter", spec.jitter)));
+            specs.push_back(std::move(spec));
+            lua_pop(L, 1);
+        }
+        if (specs.empty()) return luaL_argerror(L, 1, "no services");
+
+        g_supervisors.insert(PushHandle(L, kSupervisorType, Supervisor::Create(std::move(specs))));
+        return 1;
+    }
+
+    static const char* ServiceStateName(ServiceState state)
+    {
+        switch (state) {
+        case ServiceState::Pending: return "pending";
+        case ServiceState::Running: return "running";
+        case ServiceState::Backoff: return "backoff";
+        case ServiceState::Failed:  return "failed";
+        case ServiceState::Stopped: return "stopped";
+        }
+        return "unknown";
+    }
+
+    static void PushServiceEvent(lua_State* L, const ServiceEvent& e)
+    {
+        static const char* kTypes[] = {"started", "exited", "failed", "stopped"};
+        lua_createtable(L, 0, 7);
+        lua_pushstring(L, kTypes[(int)e.type]);        lua_setfield(L, -2, "type");
+        lua_pushstring(L, e.service.c_str());          lua_setfield(L, -2, "service");
+        lua_pushinteger(L, (lua_Integer)e.pid);        lua_setfield(L, -2, "pid");
+        lua_pushinteger(L, (lua_Integer)e.exit_code);  lua_setfield(L, -2, "exit_code");
+        lua_pushinteger(L, (lua_Integer)e.restarts);   lua_setfield(L, -2, "restarts");
+        if (e.delay_ms >= 0) { lua_pushnumber(L, (lua_Number)e.delay_ms); lua_setfield(L, -2, "delay_ms"); }
+        if (!e.error.empty()) { lua_pushstring(L, e.error.c_str()); lua_setfield(L, -2, "error"); }
+    }
+
+    static std::shared_ptr<Supervisor>& CheckSupervisor(lua_State* L, int idx)
+    {
+        return CheckHandle<Supervisor>(L, idx, kSupervisorType);
+    }
+
+    static int pesh_supervisor_next(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
+        auto& supervisor = CheckSupervisor(L, 2);
+
+        g_scheduler->Anchor(L, 1);
+        supervisor->NextEvent([co](const ServiceEvent* event) {
+            if (!event) {
+                g_scheduler->PostValue(co, [](lua_State* target) { lua_pushnil(target); });
+                return;
+            }
+            ServiceEvent copy = *event;
+            g_scheduler->PostValue(co, [copy](lua_State* target) { PushServiceEvent(target, copy); });
+        });
+        return 0;
+    }
+
+    static int pesh_supervisor_status(lua_State* L)
+    {
+        std::vector<ServiceStatus> statuses = CheckSupervisor(L, 1)->Status();
+        lua_createtable(L, (int)statuses.size(), 0);
+        for (size_t i = 0; i < statuses.size(); ++i) {
+            const ServiceStatus& s = statuses[i];
+            lua_createtable(L, 0, 5);
+            lua_pushstring(L, s.name.c_str());              lua_setfield(L, -2, "name");
+            lua_pushstring(L, ServiceStateName(s.state));   lua_setfield(L, -2, "state");
+            lua_pushinteger(L, (lua_Integer)s.pid);         lua_setfield(L, -2, "pid");
+            lua_pushinteger(L, (lua_Integer)s.restarts);    lua_setfield(L, -2, "restarts");
+            lua_pushinteger(L, (lua_Integer)s.exit_code);   lua_setfield(L, -2, "exit_code");
+            lua_rawseti(L, -2, (int)i + 1);
+        }
+        return 1;
+    }
+
+    static int pesh_supervisor_stop(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
+        auto& supervisor = CheckSupervisor(L, 2);
+
+        g_scheduler->Anchor(L, 1);
+        supervisor->Stop([co]() {
+            g_scheduler->PostValue(co, [](lua_State* target) { lua_pushboolean(target, 1); });
+        });
+        return 0;
+    }
+
+    static int pesh_supervisor_close(lua_State* L)
+    {
+        auto* supervisor = ToHandle<Supervisor>(L, 1, kSupervisorType);
+        g_supervisors.erase(supervisor);
+        supervisor->reset();
+        return 0;
+    }
+
+    static int pesh_supervisor_gc(lua_State* L)
+    {
+        pesh_supervisor_close(L);
+        ToHandle<Supervisor>(L, 1, kSupervisorType)->~shared_ptr();
+        return 0;
+    }
+
+    // 句柄是带 __gc 的完整 userdata：pipe_close 之后内部的 shared_ptr 为空，再传给原生函数时报错
+    static const char* const kPipeHandleType = "pesh.PipedProcess";
+
+    static std::shared_ptr<PipedProcess>* ToPipe(lua_State* L, int idx)
+    {
+        return static_cast<std::shared_ptr<PipedProcess>*>(luaL_checkudata(L, idx, kPipeHandleType));
+    }
+
+    static std::shared_ptr<PipedProcess>& CheckPipe(lua_State* L, int idx)
+    {
+        auto* process = ToPipe(L, idx);
+        if (!*process) luaL_argerror(L, idx, "piped process is closed");
+        return *process;
+    }
+
+    // 带管道的子进程：pipe_spawn 返回 (句柄, pid)，失败时 (nil, 错误信息)；
+    // pipe_read 以一块输出恢复 co (EOF 时为 nil)，pipe_read_any 以 { stream, data } 恢复 (两个流都 EOF 时为 nil)；
+    // pipe_write 在数据写入管道后以 true 恢复；pipe_wait 以退出码恢复；
+    // pipe_close 丢弃未读的输出、关闭 stdin 并释放句柄，子进程继续运行直到自行退出
+    static int pesh_pipe_spawn(lua_State* L)
+    {
+        PipeSpawnOptions options;
+        options.command = luaL_checkstring(L, 1);
+        if (lua_istable(L, 2)) {
+            options.working_dir = OptStringField(L, 2, "working_dir");
+            std::string err_mode = OptStringField(L, 2, "stderr");
+            if (err_mode == "merge") options.merge_stderr = true;
+            else if (err_mode == "inherit") options.capture_stderr = false;
+            else if (!err_mode.empty() && err_mode != "pipe") return luaL_error(L, "Bad stderr mode '%s' (expected pipe, merge or inherit)", err_mode.c_str());
+            lua_getfield(L, 2, "stdin");
+            options.pipe_stdin = lua_toboolean(L, -1) != 0;
+            lua_pop(L, 1);
+            options.buffer_bytes = (size_t)std::max<lua_Integer>(4096, OptField(L, 2, "buffer", (lua_Integer)options.buffer_bytes));
+        }
+
+        std::string error;
+        if (!g_pipe_reactor) {
+            g_pipe_reactor = PipeReactor::Create(&error);
+            if (!g_pipe_reactor) { lua_pushnil(L); lua_pushstring(L, error.c_str()); return 2; }
+        }
+        auto process = g_pipe_reactor->Spawn(options, &error);
+        if (!process) { lua_pushnil(L); lua_pushstring(L, error.c_str()); return 2; }
+        lua_Integer pid = (lua_Integer)process->Pid();
+        new (lua_newuserdata(L, sizeof(std::shared_ptr<PipedProcess>))) std::shared_ptr<PipedProcess>(std::move(process));
+        luaL_getmetatable(L, kPipeHandleType);
+        lua_setmetatable(L, -2);
+        lua_pushinteger(L, pid);
+        return 2;
+    }
+
+    static const char* PipeStreamName(PipeStream stream)
+    {
+        return stream == PipeStream::Stderr ? "stderr" : "stdout";
+    }
+
+    static void PostPipeChunk(lua_State* co, PipedProcess& process, PipeStream stream, std::string data)
+    {
+        if (!data.empty()) { PostCompletion(co, true, std::move(data), ""); return; }
+        std::string error = process.StreamError(stream);
+        if (!error.empty()) PostCompletion(co, false, "", std::string(PipeStreamName(stream)) + " " + error);
+        else g_scheduler->PostValue(co, [](lua_State* target) { lua_pushnil(target); });
+    }
+
+    static int pesh_pipe_read(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
+        auto& process = CheckPipe(L, 2);
+        const char* name = luaL_optstring(L, 3, "stdout");
+        PipeStream stream;
+        if (strcmp(name, "stdout") == 0) stream = PipeStream::Stdout;
+        else if (strcmp(name, "stderr") == 0) stream = PipeStream::Stderr;
+        else return luaL_argerror(L, 3, "expected 'stdout' or 'stderr'");
+        size_t max_bytes = (size_t)std::max<lua_Integer>(0, luaL_optinteger(L, 4, 0));
+
+        g_scheduler->Anchor(L, 1);
+        std::weak_ptr<PipedProcess> weak = process;
+        process->Read(stream, max_bytes, [co, weak, stream](std::string data) {
+            if (auto p = weak.lock()) PostPipeChunk(co, *p, stream, std::move(data));
+            else g_scheduler->PostValue(co, [](lua_State* target) { lua_pushnil(target); });
+        });
+        return 0;
+    }
+
+    static int pesh_pipe_read_any(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
+        auto& process = CheckPipe(L, 2);
+        size_t max_bytes = (size_t)std::max<lua_Integer>(0, luaL_optinteger(L, 3, 0));
+
+        g_scheduler->Anchor(L, 1);
+        process->ReadAny(max_bytes, [co](PipeStream stream, std::string data) {
+            auto chunk = std::make_shared<std::string>(std::move(data));
+            g_scheduler->PostValue(co, [stream, chunk](lua_State* target) {
+                if (chunk->empty()) { lua_pushnil(target); return; }
+                lua_createtable(target, 0, 2);
+                lua_pushstring(target, PipeStreamName(stream));          lua_setfield(target, -2, "stream");
+                lua_pushlstring(target, chunk->data(), chunk->size());  lua_setfield(target, -2, "data");
+            });
+        });
+        return 0;
+    }
+
+    static int pesh_pipe_write(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
+        auto& process = CheckPipe(L, 2);
+        size_t len = 0;
+        const char* data = luaL_checklstring(L, 3, &len);
+
+        g_scheduler->Anchor(L, 1);
+        process->Write(std::string(data, len), [co](bool ok, std::string error) {
+            if (ok) g_scheduler->PostValue(co, [](lua_State* target) { lua_pushboolean(target, 1); });
+            else PostCompletion(co, false, "", "stdin write failed: " + error);
+        });
+        return 0;
+    }
+
+    static int pesh_pipe_close_stdin(lua_State* L)
+    {
+        CheckPipe(L, 1)->CloseStdin();
+        return 0;
+    }
+
+    static int pesh_pipe_wait(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
+        auto& process = CheckPipe(L, 2);
+
+        g_scheduler->Anchor(L, 1);
+        process->WaitExit([co](int code) {
+            g_scheduler->PostValue(co, [code](lua_State* target) { lua_pushinteger(target, code); });
+        });
+        return 0;
+    }
+
+    static int pesh_pipe_kill(lua_State* L)
+    {
+        CheckPipe(L, 1)->Kill();
+        return 0;
+    }
+
+    static int pesh_pipe_close(lua_State* L)
+    {
+        auto* process = ToPipe(L, 1);
+        if (!*process) return 0;
+        // 退出阶段反应器先于调度器销毁，之后 (lua_close 触发的 GC) 只释放句柄
+        if (g_pipe_reactor) {
+            (*process)->Discard();
+            (*process)->CloseStdin();
+        }
+        process->reset();
+        return 0;
+    }
+
+    static int pesh_pipe_gc(lua_State* L)
+    {
+        pesh_pipe_close(L);
+        ToPipe(L, 1)->~shared_ptr();
+        return 0;
+    }
+
+    // 合并写入 (src/write_behind.h)：arg 1 为 co 时写完 (要求 sync 时为同步完) 后以 true 恢复 co；
+    // 为 nil 时不等待 (不分配回调)，失败只记日志。write_flush 在此前提交的写入全部同步后以 true 恢复 co
+    static WriteBehind& Writes()
+    {
+        if (!g_write_behind) {
+            g_write_behind = std::make_unique<WriteBehind>(
+                [](std::function<void()> task) { g_thread_pool->Push(std::move(task), TaskLane::Io); },
+                [](const std::string& error) { spdlog::error("Background write failed: {}", error); });
+        }
+        return *g_write_behind;
+    }
+
+    static WriteBehind::DoneFn WriteDone(lua_State* L, const char* what)
+    {
+        if (lua_isnoneornil(L, 1)) return nullptr;
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) luaL_argerror(L, 1, "coroutine or nil expected");
+        g_scheduler->Anchor(L, 1);
+        return [co, what](bool ok, std::string error) {
+            if (ok) g_scheduler->PostValue(co, [](lua_State* target) { lua_pushboolean(target, 1); });
+            else PostCompletion(co, false, "", std::string(what) + " failed: " + error);
+        };
+    }
+
+    static int pesh_write_append(lua_State* L)
+    {
+        std::string path(luaL_checkstring(L, 2));
+        size_t len = 0;
+        const char* data = luaL_checklstring(L, 3, &len);
+        bool sync = lua_toboolean(L, 4) != 0;
+        Writes().Append(Utf8Path(path), std::string(data, len), sync, WriteDone(L, "append"));
+        return 0;
+    }
+
+    static int pesh_write_replace(lua_State* L)
+    {
+        std::string path(luaL_checkstring(L, 2));
+        size_t len = 0;
+        const char* data = luaL_checklstring(L, 3, &len);
+        bool sync = lua_toboolean(L, 4) != 0;
+        Writes().Replace(Utf8Path(path), std::string(data, len), sync, WriteDone(L, "replace"));
+        return 0;
+    }
 
-#if defined(LUA_JITLIBNAME) && defined(OPENRESTY_LUAJIT)
-#define HAVE_LUA_RESETTHREAD 1
-#endif
+    static int pesh_write_flush(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
+        Writes().Flush(WriteDone(L, "flush"));
+        return 0;
+    }
 
-struct AsyncTaskResult
-{
-    lua_State*  co;
-    bool        success;
-    std::string data;
-    std::string error_msg;
-};
+    static int pesh_coroutine_stats(lua_State* L)
+    {
+        CoroutinePool::Stats stats = g_scheduler->Coroutines().GetStats();
+        lua_createtable(L, 0, 5);
+        lua_pushnumber(L, (lua_Number)stats.created); lua_setfield(L, -2, "created");
+        lua_pushnumber(L, (lua_Number)stats.reused);  lua_setfield(L, -2, "reused");
+        lua_pushnumber(L, (lua_Number)stats.failed);  lua_setfield(L, -2, "failed");
+        lua_pushnumber(L, (lua_Number)stats.running); lua_setfield(L, -2, "running");
+        lua_pushnumber(L, (lua_Number)stats.idle);    lua_setfield(L, -2, "idle");
+        return 1;
+    }
 
-struct WaitOperation
-{
-    lua_State*          co;
-    std::vector<HANDLE> handles;
-};
+    static void PushMetricsSnapshot(lua_State* L, const MetricsSnapshot& snapshot)
+    {
+        lua_createtable(L, 0, 4);
+        lua_pushnumber(L, (lua_Number)snapshot.pid);  lua_setfield(L, -2, "pid");
+        lua_pushnumber(L, snapshot.uptime_s);         lua_setfield(L, -2, "uptime_s");
+        lua_createtable(L, 0, (int)snapshot.values.size());
+        for (const auto& v : snapshot.values) {
+            lua_pushnumber(L, (lua_Number)v.value);
+            lua_setfield(L, -2, v.name.c_str());
+        }
+        lua_setfield(L, -2, "values");
+        lua_createtable(L, 0, (int)snapshot.latencies.size());
+        for (const auto& l : snapshot.latencies) {
+            lua_createtable(L, 0, 7);
+            lua_pushnumber(L, (lua_Number)l.us.count); lua_setfield(L, -2, "count");
+            lua_pushnumber(L, l.us.mean);              lua_setfield(L, -2, "mean");
+            lua_pushnumber(L, l.us.p50);               lua_setfield(L, -2, "p50");
+            lua_pushnumber(L, l.us.p90);               lua_setfield(L, -2, "p90");
+            lua_pushnumber(L, l.us.p99);               lua_setfield(L, -2, "p99");
+            lua_pushnumber(L, l.us.p999);              lua_setfield(L, -2, "p999");
+            lua_pushnumber(L, l.us.max);               lua_setfield(L, -2, "max");
+            lua_setfield(L, -2, l.name.c_str());
+        }
+        lua_setfield(L, -2, "latency_us");
+    }
 
-std::queue<AsyncTaskResult>     g_completed_tasks;
-std::mutex                      g_completed_tasks_mutex;
-HANDLE                          g_hTaskCompletedEvent = NULL;
-std::vector<HANDLE>             g_wait_handles_cache;
-std::map<HANDLE, WaitOperation> g_wait_operations;
-std::mutex                      g_wait_operations_mutex;
-ctpl::thread_pool               g_thread_pool(std::thread::hardware_concurrency());
-static volatile bool            g_handle_list_dirty = true;
+    // stats() -> { pid, uptime_s, values = { name = n }, latency_us = { name = { count, mean, p50, p90, p99, p999, max } } }
+    static int pesh_stats(lua_State* L)
+    {
+        g_scheduler->PublishMetrics();
+        PushMetricsSnapshot(L, SnapshotMetrics());
+        return 1;
+    }
 
-lua_State*   InitializeLuaState(const std::string& package_root_dir);
-std::wstring Utf8ToWide(const std::string& str);
+    // stats_endpoints() -> { pid, ... }：本机上正在提供查询通道的实例
+    static int pesh_stats_endpoints(lua_State* L)
+    {
+        std::vector<uint64_t> pids = ListStatsEndpoints();
+        lua_createtable(L, (int)pids.size(), 0);
+        for (size_t i = 0; i < pids.size(); ++i) {
+            lua_pushnumber(L, (lua_Number)pids[i]);
+            lua_rawseti(L, -2, (int)i + 1);
+        }
+        return 1;
+    }
 
-namespace LuaBindings
-{
-    struct SafeHandle { HANDLE h; };
+    // stats_query(pid, json) -> text | nil, err；只读取对方的原子计数，不打扰它的事件循环
+    static int pesh_stats_query(lua_State* L)
+    {
+        uint64_t    pid = (uint64_t)luaL_checknumber(L, 1);
+        std::string text, error;
+        if (!QueryStats(pid, lua_toboolean(L, 2) != 0, &text, &error)) {
+            lua_pushnil(L);
+            lua_pushstring(L, error.c_str());
+            return 2;
+        }
+        lua_pushlstring(L, text.data(), text.size());
+        return 1;
+    }
 
-    static int pesh_sleep(lua_State* L)
+    // 以 { id, cwd, args = { 命令名, 参数... } } 恢复等待中的 command_next
+    static void DeliverForwardedCommand(lua_State* co, uint64_t id, CommandRequest request)
     {
-        int duration_ms = (int)luaL_checkinteger(L, 1);
-        Sleep(duration_ms);
+        auto shared = std::make_shared<CommandRequest>(std::move(request));
+        g_scheduler->PostValue(co, [id, shared](lua_State* target) {
+            lua_createtable(target, 0, 3);
+            lua_pushnumber(target, (lua_Number)id);                           lua_setfield(target, -2, "id");
+            lua_pushlstring(target, shared->cwd.data(), shared->cwd.size()); lua_setfield(target, -2, "cwd");
+            lua_createtable(target, (int)shared->args.size(), 0);
+            for (size_t i = 0; i < shared->args.size(); ++i) {
+                lua_pushlstring(target, shared->args[i].data(), shared->args[i].size());
+                lua_rawseti(target, -2, (int)i + 1);
+            }
+            lua_setfield(target, -2, "args");
+        });
+    }
+
+    // command_next(co)：等待下一条转发来的命令；同一时刻只应有一个协程在等待
+    static int pesh_command_next(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_argerror(L, 1, "coroutine expected");
+        g_scheduler->Anchor(L, 1);
+        std::unique_lock<std::mutex> lock(g_command_inbox.mutex);
+        if (g_command_inbox.queue.empty()) {
+            g_command_inbox.waiter = co;
+            return 0;
+        }
+        auto next = std::move(g_command_inbox.queue.front());
+        g_command_inbox.queue.pop_front();
+        lock.unlock();
+        DeliverForwardedCommand(co, next.first, std::move(next.second));
         return 0;
     }
 
-    static int pesh_dispatch_worker(lua_State* L)
+    // command_reply(id, exit_code, output) -> bool：把结果写回等待中的客户端进程
+    static int pesh_command_reply(lua_State* L)
     {
-        const char* worker_name = luaL_checkstring(L, 1);
+        uint64_t     id = (uint64_t)luaL_checknumber(L, 1);
+        CommandReply reply;
+        reply.exit_code = (int)luaL_optinteger(L, 2, 0);
+        size_t      len = 0;
+        const char* output = luaL_optlstring(L, 3, "", &len);
+        reply.output.assign(output, len);
 
-        if (strcmp(worker_name, "file_copy_worker") == 0)
+        CommandServer::Reply send;
         {
-            std::string src_path(luaL_checkstring(L, 2));
-            std::string dst_path(luaL_checkstring(L, 3));
-            lua_State*  co_to_wake = lua_tothread(L, 4);
-
-            g_thread_pool.push([src_path, dst_path, co_to_wake](int id) {
-                (void)id; 
-                spdlog::debug("WORKER: Async copy '{}' -> '{}'", src_path, dst_path);
-                BOOL copy_success = CopyFileW(Utf8ToWide(src_path).c_str(), Utf8ToWide(dst_path).c_str(), FALSE);
-
-                std::lock_guard<std::mutex> lock(g_completed_tasks_mutex);
-                if (copy_success) g_completed_tasks.push({co_to_wake, true, "Copy successful", ""});
-                else g_completed_tasks.push({co_to_wake, false, "", "Copy failed: " + std::to_string(GetLastError())});
-                SetEvent(g_hTaskCompletedEvent);
-            });
+            std::lock_guard<std::mutex> lock(g_command_inbox.mutex);
+            auto it = g_command_inbox.replies.find(id);
+            if (it != g_command_inbox.replies.end()) {
+                send = std::move(it->second);
+                g_command_inbox.replies.erase(it);
+            }
         }
-        else if (strcmp(worker_name, "file_read_worker") == 0)
-        {
-            std::string filepath(luaL_checkstring(L, 2));
-            lua_State*  co_to_wake = lua_tothread(L, 3);
-
-            g_thread_pool.push([filepath, co_to_wake](int id) {
-                (void)id;
-                spdlog::debug("WORKER: Async read '{}'", filepath);
-                std::ifstream file(Utf8ToWide(filepath), std::ios::binary | std::ios::ate);
-                if (file) {
-                    std::streamsize size = file.tellg();
-                    file.seekg(0, std::ios::beg);
-                    std::string buffer(size, '\0');
-                    if (file.read(&buffer[0], size)) {
-                        std::lock_guard<std::mutex> lock(g_completed_tasks_mutex);
-                        g_completed_tasks.push({co_to_wake, true, std::move(buffer), ""});
-                    } else {
-                        std::lock_guard<std::mutex> lock(g_completed_tasks_mutex);
-                        g_completed_tasks.push({co_to_wake, false, "", "File read failed: " + filepath});
-                    }
-                } else {
-                    std::lock_guard<std::mutex> lock(g_completed_tasks_mutex);
-                    g_completed_tasks.push({co_to_wake, false, "", "File open failed: " + filepath});
-                }
-                SetEvent(g_hTaskCompletedEvent);
-            });
+        if (send) send(std::move(reply));
+        lua_pushboolean(L, send != nullptr);
+        return 1;
+    }
+
+    // parallel_submit(co, tag, target, name, ...)：name 为 nil 时 target 为 string.dump 的字节码，否则调用 require(target)[name]。
+    // 参数在此复制 (共享缓冲区只增加引用)。以 (true, 第一个返回值) 或 (false, 带调用栈的错误) 恢复 co；
+    // tag 不为 nil 时成功值为 { tag, 返回值 }，同一协程可一次提交多个作业，按完成顺序逐个收取
+    static int pesh_parallel_submit(lua_State* L)
+    {
+        lua_State* co = lua_tothread(L, 1);
+        if (!co) return luaL_argerror(L, 1, "coroutine expected");
+        bool tagged = !lua_isnoneornil(L, 2);
+        lua_Number tag = tagged ? luaL_checknumber(L, 2) : 0;
+        LuaJob job;
+        size_t len = 0;
+        const char* target = luaL_checklstring(L, 3, &len);
+        job.target.assign(target, len);
+        if (!lua_isnoneornil(L, 4)) job.name = luaL_checkstring(L, 4);
+
+        int top = lua_gettop(L);
+        job.args.resize(top > 4 ? top - 4 : 0);
+        for (int i = 5; i <= top; ++i) {
+            std::string error;
+            if (!LuaMessage::FromLua(L, i, &job.args[i - 5], &error)) return luaL_argerror(L, i, error.c_str());
         }
-        else if (strcmp(worker_name, "timer_worker") == 0)
-        {
-            int duration_ms = (int)luaL_checkinteger(L, 2);
-            lua_State* co_to_wake = lua_tothread(L, 3);
-            g_thread_pool.push([duration_ms, co_to_wake](int id) {
-                (void)id;
-                Sleep(duration_ms);
-                std::lock_guard<std::mutex> lock(g_completed_tasks_mutex);
-                g_completed_tasks.push({co_to_wake, true, "Timer expired", ""});
-                SetEvent(g_hTaskCompletedEvent);
+        job.complete = [co, tagged, tag](bool ok, LuaMessage result, std::string error) {
+            if (!ok) {
+                g_scheduler->PostFailure(co, kWorkerFailed, std::move(error));
+                return;
+            }
+            auto message = std::make_shared<LuaMessage>(std::move(result));
+            g_scheduler->PostValue(co, [message, tagged, tag](lua_State* target) {
+                if (!tagged) { message->Push(target); return; }
+                lua_createtable(target, 2, 0);
+                lua_pushnumber(target, tag); lua_rawseti(target, -2, 1);
+                message->Push(target);       lua_rawseti(target, -2, 2);
             });
+        };
+        g_scheduler->Anchor(L, 1);
+        g_lua_workers->Submit(std::move(job));
+        return 0;
+    }
+
+    // parallel_stats() -> { states, idle, queued, completed, failed }
+    static int pesh_parallel_stats(lua_State* L)
+    {
+        LuaWorkerPool::Stats stats = g_lua_workers->GetStats();
+        lua_createtable(L, 0, 5);
+        lua_pushnumber(L, (lua_Number)stats.states);    lua_setfield(L, -2, "states");
+        lua_pushnumber(L, (lua_Number)stats.idle);      lua_setfield(L, -2, "idle");
+        lua_pushnumber(L, (lua_Number)stats.queued);    lua_setfield(L, -2, "queued");
+        lua_pushnumber(L, (lua_Number)stats.completed); lua_setfield(L, -2, "completed");
+        lua_pushnumber(L, (lua_Number)stats.failed);    lua_setfield(L, -2, "failed");
+        return 1;
+    }
+
+    // shared_new(size | string) -> lightuserdata，引用计数为 1，由 Lua 端包装为带 GC 释放的 cdata
+    static int pesh_shared_new(lua_State* L)
+    {
+        pesh_shared* shared;
+        if (lua_type(L, 1) == LUA_TSTRING) {
+            size_t len = 0;
+            const char* str = lua_tolstring(L, 1, &len);
+            shared = NewSharedBuffer(len);
+            if (shared) memcpy(shared->data, str, len);
+        } else {
+            lua_Number size = luaL_checknumber(L, 1);
+            if (size < 0) return luaL_argerror(L, 1, "size must not be negative");
+            shared = NewSharedBuffer((size_t)size);
         }
+        if (!shared) return luaL_error(L, "Shared buffer allocation failed");
+        lua_pushlightuserdata(L, shared);
+        return 1;
+    }
+
+    // shared_adopt(pesh_buffer_t* cdata) -> lightuserdata：接管映射缓冲区，调用方不得再释放原缓冲区
+    static int pesh_shared_adopt(lua_State* L)
+    {
+        if (lua_type(L, 1) != LUA_TCDATA) return luaL_argerror(L, 1, "pesh_buffer_t* expected");
+        auto* buffer = *static_cast<pesh_buffer* const*>(lua_topointer(L, 1));
+        if (!buffer) return luaL_argerror(L, 1, "buffer already freed");
+        lua_pushlightuserdata(L, AdoptSharedBuffer(buffer));
+        return 1;
+    }
+
+    // shared_wrapper(fn)：fn(lightuserdata) -> cdata，用于把收到的共享缓冲区交给本状态的 GC
+    static int pesh_shared_wrapper(lua_State* L)
+    {
+        luaL_checktype(L, 1, LUA_TFUNCTION);
+        lua_settop(L, 1);
+        LuaMessage::SetSharedWrapper(L);
         return 0;
     }
 
-    static int pesh_wait_for_multiple_objects_async(lua_State* L)
+    static int pesh_reset_thread(lua_State* L)
     {
-        lua_State* co = lua_tothread(L, 1);
-        if (!co) return luaL_error(L, "Arg 1 must be a coroutine");
-        if (!lua_istable(L, 2)) return luaL_error(L, "Arg 2 must be a table of FFI SafeHandles");
+#ifdef HAVE_LUA_RESETTHREAD
+        if (!lua_isthread(L, 1)) return luaL_argerror(L, 1, "thread expected");
+        lua_resetthread(L, lua_tothread(L, 1));
+        lua_pushboolean(L, 1);
+#else
+        lua_pushboolean(L, 0);
+#endif
+        return 1;
+    }
 
-        WaitOperation op;
-        op.co = co;
+    // 按 tostring 语义把参数以空格连接，直接格式化进 spdlog 的缓冲区，不创建中间 Lua 字符串。
+    // 低于输出级别、只由飞行记录器捕获的调用不做格式化，只记录第一个字符串参数的前缀
+    static int LogWrite(lua_State* L, spdlog::level::level_enum level)
+    {
+        spdlog::logger* logger = spdlog::default_logger_raw();
+        bool            record = (int)level >= FlightLogLevel();
+        if (!logger->should_log(level))
+        {
+            if (record && lua_type(L, 1) == LUA_TSTRING)
+            {
+                size_t      len = 0;
+                const char* str = lua_tolstring(L, 1, &len);
+                FlightRecordText(FlightEvent::Log, (uint8_t)level, str, len);
+            }
+            return 0;
+        }
 
-        lua_pushnil(L);
-        while (lua_next(L, 2) != 0) {
-            if (lua_type(L, -1) == LUA_TCDATA) {
-                auto* handle_obj = static_cast<SafeHandle*>(const_cast<void*>(lua_topointer(L, -1)));
-                if (handle_obj && handle_obj->h) op.handles.push_back(handle_obj->h);
+        spdlog::memory_buf_t buf;
+        for (int i = 1, top = lua_gettop(L); i <= top; ++i) {
+            if (i > 1) buf.push_back(' ');
+            switch (lua_type(L, i)) {
+            case LUA_TSTRING: {
+                size_t len = 0;
+                const char* str = lua_tolstring(L, i, &len);
+                buf.append(str, str + len);
+                break;
+            }
+            case LUA_TNUMBER:  fmt::format_to(std::back_inserter(buf), "{:.14g}", lua_tonumber(L, i)); break;  // 与 LUA_NUMBER_FMT 一致
+            case LUA_TBOOLEAN: fmt::format_to(std::back_inserter(buf), "{}", lua_toboolean(L, i) ? "true" : "false"); break;
+            case LUA_TNIL:     fmt::format_to(std::back_inserter(buf), "nil"); break;
+            default: {
+                // 表、cdata 等交给 tostring，以尊重 __tostring
+                lua_getglobal(L, "tostring");
+                lua_pushvalue(L, i);
+                lua_call(L, 1, 1);
+                size_t len = 0;
+                const char* str = lua_tolstring(L, -1, &len);
+                if (str) buf.append(str, str + len);
+                lua_pop(L, 1);
+            }
             }
-            lua_pop(L, 1);
         }
+        if (record) FlightRecordText(FlightEvent::Log, (uint8_t)level, buf.data(), buf.size());
+        logger->log(level, spdlog::string_view_t(buf.data(), buf.size()));
+        return 0;
+    }
 
-        if (op.handles.empty()) {
-            lua_pushboolean(co, false);
-            lua_pushstring(co, "No valid handles provided.");
-            lua_resume(co, 2);
-            return 0;
+    // flight_dump([path]) -> path | nil, err；省略 path 时写入 logs/ 下本次会话的 .flight 文件
+    static int pesh_flight_dump(lua_State* L)
+    {
+        std::filesystem::path path = lua_isnoneornil(L, 1) ? std::filesystem::path() : Utf8Path(luaL_checkstring(L, 1));
+        std::filesystem::path written = DumpFlightRecorder(FlightDumpReason::OnDemand, path);
+        if (written.empty())
+        {
+            lua_pushnil(L);
+            lua_pushstring(L, "Failed to write flight recorder dump");
+            return 2;
         }
+        lua_pushstring(L, written.u8string().c_str());
+        return 1;
+    }
 
+    // flight_decode(path, json) -> text | nil, err
+    static int pesh_flight_decode(lua_State* L)
+    {
+        std::filesystem::path path = Utf8Path(luaL_checkstring(L, 1));
+        std::ostringstream    out;
+        std::string           error;
+        if (!DecodeFlightDump(path, lua_toboolean(L, 2) != 0, out, &error))
         {
-            std::lock_guard<std::mutex> lock(g_wait_operations_mutex);
-            for (HANDLE h : op.handles) g_wait_operations[h] = op;
-            g_handle_list_dirty = true;
+            lua_pushnil(L);
+            lua_pushstring(L, error.c_str());
+            return 2;
         }
+        std::string text = out.str();
+        lua_pushlstring(L, text.data(), text.size());
+        return 1;
+    }
+
+    // trace_begin(name) -> span, name_id，追踪关闭时只返回 0；span 为异步区间，可跨越 await。
+    // 两个值原样交给 trace_end。名称按字符串永久驻留在名称表中，应使用固定字符串或取值有限的组合
+    // (如 "plugin " .. 插件名)，不要把请求参数、路径这类无界的值拼进名称
+    static int pesh_trace_begin(lua_State* L)
+    {
+        if (!TraceEnabled()) { lua_pushinteger(L, 0); return 1; }
+        size_t      len  = 0;
+        const char* name = luaL_checklstring(L, 1, &len);
+        uint32_t    id   = TraceName(std::string_view(name, len));
+        uint64_t    span = TraceNextId();
+        if (span == 0) span = TraceNextId();
+        TraceAsyncBegin(id, TraceCategory::Lua, span, TraceNow());
+        lua_pushnumber(L, (lua_Number)span);  // 进程内计数，远小于 2^53，在 double 中精确
+        lua_pushinteger(L, id);
+        return 2;
+    }
+
+    // trace_end(span, name_id)
+    static int pesh_trace_end(lua_State* L)
+    {
+        lua_Number span = luaL_optnumber(L, 1, 0);
+        if (span <= 0 || !TraceEnabled()) return 0;
+        TraceAsyncEnd((uint32_t)luaL_checkinteger(L, 2), TraceCategory::Lua, (uint64_t)span, TraceNow());
         return 0;
     }
 
-    static int pesh_wait_for_multiple_objects_blocking(lua_State* L)
+    static int pesh_trace_enabled(lua_State* L)
     {
-        if (!lua_istable(L, 1)) return luaL_error(L, "Arg 1 must be table");
-        int timeout_ms = (int)luaL_optinteger(L, 2, -1);
-        DWORD timeout_dw = (timeout_ms < 0) ? INFINITE : (DWORD)timeout_ms;
+        lua_pushboolean(L, TraceEnabled());
+        return 1;
+    }
 
-        std::vector<HANDLE> handles;
-        lua_pushnil(L);
-        while (lua_next(L, 1) != 0) {
-            if (lua_type(L, -1) == LUA_TCDATA) {
-                auto* handle_obj = static_cast<SafeHandle*>(const_cast<void*>(lua_topointer(L, -1)));
-                if (handle_obj && handle_obj->h) handles.push_back(handle_obj->h);
+    // bundle_build(out_path, scripts_dir) -> 模块数 | nil, err
+    // 按 prelude 中 package.path 的模板为每个脚本推导模块名，靠前的模板优先，编译失败则整体失败
+    static int LuaStringWriter(lua_State*, const void* p, size_t size, void* ud)
+    {
+        static_cast<std::string*>(ud)->append(static_cast<const char*>(p), size);
+        return 0;
+    }
+
+    static int pesh_bundle_build(lua_State* L)
+    {
+        std::filesystem::path out  = Utf8Path(luaL_checkstring(L, 1));
+        std::filesystem::path root = Utf8Path(luaL_checkstring(L, 2));
+        static const char* kTemplates[] = {"?.lua", "?/init.lua", "lib/?.lua", "lib/?/init.lua", "core/?.lua"};
+
+        std::error_code ec;
+        std::map<std::string, std::pair<size_t, std::string>> names;  // 模块名 -> (模板序号, 相对路径)
+        for (auto it = std::filesystem::recursive_directory_iterator(root, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            if (!it->is_regular_file() || it->path().extension() != ".lua") continue;
+            std::string rel = it->path().lexically_relative(root).generic_u8string();
+            for (size_t t = 0; t < sizeof(kTemplates) / sizeof(kTemplates[0]); ++t) {
+                std::string tpl = kTemplates[t];
+                std::string prefix = tpl.substr(0, tpl.find('?')), suffix = tpl.substr(tpl.find('?') + 1);
+                if (rel.size() <= prefix.size() + suffix.size() || rel.compare(0, prefix.size(), prefix) != 0 ||
+                    rel.compare(rel.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+                std::string name = rel.substr(prefix.size(), rel.size() - prefix.size() - suffix.size());
+                if (name.find('.') != std::string::npos) continue;  // require 无法表达含点的文件名
+                std::replace(name.begin(), name.end(), '/', '.');
+                auto existing = names.find(name);
+                if (existing == names.end() || existing->second.first > t) names[name] = {t, rel};
             }
-            lua_pop(L, 1);
         }
+        if (ec) { lua_pushnil(L); lua_pushstring(L, ec.message().c_str()); return 2; }
 
-        if (handles.empty()) { lua_pushnil(L); lua_pushstring(L, "No handles"); return 2; }
+        // 同一文件可能对应多个模块名，只编译一次；大小与修改时间在读取前取得，编译期间的改动在下次启动时被识别
+        std::map<std::string, BundleModule> compiled;
+        std::vector<BundleModule> modules;
+        for (const auto& entry : names) {
+            const std::string& rel = entry.second.second;
+            auto cached = compiled.find(rel);
+            if (cached == compiled.end()) {
+                BundleModule module;
+                module.source = rel;
+                if (!StatBundleSource(root / std::filesystem::u8path(rel), &module.source_size, &module.source_mtime)) {
+                    lua_pushnil(L);
+                    lua_pushfstring(L, "cannot stat %s", rel.c_str());
+                    return 2;
+                }
+                std::ifstream in(root / std::filesystem::u8path(rel), std::ios::binary);
+                std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+                if (source.compare(0, 3, "\xEF\xBB\xBF") == 0) source.erase(0, 3);
+                if (!source.empty() && source[0] == '#') source.erase(0, source.find('\n'));  // 与 loadfile 一样跳过首行 #!，保留行号
 
-        DWORD res = WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE, timeout_dw);
-        if (res >= WAIT_OBJECT_0 && res < (WAIT_OBJECT_0 + handles.size())) {
-            lua_pushinteger(L, res - WAIT_OBJECT_0 + 1);
-            return 1;
-        } else if (res == WAIT_TIMEOUT) {
-            lua_pushnil(L); lua_pushstring(L, "Timeout"); return 2;
-        } else {
-            lua_pushnil(L); lua_pushstring(L, "Failed"); return 2;
+                std::string chunkname = "@" + rel;
+                if (luaL_loadbuffer(L, source.data(), source.size(), chunkname.c_str()) != 0) {
+                    lua_pushnil(L);
+                    lua_insert(L, -2);
+                    return 2;
+                }
+                lua_dump(L, LuaStringWriter, &module.bytecode);
+                lua_pop(L, 1);
+                cached = compiled.emplace(rel, std::move(module)).first;
+            }
+            modules.push_back(cached->second);
+            modules.back().name = entry.first;
         }
+
+        std::string error;
+        if (!WriteBytecodeBundle(out, modules, &error)) { lua_pushnil(L); lua_pushstring(L, error.c_str()); return 2; }
+        lua_pushinteger(L, (lua_Integer)modules.size());
+        return 1;
     }
 
-    static int pesh_reset_thread(lua_State* L)
+    // package.loaders 的第 2 项 (preload 之后、文件搜索之前)：包中没有的模块交给后面的搜索器
+    static int pesh_bundle_loader(lua_State* L)
     {
-#ifdef HAVE_LUA_RESETTHREAD
-        if (!lua_isthread(L, 1)) return luaL_argerror(L, 1, "thread expected");
-        lua_resetthread(L, lua_tothread(L, 1));
-        lua_pushboolean(L, 1);
-#else
-        lua_pushboolean(L, 0);
-#endif
+        size_t         len;
+        const char*    name = luaL_checklstring(L, 1, &len);
+        const uint8_t* data;
+        size_t         size;
+        if (!g_bundle->Find(std::string_view(name, len), &data, &size)) {
+            lua_pushfstring(L, "\n\tno module '%s' in bytecode bundle", name);
+            return 1;
+        }
+        if (luaL_loadbuffer(L, reinterpret_cast<const char*>(data), size, name) != 0) return lua_error(L);
         return 1;
     }
 
-#define DEFINE_LOG_FUNC(name, level) \
-    static int pesh_log_##name(lua_State* L) { spdlog::level(luaL_checkstring(L, 1)); return 0; }
+#define DEFINE_LOG_FUNC(name, lvl) \
+    static int pesh_log_##name(lua_State* L) { return LogWrite(L, spdlog::level::lvl); }
 
     DEFINE_LOG_FUNC(trace, trace)
     DEFINE_LOG_FUNC(debug, debug)
     DEFINE_LOG_FUNC(info, info)
     DEFINE_LOG_FUNC(warn, warn)
-    DEFINE_LOG_FUNC(error, error)
+    DEFINE_LOG_FUNC(error, err)
     DEFINE_LOG_FUNC(critical, critical)
+
+    // 指向当前日志级别的 lightuserdata，core/log.lua 以 const volatile int32_t* 读取
+    static int pesh_log_level_ptr(lua_State* L)
+    {
+        static_assert(sizeof(std::atomic<int>) == sizeof(int32_t), "log level must be FFI-readable as int32_t");
+        lua_pushlightuserdata(L, const_cast<std::atomic<int>*>(ActiveLogLevel()));
+        return 1;
+    }
 }
 
 lua_State* InitializeLuaState(const std::string& package_root_dir)
 {
+    PESH_TRACE_SCOPE("InitializeLuaState", TraceCategory::Boot);
     lua_State* L = luaL_newstate();
     if (!L) { spdlog::critical("Failed to create Lua state."); return nullptr; }
     luaL_openlibs(L);
@@ -225,18 +1501,76 @@ lua_State* InitializeLuaState(const std::string& package_root_dir)
         {"wait_for_multiple_objects", LuaBindings::pesh_wait_for_multiple_objects_async},
         {"wait_for_multiple_objects_blocking", LuaBindings::pesh_wait_for_multiple_objects_blocking},
         {"dispatch_worker", LuaBindings::pesh_dispatch_worker},
+        {"worker_id", LuaBindings::pesh_worker_id},
+        {"dispatch", LuaBindings::pesh_dispatch},
+        {"cancel_worker", LuaBindings::pesh_cancel_worker},
+        {"chunk_reader_open", LuaBindings::pesh_chunk_reader_open},
+        {"chunk_reader_next", LuaBindings::pesh_chunk_reader_next},
+        {"chunk_reader_close", LuaBindings::pesh_chunk_reader_close},
+        {"tree_copy_start", LuaBindings::pesh_tree_copy_start},
+        {"tree_copy_next", LuaBindings::pesh_tree_copy_next},
+        {"tree_copy_close", LuaBindings::pesh_tree_copy_close},
+        {"tree_scan_start", LuaBindings::pesh_tree_scan_start},
+        {"tree_scan_next", LuaBindings::pesh_tree_scan_next},
+        {"tree_scan_close", LuaBindings::pesh_tree_scan_close},
+        {"spawn", LuaBindings::pesh_spawn},
+        {"coroutine_stats", LuaBindings::pesh_coroutine_stats},
+        {"stats", LuaBindings::pesh_stats},
+        {"stats_endpoints", LuaBindings::pesh_stats_endpoints},
+        {"stats_query", LuaBindings::pesh_stats_query},
+        {"command_next", LuaBindings::pesh_command_next},
+        {"command_reply", LuaBindings::pesh_command_reply},
+        {"process_find", LuaBindings::pesh_process_find},
+        {"process_wait", LuaBindings::pesh_process_wait},
+        {"process_table_stats", LuaBindings::pesh_process_table_stats},
+        {"supervisor_start", LuaBindings::pesh_supervisor_start},
+        {"supervisor_next", LuaBindings::pesh_supervisor_next},
+        {"supervisor_status", LuaBindings::pesh_supervisor_status},
+        {"supervisor_stop", LuaBindings::pesh_supervisor_stop},
+        {"supervisor_close", LuaBindings::pesh_supervisor_close},
+        {"pipe_spawn", LuaBindings::pesh_pipe_spawn},
+        {"pipe_read", LuaBindings::pesh_pipe_read},
+        {"pipe_read_any", LuaBindings::pesh_pipe_read_any},
+        {"pipe_write", LuaBindings::pesh_pipe_write},
+        {"pipe_close_stdin", LuaBindings::pesh_pipe_close_stdin},
+        {"pipe_wait", LuaBindings::pesh_pipe_wait},
+        {"pipe_kill", LuaBindings::pesh_pipe_kill},
+        {"pipe_close", LuaBindings::pesh_pipe_close},
+        {"write_append", LuaBindings::pesh_write_append},
+        {"write_replace", LuaBindings::pesh_write_replace},
+        {"write_flush", LuaBindings::pesh_write_flush},
         {"reset_thread", LuaBindings::pesh_reset_thread},
+        {"set_resume_budget", LuaBindings::pesh_set_resume_budget},
+        {"quit", LuaBindings::pesh_quit},
         {"log_trace", LuaBindings::pesh_log_trace},
         {"log_debug", LuaBindings::pesh_log_debug},
         {"log_info", LuaBindings::pesh_log_info},
         {"log_warn", LuaBindings::pesh_log_warn},
         {"log_error", LuaBindings::pesh_log_error},
         {"log_critical", LuaBindings::pesh_log_critical},
+        {"log_level_ptr", LuaBindings::pesh_log_level_ptr},
+        {"flight_dump", LuaBindings::pesh_flight_dump},
+        {"flight_decode", LuaBindings::pesh_flight_decode},
+        {"bundle_build", LuaBindings::pesh_bundle_build},
+        {"trace_begin", LuaBindings::pesh_trace_begin},
+        {"trace_end", LuaBindings::pesh_trace_end},
+        {"trace_enabled", LuaBindings::pesh_trace_enabled},
+        {"parallel_submit", LuaBindings::pesh_parallel_submit},
+        {"parallel_stats", LuaBindings::pesh_parallel_stats},
+        {"shared_new", LuaBindings::pesh_shared_new},
+        {"shared_adopt", LuaBindings::pesh_shared_adopt},
+        {"shared_wrapper", LuaBindings::pesh_shared_wrapper},
         {NULL, NULL}};
     lua_newtable(L);
     luaL_setfuncs(L, pesh_native_lib, 0);
     lua_setglobal(L, "pesh_native");
 
+    LuaBindings::RegisterHandleType(L, LuaBindings::kPipeHandleType, LuaBindings::pesh_pipe_gc);
+    LuaBindings::RegisterHandleType(L, LuaBindings::kChunkReaderType, LuaBindings::pesh_chunk_reader_gc);
+    LuaBindings::RegisterHandleType(L, LuaBindings::kTreeCopyType, LuaBindings::pesh_tree_copy_gc);
+    LuaBindings::RegisterHandleType(L, LuaBindings::kTreeScanType, LuaBindings::pesh_tree_scan_gc);
+    LuaBindings::RegisterHandleType(L, LuaBindings::kSupervisorType, LuaBindings::pesh_supervisor_gc);
+
     std::filesystem::path exe_dir = std::filesystem::path(package_root_dir) / "bin";
     lua_pushstring(L, exe_dir.string().c_str());
     lua_setglobal(L, "PESHELL_EXE_DIR");
@@ -244,13 +1578,253 @@ lua_State* InitializeLuaState(const std::string& package_root_dir)
     return L;
 }
 
+// 把字节码包的查找插到 package.loaders 的文件搜索之前；包之外的模块 (如后来新增的插件) 照常从磁盘加载
+static void InstallBundleLoader(lua_State* L)
+{
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "loaders");
+    for (int i = (int)lua_objlen(L, -1); i >= 2; --i) {
+        lua_rawgeti(L, -1, i);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_pushcfunction(L, LuaBindings::pesh_bundle_loader);
+    lua_rawseti(L, -2, 2);
+    lua_pop(L, 2);
+}
+
+// 映射字节码包并为主状态安装查找；Lua 工作者状态共用同一份映射
+static void InstallBytecodeBundle(lua_State* L, const std::filesystem::path& package_root)
+{
+    PESH_TRACE_SCOPE("InstallBytecodeBundle", TraceCategory::Boot);
+    const char* env = getenv("PESHELL_BUNDLE");
+    if (env && strcmp(env, "0") == 0) return;
+    std::filesystem::path path = package_root / "bin" / "peshell.bundle";
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) return;
+
+    std::string error;
+    g_bundle = BytecodeBundle::Open(path, package_root / "share" / "lua" / "5.1", &error);
+    if (!g_bundle) {
+        spdlog::warn("Ignoring bytecode bundle: {}", error);
+        return;
+    }
+    InstallBundleLoader(L);
+    spdlog::debug("Bytecode bundle: {} modules from {}", g_bundle->Size(), path.string());
+}
+
+// prelude 优先取自字节码包
+static bool RunPrelude(lua_State* L, const std::filesystem::path& package_root)
+{
+    PESH_TRACE_SCOPE("prelude", TraceCategory::Boot);
+    const uint8_t* data;
+    size_t         size;
+    if (g_bundle && g_bundle->Find("prelude", &data, &size)) {
+        return luaL_loadbuffer(L, reinterpret_cast<const char*>(data), size, "prelude") == LUA_OK &&
+               lua_pcall(L, 0, LUA_MULTRET, 0) == LUA_OK;
+    }
+    std::string prelude_path = (package_root / "share" / "lua" / "5.1" / "prelude.lua").string();
+    return luaL_dofile(L, prelude_path.c_str()) == LUA_OK;
+}
+
+// Lua 工作者状态：与主状态相同的 prelude 与 package.path，但 pesh_native 只有可在任意线程调用的函数
+// (日志、追踪、阻塞休眠、共享缓冲区)；调度器、等待与进程类接口只属于主状态。在线程池线程上调用
+static lua_State* InitializeWorkerLuaState(const std::filesystem::path& package_root, std::string* error)
+{
+    lua_State* L = luaL_newstate();
+    if (!L) { *error = "luaL_newstate failed"; return nullptr; }
+    luaL_openlibs(L);
+
+    static const struct luaL_Reg worker_native_lib[] = {
+        {"sleep", LuaBindings::pesh_sleep},
+        {"log_trace", LuaBindings::pesh_log_trace},
+        {"log_debug", LuaBindings::pesh_log_debug},
+        {"log_info", LuaBindings::pesh_log_info},
+        {"log_warn", LuaBindings::pesh_log_warn},
+        {"log_error", LuaBindings::pesh_log_error},
+        {"log_critical", LuaBindings::pesh_log_critical},
+        {"log_level_ptr", LuaBindings::pesh_log_level_ptr},
+        {"trace_begin", LuaBindings::pesh_trace_begin},
+        {"trace_end", LuaBindings::pesh_trace_end},
+        {"trace_enabled", LuaBindings::pesh_trace_enabled},
+        {"shared_new", LuaBindings::pesh_shared_new},
+        {"shared_wrapper", LuaBindings::pesh_shared_wrapper},
+        {NULL, NULL}};
+    lua_newtable(L);
+    luaL_setfuncs(L, worker_native_lib, 0);
+    lua_setglobal(L, "pesh_native");
+
+    std::filesystem::path exe_dir = package_root / "bin";
+    lua_pushstring(L, exe_dir.string().c_str());
+    lua_setglobal(L, "PESHELL_EXE_DIR");
+    lua_pushboolean(L, 1);
+    lua_setglobal(L, "PESHELL_WORKER");
+
+    if (g_bundle) InstallBundleLoader(L);
+    // parallel 插件登记共享缓冲区的包装函数，作业参数中的缓冲区才能以 cdata 交付
+    if (!RunPrelude(L, package_root) || luaL_dostring(L, "pesh.plugin.load('parallel')") != LUA_OK) {
+        const char* message = lua_tostring(L, -1);
+        *error = message ? message : "prelude failed";
+        lua_close(L);
+        return nullptr;
+    }
+    lua_settop(L, 0);
+    return L;
+}
+
+// config/threads.ini 的 [ThreadPool] 节，缺省时生成默认文件
+static ThreadPoolOptions LoadThreadPoolOptions(const std::filesystem::path& package_root)
+{
+    std::filesystem::path config_path = package_root / "config" / "threads.ini";
+    if (!std::filesystem::exists(config_path)) {
+        std::ofstream default_config(config_path);
+        if (default_config.is_open()) {
+            default_config << "[ThreadPool]\n"
+                              "; CPU 通道线程数，0 = 逻辑核心数\n"
+                              "cpu_threads = 0\n"
+                              "; 阻塞 I/O 通道：常驻线程数 / 弹性上限 / 多余线程空闲退出时间 (毫秒)\n"
+                              "io_threads = 2\n"
+                              "io_max_threads = 64\n"
+                              "io_idle_ms = 10000\n";
+        }
+    }
+
+    IniValues         config = ReadIniFile(config_path);
+    ThreadPoolOptions options;
+    options.cpu_threads    = (size_t)std::max<int64_t>(0, IniInt(config, "ThreadPool.cpu_threads", 0));
+    options.io_threads     = (size_t)std::max<int64_t>(0, IniInt(config, "ThreadPool.io_threads", (int64_t)options.io_threads));
+    options.io_max_threads = (size_t)std::max<int64_t>(1, IniInt(config, "ThreadPool.io_max_threads", (int64_t)options.io_max_threads));
+    options.io_idle_ms     = (uint32_t)std::max<int64_t>(100, IniInt(config, "ThreadPool.io_idle_ms", options.io_idle_ms));
+    return options;
+}
+
+// 注册表的执行与完成投递接到线程池和调度器上；定时器由事件循环的时间轮驱动，不占用线程池
+static void InstallWorkerHooks()
+{
+    WorkerRegistry& registry = WorkerRegistry::Instance();
+    registry.SetHooks(
+        [](std::function<void()> task, TaskLane lane) { g_thread_pool->Push(std::move(task), lane); },
+        [](void* waiter, WorkerResult result) {
+            lua_State* co = static_cast<lua_State*>(waiter);
+            if (!result.ok) g_scheduler->PostFailure(co, result.error_code, std::move(result.error));
+            else if (result.value.type == WorkerValueType::Buffer) g_scheduler->PostBuffer(co, result.value.buffer);
+            else if (result.value.type == WorkerValueType::String) PostCompletion(co, true, std::move(result.value.string), "");
+            else g_scheduler->PostValue(co, [value = std::move(result.value)](lua_State* target) { LuaBindings::PushWorkerValue(target, value); });
+        });
+    registry.RegisterInline("timer", {WorkerValueType::Integer}, [](const WorkerArgs& args, void* waiter) {
+        g_scheduler->SleepAsync(static_cast<lua_State*>(waiter), args[0].integer > 0 ? (uint64_t)args[0].integer : 0);
+    });
+}
+
+#if !defined(_WIN32)
+// WaitSet 为每个等待注册 dup 一个 fd，默认 1024 的软限制不够守护数百个对象
+static void RaiseFdLimit()
+{
+    rlimit lim{};
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+}
+#endif
+
+// 可交给常驻实例代为执行的命令：只作用于系统状态、很快返回，结果与调用方的环境变量无关。
+// exec 不在其中：常驻实例启动的子进程会继承它自己的环境，而不是调用方的
+static bool IsForwardableCommand(const char* name)
+{
+    for (const char* command : {"kill", "killtree", "shutdown"}) {
+        if (strcmp(name, command) == 0) return true;
+    }
+    return false;
+}
+
+// 本机有常驻的 main 实例时由它执行命令，省去日志、Lua 状态与 prelude 的初始化；
+// 没有实例或 PESHELL_FORWARD=0 时返回 false，照常冷启动
+static bool TryForwardCommand(const std::vector<char*>& args, int* exit_code)
+{
+    if (args.size() < 2 || !IsForwardableCommand(args[1])) return false;
+    const char* env = getenv("PESHELL_FORWARD");
+    if (env && strcmp(env, "0") == 0) return false;
+
+    CommandRequest request;
+    std::error_code ec;
+    request.cwd = std::filesystem::current_path(ec).u8string();
+    request.args.assign(args.begin() + 1, args.end());
+    CommandReply reply;
+    if (!ForwardCommand(DefaultCommandEndpoint(), request, &reply)) return false;
+#if defined(_WIN32)
+    SetConsoleOutputCP(CP_UTF8);  // 输出来自常驻实例的 Lua，为 UTF-8
+#endif
+    fwrite(reply.output.data(), 1, reply.output.size(), stdout);
+    fflush(stdout);
+    *exit_code = reply.exit_code;
+    return true;
+}
+
+// 接收转发命令的端点；交给 remote 插件在事件循环上逐条执行。同一会话已有常驻实例时不启动
+static void StartCommandServer(lua_State* L)
+{
+    std::string error;
+    g_command_server = CommandServer::Start(DefaultCommandEndpoint(), [](CommandRequest request, CommandServer::Reply reply) {
+        std::unique_lock<std::mutex> lock(g_command_inbox.mutex);
+        uint64_t id = ++g_command_inbox.next_id;
+        g_command_inbox.replies.emplace(id, std::move(reply));
+        lua_State* co = std::exchange(g_command_inbox.waiter, nullptr);
+        if (!co) {
+            g_command_inbox.queue.emplace_back(id, std::move(request));
+            return;
+        }
+        lock.unlock();
+        LuaBindings::DeliverForwardedCommand(co, id, std::move(request));
+    }, &error);
+    if (!g_command_server) {
+        spdlog::warn("Command forwarding unavailable (another resident instance?): {}", error);
+        return;
+    }
+    if (luaL_dostring(L, "pesh.plugin.load('remote').serve()") != LUA_OK) {
+        spdlog::error("Command forwarding disabled: {}", lua_tostring(L, -1));
+        lua_pop(L, 1);
+        g_command_server.reset();
+    }
+}
+
+// 停止接收；尚未应答的客户端随连接关闭得到退出码 1
+static void StopCommandServer()
+{
+    g_command_server.reset();
+    std::lock_guard<std::mutex> lock(g_command_inbox.mutex);
+    g_command_inbox.queue.clear();
+    g_command_inbox.replies.clear();
+    g_command_inbox.waiter = nullptr;
+}
+
 int main(int argc, char* argv[])
 {
+    auto startup_begin = std::chrono::steady_clock::now();
+    // 全局选项 --trace[=path] 写在命令名之前，分派前从参数中去掉
+    std::vector<char*>    args(argv, argv + argc);
+    bool                  trace_flag = false;
+    std::filesystem::path trace_path;
+    while (args.size() > 1 && strncmp(args[1], "--trace", 7) == 0 && (args[1][7] == '\0' || args[1][7] == '=')) {
+        trace_flag = true;
+        if (args[1][7] == '=') trace_path = args[1] + 8;
+        args.erase(args.begin() + 1);
+    }
+    int forwarded_code = 0;
+    if (!trace_flag && TryForwardCommand(args, &forwarded_code)) return forwarded_code;
+    StartTracing(trace_flag, trace_path);
+    SetTraceThreadName("main");
+#if defined(_WIN32)
     timeBeginPeriod(1);
-    DWORD pid = GetCurrentProcessId();
+    unsigned long pid = GetCurrentProcessId();
     char exe_path_buf[MAX_PATH];
     GetModuleFileNameA(NULL, exe_path_buf, MAX_PATH);
-    std::filesystem::path package_root = std::filesystem::path(exe_path_buf).parent_path().parent_path();
+    std::filesystem::path exe_path(exe_path_buf);
+#else
+    RaiseFdLimit();
+    unsigned long pid = (unsigned long)getpid();
+    std::filesystem::path exe_path = std::filesystem::read_symlink("/proc/self/exe");
+#endif
+    std::filesystem::path package_root = exe_path.parent_path().parent_path();
     std::string package_root_str = package_root.string();
 
     InitializeLogger(package_root_str, pid, argc, argv);
@@ -259,98 +1833,101 @@ int main(int argc, char* argv[])
     lua_State* L = InitializeLuaState(package_root_str);
     if (!L) { ShutdownLogger(); return 1; }
 
-    g_hTaskCompletedEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    {
+        PESH_TRACE_SCOPE("ThreadPool", TraceCategory::Boot);
+        g_thread_pool = std::make_unique<ThreadPool>(LoadThreadPoolOptions(package_root));
+    }
+    AddMetricsSource([](MetricsSnapshot& snapshot) {
+        snapshot.values.push_back({"pool_cpu_threads", (int64_t)g_thread_pool->CpuThreads()});
+        snapshot.values.push_back({"pool_io_threads", (int64_t)g_thread_pool->IoThreads()});
+        snapshot.values.push_back({"pool_tasks_outstanding", (int64_t)g_thread_pool->Outstanding()});
+    });
+    spdlog::debug("Thread pool: {} CPU threads, {} resident I/O threads.", g_thread_pool->CpuThreads(), g_thread_pool->IoThreads());
+    g_scheduler = std::make_unique<Scheduler>(L);
+    InstallWorkerHooks();
+    g_lua_workers = std::make_unique<LuaWorkerPool>(
+        [package_root](std::string* error) { return InitializeWorkerLuaState(package_root, error); },
+        [](std::function<void()> task) { g_thread_pool->Push(std::move(task), TaskLane::Cpu); },
+        g_thread_pool->CpuThreads());
+    AddMetricsSource([](MetricsSnapshot& snapshot) {
+        LuaWorkerPool::Stats stats = g_lua_workers->GetStats();
+        snapshot.values.push_back({"lua_worker_states", (int64_t)stats.states});
+        snapshot.values.push_back({"lua_jobs_queued", (int64_t)stats.queued});
+        snapshot.values.push_back({"lua_jobs_completed", (int64_t)stats.completed});
+        snapshot.values.push_back({"lua_jobs_failed", (int64_t)stats.failed});
+    });
+    AddMetricsSource([](MetricsSnapshot& snapshot) {
+        if (!g_write_behind) return;
+        WriteBehind::Stats stats = g_write_behind->GetStats();
+        snapshot.values.push_back({"write_behind_requests", (int64_t)stats.requests});
+        snapshot.values.push_back({"write_behind_batches", (int64_t)stats.batches});
+        snapshot.values.push_back({"write_behind_syncs", (int64_t)stats.syncs});
+        snapshot.values.push_back({"write_behind_errors", (int64_t)stats.errors});
+        snapshot.values.push_back({"write_behind_pending_bytes", (int64_t)stats.pending_bytes});
+    });
 
-    std::string prelude_path = (package_root / "share" / "lua" / "5.1" / "prelude.lua").string();
-    if (luaL_dofile(L, prelude_path.c_str()) != LUA_OK) {
+    InstallBytecodeBundle(L, package_root);
+    if (!RunPrelude(L, package_root)) {
         spdlog::critical("Failed to load prelude: {}", lua_tostring(L, -1));
         lua_close(L);
         ShutdownLogger();
         return 1;
     }
 
+    static const uint32_t kTraceDispatch = TraceName("DispatchCommand");
+    uint64_t dispatch_begin = TraceEnabled() ? TraceNow() : 0;
     lua_getglobal(L, "DispatchCommand");
-    for (int i = 1; i < argc; ++i) lua_pushstring(L, argv[i]);
+    for (size_t i = 1; i < args.size(); ++i) lua_pushstring(L, args[i]);
 
     int return_code = 0;
-    if (lua_pcall(L, argc - 1, 1, 0) != LUA_OK) {
+    int dispatch_status = lua_pcall(L, (int)args.size() - 1, 1, 0);
+    if (dispatch_begin) TraceComplete(kTraceDispatch, TraceCategory::Boot, dispatch_begin, TraceNow());
+    if (dispatch_status != LUA_OK) {
         spdlog::critical("Dispatcher error: {}", lua_tostring(L, -1));
         return_code = 1;
     } else {
         return_code = lua_isnumber(L, -1) ? (int)lua_tointeger(L, -1) : 0;
         lua_pop(L, 1);
     }
+    double startup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_begin).count();
+    if (g_bundle) spdlog::info("Startup: DispatchCommand returned after {:.2f} ms ({} modules from bundle, {} stale).", startup_ms, g_bundle->Hits(), g_bundle->Stale());
+    else spdlog::info("Startup: DispatchCommand returned after {:.2f} ms (loose files).", startup_ms);
 
-    bool is_main_mode = (argc > 1 && strcmp(argv[1], "main") == 0);
+    bool is_main_mode = (args.size() > 1 && strcmp(args[1], "main") == 0);
     if (is_main_mode && return_code == 0)
     {
-        spdlog::info("Entering persistent loop.");
-        MSG msg;
-        bool is_running = true;
-        while (is_running)
-        {
-            if (g_handle_list_dirty) {
-                std::lock_guard<std::mutex> lock(g_wait_operations_mutex);
-                g_wait_handles_cache.clear();
-                g_wait_handles_cache.push_back(g_hTaskCompletedEvent);
-                for (auto const& [handle, op] : g_wait_operations) g_wait_handles_cache.push_back(handle);
-                g_handle_list_dirty = false;
-            }
-
-            DWORD res = MsgWaitForMultipleObjects((DWORD)g_wait_handles_cache.size(), g_wait_handles_cache.data(), FALSE, INFINITE, QS_ALLINPUT);
-
-            if (res >= WAIT_OBJECT_0 && res < (WAIT_OBJECT_0 + g_wait_handles_cache.size()))
-            {
-                HANDLE h = g_wait_handles_cache[res - WAIT_OBJECT_0];
-                if (h == g_hTaskCompletedEvent) {
-                    std::queue<AsyncTaskResult> tasks;
-                    { std::lock_guard<std::mutex> lock(g_completed_tasks_mutex); tasks.swap(g_completed_tasks); }
-                    while (!tasks.empty()) {
-                        AsyncTaskResult r = tasks.front(); tasks.pop();
-                        if (lua_status(r.co) != LUA_YIELD) continue;
-                        lua_pushboolean(r.co, r.success);
-                        if(r.success) lua_pushlstring(r.co, r.data.c_str(), r.data.length());
-                        else lua_pushstring(r.co, r.error_msg.c_str());
-                        lua_resume(r.co, 2);
-                    }
-                } else {
-                    WaitOperation op;
-                    bool found = false;
-                    {
-                        std::lock_guard<std::mutex> lock(g_wait_operations_mutex);
-                        if (g_wait_operations.count(h)) {
-                            op = g_wait_operations.at(h);
-                            for (HANDLE hh : op.handles) g_wait_operations.erase(hh);
-                            g_handle_list_dirty = true;
-                            found = true;
-                        }
-                    }
-                    if (found && lua_status(op.co) == LUA_YIELD) {
-                        lua_pushboolean(op.co, true);
-                        int idx = 0;
-                        for(size_t i=0; i<op.handles.size(); ++i) if(op.handles[i]==h) { idx=i+1; break; }
-                        lua_pushinteger(op.co, idx);
-                        lua_resume(op.co, 2);
-                    }
-                }
-            }
-            else if (res == (WAIT_OBJECT_0 + g_wait_handles_cache.size())) {
-                while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
-                    if (msg.message == WM_QUIT) { is_running = false; break; }
-                    TranslateMessage(&msg); DispatchMessage(&msg);
-                }
-            }
-        }
+        spdlog::info("Entering persistent loop ({} backend).", g_scheduler->BackendName());
+        std::string stats_error;
+        auto stats_server = StatsServer::Start(pid, &stats_error);
+        if (!stats_server) spdlog::warn("Runtime stats endpoint unavailable: {}", stats_error);
+        StartCommandServer(L);
+        return_code = g_scheduler->Run();
+        StopCommandServer();
+        stats_server.reset();
     }
 
-    g_thread_pool.stop(true);
-    if (g_hTaskCompletedEvent) CloseHandle(g_hTaskCompletedEvent);
-    if (L) lua_close(L);
+    {
+        PESH_TRACE_SCOPE("Shutdown", TraceCategory::Boot);
+        ClearMetricsSources();
+        g_thread_pool->Stop(true);
+        g_lua_workers.reset();  // 排队作业已随线程池执行完毕，这里只关闭空闲状态
+        g_write_behind.reset();  // 排队的写入同样已随线程池写完，回调投递到调度器
+        g_process_table.reset();  // 服务线程的回调会投递到调度器
+        g_pipe_reactor.reset();  // 同上；仍在运行的管道子进程随之结束
+        for (auto* supervisor : g_supervisors) supervisor->reset();  // 同上；被监督的子进程不比宿主活得久
+        g_supervisors.clear();
+        g_scheduler.reset();
+        if (L) lua_close(L);
+        g_bundle.reset();
+    }
     ShutdownLogger();
+#if defined(_WIN32)
     timeEndPeriod(1);
+#endif
     return return_code;
 }
 
+#if defined(_WIN32)
 std::wstring Utf8ToWide(const std::string& str)
 {
     if (str.empty()) return std::wstring();
@@ -358,4 +1935,5 @@ std::wstring Utf8ToWide(const std::string& str)
     std::wstring wstr(size, 0);
     MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstr[0], size);
     return wstr;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+// 侵入式无锁 MPSC 队列。
+// 生产者 (任意线程) 用 CAS 压栈；唯一的消费者 (事件循环) 一次性摘走整条链并反转为 FIFO。
+// Push 返回 true 表示队列由空变为非空，只有这种情况才需要唤醒消费者。
+// 节点类型 T 需要一个 `T* mpsc_next` 成员，节点所有权随 Push/Pop 转移。
+
+#include <atomic>
+
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() = default;
+
+    MpscQueue(const MpscQueue&)            = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    bool Push(T* node)
+    {
+        T* head = head_.load(std::memory_order_relaxed);
+        do
+        {
+            node->mpsc_next = head;
+        } while (!head_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+        return head == nullptr;
+    }
+
+    // 以下仅限消费者线程调用
+    T* Pop()
+    {
+        if (!cache_) cache_ = TakeAll();
+        T* node = cache_;
+        if (node)
+        {
+            cache_          = node->mpsc_next;
+            node->mpsc_next = nullptr;
+        }
+        return node;
+    }
+
+    bool Empty() const
+    {
+        return !cache_ && !head_.load(std::memory_order_acquire);
+    }
+
+private:
+    T* TakeAll()
+    {
+        T* node = head_.exchange(nullptr, std::memory_order_acquire);
+        T* fifo = nullptr;
+        while (node)
+        {
+            T* next         = node->mpsc_next;
+            node->mpsc_next = fifo;
+            fifo            = node;
+            node            = next;
+        }
+        return fifo;
+    }
+
+    std::atomic<T*> head_{nullptr};
+    T*              cache_ = nullptr;  // 消费者私有，已按 FIFO 排好的批次
+};
@@ -0,0 +1,298 @@
+#include "process_pipe.h"
+
+#include <algorithm>
+#include <cstring>
+
+int ByteRing::FreeSpans(uint8_t* ptrs[2], size_t lens[2])
+{
+    size_t capacity = data_.size();
+    size_t free     = capacity - size_;
+    if (free == 0) return 0;
+    size_t tail  = (head_ + size_) % capacity;
+    size_t first = std::min(free, capacity - tail);
+    ptrs[0]      = data_.data() + tail;
+    lens[0]      = first;
+    if (first == free) return 1;
+    ptrs[1] = data_.data();
+    lens[1] = free - first;
+    return 2;
+}
+
+void ByteRing::Commit(size_t n)
+{
+    size_ += n;
+}
+
+std::string ByteRing::Take(size_t max_bytes)
+{
+    size_t      n = std::min(max_bytes, size_);
+    std::string out(n, '\0');
+    if (n == 0) return out;
+    size_t first = std::min(n, data_.size() - head_);
+    memcpy(&out[0], data_.data() + head_, first);
+    if (n > first) memcpy(&out[first], data_.data(), n - first);
+    head_ = (head_ + n) % data_.size();
+    size_ -= n;
+    return out;
+}
+
+// 生产者可能正在写入空闲区，不能把 head_ 归零
+void ByteRing::Clear()
+{
+    head_ = (head_ + size_) % data_.size();
+    size_ = 0;
+}
+
+std::string PipedProcess::TakeLocked(Output& out, size_t max_bytes, bool* resume)
+{
+    std::string data = out.ring.Take(max_bytes);
+    // 腾出一半再恢复，避免每取一小块就唤醒一次反应器
+    if (out.paused && out.ring.Free() * 2 >= out.ring.Capacity())
+    {
+        out.paused = false;
+        *resume    = true;
+    }
+    return data;
+}
+
+void PipedProcess::Read(PipeStream stream, size_t max_bytes, ReadFn callback)
+{
+    if (max_bytes == 0) max_bytes = 64 << 10;
+
+    std::string data;
+    bool        ready  = false;
+    bool        resume = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Output&                     out = outputs_[(int)stream];
+        if (out.ring.Size() > 0 || !out.open || discard_)
+        {
+            data  = TakeLocked(out, max_bytes, &resume);
+            ready = true;
+        }
+        else
+        {
+            out.waiter     = std::move(callback);
+            out.waiter_max = max_bytes;
+        }
+    }
+    if (resume) RequestResume(stream);
+    if (ready) callback(std::move(data));
+}
+
+void PipedProcess::ReadAny(size_t max_bytes, ReadAnyFn callback)
+{
+    if (max_bytes == 0) max_bytes = 64 << 10;
+
+    std::string data;
+    PipeStream  stream = PipeStream::Stdout;
+    bool        ready  = false;
+    bool        resume = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (outputs_[1].ring.Size() > outputs_[0].ring.Size()) stream = PipeStream::Stderr;
+        Output& out = outputs_[(int)stream];
+        if (out.ring.Size() > 0 || discard_ || (!outputs_[0].open && !outputs_[1].open))
+        {
+            data  = TakeLocked(out, max_bytes, &resume);
+            ready = true;
+        }
+        else
+        {
+            any_waiter_ = std::move(callback);
+            any_max_    = max_bytes;
+        }
+    }
+    if (resume) RequestResume(stream);
+    if (ready) callback(stream, std::move(data));
+}
+
+void PipedProcess::Write(std::string data, WriteFn callback)
+{
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stdin_open_ && !stdin_closing_ && !data.empty())
+        {
+            writes_.push_back({std::move(data), 0, std::move(callback)});
+            start = writes_.size() == 1;
+            callback = nullptr;
+        }
+    }
+    if (start) RequestWrite();
+    if (!callback) return;
+    if (data.empty()) callback(true, "");
+    else callback(false, "stdin is not open");
+}
+
+void PipedProcess::CloseStdin()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stdin_open_ || stdin_closing_) return;
+        stdin_closing_ = true;
+    }
+    RequestWrite();  // 队列写完后由反应器关闭
+}
+
+void PipedProcess::WaitExit(ExitFn callback)
+{
+    int code = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!exited_)
+        {
+            exit_waiters_.push_back(std::move(callback));
+            return;
+        }
+        code = exit_code_;
+    }
+    callback(code);
+}
+
+void PipedProcess::Kill()
+{
+    RequestKill();
+}
+
+void PipedProcess::Discard()
+{
+    ReadFn    waiters[2];
+    ReadAnyFn any_waiter;
+    bool      resume[2] = {false, false};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        discard_    = true;
+        any_waiter  = std::move(any_waiter_);
+        any_waiter_ = nullptr;
+        for (int i = 0; i < 2; ++i)
+        {
+            outputs_[i].ring.Clear();
+            waiters[i] = std::move(outputs_[i].waiter);
+            outputs_[i].waiter = nullptr;
+            resume[i]          = outputs_[i].paused;
+            outputs_[i].paused = false;
+        }
+    }
+    for (int i = 0; i < 2; ++i)
+    {
+        if (resume[i]) RequestResume((PipeStream)i);
+        if (waiters[i]) waiters[i]("");
+    }
+    if (any_waiter) any_waiter(PipeStream::Stdout, "");
+}
+
+uint64_t PipedProcess::BytesRead(PipeStream stream) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return outputs_[(int)stream].total;
+}
+
+std::string PipedProcess::StreamError(PipeStream stream) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return outputs_[(int)stream].error;
+}
+
+int PipedProcess::OutputSpans(PipeStream stream, uint8_t* ptrs[2], size_t lens[2])
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Output&                     out   = outputs_[(int)stream];
+    int                         count = out.ring.FreeSpans(ptrs, lens);
+    out.paused                        = count == 0;
+    return count;
+}
+
+void PipedProcess::OnOutput(PipeStream stream, size_t n, const std::string& error)
+{
+    ReadFn      waiter;
+    ReadAnyFn   any_waiter;
+    std::string data;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Output&                     out = outputs_[(int)stream];
+        if (n > 0)
+        {
+            out.ring.Commit(n);
+            out.total += n;
+            if (discard_) out.ring.Clear();
+        }
+        else
+        {
+            out.open  = false;
+            out.error = error;
+        }
+        if (out.waiter && (out.ring.Size() > 0 || !out.open))
+        {
+            data       = out.ring.Take(out.waiter_max);
+            waiter     = std::move(out.waiter);
+            out.waiter = nullptr;
+        }
+        else if (any_waiter_ && (out.ring.Size() > 0 || (!outputs_[0].open && !outputs_[1].open)))
+        {
+            data        = out.ring.Take(any_max_);
+            any_waiter  = std::move(any_waiter_);
+            any_waiter_ = nullptr;
+        }
+    }
+    if (waiter) waiter(std::move(data));
+    if (any_waiter) any_waiter(stream, std::move(data));
+}
+
+void PipedProcess::OnExit(int exit_code)
+{
+    std::vector<ExitFn> waiters;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        exited_    = true;
+        exit_code_ = exit_code;
+        waiters.swap(exit_waiters_);
+    }
+    for (ExitFn& waiter : waiters) waiter(exit_code);
+}
+
+bool PipedProcess::NextWrite(const char** data, size_t* size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (writes_.empty()) return false;
+    const PendingWrite& front = writes_.front();
+    *data                     = front.data.data() + front.offset;
+    *size                     = front.data.size() - front.offset;
+    return true;
+}
+
+void PipedProcess::WriteProgress(size_t n)
+{
+    WriteFn done;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        PendingWrite&               front = writes_.front();
+        front.offset += n;
+        if (front.offset < front.data.size()) return;
+        done = std::move(front.callback);
+        writes_.pop_front();
+    }
+    if (done) done(true, "");
+}
+
+void PipedProcess::FailWrites(const std::string& error)
+{
+    std::deque<PendingWrite> failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stdin_open_ = false;
+        failed.swap(writes_);
+    }
+    for (PendingWrite& write : failed)
+    {
+        if (write.callback) write.callback(false, error);
+    }
+}
+
+bool PipedProcess::StdinDrained()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!stdin_closing_ || !writes_.empty()) return false;
+    stdin_open_ = false;
+    return true;
+}
@@ -0,0 +1,211 @@
+#pragma once
+// 带管道的子进程：流式读取 stdout / stderr、异步写入 stdin、等待退出。
+//   - 所有管道由一个反应器线程驱动 (Linux: 非阻塞管道 + epoll / Windows: 重叠 I/O 命名管道 + 完成端口)，
+//     不为每个子进程另开线程
+//   - 每个输出流一个有界环形缓冲区，反应器直接读入空闲区；缓冲区满时停止读取该管道，
+//     子进程随之阻塞在写入上 (背压)，调用方取走一半后恢复
+//   - 管道与进程句柄只在反应器线程上关闭；回调在反应器线程或调用方线程上执行
+// 本文件不依赖 Lua。
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 单生产者 (反应器) / 单消费者 (Read) 的字节环。生产者在锁内取得空闲区、锁外写入、再在锁内 Commit；
+// 消费者只推进 head_，不会挪动生产者正在写的空闲区
+class ByteRing
+{
+public:
+    explicit ByteRing(size_t capacity) : data_(capacity) {}
+
+    size_t Capacity() const
+    {
+        return data_.size();
+    }
+
+    size_t Size() const
+    {
+        return size_;
+    }
+
+    size_t Free() const
+    {
+        return data_.size() - size_;
+    }
+
+    // 空闲区按地址顺序的至多两段，返回段数
+    int FreeSpans(uint8_t* ptrs[2], size_t lens[2]);
+
+    void Commit(size_t n);
+
+    // 取走至多 max_bytes 字节
+    std::string Take(size_t max_bytes);
+
+    // 丢弃全部已提交的数据
+    void Clear();
+
+private:
+    std::vector<uint8_t> data_;
+    size_t               head_ = 0;  // 最早未读字节的位置
+    size_t               size_ = 0;
+};
+
+struct PipeSpawnOptions
+{
+    std::string command;  // Windows: CreateProcessW 命令行；Linux: 交给 /bin/sh -c
+    std::string working_dir;
+    bool        capture_stderr = true;     // false: stderr 继承本进程的
+    bool        merge_stderr   = false;    // stderr 写入 stdout 的管道 (2>&1)
+    bool        pipe_stdin     = false;    // false: stdin 为空设备
+    size_t      buffer_bytes   = 1 << 20;  // 每个输出流的环形缓冲区大小
+};
+
+enum class PipeStream
+{
+    Stdout = 0,
+    Stderr = 1,
+};
+
+struct PipeReactorImpl;  // 平台实现：反应器线程与句柄，进程对象与 PipeReactor 共同持有
+
+class PipedProcess : public std::enable_shared_from_this<PipedProcess>
+{
+public:
+    // data 为空表示 EOF (读取出错也按 EOF 处理，原因见 StreamError)
+    using ReadFn    = std::function<void(std::string data)>;
+    using ReadAnyFn = std::function<void(PipeStream stream, std::string data)>;
+    using WriteFn   = std::function<void(bool ok, std::string error)>;
+    using ExitFn    = std::function<void(int exit_code)>;
+
+    ~PipedProcess();
+
+    PipedProcess(const PipedProcess&)            = delete;
+    PipedProcess& operator=(const PipedProcess&) = delete;
+
+    uint32_t Pid() const
+    {
+        return pid_;
+    }
+
+    // 取走已缓冲的至多 max_bytes 字节，没有数据时等到有数据或 EOF。每个流同一时刻至多一个未完成的 Read；
+    // 未捕获的流立即得到 EOF
+    void Read(PipeStream stream, size_t max_bytes, ReadFn callback);
+
+    // 从任一有数据的流读取 (缓冲较多的优先)，两个流都到 EOF 时 data 为空。
+    // 同时等待 stdout 与 stderr 的调用方用它，避免只读一个流时另一个流的缓冲区写满、子进程卡住；
+    // 不与同一进程上的 Read 混用
+    void ReadAny(size_t max_bytes, ReadAnyFn callback);
+
+    // 数据全部写入管道后回调；子进程已关闭 stdin 时以失败回调。未开启 pipe_stdin 时立即失败
+    void Write(std::string data, WriteFn callback);
+
+    // 已排队的数据写完后关闭 stdin，子进程读到 EOF
+    void CloseStdin();
+
+    // 子进程退出后回调 (Linux: 被信号结束时为 128 + 信号值)；可多次调用
+    void WaitExit(ExitFn callback);
+
+    // 强制结束 (Linux: 整个进程组)；已退出时无副作用
+    void Kill();
+
+    // 调用方不再读取：已缓冲与此后的输出直接丢弃，子进程不会因缓冲区满而阻塞；之后的 Read 立即得到 EOF
+    void Discard();
+
+    uint64_t BytesRead(PipeStream stream) const;
+
+    std::string StreamError(PipeStream stream) const;
+
+private:
+    friend class PipeReactor;
+    friend struct PipeReactorImpl;
+    struct Native;  // 平台相关的句柄与重叠结构，只在反应器线程上访问
+
+    struct Output
+    {
+        explicit Output(size_t capacity) : ring(capacity) {}
+
+        ByteRing    ring;
+        bool        open   = false;  // 管道存在且尚未读到 EOF
+        bool        paused = false;  // 因缓冲区满而停止读取
+        ReadFn      waiter;
+        size_t      waiter_max = 0;
+        uint64_t    total      = 0;
+        std::string error;
+    };
+
+    struct PendingWrite
+    {
+        std::string data;
+        size_t      offset = 0;
+        WriteFn     callback;
+    };
+
+    PipedProcess(std::shared_ptr<PipeReactorImpl> reactor, size_t buffer_bytes);
+
+    // 锁内取走数据；腾出一半缓冲区且读取已暂停时置 *resume
+    static std::string TakeLocked(Output& out, size_t max_bytes, bool* resume);
+
+    // 以下由平台实现在反应器线程上调用
+
+    // 取得可读入的空闲区，返回段数；缓冲区满时返回 0 并标记暂停
+    int OutputSpans(PipeStream stream, uint8_t* ptrs[2], size_t lens[2]);
+    // 读入了 n 字节 (n == 0 表示 EOF，error 非空表示读取出错)；满足挂起的 Read
+    void OnOutput(PipeStream stream, size_t n, const std::string& error);
+    void OnExit(int exit_code);
+    // stdin 队列头部尚未写出的数据；队列为空返回 false
+    bool NextWrite(const char** data, size_t* size);
+    // 头部写出了 n 字节，写完的请求在锁外回调
+    void WriteProgress(size_t n);
+    void FailWrites(const std::string& error);
+    // 队列已空且调用方要求关闭 stdin
+    bool StdinDrained();
+
+    // 以下由平台实现：把请求转交反应器线程 (反应器已停止时无操作)
+    void RequestResume(PipeStream stream);
+    void RequestWrite();
+    void RequestKill();
+
+    const std::shared_ptr<PipeReactorImpl> reactor_;
+    uint32_t                               pid_ = 0;
+    std::unique_ptr<Native>                native_;
+
+    mutable std::mutex       mutex_;
+    Output                   outputs_[2];
+    ReadAnyFn                any_waiter_;
+    size_t                   any_max_ = 0;
+    std::deque<PendingWrite> writes_;
+    bool                     stdin_open_    = false;
+    bool                     stdin_closing_ = false;
+    bool                     discard_       = false;
+    bool                     exited_        = false;
+    int                      exit_code_     = 0;
+    std::vector<ExitFn>      exit_waiters_;
+};
+
+class PipeReactor
+{
+public:
+    static std::unique_ptr<PipeReactor> Create(std::string* error);
+    // 停止反应器线程；仍在运行的子进程被强制结束，未完成的回调不再执行
+    ~PipeReactor();
+
+    PipeReactor(const PipeReactor&)            = delete;
+    PipeReactor& operator=(const PipeReactor&) = delete;
+
+    // 启动子进程并开始读取它的输出
+    std::shared_ptr<PipedProcess> Spawn(const PipeSpawnOptions& options, std::string* error);
+
+    // 尚未退出或仍有管道打开的子进程数
+    size_t Active() const;
+
+private:
+    explicit PipeReactor(std::shared_ptr<PipeReactorImpl> impl) : impl_(std::move(impl)) {}
+
+    std::shared_ptr<PipeReactorImpl> impl_;
+};
@@ -0,0 +1,469 @@
+#include "process_pipe.h"
+
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <thread>
+#include <unordered_set>
+
+#if !defined(SYS_pidfd_open)
+#define SYS_pidfd_open 434
+#endif
+
+namespace
+{
+    enum WatchKind
+    {
+        kStdout = 0,
+        kStderr = 1,
+        kStdin  = 2,
+        kExit   = 3,  // pidfd
+    };
+
+    constexpr int kReadsPerEvent = 16;  // 单个管道一次事件最多读几轮，其余进程不被一个高产的子进程饿死
+
+    std::string ErrnoMessage(const char* what)
+    {
+        return std::string(what) + " failed: " + strerror(errno);
+    }
+
+    void CloseFd(int& fd)
+    {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+}  // namespace
+
+// 四个 fd 全部关闭后进程离开反应器
+struct PipedProcess::Native
+{
+    struct Watch
+    {
+        PipedProcess* owner = nullptr;
+        int           kind  = 0;
+        int           fd    = -1;
+        bool          armed = false;  // 已加入 epoll
+    };
+
+    Watch watches[4];
+    pid_t pid    = 0;
+    bool  reaped = false;
+
+    // 正常情况下 fd 已在反应器线程上关闭；只有反应器在登记之前就停止时才会走到这里
+    ~Native()
+    {
+        for (auto& w : watches) CloseFd(w.fd);
+    }
+};
+
+struct PipeReactorImpl
+{
+    int         epoll_fd = -1;
+    int         wake_fd  = -1;
+    std::thread thread;
+
+    std::mutex                         mutex;
+    std::vector<std::function<void()>> posted;
+    bool                               stopped = false;
+    std::atomic<size_t>                active_count{0};
+
+    // 以下只在反应器线程上访问
+    std::unordered_set<std::shared_ptr<PipedProcess>> active;
+    std::vector<std::shared_ptr<PipedProcess>>        retired;  // 本批 epoll 事件处理完再释放
+
+    ~PipeReactorImpl()
+    {
+        CloseFd(wake_fd);
+        CloseFd(epoll_fd);
+    }
+
+    void Post(std::function<void()> fn)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopped) return;
+            posted.push_back(std::move(fn));
+            if (posted.size() > 1) return;  // 已有唤醒在途
+        }
+        uint64_t one = 1;
+        (void)!write(wake_fd, &one, sizeof(one));
+    }
+
+    void Arm(PipedProcess::Native::Watch& w, uint32_t events)
+    {
+        if (w.fd < 0 || w.armed) return;
+        epoll_event ev{};
+        ev.events   = events;
+        ev.data.ptr = &w;
+        w.armed     = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, w.fd, &ev) == 0;
+    }
+
+    void Disarm(PipedProcess::Native::Watch& w)
+    {
+        if (!w.armed) return;
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, w.fd, nullptr);
+        w.armed = false;
+    }
+
+    void CloseWatch(PipedProcess::Native::Watch& w)
+    {
+        Disarm(w);
+        CloseFd(w.fd);
+        PipedProcess::Native& native = *w.owner->native_;
+        for (const auto& other : native.watches)
+        {
+            if (other.fd >= 0) return;
+        }
+        auto it = active.find(w.owner->shared_from_this());
+        if (it == active.end()) return;
+        retired.push_back(*it);
+        active.erase(it);
+        active_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void Register(const std::shared_ptr<PipedProcess>& process)
+    {
+        active.insert(process);
+        PipedProcess::Native& native = *process->native_;
+        Arm(native.watches[kStdout], EPOLLIN);
+        Arm(native.watches[kStderr], EPOLLIN);
+        Arm(native.watches[kExit], EPOLLIN);
+        PumpStdin(native.watches[kStdin]);
+    }
+
+    // readv 直接读入环形缓冲区的空闲区；缓冲区满时移出 epoll，等 Read 取走数据后由 RequestResume 恢复
+    void PumpOutput(PipedProcess::Native::Watch& w)
+    {
+        PipeStream stream = (PipeStream)w.kind;
+        for (int round = 0; round < kReadsPerEvent && w.fd >= 0; ++round)
+        {
+            uint8_t* ptrs[2];
+            size_t   lens[2];
+            int      count = w.owner->OutputSpans(stream, ptrs, lens);
+            if (count == 0)
+            {
+                Disarm(w);
+                return;
+            }
+            iovec iov[2];
+            for (int i = 0; i < count; ++i) iov[i] = {ptrs[i], lens[i]};
+
+            ssize_t n = readv(w.fd, iov, count);
+            if (n > 0)
+            {
+                w.owner->OnOutput(stream, (size_t)n, "");
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && errno == EAGAIN) break;
+            std::string error = n < 0 ? ErrnoMessage("read") : "";
+            PipedProcess* owner = w.owner;
+            CloseWatch(w);
+            owner->OnOutput(stream, 0, error);
+            return;
+        }
+        Arm(w, EPOLLIN);
+    }
+
+    void PumpStdin(PipedProcess::Native::Watch& w)
+    {
+        if (w.fd < 0) return;
+        const char* data;
+        size_t      size;
+        while (w.owner->NextWrite(&data, &size))
+        {
+            ssize_t n = write(w.fd, data, size);
+            if (n > 0)
+            {
+                w.owner->WriteProgress((size_t)n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && errno == EAGAIN)
+            {
+                Arm(w, EPOLLOUT);
+                return;
+            }
+            int         code  = errno;
+            std::string error = ErrnoMessage("write");
+            if (code == EPIPE) ConsumeSigpipe();
+            PipedProcess* owner = w.owner;
+            CloseWatch(w);
+            owner->FailWrites(error);
+            return;
+        }
+        if (w.owner->StdinDrained()) CloseWatch(w);
+        else Disarm(w);
+    }
+
+    // 反应器线程屏蔽了 SIGPIPE，写入已关闭的管道留下的挂起信号在这里取走
+    static void ConsumeSigpipe()
+    {
+        sigset_t pipe_set;
+        sigemptyset(&pipe_set);
+        sigaddset(&pipe_set, SIGPIPE);
+        timespec zero{};
+        while (sigtimedwait(&pipe_set, nullptr, &zero) == SIGPIPE)
+        {
+        }
+    }
+
+    void Reap(PipedProcess::Native::Watch& w)
+    {
+        PipedProcess::Native& native = *w.owner->native_;
+        int                   status = 0;
+        pid_t                 r;
+        while ((r = waitpid(native.pid, &status, WNOHANG)) < 0 && errno == EINTR)
+        {
+        }
+        if (r == 0) return;  // pidfd 可读但尚未成为僵尸，不会发生；保险起见等下一次事件
+        native.reaped = true;
+        int code      = r < 0 ? -1 : WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        PipedProcess* owner = w.owner;
+        CloseWatch(w);
+        // 子进程已经不会再读 stdin；输出管道可能仍被它的后代持有，照常读到 EOF
+        auto& in = native.watches[kStdin];
+        if (in.fd >= 0)
+        {
+            CloseWatch(in);
+            owner->FailWrites("process exited");
+        }
+        owner->OnExit(code);
+    }
+
+    void Loop()
+    {
+        SetTraceThreadName("pipe-reactor");
+        sigset_t pipe_set;
+        sigemptyset(&pipe_set);
+        sigaddset(&pipe_set, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipe_set, nullptr);
+
+        epoll_event events[64];
+        while (true)
+        {
+            int n = epoll_wait(epoll_fd, events, 64, -1);
+            if (n < 0 && errno != EINTR) break;
+
+            for (int i = 0; i < n; ++i)
+            {
+                if (events[i].data.ptr == nullptr)
+                {
+                    uint64_t value;
+                    (void)!read(wake_fd, &value, sizeof(value));
+                    continue;
+                }
+                auto& w = *static_cast<PipedProcess::Native::Watch*>(events[i].data.ptr);
+                if (w.fd < 0) continue;  // 同一批里已被关闭
+                if (w.kind == kExit) Reap(w);
+                else if (w.kind == kStdin) PumpStdin(w);
+                else PumpOutput(w);
+            }
+
+            std::vector<std::function<void()>> tasks;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopped) break;
+                tasks.swap(posted);
+            }
+            for (auto& task : tasks) task();
+            retired.clear();
+        }
+    }
+
+    // 反应器线程结束后调用：关闭全部管道，结束并回收仍在运行的子进程
+    void Shutdown()
+    {
+        for (const auto& process : active)
+        {
+            PipedProcess::Native& native = *process->native_;
+            for (auto& w : native.watches) CloseFd(w.fd);
+            if (native.reaped) continue;
+            kill(-native.pid, SIGKILL);
+            while (waitpid(native.pid, nullptr, 0) < 0 && errno == EINTR)
+            {
+            }
+            native.reaped = true;
+        }
+        active.clear();
+        retired.clear();
+        active_count.store(0, std::memory_order_relaxed);
+    }
+};
+
+std::unique_ptr<PipeReactor> PipeReactor::Create(std::string* error)
+{
+    auto impl      = std::make_shared<PipeReactorImpl>();
+    impl->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    impl->wake_fd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (impl->epoll_fd < 0 || impl->wake_fd < 0)
+    {
+        if (error) *error = ErrnoMessage("epoll/eventfd");
+        return nullptr;
+    }
+    epoll_event ev{};
+    ev.events   = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epoll_ctl(impl->epoll_fd, EPOLL_CTL_ADD, impl->wake_fd, &ev);
+
+    PipeReactorImpl* raw = impl.get();
+    impl->thread         = std::thread([raw] { raw->Loop(); });
+    return std::unique_ptr<PipeReactor>(new PipeReactor(std::move(impl)));
+}
+
+PipeReactor::~PipeReactor()
+{
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->stopped = true;
+        impl_->posted.clear();
+    }
+    uint64_t one = 1;
+    (void)!write(impl_->wake_fd, &one, sizeof(one));
+    if (impl_->thread.joinable()) impl_->thread.join();
+    impl_->Shutdown();
+}
+
+size_t PipeReactor::Active() const
+{
+    return impl_->active_count.load(std::memory_order_relaxed);
+}
+
+// 子进程自成进程组，Kill 连同 sh -c 派生的后代一起结束。管道两端都带 O_CLOEXEC，
+// 子进程里 dup2 到 0/1/2 的副本不带；父进程一端设为非阻塞
+std::shared_ptr<PipedProcess> PipeReactor::Spawn(const PipeSpawnOptions& options, std::string* error)
+{
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        if (impl_->stopped)
+        {
+            if (error) *error = "pipe reactor stopped";
+            return nullptr;
+        }
+    }
+
+    bool want_stderr = options.capture_stderr && !options.merge_stderr;
+    int  out[2] = {-1, -1}, err[2] = {-1, -1}, in[2] = {-1, -1};
+    auto close_all = [&] {
+        for (int* fds : {out, err, in})
+        {
+            CloseFd(fds[0]);
+            CloseFd(fds[1]);
+        }
+    };
+    if (pipe2(out, O_CLOEXEC) != 0 || (want_stderr && pipe2(err, O_CLOEXEC) != 0) ||
+        (options.pipe_stdin && pipe2(in, O_CLOEXEC) != 0))
+    {
+        if (error) *error = ErrnoMessage("pipe2");
+        close_all();
+        return nullptr;
+    }
+
+    const char* command = options.command.c_str();
+    const char* dir     = options.working_dir.empty() ? nullptr : options.working_dir.c_str();
+    pid_t       pid     = fork();
+    if (pid < 0)
+    {
+        if (error) *error = ErrnoMessage("fork");
+        close_all();
+        return nullptr;
+    }
+    if (pid == 0)
+    {
+        // exec 之前只调用 async-signal-safe 的函数
+        setpgid(0, 0);
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        int stdin_fd = in[0] >= 0 ? in[0] : open("/dev/null", O_RDONLY);
+        if (stdin_fd < 0 || dup2(stdin_fd, 0) < 0 || dup2(out[1], 1) < 0) _exit(127);
+        if (options.merge_stderr && dup2(out[1], 2) < 0) _exit(127);
+        if (want_stderr && dup2(err[1], 2) < 0) _exit(127);
+        if (dir && chdir(dir) != 0) _exit(127);
+        execl("/bin/sh", "sh", "-c", command, (char*)nullptr);
+        _exit(127);
+    }
+    setpgid(pid, pid);  // 与子进程中的调用竞争，谁先都一样
+    CloseFd(out[1]);
+    CloseFd(err[1]);
+    CloseFd(in[0]);
+
+    int pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd < 0)
+    {
+        if (error) *error = ErrnoMessage("pidfd_open");
+        close_all();
+        kill(-pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        return nullptr;
+    }
+    for (int fd : {out[0], err[0], in[1], pidfd})
+    {
+        if (fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    // 默认 64 KiB 的管道每轮读写太碎；扩大失败 (超出 pipe-max-size) 不影响正确性
+    fcntl(out[0], F_SETPIPE_SZ, (int)std::min<size_t>(options.buffer_bytes, 1 << 20));
+
+    size_t capacity = std::max<size_t>(options.buffer_bytes, 4096);
+    std::shared_ptr<PipedProcess> process(new PipedProcess(impl_, capacity));
+    process->pid_                 = (uint32_t)pid;
+    process->outputs_[0].open     = true;
+    process->outputs_[1].open     = want_stderr;
+    process->stdin_open_          = options.pipe_stdin;
+    process->native_              = std::make_unique<PipedProcess::Native>();
+    process->native_->pid         = pid;
+    int fds[4]                    = {out[0], err[0], in[1], pidfd};
+    for (int kind = 0; kind < 4; ++kind)
+    {
+        auto& w = process->native_->watches[kind];
+        w.owner = process.get();
+        w.kind  = kind;
+        w.fd    = fds[kind];
+    }
+
+    impl_->active_count.fetch_add(1, std::memory_order_relaxed);
+    PipeReactorImpl* reactor = impl_.get();
+    impl_->Post([reactor, process] { reactor->Register(process); });
+    return process;
+}
+
+// 构造与析构放在这里：需要完整的 Native
+PipedProcess::PipedProcess(std::shared_ptr<PipeReactorImpl> reactor, size_t buffer_bytes)
+    : reactor_(std::move(reactor)), outputs_{Output(buffer_bytes), Output(buffer_bytes)}
+{
+}
+
+PipedProcess::~PipedProcess() = default;
+
+void PipedProcess::RequestResume(PipeStream stream)
+{
+    PipeReactorImpl* reactor = reactor_.get();
+    auto             self    = shared_from_this();
+    reactor_->Post([reactor, self, stream] { reactor->PumpOutput(self->native_->watches[(int)stream]); });
+}
+
+void PipedProcess::RequestWrite()
+{
+    PipeReactorImpl* reactor = reactor_.get();
+    auto             self    = shared_from_this();
+    reactor_->Post([reactor, self] { reactor->PumpStdin(self->native_->watches[kStdin]); });
+}
+
+// 回收只在反应器线程上发生，回收前 pid 与进程组号不会被复用
+void PipedProcess::RequestKill()
+{
+    auto self = shared_from_this();
+    reactor_->Post([self] {
+        if (!self->native_->reaped) kill(-self->native_->pid, SIGKILL);
+    });
+}
@@ -0,0 +1,532 @@
+#include "process_pipe.h"
+
+#include "trace.h"
+
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+
+#include <algorithm>
+#include <thread>
+#include <unordered_set>
+
+namespace
+{
+    enum OpKind
+    {
+        kStdout = 0,
+        kStderr = 1,
+        kStdin  = 2,
+        kExit   = 3,  // 只用作退出通知完成包的标识
+    };
+
+    constexpr ULONG_PTR kIoKey   = 1;
+    constexpr ULONG_PTR kPostKey = 2;
+    constexpr ULONG_PTR kExitKey = 3;
+
+    constexpr DWORD kMaxTransfer = 1 << 20;  // 单次 WriteFile 的上限，大块写入分几次完成
+
+    std::wstring Utf8ToWide(const std::string& str)
+    {
+        if (str.empty()) return {};
+        int          size = MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), NULL, 0);
+        std::wstring out((size_t)size, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), &out[0], size);
+        return out;
+    }
+
+    std::string ErrorMessage(const char* what, DWORD code)
+    {
+        return std::string(what) + " failed: " + std::to_string(code);
+    }
+
+    void CloseHandleOnce(HANDLE& handle)
+    {
+        if (handle && handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+        handle = NULL;
+    }
+
+    // 匿名管道不支持重叠 I/O，改用唯一命名的单实例命名管道：父进程一端重叠、子进程一端同步且可继承
+    bool CreatePipePair(bool parent_reads, DWORD buffer_bytes, HANDLE* parent, HANDLE* child, std::string* error)
+    {
+        static std::atomic<uint32_t> serial{0};
+        std::wstring                 name = L"\\\\.\\pipe\\peshell-" + std::to_wstring(GetCurrentProcessId()) + L"-" +
+                            std::to_wstring(serial.fetch_add(1, std::memory_order_relaxed));
+
+        DWORD open_mode = (parent_reads ? PIPE_ACCESS_INBOUND : PIPE_ACCESS_OUTBOUND) | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE;
+        *parent         = CreateNamedPipeW(name.c_str(), open_mode, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1,
+                                           buffer_bytes, buffer_bytes, 0, NULL);
+        if (*parent == INVALID_HANDLE_VALUE)
+        {
+            *parent = NULL;
+            if (error) *error = ErrorMessage("CreateNamedPipe", GetLastError());
+            return false;
+        }
+
+        SECURITY_ATTRIBUTES sa{sizeof(sa), NULL, TRUE};
+        DWORD               access = parent_reads ? GENERIC_WRITE | FILE_READ_ATTRIBUTES : GENERIC_READ | FILE_WRITE_ATTRIBUTES;
+        *child                     = CreateFileW(name.c_str(), access, 0, &sa, OPEN_EXISTING, 0, NULL);
+        if (*child == INVALID_HANDLE_VALUE)
+        {
+            *child = NULL;
+            if (error) *error = ErrorMessage("CreateFile(pipe)", GetLastError());
+            CloseHandleOnce(*parent);
+            return false;
+        }
+        return true;
+    }
+}  // namespace
+
+// 管道句柄全部关闭、没有未完成的 I/O 且退出已通知后，进程离开反应器
+struct PipedProcess::Native
+{
+    struct Op
+    {
+        OVERLAPPED    overlapped{};  // 完成包里拿到的是它的地址
+        PipedProcess* owner   = nullptr;
+        int           kind    = 0;
+        HANDLE        handle  = NULL;
+        bool          pending = false;  // 有未完成的 ReadFile / WriteFile
+    };
+
+    Op     ops[4];
+    HANDLE port    = NULL;
+    HANDLE process = NULL;
+    HANDLE wait    = NULL;  // RegisterWaitForSingleObject
+    bool   exited  = false;
+
+    // 系统线程池上执行：把退出通知转成完成包交给反应器线程
+    static VOID CALLBACK OnProcessSignaled(PVOID context, BOOLEAN)
+    {
+        auto* native = static_cast<Native*>(context);
+        PostQueuedCompletionStatus(native->port, 0, kExitKey, &native->ops[kExit].overlapped);
+    }
+
+    // 正常情况下句柄已在反应器线程上关闭；只有反应器在登记之前就停止时才会走到这里
+    ~Native()
+    {
+        for (auto& op : ops) CloseHandleOnce(op.handle);
+        CloseHandleOnce(process);
+    }
+};
+
+struct PipeReactorImpl
+{
+    HANDLE      port = NULL;
+    std::thread thread;
+
+    std::mutex                         mutex;
+    std::vector<std::function<void()>> posted;
+    bool                               stopped = false;
+    std::atomic<size_t>                active_count{0};
+
+    // 以下只在反应器线程上访问
+    std::unordered_set<std::shared_ptr<PipedProcess>> active;
+
+    ~PipeReactorImpl()
+    {
+        CloseHandleOnce(port);
+    }
+
+    void Post(std::function<void()> fn)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopped) return;
+            posted.push_back(std::move(fn));
+            if (posted.size() > 1) return;  // 已有唤醒在途
+        }
+        PostQueuedCompletionStatus(port, 0, kPostKey, NULL);
+    }
+
+    void TryRetire(PipedProcess* owner)
+    {
+        PipedProcess::Native& native = *owner->native_;
+        if (!native.exited) return;
+        for (const auto& op : native.ops)
+        {
+            if (op.handle || op.pending) return;
+        }
+        auto it = active.find(owner->shared_from_this());
+        if (it == active.end()) return;
+        active.erase(it);
+        active_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void CloseOp(PipedProcess::Native::Op& op)
+    {
+        CloseHandleOnce(op.handle);  // 未完成的 I/O 随之取消，完成包仍会到达
+    }
+
+    void Register(const std::shared_ptr<PipedProcess>& process)
+    {
+        active.insert(process);
+        PipedProcess::Native& native = *process->native_;
+        for (auto& op : native.ops)
+        {
+            if (op.handle) CreateIoCompletionPort(op.handle, port, kIoKey, 0);
+        }
+        if (!RegisterWaitForSingleObject(&native.wait, native.process, PipedProcess::Native::OnProcessSignaled, &native, INFINITE,
+                                         WT_EXECUTEONLYONCE))
+        {
+            // 等不到退出通知就无法回收：视为已退出，输出照常读到 EOF
+            native.wait   = NULL;
+            native.exited = true;
+            process->OnExit(-1);
+        }
+        PumpOutput(native.ops[kStdout]);
+        PumpOutput(native.ops[kStderr]);
+        PumpStdin(native.ops[kStdin]);
+    }
+
+    // ReadFile 直接读入环形缓冲区的空闲区 (每次一段)；缓冲区满时不再发起读取，
+    // 等 Read 取走数据后由 RequestResume 恢复
+    void PumpOutput(PipedProcess::Native::Op& op)
+    {
+        if (!op.handle || op.pending) return;
+        uint8_t* ptrs[2];
+        size_t   lens[2];
+        if (op.owner->OutputSpans((PipeStream)op.kind, ptrs, lens) == 0) return;
+
+        op.overlapped = OVERLAPPED{};
+        DWORD len     = (DWORD)std::min<size_t>(lens[0], 1u << 30);
+        if (ReadFile(op.handle, ptrs[0], len, NULL, &op.overlapped) || GetLastError() == ERROR_IO_PENDING)
+        {
+            op.pending = true;  // 同步完成也会投递完成包
+            return;
+        }
+        DWORD         code  = GetLastError();
+        PipedProcess* owner = op.owner;
+        CloseOp(op);
+        owner->OnOutput((PipeStream)op.kind, 0, code == ERROR_BROKEN_PIPE ? "" : ErrorMessage("ReadFile", code));
+        TryRetire(owner);
+    }
+
+    void PumpStdin(PipedProcess::Native::Op& op)
+    {
+        if (!op.handle || op.pending) return;
+        const char* data;
+        size_t      size;
+        if (!op.owner->NextWrite(&data, &size))
+        {
+            if (op.owner->StdinDrained()) CloseOp(op);
+            TryRetire(op.owner);
+            return;
+        }
+        op.overlapped = OVERLAPPED{};
+        DWORD len     = (DWORD)std::min<size_t>(size, kMaxTransfer);
+        if (WriteFile(op.handle, data, len, NULL, &op.overlapped) || GetLastError() == ERROR_IO_PENDING)
+        {
+            op.pending = true;
+            return;
+        }
+        DWORD         code  = GetLastError();
+        PipedProcess* owner = op.owner;
+        CloseOp(op);
+        owner->FailWrites(ErrorMessage("WriteFile", code));
+        TryRetire(owner);
+    }
+
+    void OnIoComplete(PipedProcess::Native::Op& op, BOOL ok, DWORD bytes)
+    {
+        op.pending          = false;
+        DWORD         code  = ok ? ERROR_SUCCESS : GetLastError();
+        PipedProcess* owner = op.owner;
+        auto          keep  = owner->shared_from_this();  // TryRetire 可能移除最后一个引用
+
+        if (!op.handle)  // 已关闭 (进程退出后关闭 stdin)，只剩这个完成包
+        {
+            TryRetire(owner);
+            return;
+        }
+        if (op.kind == kStdin)
+        {
+            if (!ok)
+            {
+                CloseOp(op);
+                owner->FailWrites(ErrorMessage("WriteFile", code));
+                TryRetire(owner);
+                return;
+            }
+            owner->WriteProgress(bytes);
+            PumpStdin(op);
+            return;
+        }
+
+        if (!ok)
+        {
+            CloseOp(op);
+            owner->OnOutput((PipeStream)op.kind, 0, code == ERROR_BROKEN_PIPE ? "" : ErrorMessage("ReadFile", code));
+            TryRetire(owner);
+            return;
+        }
+        if (bytes > 0) owner->OnOutput((PipeStream)op.kind, bytes, "");  // 0 字节的写入不是 EOF，继续读
+        PumpOutput(op);
+    }
+
+    void OnExit(PipedProcess::Native& native)
+    {
+        PipedProcess* owner = native.ops[kExit].owner;
+        auto          keep  = owner->shared_from_this();
+        if (native.wait) UnregisterWaitEx(native.wait, NULL);  // 回调已经执行，不必等待
+        native.wait   = NULL;
+        DWORD code    = (DWORD)-1;
+        GetExitCodeProcess(native.process, &code);
+        native.exited = true;
+        CloseHandleOnce(native.process);
+
+        // 子进程已经不会再读 stdin；输出管道可能仍被它的后代持有，照常读到 EOF
+        auto& in = native.ops[kStdin];
+        if (in.handle)
+        {
+            CloseOp(in);
+            owner->FailWrites("process exited");
+        }
+        owner->OnExit((int)code);
+        TryRetire(owner);
+    }
+
+    void Loop()
+    {
+        SetTraceThreadName("pipe-reactor");
+        while (true)
+        {
+            DWORD       bytes      = 0;
+            ULONG_PTR   key        = 0;
+            OVERLAPPED* overlapped = NULL;
+            BOOL        ok         = GetQueuedCompletionStatus(port, &bytes, &key, &overlapped, INFINITE);
+            if (!ok && !overlapped) break;  // 完成端口本身出错
+
+            if (key == kIoKey)
+            {
+                OnIoComplete(*CONTAINING_RECORD(overlapped, PipedProcess::Native::Op, overlapped), ok, bytes);
+            }
+            else if (key == kExitKey)
+            {
+                auto* op = CONTAINING_RECORD(overlapped, PipedProcess::Native::Op, overlapped);
+                OnExit(*op->owner->native_);
+            }
+
+            std::vector<std::function<void()>> tasks;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopped) break;
+                tasks.swap(posted);
+            }
+            for (auto& task : tasks) task();
+        }
+    }
+
+    // 反应器线程结束后调用：结束仍在运行的子进程，关闭管道并收完取消产生的完成包
+    void Shutdown()
+    {
+        for (const auto& process : active)
+        {
+            PipedProcess::Native& native = *process->native_;
+            if (native.wait) UnregisterWaitEx(native.wait, INVALID_HANDLE_VALUE);  // 等回调结束
+            native.wait = NULL;
+            if (!native.exited && native.process) TerminateProcess(native.process, 1);
+            for (auto& op : native.ops) CloseOp(op);
+        }
+
+        auto any_pending = [this] {
+            for (const auto& process : active)
+            {
+                for (const auto& op : process->native_->ops)
+                {
+                    if (op.pending) return true;
+                }
+            }
+            return false;
+        };
+        while (any_pending())
+        {
+            DWORD       bytes      = 0;
+            ULONG_PTR   key        = 0;
+            OVERLAPPED* overlapped = NULL;
+            BOOL        ok         = GetQueuedCompletionStatus(port, &bytes, &key, &overlapped, 1000);
+            if (!ok && !overlapped) break;
+            if (key == kIoKey) CONTAINING_RECORD(overlapped, PipedProcess::Native::Op, overlapped)->pending = false;
+        }
+
+        for (const auto& process : active) CloseHandleOnce(process->native_->process);
+        active.clear();
+        active_count.store(0, std::memory_order_relaxed);
+    }
+};
+
+std::unique_ptr<PipeReactor> PipeReactor::Create(std::string* error)
+{
+    auto impl  = std::make_shared<PipeReactorImpl>();
+    impl->port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (!impl->port)
+    {
+        if (error) *error = ErrorMessage("CreateIoCompletionPort", GetLastError());
+        return nullptr;
+    }
+    PipeReactorImpl* raw = impl.get();
+    impl->thread         = std::thread([raw] { raw->Loop(); });
+    return std::unique_ptr<PipeReactor>(new PipeReactor(std::move(impl)));
+}
+
+PipeReactor::~PipeReactor()
+{
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->stopped = true;
+        impl_->posted.clear();
+    }
+    PostQueuedCompletionStatus(impl_->port, 0, kPostKey, NULL);
+    if (impl_->thread.joinable()) impl_->thread.join();
+    impl_->Shutdown();
+}
+
+size_t PipeReactor::Active() const
+{
+    return impl_->active_count.load(std::memory_order_relaxed);
+}
+
+// PROC_THREAD_ATTRIBUTE_HANDLE_LIST 只让子进程继承这几个句柄，
+// 其他线程同时创建的可继承句柄不会漏进来
+std::shared_ptr<PipedProcess> PipeReactor::Spawn(const PipeSpawnOptions& options, std::string* error)
+{
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        if (impl_->stopped)
+        {
+            if (error) *error = "pipe reactor stopped";
+            return nullptr;
+        }
+    }
+
+    bool   want_stderr = options.capture_stderr && !options.merge_stderr;
+    DWORD  pipe_bytes  = (DWORD)std::min<size_t>(options.buffer_bytes, 1 << 20);
+    HANDLE parent[3]   = {NULL, NULL, NULL};  // stdout, stderr, stdin
+    HANDLE child[3]    = {NULL, NULL, NULL};  // stdin, stdout, stderr
+    auto   close_all   = [&] {
+        for (HANDLE& h : parent) CloseHandleOnce(h);
+        for (HANDLE& h : child) CloseHandleOnce(h);
+    };
+
+    if (!CreatePipePair(true, pipe_bytes, &parent[kStdout], &child[1], error) ||
+        (want_stderr && !CreatePipePair(true, pipe_bytes, &parent[kStderr], &child[2], error)) ||
+        (options.pipe_stdin && !CreatePipePair(false, pipe_bytes, &parent[kStdin], &child[0], error)))
+    {
+        close_all();
+        return nullptr;
+    }
+
+    SECURITY_ATTRIBUTES sa{sizeof(sa), NULL, TRUE};
+    if (!options.pipe_stdin)
+    {
+        child[0] = CreateFileW(L"NUL", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, &sa, OPEN_EXISTING, 0, NULL);
+        if (child[0] == INVALID_HANDLE_VALUE) child[0] = NULL;
+    }
+    if (options.merge_stderr)
+    {
+        DuplicateHandle(GetCurrentProcess(), child[1], GetCurrentProcess(), &child[2], 0, TRUE, DUPLICATE_SAME_ACCESS);
+    }
+    else if (!want_stderr)
+    {
+        // 继承本进程的 stderr；GUI 子系统下可能没有
+        HANDLE own = GetStdHandle(STD_ERROR_HANDLE);
+        if (own && own != INVALID_HANDLE_VALUE)
+            DuplicateHandle(GetCurrentProcess(), own, GetCurrentProcess(), &child[2], 0, TRUE, DUPLICATE_SAME_ACCESS);
+    }
+
+    std::vector<HANDLE> inherit;
+    for (HANDLE h : child)
+    {
+        if (h) inherit.push_back(h);
+    }
+    SIZE_T attr_size = 0;
+    InitializeProcThreadAttributeList(NULL, 1, 0, &attr_size);
+    std::vector<char> attr_buffer(attr_size);
+    auto*             attrs = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attr_buffer.data());
+    if (!InitializeProcThreadAttributeList(attrs, 1, 0, &attr_size) ||
+        !UpdateProcThreadAttribute(attrs, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, inherit.data(), inherit.size() * sizeof(HANDLE), NULL,
+                                   NULL))
+    {
+        if (error) *error = ErrorMessage("UpdateProcThreadAttribute", GetLastError());
+        close_all();
+        return nullptr;
+    }
+
+    STARTUPINFOEXW si{};
+    si.StartupInfo.cb         = sizeof(si);
+    si.StartupInfo.dwFlags    = STARTF_USESTDHANDLES;
+    si.StartupInfo.hStdInput  = child[0];
+    si.StartupInfo.hStdOutput = child[1];
+    si.StartupInfo.hStdError  = child[2];
+    si.lpAttributeList        = attrs;
+
+    std::wstring        command = Utf8ToWide(options.command);
+    std::wstring        dir     = Utf8ToWide(options.working_dir);
+    PROCESS_INFORMATION pi{};
+    BOOL created = CreateProcessW(NULL, &command[0], NULL, NULL, TRUE, EXTENDED_STARTUPINFO_PRESENT | CREATE_NO_WINDOW | CREATE_UNICODE_ENVIRONMENT,
+                                  NULL, dir.empty() ? NULL : dir.c_str(), &si.StartupInfo, &pi);
+    DWORD create_error = GetLastError();
+    DeleteProcThreadAttributeList(attrs);
+    for (HANDLE& h : child) CloseHandleOnce(h);
+    if (!created)
+    {
+        if (error) *error = ErrorMessage("CreateProcessW", create_error);
+        close_all();
+        return nullptr;
+    }
+    CloseHandle(pi.hThread);
+
+    size_t capacity = std::max<size_t>(options.buffer_bytes, 4096);
+    std::shared_ptr<PipedProcess> process(new PipedProcess(impl_, capacity));
+    process->pid_             = pi.dwProcessId;
+    process->outputs_[0].open = true;
+    process->outputs_[1].open = want_stderr;
+    process->stdin_open_      = options.pipe_stdin;
+    process->native_          = std::make_unique<PipedProcess::Native>();
+    process->native_->port    = impl_->port;
+    process->native_->process = pi.hProcess;
+    for (int kind = 0; kind < 4; ++kind)
+    {
+        auto& op  = process->native_->ops[kind];
+        op.owner  = process.get();
+        op.kind   = kind;
+        op.handle = kind < 3 ? parent[kind] : NULL;
+    }
+
+    impl_->active_count.fetch_add(1, std::memory_order_relaxed);
+    PipeReactorImpl* reactor = impl_.get();
+    impl_->Post([reactor, process] { reactor->Register(process); });
+    return process;
+}
+
+// 构造与析构放在这里：需要完整的 Native
+PipedProcess::PipedProcess(std::shared_ptr<PipeReactorImpl> reactor, size_t buffer_bytes)
+    : reactor_(std::move(reactor)), outputs_{Output(buffer_bytes), Output(buffer_bytes)}
+{
+}
+
+PipedProcess::~PipedProcess() = default;
+
+void PipedProcess::RequestResume(PipeStream stream)
+{
+    PipeReactorImpl* reactor = reactor_.get();
+    auto             self    = shared_from_this();
+    reactor_->Post([reactor, self, stream] { reactor->PumpOutput(self->native_->ops[(int)stream]); });
+}
+
+void PipedProcess::RequestWrite()
+{
+    PipeReactorImpl* reactor = reactor_.get();
+    auto             self    = shared_from_this();
+    reactor_->Post([reactor, self] { reactor->PumpStdin(self->native_->ops[kStdin]); });
+}
+
+// 进程句柄只在反应器线程上关闭，TerminateProcess 不会落到复用了 PID 的其他进程上
+void PipedProcess::RequestKill()
+{
+    auto self = shared_from_this();
+    reactor_->Post([self] {
+        if (!self->native_->exited && self->native_->process) TerminateProcess(self->native_->process, 1);
+    });
+}
@@ -0,0 +1,183 @@
+#include "process_table.h"
+
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <cctype>
+
+std::string ProcessTable::Key(const std::string& name)
+{
+    std::string key = name;
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return key;
+}
+
+std::vector<uint32_t> ProcessTable::Find(const std::string& name) const
+{
+    std::vector<uint32_t>       pids;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto                        it = by_name_.find(Key(name));
+    if (it != by_name_.end()) pids.assign(it->second.begin(), it->second.end());
+    std::sort(pids.begin(), pids.end());
+    return pids;
+}
+
+uint64_t ProcessTable::Watch(WatchKind kind, const std::string& name, int64_t timeout_ms, WatchFn fn)
+{
+    std::string key = Key(name);
+    uint64_t    id;
+    uint32_t    pid       = 0;
+    bool        satisfied = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id           = next_watch_id_++;
+        auto it      = by_name_.find(key);
+        bool present = it != by_name_.end();
+        if (present) pid = *it->second.begin();
+        satisfied = present == (kind == WatchKind::Appeared);
+        if (!satisfied)
+        {
+            int64_t deadline = timeout_ms < 0 ? -1 : (int64_t)MonotonicNowMs() + timeout_ms;
+            watches_.emplace(id, WatchEntry{kind, std::move(key), deadline, std::move(fn)});
+        }
+    }
+    if (satisfied) fn(true, kind == WatchKind::Appeared ? pid : 0);  // 已满足：不进入监视表
+    else if (timeout_ms >= 0) WakeService();  // 让服务线程按新的截止时间重新计算等待时长
+    return id;
+}
+
+bool ProcessTable::Unwatch(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return watches_.erase(id) > 0;
+}
+
+ProcessTable::Stats ProcessTable::GetStats() const
+{
+    Stats stats;
+    stats.events     = events_.load();
+    stats.rescans    = rescans_.load();
+    stats.name_reads = name_reads_.load();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.processes = names_.size();
+    stats.watches   = watches_.size();
+    return stats;
+}
+
+void ProcessTable::Added(uint32_t pid, const std::string& key, Fired* fired)
+{
+    auto it = names_.find(pid);
+    if (it != names_.end())
+    {
+        if (it->second == key) return;
+        Removed(pid, fired);  // exec 换了映像：从旧名称下移走
+    }
+    if (key.empty()) return;
+    names_.emplace(pid, key);
+    by_name_[key].insert(pid);
+
+    for (auto w = watches_.begin(); w != watches_.end();)
+    {
+        if (w->second.kind == WatchKind::Appeared && w->second.key == key)
+        {
+            fired->emplace_back(std::move(w->second.fn), std::make_pair(true, pid));
+            w = watches_.erase(w);
+        }
+        else ++w;
+    }
+}
+
+void ProcessTable::Removed(uint32_t pid, Fired* fired)
+{
+    auto it = names_.find(pid);
+    if (it == names_.end()) return;
+    std::string key = std::move(it->second);
+    names_.erase(it);
+
+    auto set = by_name_.find(key);
+    if (set == by_name_.end()) return;
+    set->second.erase(pid);
+    if (!set->second.empty()) return;
+    by_name_.erase(set);
+
+    for (auto w = watches_.begin(); w != watches_.end();)
+    {
+        if (w->second.kind == WatchKind::Gone && w->second.key == key)
+        {
+            fired->emplace_back(std::move(w->second.fn), std::make_pair(true, 0u));
+            w = watches_.erase(w);
+        }
+        else ++w;
+    }
+}
+
+void ProcessTable::Rescan(const std::vector<uint32_t>& pids, const std::function<std::string(uint32_t)>& read_name)
+{
+    std::unordered_set<uint32_t> alive(pids.begin(), pids.end());
+    std::vector<uint32_t>        fresh, gone;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (uint32_t pid : pids)
+        {
+            if (!names_.count(pid)) fresh.push_back(pid);
+        }
+        for (const auto& entry : names_)
+        {
+            if (!alive.count(entry.first)) gone.push_back(entry.first);
+        }
+    }
+
+    // 读取名称不持锁：可能涉及大量文件系统或内核调用
+    std::vector<std::pair<uint32_t, std::string>> added;
+    added.reserve(fresh.size());
+    for (uint32_t pid : fresh) added.emplace_back(pid, Key(read_name(pid)));
+    name_reads_ += fresh.size();
+    ++rescans_;
+
+    Fired fired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (uint32_t pid : gone) Removed(pid, &fired);
+        for (const auto& entry : added) Added(entry.first, entry.second, &fired);
+    }
+    Fire(fired);
+}
+
+void ProcessTable::ExpireWatches()
+{
+    Fired   fired;
+    int64_t now = (int64_t)MonotonicNowMs();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto w = watches_.begin(); w != watches_.end();)
+        {
+            if (w->second.deadline_ms >= 0 && w->second.deadline_ms <= now)
+            {
+                fired.emplace_back(std::move(w->second.fn), std::make_pair(false, 0u));
+                w = watches_.erase(w);
+            }
+            else ++w;
+        }
+    }
+    Fire(fired);
+}
+
+int64_t ProcessTable::NextTimeoutMs(int64_t idle_ms) const
+{
+    int64_t now     = (int64_t)MonotonicNowMs();
+    int64_t timeout = idle_ms;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& w : watches_)
+    {
+        if (w.second.deadline_ms < 0) continue;
+        int64_t remaining = std::max<int64_t>(0, w.second.deadline_ms - now);
+        if (timeout < 0 || remaining < timeout) timeout = remaining;
+    }
+    return timeout;
+}
+
+void ProcessTable::Fire(Fired& fired)
+{
+    for (auto& f : fired) f.first(f.second.first, f.second.second);
+    fired.clear();
+}
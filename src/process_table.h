@@ -0,0 +1,116 @@
+#pragma once
+// 常驻的进程表服务：增量维护 进程名 -> PID 索引，取代 Lua 侧反复的全量进程快照与名称比较。
+//   Linux:   proc connector (netlink) 推送 fork / exec / exit 事件，只读取新进程的名称；
+//            没有 CAP_NET_ADMIN 时退化为定时比对 /proc 目录 (只为新出现的 PID 读取名称)
+//   Windows: 后台线程定时 CreateToolhelp32Snapshot 并与索引比对，所有等待者共享同一次快照
+// 名称为可执行文件名 (不含路径)，按 ASCII 不区分大小写比较。
+// Watch 的回调在服务线程上调用，须自行投递到事件循环。本文件不依赖 Lua。
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct ProcessTableOptions
+{
+    bool     use_events = true;  // Linux：优先使用 proc connector
+    uint32_t rescan_ms  = 250;   // 比对模式 (Windows / 无 proc connector 的 Linux) 的扫描间隔
+};
+
+class ProcessTable
+{
+public:
+    enum class WatchKind
+    {
+        Appeared,  // 出现任一同名进程 (已存在时立即触发)
+        Gone,      // 同名进程全部退出 (本来就没有时立即触发)
+    };
+
+    // fired 为 false 表示超时；pid 为 Appeared 时出现的进程
+    using WatchFn = std::function<void(bool fired, uint32_t pid)>;
+
+    struct Stats
+    {
+        uint64_t events     = 0;  // 处理的内核进程事件
+        uint64_t rescans    = 0;  // 全量比对次数
+        uint64_t name_reads = 0;  // 读取进程名称的次数
+        size_t   processes  = 0;
+        size_t   watches    = 0;
+    };
+
+    explicit ProcessTable(const ProcessTableOptions& options = {});
+    ~ProcessTable();
+
+    ProcessTable(const ProcessTable&)            = delete;
+    ProcessTable& operator=(const ProcessTable&) = delete;
+
+    // 以下可在任意线程调用
+
+    std::vector<uint32_t> Find(const std::string& name) const;
+
+    // timeout_ms < 0 表示不超时；已满足时在调用线程上立即回调。返回值可交给 Unwatch
+    uint64_t Watch(WatchKind kind, const std::string& name, int64_t timeout_ms, WatchFn fn);
+
+    // 未触发的监视被移除时返回 true，回调不再调用
+    bool Unwatch(uint64_t id);
+
+    Stats GetStats() const;
+
+    const char* BackendName() const
+    {
+        return backend_name_;
+    }
+
+private:
+    struct WatchEntry
+    {
+        WatchKind   kind;
+        std::string key;
+        int64_t     deadline_ms;  // -1 表示不超时
+        WatchFn     fn;
+    };
+
+    using Fired = std::vector<std::pair<WatchFn, std::pair<bool, uint32_t>>>;
+
+    static std::string Key(const std::string& name);
+
+    // 以下由后端在服务线程上调用，Added / Removed 须持有 mutex_；name 为空的进程不进入索引
+    void Added(uint32_t pid, const std::string& key, Fired* fired);
+    void Removed(uint32_t pid, Fired* fired);
+
+    // 与当前存在的全部 PID 比对，只为新出现的 PID 调用 read_name
+    void Rescan(const std::vector<uint32_t>& pids, const std::function<std::string(uint32_t)>& read_name);
+
+    void    ExpireWatches();
+    int64_t NextTimeoutMs(int64_t idle_ms) const;  // 距最近一个监视超时的毫秒数，没有时为 idle_ms
+    static void Fire(Fired& fired);
+
+    void ServiceLoop();
+    void WakeService();
+
+    mutable std::mutex                                               mutex_;
+    std::unordered_map<uint32_t, std::string>                        names_;  // pid -> key
+    std::unordered_map<std::string, std::unordered_set<uint32_t>>    by_name_;
+    std::map<uint64_t, WatchEntry>                                   watches_;
+    uint64_t                                                         next_watch_id_ = 1;
+    std::atomic<uint64_t>                                            events_{0};
+    std::atomic<uint64_t>                                            rescans_{0};
+    std::atomic<uint64_t>                                            name_reads_{0};
+
+    ProcessTableOptions options_;
+    const char*         backend_name_ = "snapshot";
+    std::atomic<bool>   stopping_{false};
+#if defined(_WIN32)
+    void* wake_event_ = nullptr;
+#else
+    int wake_fd_    = -1;
+    int netlink_fd_ = -1;
+#endif
+    std::thread service_;  // 最后构造：线程启动时其余成员均已就绪
+};
@@ -0,0 +1,205 @@
+#include "process_table.h"
+
+#include "timer_wheel.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    // 事件模式下的兜底比对间隔：补上 netlink 缓冲区溢出等原因漏掉的事件
+    constexpr int64_t kSafetyRescanMs = 10000;
+
+    // 可执行文件名：优先 /proc/<pid>/exe 的文件名 (不受 comm 的 15 字节截断影响)，
+    // 内核线程与无权访问的进程退回 comm
+    std::string ReadProcessName(uint32_t pid)
+    {
+        char path[64];
+        char target[4096];
+        std::snprintf(path, sizeof(path), "/proc/%u/exe", pid);
+        ssize_t len = readlink(path, target, sizeof(target) - 1);
+        if (len > 0)
+        {
+            target[len]          = 0;
+            const char* deleted  = " (deleted)";
+            size_t      tail     = std::strlen(deleted);
+            if ((size_t)len > tail && std::strcmp(target + len - tail, deleted) == 0) target[len - tail] = 0;
+            const char* slash = std::strrchr(target, '/');
+            return slash ? slash + 1 : target;
+        }
+
+        std::snprintf(path, sizeof(path), "/proc/%u/comm", pid);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return {};
+        len = read(fd, target, sizeof(target) - 1);
+        close(fd);
+        if (len <= 0) return {};
+        if (target[len - 1] == '\n') --len;
+        return std::string(target, (size_t)len);
+    }
+
+    std::vector<uint32_t> ListPids()
+    {
+        std::vector<uint32_t> pids;
+        DIR*                  dir = opendir("/proc");
+        if (!dir) return pids;
+        while (dirent* entry = readdir(dir))
+        {
+            char* end = nullptr;
+            unsigned long pid = std::strtoul(entry->d_name, &end, 10);
+            if (end != entry->d_name && *end == 0) pids.push_back((uint32_t)pid);
+        }
+        closedir(dir);
+        return pids;
+    }
+
+    // 订阅 proc connector；需要 CAP_NET_ADMIN，且只在初始网络命名空间中有事件
+    int OpenProcConnector()
+    {
+        int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_CONNECTOR);
+        if (fd < 0) return -1;
+
+        sockaddr_nl addr{};
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = CN_IDX_PROC;
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            close(fd);
+            return -1;
+        }
+
+        alignas(nlmsghdr) char buf[NLMSG_SPACE(sizeof(cn_msg) + sizeof(int))] = {};
+        nlmsghdr* header    = reinterpret_cast<nlmsghdr*>(buf);
+        header->nlmsg_len   = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(int));
+        header->nlmsg_type  = NLMSG_DONE;
+        header->nlmsg_pid   = (uint32_t)getpid();
+        cn_msg* msg         = reinterpret_cast<cn_msg*>(NLMSG_DATA(header));
+        msg->id.idx         = CN_IDX_PROC;
+        msg->id.val         = CN_VAL_PROC;
+        msg->len            = sizeof(int);
+        int op              = PROC_CN_MCAST_LISTEN;
+        std::memcpy(msg->data, &op, sizeof(op));
+        if (send(fd, header, header->nlmsg_len, 0) < 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}  // namespace
+
+ProcessTable::ProcessTable(const ProcessTableOptions& options) : options_(options)
+{
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    // 先订阅再做首次全量扫描：扫描期间发生的事件留在套接字中，之后重放是幂等的
+    if (options_.use_events) netlink_fd_ = OpenProcConnector();
+    backend_name_ = netlink_fd_ >= 0 ? "proc-connector" : "proc-scan";
+    Rescan(ListPids(), ReadProcessName);
+    service_ = std::thread(&ProcessTable::ServiceLoop, this);
+}
+
+ProcessTable::~ProcessTable()
+{
+    stopping_ = true;
+    WakeService();
+    if (service_.joinable()) service_.join();
+    if (netlink_fd_ >= 0) close(netlink_fd_);
+    close(wake_fd_);
+}
+
+void ProcessTable::WakeService()
+{
+    uint64_t one = 1;
+    (void)!write(wake_fd_, &one, sizeof(one));
+}
+
+void ProcessTable::ServiceLoop()
+{
+    int64_t interval    = netlink_fd_ >= 0 ? kSafetyRescanMs : (int64_t)options_.rescan_ms;
+    int64_t next_rescan = (int64_t)MonotonicNowMs() + interval;
+    alignas(nlmsghdr) char buf[16384];
+
+    while (!stopping_)
+    {
+        int64_t until_rescan = std::max<int64_t>(0, next_rescan - (int64_t)MonotonicNowMs());
+        pollfd  fds[2]       = {{wake_fd_, POLLIN, 0}, {netlink_fd_, POLLIN, 0}};
+        if (poll(fds, netlink_fd_ >= 0 ? 2 : 1, (int)NextTimeoutMs(until_rescan)) < 0 && errno != EINTR) break;
+        if (stopping_) break;
+
+        if (fds[0].revents & POLLIN)
+        {
+            uint64_t value;
+            (void)!read(wake_fd_, &value, sizeof(value));
+        }
+
+        bool overrun = false;
+        if (netlink_fd_ >= 0 && (fds[1].revents & POLLIN))
+        {
+            Fired fired;
+            while (true)
+            {
+                ssize_t len = recv(netlink_fd_, buf, sizeof(buf), 0);
+                if (len < 0)
+                {
+                    if (errno == ENOBUFS) overrun = true;  // 内核丢了事件，读完后全量比对
+                    if (errno == EINTR || errno == ENOBUFS) continue;
+                    break;
+                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (nlmsghdr* h = reinterpret_cast<nlmsghdr*>(buf); NLMSG_OK(h, (size_t)len); h = NLMSG_NEXT(h, len))
+                {
+                    const cn_msg*     msg = reinterpret_cast<const cn_msg*>(NLMSG_DATA(h));
+                    const proc_event* ev  = reinterpret_cast<const proc_event*>(msg->data);
+                    ++events_;
+                    switch (ev->what)
+                    {
+                    case proc_event::PROC_EVENT_FORK:
+                    {
+                        // 只关心新进程 (不是新线程)；exec 之前与父进程同名，无需读取
+                        const auto& fork = ev->event_data.fork;
+                        if (fork.child_pid != fork.child_tgid) break;
+                        auto parent = names_.find((uint32_t)fork.parent_tgid);
+                        if (parent != names_.end()) Added((uint32_t)fork.child_tgid, std::string(parent->second), &fired);
+                        break;
+                    }
+                    case proc_event::PROC_EVENT_EXEC:
+                    {
+                        uint32_t pid = (uint32_t)ev->event_data.exec.process_tgid;
+                        ++name_reads_;
+                        Added(pid, Key(ReadProcessName(pid)), &fired);
+                        break;
+                    }
+                    case proc_event::PROC_EVENT_EXIT:
+                    {
+                        const auto& exit = ev->event_data.exit;
+                        if (exit.process_pid == exit.process_tgid) Removed((uint32_t)exit.process_tgid, &fired);
+                        break;
+                    }
+                    default: break;
+                    }
+                }
+            }
+            Fire(fired);
+        }
+
+        if (overrun || (int64_t)MonotonicNowMs() >= next_rescan)
+        {
+            Rescan(ListPids(), ReadProcessName);
+            next_rescan = (int64_t)MonotonicNowMs() + interval;
+        }
+        ExpireWatches();
+    }
+}
@@ -0,0 +1,84 @@
+#include "process_table.h"
+
+#include "timer_wheel.h"
+
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <tlhelp32.h>
+// clang-format on
+
+#include <algorithm>
+
+namespace
+{
+    std::string WideToUtf8(const wchar_t* str)
+    {
+        int size = WideCharToMultiByte(CP_UTF8, 0, str, -1, NULL, 0, NULL, NULL);
+        if (size <= 1) return {};
+        std::string out((size_t)size - 1, '\0');
+        WideCharToMultiByte(CP_UTF8, 0, str, -1, &out[0], size, NULL, NULL);
+        return out;
+    }
+
+    // 一次快照取得全部 PID 与名称；System Idle Process (PID 0) 不计入
+    bool Snapshot(std::vector<uint32_t>* pids, std::unordered_map<uint32_t, std::wstring>* names)
+    {
+        HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+        if (snapshot == INVALID_HANDLE_VALUE) return false;
+        PROCESSENTRY32W entry{};
+        entry.dwSize = sizeof(entry);
+        for (BOOL ok = Process32FirstW(snapshot, &entry); ok; ok = Process32NextW(snapshot, &entry))
+        {
+            if (entry.th32ProcessID == 0) continue;
+            pids->push_back(entry.th32ProcessID);
+            names->emplace(entry.th32ProcessID, entry.szExeFile);
+        }
+        CloseHandle(snapshot);
+        return true;
+    }
+}  // namespace
+
+ProcessTable::ProcessTable(const ProcessTableOptions& options) : options_(options)
+{
+    wake_event_   = CreateEventW(NULL, FALSE, FALSE, NULL);
+    backend_name_ = "toolhelp-diff";
+    std::vector<uint32_t>                      pids;
+    std::unordered_map<uint32_t, std::wstring> names;
+    if (Snapshot(&pids, &names)) Rescan(pids, [&names](uint32_t pid) { return WideToUtf8(names[pid].c_str()); });
+    service_ = std::thread(&ProcessTable::ServiceLoop, this);
+}
+
+ProcessTable::~ProcessTable()
+{
+    stopping_ = true;
+    WakeService();
+    if (service_.joinable()) service_.join();
+    CloseHandle(wake_event_);
+}
+
+void ProcessTable::WakeService()
+{
+    SetEvent(wake_event_);
+}
+
+// 名称只为新出现的 PID 做 UTF-8 转换；快照本身无法增量获取
+void ProcessTable::ServiceLoop()
+{
+    int64_t next_rescan = (int64_t)MonotonicNowMs() + options_.rescan_ms;
+    while (!stopping_)
+    {
+        int64_t timeout = NextTimeoutMs(std::max<int64_t>(0, next_rescan - (int64_t)MonotonicNowMs()));
+        WaitForSingleObject(wake_event_, (DWORD)timeout);
+        if (stopping_) break;
+
+        if ((int64_t)MonotonicNowMs() >= next_rescan)
+        {
+            std::vector<uint32_t>                      pids;
+            std::unordered_map<uint32_t, std::wstring> names;
+            if (Snapshot(&pids, &names)) Rescan(pids, [&names](uint32_t pid) { return WideToUtf8(names[pid].c_str()); });
+            next_rescan = (int64_t)MonotonicNowMs() + options_.rescan_ms;
+        }
+        ExpireWatches();
+    }
+}
@@ -0,0 +1,249 @@
+#include "runtime_metrics.h"
+
+#include "trace.h"
+
+#if defined(_WIN32)
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+#else
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+
+namespace
+{
+    uint64_t SteadyNs()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    int HighestBit(uint64_t value)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return (int)index;
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+
+    // 进程启动时的刻度与单调时钟：校准追踪时钟的频率，并作为 uptime 的起点
+    struct Origin
+    {
+        uint64_t ticks = TraceNow();
+        uint64_t ns    = SteadyNs();
+    };
+
+    struct Sources
+    {
+        std::mutex                 mutex;
+        std::vector<MetricsSource> list;
+    };
+
+    Sources& GetSources()
+    {
+        static Sources sources;
+        return sources;
+    }
+
+    void AppendNumber(std::string& out, double value)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.3f", value);
+        out += text;
+    }
+}  // namespace
+
+int LatencyHistogram::Bucket(uint64_t value)
+{
+    if (value < (uint64_t)kSubBuckets) return (int)value;
+    int exponent = HighestBit(value);
+    int sub      = (int)((value >> (exponent - kSubBits)) & (kSubBuckets - 1));
+    return (exponent - kSubBits + 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::BucketMidpoint(int bucket)
+{
+    int group = bucket / kSubBuckets;
+    int sub   = bucket % kSubBuckets;
+    if (group == 0) return (uint64_t)sub;
+    int      shift = group - 1;
+    uint64_t lower = (uint64_t)(kSubBuckets + sub) << shift;
+    return lower + ((uint64_t)1 << shift) / 2;
+}
+
+LatencyHistogram::Summary LatencyHistogram::Summarize(double scale) const
+{
+    std::array<uint64_t, kBuckets> counts;
+    Summary                        summary;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        summary.count += counts[i];
+    }
+    if (summary.count == 0) return summary;
+
+    summary.mean = (double)sum_.load(std::memory_order_relaxed) * scale / (double)summary.count;
+    summary.max  = (double)max_.load(std::memory_order_relaxed) * scale;
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    double*      outputs[]   = {&summary.p50, &summary.p90, &summary.p99, &summary.p999};
+    uint64_t     seen        = 0;
+    size_t       next        = 0;
+    for (int i = 0; i < kBuckets && next < 4; ++i)
+    {
+        seen += counts[i];
+        while (next < 4 && (double)seen >= std::ceil(quantiles[next] * (double)summary.count))
+        {
+            // 中点可能超过实际最大值，以 max 为上限
+            *outputs[next++] = std::min((double)BucketMidpoint(i) * scale, summary.max);
+        }
+    }
+    return summary;
+}
+
+RuntimeMetrics& Metrics()
+{
+    static RuntimeMetrics metrics;
+    return metrics;
+}
+
+static const Origin& MetricsOrigin()
+{
+    static Origin origin;
+    return origin;
+}
+
+// 静态初始化期间记录起点，uptime 从进程启动算起
+[[maybe_unused]] static const Origin& g_origin_init = MetricsOrigin();
+
+MetricsSnapshot SnapshotMetrics()
+{
+    RuntimeMetrics& m           = Metrics();
+    const Origin&   origin      = MetricsOrigin();
+    uint64_t        ticks       = TraceNow() - origin.ticks;
+    uint64_t        ns          = SteadyNs() - origin.ns;
+    double          us_per_tick = ticks > 0 ? (double)ns / (double)ticks / 1000.0 : 0.001;
+
+    MetricsSnapshot snapshot;
+#if defined(_WIN32)
+    snapshot.pid = GetCurrentProcessId();
+#else
+    snapshot.pid = (uint64_t)getpid();
+#endif
+    snapshot.uptime_s = (double)ns / 1e9;
+
+    auto load = [](const std::atomic<uint64_t>& v) { return (int64_t)v.load(std::memory_order_relaxed); };
+    int64_t posted     = load(m.completions_posted);
+    int64_t drained    = load(m.completions_drained);
+    int64_t started    = load(m.workers_started);
+    int64_t finished   = load(m.workers_finished);
+    int64_t cancelled  = load(m.workers_cancelled_queued);
+    int64_t dispatched = load(m.workers_dispatched);
+    // 各计数分别读取而非一致快照，相减得到的仪表以 0 为下限
+    snapshot.values = {
+        {"completion_queue_depth", std::max<int64_t>(0, posted - drained)},
+        {"completions_posted", posted},
+        {"resumes", load(m.resumes)},
+        {"workers_dispatched", dispatched},
+        {"workers_queued", std::max<int64_t>(0, dispatched - started - cancelled)},
+        {"workers_running", std::max<int64_t>(0, started - finished)},
+        {"workers_finished", finished},
+        {"workers_failed", load(m.workers_failed)},
+        {"workers_cancelled_queued", cancelled},
+        {"coroutines_running", m.coroutines_running.load(std::memory_order_relaxed)},
+        {"coroutines_idle", m.coroutines_idle.load(std::memory_order_relaxed)},
+        {"coroutines_created", m.coroutines_created.load(std::memory_order_relaxed)},
+        {"anchored", m.anchored.load(std::memory_order_relaxed)},
+        {"wait_operations", m.wait_operations.load(std::memory_order_relaxed)},
+        {"timers", m.timers.load(std::memory_order_relaxed)},
+    };
+    snapshot.latencies = {
+        {"worker_queue_wait", m.worker_queue_wait.Summarize(us_per_tick)},
+        {"worker_exec", m.worker_exec.Summarize(us_per_tick)},
+        {"resume_wait", m.resume_wait.Summarize(us_per_tick)},
+        {"resume", m.resume.Summarize(us_per_tick)},
+    };
+
+    Sources&                    sources = GetSources();
+    std::lock_guard<std::mutex> lock(sources.mutex);
+    for (auto& source : sources.list) source(snapshot);
+    return snapshot;
+}
+
+void AddMetricsSource(MetricsSource source)
+{
+    Sources&                    sources = GetSources();
+    std::lock_guard<std::mutex> lock(sources.mutex);
+    sources.list.push_back(std::move(source));
+}
+
+void ClearMetricsSources()
+{
+    Sources&                    sources = GetSources();
+    std::lock_guard<std::mutex> lock(sources.mutex);
+    sources.list.clear();
+}
+
+std::string FormatMetrics(const MetricsSnapshot& snapshot, bool json)
+{
+    std::string out;
+    if (json)
+    {
+        // 名称均为内部标识符，不需要转义
+        out += "{\"pid\":" + std::to_string(snapshot.pid) + ",\"uptime_s\":";
+        AppendNumber(out, snapshot.uptime_s);
+        out += ",\"values\":{";
+        for (size_t i = 0; i < snapshot.values.size(); ++i)
+        {
+            if (i) out += ",";
+            out += "\"" + snapshot.values[i].name + "\":" + std::to_string(snapshot.values[i].value);
+        }
+        out += "},\"latency_us\":{";
+        for (size_t i = 0; i < snapshot.latencies.size(); ++i)
+        {
+            const auto& l = snapshot.latencies[i];
+            if (i) out += ",";
+            out += "\"" + l.name + "\":{\"count\":" + std::to_string(l.us.count);
+            const std::pair<const char*, double> fields[] = {{"mean", l.us.mean}, {"p50", l.us.p50}, {"p90", l.us.p90},
+                                                             {"p99", l.us.p99},   {"p999", l.us.p999}, {"max", l.us.max}};
+            for (const auto& field : fields)
+            {
+                out += ",\"" + std::string(field.first) + "\":";
+                AppendNumber(out, field.second);
+            }
+            out += "}";
+        }
+        out += "}}\n";
+        return out;
+    }
+
+    char line[256];
+    std::snprintf(line, sizeof(line), "peshell pid %llu, up %.1f s\n\n", (unsigned long long)snapshot.pid,
+                  snapshot.uptime_s);
+    out += line;
+    for (const auto& v : snapshot.values)
+    {
+        std::snprintf(line, sizeof(line), "  %-26s %14lld\n", v.name.c_str(), (long long)v.value);
+        out += line;
+    }
+    std::snprintf(line, sizeof(line), "\n  %-20s %10s %10s %10s %10s %10s %10s %10s\n", "latency (us)", "count", "mean",
+                  "p50", "p90", "p99", "p99.9", "max");
+    out += line;
+    for (const auto& l : snapshot.latencies)
+    {
+        std::snprintf(line, sizeof(line), "  %-20s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", l.name.c_str(),
+                      (unsigned long long)l.us.count, l.us.mean, l.us.p50, l.us.p90, l.us.p99, l.us.p999, l.us.max);
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,115 @@
+#pragma once
+// 常驻实例的运行时指标：无锁计数器与 HDR 风格的延迟直方图，任意线程只读快照，不打扰事件循环。
+//   - 计数器只做 relaxed fetch_add；队列深度等仪表由计数器相减得到，生产者不维护共享的递减计数
+//   - 只有主线程才能读取的状态 (协程池、锚定、等待集合、定时器) 由调度器每轮循环发布到仪表
+//   - 延迟以追踪时钟 (TraceNow) 的刻度记录，快照时再换算为微秒
+// 本文件不依赖 Lua。
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 对数-线性直方图：值按 2 的幂分组，每组再线性分 16 格，相对误差不超过 1/16；
+// 覆盖完整的 uint64 范围，记录为两次 relaxed fetch_add 与一次很少发生的 max 更新
+class LatencyHistogram
+{
+public:
+    static constexpr int kSubBits    = 4;
+    static constexpr int kSubBuckets = 1 << kSubBits;
+    static constexpr int kBuckets    = (64 - kSubBits + 1) * kSubBuckets;
+
+    void Record(uint64_t value)
+    {
+        buckets_[Bucket(value)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    static int Bucket(uint64_t value);
+    static uint64_t BucketMidpoint(int bucket);
+
+    struct Summary
+    {
+        uint64_t count = 0;
+        double   mean  = 0;
+        double   p50   = 0;
+        double   p90   = 0;
+        double   p99   = 0;
+        double   p999  = 0;
+        double   max   = 0;
+    };
+
+    // scale 把记录的单位换算为输出单位
+    Summary Summarize(double scale) const;
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+    std::atomic<uint64_t>                       sum_{0};
+    std::atomic<uint64_t>                       max_{0};
+};
+
+struct RuntimeMetrics
+{
+    // 完成队列 (调度器)：深度 = posted - drained
+    std::atomic<uint64_t> completions_posted{0};
+    std::atomic<uint64_t> completions_drained{0};  // 只由主线程写
+    std::atomic<uint64_t> resumes{0};              // 只由主线程写
+
+    // 注册表派发到线程池的工作者：排队 = dispatched - started - cancelled_queued，执行中 = started - finished
+    std::atomic<uint64_t> workers_dispatched{0};
+    std::atomic<uint64_t> workers_started{0};
+    std::atomic<uint64_t> workers_finished{0};
+    std::atomic<uint64_t> workers_failed{0};  // finished 中失败 (含执行中取消) 的部分
+    std::atomic<uint64_t> workers_cancelled_queued{0};
+
+    // 主线程发布的仪表
+    std::atomic<int64_t> coroutines_running{0};
+    std::atomic<int64_t> coroutines_idle{0};
+    std::atomic<int64_t> coroutines_created{0};
+    std::atomic<int64_t> anchored{0};
+    std::atomic<int64_t> wait_operations{0};
+    std::atomic<int64_t> timers{0};
+
+    LatencyHistogram worker_queue_wait;  // 派发 -> 开始执行
+    LatencyHistogram worker_exec;        // 线程池上的执行
+    LatencyHistogram resume_wait;        // 完成投递 -> 协程在主线程上恢复
+    LatencyHistogram resume;             // 一次 lua_resume 的耗时
+};
+
+RuntimeMetrics& Metrics();
+
+struct MetricsSnapshot
+{
+    struct Value
+    {
+        std::string name;
+        int64_t     value;
+    };
+
+    struct Latency
+    {
+        std::string               name;
+        LatencyHistogram::Summary us;  // 微秒
+    };
+
+    uint64_t             pid      = 0;
+    double               uptime_s = 0;
+    std::vector<Value>   values;
+    std::vector<Latency> latencies;
+};
+
+// 任意线程；额外的数据源 (如线程池) 经 AddMetricsSource 注入，须自身线程安全
+MetricsSnapshot SnapshotMetrics();
+
+using MetricsSource = std::function<void(MetricsSnapshot&)>;
+void AddMetricsSource(MetricsSource source);
+void ClearMetricsSources();
+
+// json 为 false 时为对齐的文本表格
+std::string FormatMetrics(const MetricsSnapshot& snapshot, bool json);
@@ -0,0 +1,230 @@
+#include "scheduler.h"
+
+#include "file_buffer.h"
+#include "flight_recorder.h"
+#include "runtime_metrics.h"
+#include "trace.h"
+
+#include <lua.hpp>
+
+Scheduler::Scheduler(lua_State* L) : L_(L), coroutines_(L), loop_(EventLoop::Create()), timers_(MonotonicNowMs())
+{
+    waits_ = std::make_unique<WaitSet>([this] { loop_->Wakeup(); });
+}
+
+Scheduler::~Scheduler()
+{
+    waits_.reset();
+    while (AsyncTaskResult* r = completed_.Pop())
+    {
+        if (r->buffer) r->buffer->release(r->buffer);
+        delete r;
+    }
+}
+
+void Scheduler::Post(AsyncTaskResult* result)
+{
+    result->posted_at = TraceNow();
+    Metrics().completions_posted.fetch_add(1, std::memory_order_relaxed);
+    if (completed_.Push(result)) loop_->Wakeup();
+}
+
+void Scheduler::PostCompletion(lua_State* co, bool success, std::string data, std::string error_msg)
+{
+    auto* result = new AsyncTaskResult{co, success, std::move(data), std::move(error_msg)};
+    Post(result);
+}
+
+void Scheduler::PostBuffer(lua_State* co, pesh_buffer* buffer)
+{
+    auto* result      = new AsyncTaskResult{co, true, {}, {}};
+    result->is_buffer = true;
+    result->buffer    = buffer;
+    Post(result);
+}
+
+void Scheduler::PostValue(lua_State* co, ValuePusher push)
+{
+    auto* result = new AsyncTaskResult{co, true, {}, {}};
+    result->push = std::move(push);
+    Post(result);
+}
+
+void Scheduler::PostFailure(lua_State* co, int error_code, std::string error_msg)
+{
+    auto* result       = new AsyncTaskResult{co, false, {}, std::move(error_msg)};
+    result->error_code = error_code;
+    Post(result);
+}
+
+void Scheduler::Anchor(lua_State* L, int idx)
+{
+    lua_State* co = lua_tothread(L, idx);
+    if (!co) return;
+    auto it = anchors_.find(co);
+    if (it != anchors_.end())
+    {
+        ++it->second.count;
+        return;
+    }
+    lua_pushvalue(L, idx);
+    anchors_.emplace(co, AnchorRef{luaL_ref(L, LUA_REGISTRYINDEX), 1});
+}
+
+void Scheduler::ReleaseAnchor(lua_State* co)
+{
+    auto it = anchors_.find(co);
+    if (it == anchors_.end() || --it->second.count > 0) return;
+    luaL_unref(L_, LUA_REGISTRYINDEX, it->second.ref);
+    anchors_.erase(it);
+}
+
+// 先恢复再解除锚定：co 可能在这次恢复中再次等待并叠加锚定，结束或出错时还要由协程池读取它的栈
+void Scheduler::Resume(lua_State* co, int nargs)
+{
+    uint64_t begin = TraceNow();
+    FlightRecordAt(begin, FlightEvent::CoroutineResume, (uint8_t)nargs, 0, (uint64_t)(uintptr_t)co);
+    int      status = lua_resume(co, nargs);
+    uint64_t end    = TraceNow();
+    FlightRecordAt(end, FlightEvent::CoroutineReturn, (uint8_t)status, 0, (uint64_t)(uintptr_t)co);
+    RuntimeMetrics& metrics = Metrics();
+    metrics.resumes.store(metrics.resumes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    metrics.resume.Record(end - begin);
+    if (TraceEnabled())
+    {
+        static const uint32_t kTraceResume = TraceName("resume");
+        TraceComplete(kTraceResume, TraceCategory::Lua, begin, end);
+    }
+    coroutines_.AfterResume(co, status);
+    ReleaseAnchor(co);
+}
+
+void Scheduler::SleepAsync(lua_State* co, uint64_t delay_ms)
+{
+    FlightRecord(FlightEvent::TimerSchedule, 0, 0, (uint64_t)(uintptr_t)co, delay_ms);
+    timers_.Schedule(MonotonicNowMs(), delay_ms, co);
+}
+
+bool Scheduler::WaitAsync(lua_State* co, const std::vector<WaitHandle>& handles, std::string* error)
+{
+    FlightRecord(FlightEvent::WaitRegister, 0, (uint32_t)handles.size(), (uint64_t)(uintptr_t)co);
+    return waits_->Add(co, handles, error);
+}
+
+int Scheduler::Run()
+{
+    while (true)
+    {
+        int64_t timeout_ms = timers_.NextTimeoutMs(MonotonicNowMs());
+        if (!completed_.Empty() || waits_->HasSignaled()) timeout_ms = 0;
+
+        if (!loop_->Wait(timeout_ms)) break;
+
+        DrainSignaledWaits();
+        DrainCompletedTasks();
+        FireExpiredTimers();
+        PublishMetrics();
+    }
+    return loop_->ExitCode();
+}
+
+void Scheduler::PublishMetrics()
+{
+    RuntimeMetrics&      metrics = Metrics();
+    CoroutinePool::Stats stats   = coroutines_.GetStats();
+    metrics.coroutines_running.store((int64_t)stats.running, std::memory_order_relaxed);
+    metrics.coroutines_idle.store((int64_t)stats.idle, std::memory_order_relaxed);
+    metrics.coroutines_created.store((int64_t)stats.created, std::memory_order_relaxed);
+    metrics.anchored.store((int64_t)anchors_.size(), std::memory_order_relaxed);
+    metrics.wait_operations.store((int64_t)waits_->Size(), std::memory_order_relaxed);
+    metrics.timers.store((int64_t)timers_.Size(), std::memory_order_relaxed);
+}
+
+// 按 FIFO 恢复已完成任务的协程，结果移动而非复制；超出预算的留到下一轮
+void Scheduler::DrainCompletedTasks()
+{
+    for (size_t resumed = 0; resume_budget_ == 0 || resumed < resume_budget_; ++resumed)
+    {
+        std::unique_ptr<AsyncTaskResult> r(completed_.Pop());
+        if (!r) break;
+        lua_State*      co      = r->co;
+        RuntimeMetrics& metrics = Metrics();
+        uint64_t        now     = TraceNow();
+        metrics.completions_drained.store(metrics.completions_drained.load(std::memory_order_relaxed) + 1,
+                                          std::memory_order_relaxed);
+        metrics.resume_wait.Record(now - r->posted_at);
+        if (TraceEnabled())
+        {
+            static const uint32_t kTraceResumeWait = TraceName("resume wait");
+            uint64_t              id               = TraceNextId();
+            TraceAsyncBegin(kTraceResumeWait, TraceCategory::Resume, id, r->posted_at);
+            TraceAsyncEnd(kTraceResumeWait, TraceCategory::Resume, id, now);
+        }
+        if (lua_status(co) != LUA_YIELD)
+        {
+            if (r->buffer) r->buffer->release(r->buffer);
+            ReleaseAnchor(co);
+            continue;
+        }
+        lua_pushboolean(co, r->success);
+        if (r->success && r->push)
+        {
+            r->push(co);
+        }
+        else if (r->success && r->is_buffer)
+        {
+            if (r->buffer) lua_pushlightuserdata(co, r->buffer);
+            else lua_pushnil(co);
+        }
+        else
+        {
+            const std::string& payload = r->success ? r->data : r->error_msg;
+            lua_pushlstring(co, payload.data(), payload.length());
+        }
+        int nargs = 2;
+        if (!r->success)
+        {
+            lua_pushinteger(co, r->error_code);
+            nargs = 3;
+        }
+        r.reset();  // 恢复前释放缓冲区，避免大文件在协程运行期间多占一份内存
+        Resume(co, nargs);
+    }
+}
+
+void Scheduler::DrainSignaledWaits()
+{
+    void* context = nullptr;
+    int   index   = 0;
+    while (waits_->PopSignaled(&context, &index))
+    {
+        lua_State* co = static_cast<lua_State*>(context);
+        if (lua_status(co) != LUA_YIELD)
+        {
+            ReleaseAnchor(co);
+            continue;
+        }
+        lua_pushboolean(co, true);
+        lua_pushinteger(co, index);
+        Resume(co, 2);
+    }
+}
+
+void Scheduler::FireExpiredTimers()
+{
+    std::vector<TimerWheel::Expired> expired;
+    if (timers_.Advance(MonotonicNowMs(), expired) == 0) return;
+    for (const auto& e : expired)
+    {
+        lua_State* co = static_cast<lua_State*>(e.payload);
+        if (!co) continue;
+        if (lua_status(co) != LUA_YIELD)
+        {
+            ReleaseAnchor(co);
+            continue;
+        }
+        lua_pushboolean(co, true);
+        lua_pushstring(co, "Timer expired");
+        Resume(co, 2);
+    }
+}
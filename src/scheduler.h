@@ -0,0 +1,120 @@
+#pragma once
+// 协程调度器：工作线程完成、内核对象等待与定时器统一汇入一个事件循环，
+// 所有 Lua 协程只在事件循环线程 (主线程) 上恢复。平台差异全部在 EventLoop / WaitSet 后端中。
+// 交给原生层等待的协程由注册表引用锚定，完成送达 (或被丢弃) 时自动解除。
+
+#include "coroutine_pool.h"
+#include "event_loop.h"
+#include "mpsc_queue.h"
+#include "timer_wheel.h"
+#include "wait_set.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct lua_State;
+struct pesh_buffer;
+
+// 在主线程上向协程压入恰好一个值
+using ValuePusher = std::function<void(lua_State*)>;
+
+struct AsyncTaskResult
+{
+    lua_State*       co;
+    bool             success;
+    std::string      data;
+    std::string      error_msg;
+    int              error_code = 0;      // 失败时作为第三个值交付
+    bool             is_buffer  = false;  // 成功时以 lightuserdata (或 nil) 交付 buffer，而不是 data 字符串
+    pesh_buffer*     buffer     = nullptr;
+    ValuePusher      push       = nullptr;  // 成功时优先于 buffer / data
+    uint64_t         posted_at  = 0;        // 投递时的追踪时钟刻度，用于统计恢复前的等待
+    AsyncTaskResult* mpsc_next  = nullptr;
+};
+
+class Scheduler
+{
+public:
+    // L 为主 Lua 状态，须比调度器活得久
+    explicit Scheduler(lua_State* L);
+    ~Scheduler();
+
+    Scheduler(const Scheduler&)            = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    // 任意线程：只有队列由空变为非空时才唤醒事件循环
+    void PostCompletion(lua_State* co, bool success, std::string data, std::string error_msg);
+
+    // 任意线程：以 (true, lightuserdata) 恢复 co，buffer 为 nullptr 时值为 nil；
+    // 协程已不在等待时由调度器负责释放 buffer
+    void PostBuffer(lua_State* co, pesh_buffer* buffer);
+
+    // 任意线程：以 (true, push 压入的值) 恢复 co，用于表等字符串无法表达的结构化结果
+    void PostValue(lua_State* co, ValuePusher push);
+
+    // 任意线程：以 (false, error_msg, error_code) 恢复 co
+    void PostFailure(lua_State* co, int error_code, std::string error_msg);
+
+    // 以下仅限主线程调用
+
+    // 锚定 L 栈上 idx 处的协程，直到下一次由调度器恢复它；同一协程可叠加锚定
+    void Anchor(lua_State* L, int idx);
+
+    CoroutinePool& Coroutines()
+    {
+        return coroutines_;
+    }
+
+    void SleepAsync(lua_State* co, uint64_t delay_ms);
+
+    // 任一句柄触发时以 (true, index) 恢复 co；注册失败返回 false
+    bool WaitAsync(lua_State* co, const std::vector<WaitHandle>& handles, std::string* error);
+
+    // 每轮循环最多恢复的完成数，0 表示不限
+    void SetResumeBudget(size_t budget)
+    {
+        resume_budget_ = budget;
+    }
+
+    void Quit(int exit_code)
+    {
+        loop_->Quit(exit_code);
+    }
+
+    const char* BackendName() const
+    {
+        return loop_->Name();
+    }
+
+    // 持久循环，直到 Quit / WM_QUIT，返回退出码
+    int Run();
+
+    // 把只能在主线程读取的状态发布到 Metrics() 的仪表；Run 每轮循环调用一次
+    void PublishMetrics();
+
+private:
+    void Post(AsyncTaskResult* result);
+    void Resume(lua_State* co, int nargs);
+    void ReleaseAnchor(lua_State* co);
+    void DrainCompletedTasks();
+    void DrainSignaledWaits();
+    void FireExpiredTimers();
+
+    struct AnchorRef
+    {
+        int ref;
+        int count;
+    };
+
+    lua_State*                                L_;
+    CoroutinePool                             coroutines_;
+    std::unordered_map<lua_State*, AnchorRef> anchors_;
+    std::unique_ptr<EventLoop>                loop_;
+    MpscQueue<AsyncTaskResult> completed_;
+    TimerWheel                 timers_;
+    size_t                     resume_budget_ = 128;
+    std::unique_ptr<WaitSet>   waits_;  // 最后构造、最先析构：等待线程可能仍在调用 loop_->Wakeup()
+};
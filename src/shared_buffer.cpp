@@ -0,0 +1,87 @@
+#include "shared_buffer.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <unordered_set>
+
+namespace
+{
+    struct SharedBuffer : pesh_shared
+    {
+        std::atomic<int64_t> refs{1};
+        pesh_buffer*         adopted = nullptr;
+    };
+
+    // 存活集合只在创建与销毁时加锁，retain / release 本身无锁
+    struct LiveSet
+    {
+        std::mutex                            mutex;
+        std::unordered_set<const pesh_shared*> buffers;
+    };
+
+    LiveSet& Live()
+    {
+        static LiveSet live;
+        return live;
+    }
+
+    void Retain(pesh_shared* buffer)
+    {
+        static_cast<SharedBuffer*>(buffer)->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Release(pesh_shared* buffer)
+    {
+        auto* shared = static_cast<SharedBuffer*>(buffer);
+        if (shared->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        {
+            LiveSet&                    live = Live();
+            std::lock_guard<std::mutex> lock(live.mutex);
+            live.buffers.erase(shared);
+        }
+        if (shared->adopted) shared->adopted->release(shared->adopted);
+        else std::free(shared->data);
+        delete shared;
+    }
+
+    pesh_shared* Publish(SharedBuffer* shared)
+    {
+        shared->retain  = Retain;
+        shared->release = Release;
+        LiveSet&                    live = Live();
+        std::lock_guard<std::mutex> lock(live.mutex);
+        live.buffers.insert(shared);
+        return shared;
+    }
+}  // namespace
+
+pesh_shared* NewSharedBuffer(size_t size)
+{
+    // calloc 对大块直接取零页，不必逐字节清零
+    auto* data = static_cast<uint8_t*>(std::calloc(size ? size : 1, 1));
+    if (!data) return nullptr;
+    auto* shared     = new SharedBuffer;
+    shared->data     = data;
+    shared->size     = size;
+    shared->readonly = 0;
+    return Publish(shared);
+}
+
+pesh_shared* AdoptSharedBuffer(pesh_buffer* buffer)
+{
+    auto* shared     = new SharedBuffer;
+    shared->data     = const_cast<uint8_t*>(buffer->data);
+    shared->size     = buffer->size;
+    shared->readonly = 1;
+    shared->adopted  = buffer;
+    return Publish(shared);
+}
+
+bool IsSharedBuffer(const void* ptr)
+{
+    LiveSet&                    live = Live();
+    std::lock_guard<std::mutex> lock(live.mutex);
+    return live.buffers.count(static_cast<const pesh_shared*>(ptr)) != 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+// 跨 Lua 状态共享的引用计数缓冲区：主状态与 Lua 工作者状态 (src/lua_workers.h) 各自以 cdata 持有同一块内存，
+// 传递时只增加引用，不复制。每个持有者 (cdata、排队中的消息) 各占一个引用，最后一个 release 时释放。
+// 并发读写同一区域由脚本自行约定 (例如按片划分)。
+// pesh_shared 的布局必须与 scripts/plugins/parallel 中的 ffi.cdef 保持一致。本文件不依赖 Lua。
+
+#include "file_buffer.h"
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C"
+{
+    struct pesh_shared
+    {
+        uint8_t* data;
+        size_t   size;
+        int32_t  readonly;  // 接管映射文件得到的缓冲区不可写
+        void (*retain)(struct pesh_shared*);
+        void (*release)(struct pesh_shared*);  // 任意线程
+    };
+}
+
+// 零初始化的可写缓冲区，引用计数为 1；分配失败返回 nullptr
+pesh_shared* NewSharedBuffer(size_t size);
+
+// 接管 buffer (如 file_map 的映射)，最后一个引用释放时调用 buffer->release；引用计数为 1
+pesh_shared* AdoptSharedBuffer(pesh_buffer* buffer);
+
+// ptr 是否为仍然存活的共享缓冲区；用于校验 Lua 传入的任意 cdata 指针
+bool IsSharedBuffer(const void* ptr);
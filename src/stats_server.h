@@ -0,0 +1,37 @@
+#pragma once
+// 运行时指标的本地查询通道，供另一个 peshell 进程 (peshell stats) 读取常驻实例的 SnapshotMetrics。
+//   Windows: 命名管道 \\.\pipe\peshell-stats-<pid>
+//   Linux:   抽象 Unix 套接字 @peshell-stats-<pid> (不在文件系统中留下残留)，用 SO_PEERCRED 只应答同一 uid 的客户端
+// 请求为一行 "text" 或 "json"，应答为 FormatMetrics 的输出，随后关闭连接。
+// 服务线程只读取原子计数，不接触 Lua 与事件循环。本文件不依赖 Lua。
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class StatsServer
+{
+public:
+    // 失败 (例如同名端点已存在) 返回 nullptr
+    static std::unique_ptr<StatsServer> Start(uint64_t pid, std::string* error);
+    ~StatsServer();
+
+    StatsServer(const StatsServer&)            = delete;
+    StatsServer& operator=(const StatsServer&) = delete;
+
+    uint64_t Served() const;
+
+    struct Impl;
+
+private:
+    explicit StatsServer(std::unique_ptr<Impl> impl);
+
+    std::unique_ptr<Impl> impl_;
+};
+
+// 本机上正在提供查询通道的进程 ID
+std::vector<uint64_t> ListStatsEndpoints();
+
+// 向 pid 的查询通道请求一次快照
+bool QueryStats(uint64_t pid, bool json, std::string* out, std::string* error);
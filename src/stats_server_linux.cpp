@@ -0,0 +1,165 @@
+#include "stats_server.h"
+
+#include "runtime_metrics.h"
+#include "unix_socket.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <thread>
+
+namespace
+{
+    constexpr const char* kPrefix = "peshell-stats-";
+
+    std::string EndpointName(uint64_t pid)
+    {
+        return kPrefix + std::to_string(pid);
+    }
+}  // namespace
+
+struct StatsServer::Impl
+{
+    int                   listen_fd = -1;
+    int                   wake_fd   = -1;
+    std::thread           thread;
+    std::atomic<uint64_t> served{0};
+
+    void Serve(int client)
+    {
+        SetSocketTimeouts(client, 1000, 1000);  // 卡住的客户端不会拖住服务线程
+        char   request[64];
+        size_t size = 0;
+        while (size < sizeof(request))
+        {
+            ssize_t n = recv(client, request + size, sizeof(request) - size, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            size += (size_t)n;
+            if (std::memchr(request, '\n', size)) break;
+        }
+        bool json = size >= 4 && std::memcmp(request, "json", 4) == 0;
+        SendAll(client, FormatMetrics(SnapshotMetrics(), json));
+        served.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Loop()
+    {
+        while (true)
+        {
+            pollfd fds[2] = {{listen_fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+            if (poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR) continue;
+                return;
+            }
+            if (fds[1].revents) return;
+            if (!(fds[0].revents & POLLIN)) continue;
+            int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) continue;
+            if (PeerIsSameUser(client)) Serve(client);  // 只给同一 uid 的客户端回答指标
+            close(client);
+        }
+    }
+};
+
+StatsServer::StatsServer(std::unique_ptr<Impl> impl) : impl_(std::move(impl))
+{
+    impl_->thread = std::thread([impl = impl_.get()] { impl->Loop(); });
+}
+
+StatsServer::~StatsServer()
+{
+    uint64_t one = 1;
+    (void)!write(impl_->wake_fd, &one, sizeof(one));
+    if (impl_->thread.joinable()) impl_->thread.join();
+    close(impl_->listen_fd);
+    close(impl_->wake_fd);
+}
+
+std::unique_ptr<StatsServer> StatsServer::Start(uint64_t pid, std::string* error)
+{
+    auto impl       = std::make_unique<Impl>();
+    impl->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    impl->wake_fd   = eventfd(0, EFD_CLOEXEC);
+    sockaddr_un addr;
+    socklen_t   len = AbstractSocketAddress(EndpointName(pid), &addr);
+    if (impl->listen_fd < 0 || impl->wake_fd < 0 || bind(impl->listen_fd, (sockaddr*)&addr, len) < 0 ||
+        listen(impl->listen_fd, 8) < 0)
+    {
+        if (error) *error = std::string("stats endpoint: ") + std::strerror(errno);
+        if (impl->listen_fd >= 0) close(impl->listen_fd);
+        if (impl->wake_fd >= 0) close(impl->wake_fd);
+        return nullptr;
+    }
+    return std::unique_ptr<StatsServer>(new StatsServer(std::move(impl)));
+}
+
+uint64_t StatsServer::Served() const
+{
+    return impl_->served.load(std::memory_order_relaxed);
+}
+
+// /proc/net/unix 每行末尾为路径，抽象地址以 @ 开头；被接受的连接也带着同一路径，需去重
+std::vector<uint64_t> ListStatsEndpoints()
+{
+    std::set<uint64_t> pids;
+    std::ifstream      in("/proc/net/unix");
+    std::string        line;
+    std::string        needle = std::string("@") + kPrefix;
+    while (std::getline(in, line))
+    {
+        size_t pos = line.find(needle);
+        if (pos == std::string::npos) continue;
+        const char* digits = line.c_str() + pos + needle.size();
+        char*       end    = nullptr;
+        uint64_t    pid    = std::strtoull(digits, &end, 10);
+        if (end != digits && (*end == 0 || *end == ' ')) pids.insert(pid);
+    }
+    return std::vector<uint64_t>(pids.begin(), pids.end());
+}
+
+bool QueryStats(uint64_t pid, bool json, std::string* out, std::string* error)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        if (error) *error = std::strerror(errno);
+        return false;
+    }
+    SetSocketTimeouts(fd, 2000, 2000);
+    sockaddr_un addr;
+    socklen_t   len = AbstractSocketAddress(EndpointName(pid), &addr);
+    if (connect(fd, (sockaddr*)&addr, len) < 0 || !SendAll(fd, json ? "json\n" : "text\n"))
+    {
+        if (error) *error = "no stats endpoint for pid " + std::to_string(pid) + ": " + std::strerror(errno);
+        close(fd);
+        return false;
+    }
+    shutdown(fd, SHUT_WR);
+
+    out->clear();
+    char buf[4096];
+    while (true)
+    {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0)
+        {
+            if (error) *error = std::string("stats query: ") + std::strerror(errno);
+            close(fd);
+            return false;
+        }
+        if (n == 0) break;
+        out->append(buf, (size_t)n);
+    }
+    close(fd);
+    return true;
+}
@@ -0,0 +1,182 @@
+#include "stats_server.h"
+
+#include "runtime_metrics.h"
+
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+
+#include <atomic>
+#include <cstring>
+#include <cwchar>
+#include <set>
+#include <thread>
+
+namespace
+{
+    constexpr const wchar_t* kPipePrefix = L"peshell-stats-";
+
+    std::wstring PipeName(uint64_t pid)
+    {
+        return std::wstring(L"\\\\.\\pipe\\") + kPipePrefix + std::to_wstring(pid);
+    }
+
+    // 重叠 I/O 等待 timeout_ms，超时则取消；返回传输的字节数，失败为 -1
+    long Transfer(HANDLE pipe, OVERLAPPED* ov, BOOL started, DWORD timeout_ms)
+    {
+        DWORD bytes = 0;
+        if (!started && GetLastError() != ERROR_IO_PENDING) return -1;
+        if (WaitForSingleObject(ov->hEvent, timeout_ms) != WAIT_OBJECT_0)
+        {
+            CancelIo(pipe);
+            GetOverlappedResult(pipe, ov, &bytes, TRUE);
+            return -1;
+        }
+        if (!GetOverlappedResult(pipe, ov, &bytes, FALSE)) return -1;
+        return (long)bytes;
+    }
+}  // namespace
+
+struct StatsServer::Impl
+{
+    std::wstring          name;
+    HANDLE                pipe       = INVALID_HANDLE_VALUE;  // 唯一的实例，每个客户端应答后断开复用
+    HANDLE                stop_event = nullptr;
+    HANDLE                io_event   = nullptr;
+    std::thread           thread;
+    std::atomic<uint64_t> served{0};
+
+    void Serve()
+    {
+        OVERLAPPED ov{};
+        ov.hEvent = io_event;
+        char request[64];
+        long size = Transfer(pipe, &ov, ReadFile(pipe, request, sizeof(request), nullptr, &ov), 1000);
+        bool json = size >= 4 && std::memcmp(request, "json", 4) == 0;
+
+        std::string response = FormatMetrics(SnapshotMetrics(), json);
+        ov                   = OVERLAPPED{};
+        ov.hEvent            = io_event;
+        Transfer(pipe, &ov, WriteFile(pipe, response.data(), (DWORD)response.size(), nullptr, &ov), 1000);
+
+        // 客户端读到断开为止；先等它取走全部应答再断开，避免截断
+        FlushFileBuffers(pipe);
+        served.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Loop()
+    {
+        while (true)
+        {
+            OVERLAPPED ov{};
+            ov.hEvent      = io_event;
+            BOOL connected = ConnectNamedPipe(pipe, &ov);
+            DWORD error    = connected ? ERROR_SUCCESS : GetLastError();
+            if (!connected && error == ERROR_IO_PENDING)
+            {
+                HANDLE events[2] = {stop_event, io_event};
+                if (WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0)
+                {
+                    CancelIo(pipe);
+                    DWORD bytes;
+                    GetOverlappedResult(pipe, &ov, &bytes, TRUE);
+                    return;
+                }
+                DWORD bytes;
+                error = GetOverlappedResult(pipe, &ov, &bytes, FALSE) ? ERROR_SUCCESS : GetLastError();
+            }
+            if (error == ERROR_SUCCESS || error == ERROR_PIPE_CONNECTED) Serve();
+            DisconnectNamedPipe(pipe);
+            if (WaitForSingleObject(stop_event, 0) == WAIT_OBJECT_0) return;
+        }
+    }
+};
+
+StatsServer::StatsServer(std::unique_ptr<Impl> impl) : impl_(std::move(impl))
+{
+    impl_->thread = std::thread([impl = impl_.get()] { impl->Loop(); });
+}
+
+StatsServer::~StatsServer()
+{
+    SetEvent(impl_->stop_event);
+    if (impl_->thread.joinable()) impl_->thread.join();
+    CloseHandle(impl_->pipe);
+    CloseHandle(impl_->stop_event);
+    CloseHandle(impl_->io_event);
+}
+
+std::unique_ptr<StatsServer> StatsServer::Start(uint64_t pid, std::string* error)
+{
+    auto impl  = std::make_unique<Impl>();
+    impl->name = PipeName(pid);
+    impl->pipe = CreateNamedPipeW(impl->name.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                  PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1,
+                                  64 * 1024, 64 * 1024, 0, nullptr);
+    if (impl->pipe == INVALID_HANDLE_VALUE)
+    {
+        if (error) *error = "stats endpoint: CreateNamedPipe failed (" + std::to_string(GetLastError()) + ")";
+        return nullptr;
+    }
+    impl->stop_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    impl->io_event   = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    return std::unique_ptr<StatsServer>(new StatsServer(std::move(impl)));
+}
+
+uint64_t StatsServer::Served() const
+{
+    return impl_->served.load(std::memory_order_relaxed);
+}
+
+// 枚举 \\.\pipe\ 下的全部管道名
+std::vector<uint64_t> ListStatsEndpoints()
+{
+    std::set<uint64_t> pids;
+    WIN32_FIND_DATAW   data;
+    HANDLE             find = FindFirstFileW(L"\\\\.\\pipe\\*", &data);
+    if (find == INVALID_HANDLE_VALUE) return {};
+    size_t prefix = std::wcslen(kPipePrefix);
+    do
+    {
+        if (std::wcsncmp(data.cFileName, kPipePrefix, prefix) != 0) continue;
+        wchar_t* end = nullptr;
+        uint64_t pid = std::wcstoull(data.cFileName + prefix, &end, 10);
+        if (end != data.cFileName + prefix && *end == 0) pids.insert(pid);
+    } while (FindNextFileW(find, &data));
+    FindClose(find);
+    return std::vector<uint64_t>(pids.begin(), pids.end());
+}
+
+bool QueryStats(uint64_t pid, bool json, std::string* out, std::string* error)
+{
+    std::wstring name = PipeName(pid);
+    HANDLE       pipe = INVALID_HANDLE_VALUE;
+    // 服务端同一时刻只有一个实例，正在应答其他客户端时短暂等待
+    for (int attempt = 0; attempt < 2 && pipe == INVALID_HANDLE_VALUE; ++attempt)
+    {
+        pipe = CreateFileW(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (pipe == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY) WaitNamedPipeW(name.c_str(), 2000);
+    }
+    if (pipe == INVALID_HANDLE_VALUE)
+    {
+        if (error) *error = "no stats endpoint for pid " + std::to_string(pid) + " (" + std::to_string(GetLastError()) + ")";
+        return false;
+    }
+
+    const char* request = json ? "json\n" : "text\n";
+    DWORD       written = 0;
+    if (!WriteFile(pipe, request, 5, &written, nullptr))
+    {
+        if (error) *error = "stats query: WriteFile failed (" + std::to_string(GetLastError()) + ")";
+        CloseHandle(pipe);
+        return false;
+    }
+
+    out->clear();
+    char  buf[4096];
+    DWORD read = 0;
+    while (ReadFile(pipe, buf, sizeof(buf), &read, nullptr) && read > 0) out->append(buf, read);
+    CloseHandle(pipe);
+    return !out->empty();
+}
@@ -0,0 +1,287 @@
+#include "supervisor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+std::shared_ptr<Supervisor> Supervisor::Create(std::vector<ServiceSpec> specs)
+{
+    return std::shared_ptr<Supervisor>(new Supervisor(std::move(specs)));
+}
+
+Supervisor::Supervisor(std::vector<ServiceSpec> specs)
+{
+    services_.resize(specs.size());
+    for (size_t i = 0; i < specs.size(); ++i)
+    {
+        services_[i].spec        = std::move(specs[i]);
+        services_[i].status.name = services_[i].spec.name;
+    }
+    waits_ = std::make_unique<WaitSet>([this] {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wakeup_ = true;
+        cv_.notify_one();
+    });
+    next_start_at_ = Clock::now();
+    thread_        = std::thread(&Supervisor::ServiceLoop, this);
+}
+
+Supervisor::~Supervisor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    cv_.notify_one();
+    if (thread_.joinable()) thread_.join();
+    waits_.reset();
+}
+
+void Supervisor::Stop(DoneFn done)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    wakeup_   = true;
+    stop_waiters_.push_back(std::move(done));
+    cv_.notify_one();
+}
+
+std::vector<ServiceStatus> Supervisor::Status() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<ServiceStatus>  statuses;
+    statuses.reserve(services_.size());
+    for (const Service& service : services_) statuses.push_back(service.status);
+    return statuses;
+}
+
+void Supervisor::NextEvent(EventFn callback)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (events_.empty())
+    {
+        event_waiter_ = std::move(callback);
+        return;
+    }
+    ServiceEvent event = std::move(events_.front());
+    events_.pop_front();
+    lock.unlock();
+    callback(&event);
+}
+
+void Supervisor::ServiceLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!quit_)
+    {
+        Clock::time_point deadline = NextDeadline();
+        auto              woken    = [this] { return wakeup_ || quit_; };
+        if (deadline == Clock::time_point::max()) cv_.wait(lock, woken);
+        else cv_.wait_until(lock, deadline, woken);
+        wakeup_ = false;
+        if (quit_) break;
+
+        // PopSignaled 不持锁：WaitSet 的唤醒回调需要拿锁
+        lock.unlock();
+        std::vector<Service*> exited;
+        void*                 context;
+        int                   index;
+        while (waits_->PopSignaled(&context, &index)) exited.push_back(static_cast<Service*>(context));
+        lock.lock();
+
+        Clock::time_point now = Clock::now();
+        for (Service* service : exited) OnExit(*service, now);
+        if (!stopping_)
+        {
+            for (Service& service : services_)
+            {
+                if (service.status.state == ServiceState::Backoff && now >= service.restart_at) Launch(service, now);
+            }
+            while (next_start_ < services_.size() && now >= next_start_at_)
+            {
+                Service& service = services_[next_start_++];
+                Launch(service, now);
+                next_start_at_ = now + std::chrono::milliseconds(service.spec.start_delay_ms);
+            }
+        }
+        else AdvanceShutdown(now);
+        Deliver(lock);
+    }
+
+    // 销毁：不再按顺序优雅停止，直接结束全部子进程
+    for (Service& service : services_)
+    {
+        if (service.status.state != ServiceState::Running) continue;
+        KillChild(service.child);
+        service.status.exit_code = ReapChild(&service.child);
+        service.status.state     = ServiceState::Stopped;
+        service.status.pid       = 0;
+    }
+    EventFn             waiter = std::move(event_waiter_);
+    std::vector<DoneFn> done   = std::move(stop_waiters_);
+    lock.unlock();
+    if (waiter) waiter(nullptr);
+    for (DoneFn& fn : done) fn();
+}
+
+void Supervisor::Launch(Service& service, Clock::time_point now)
+{
+    bool        restart = service.status.state == ServiceState::Backoff;
+    std::string error;
+    if (!SpawnChild(service.spec, &service.child, &error))
+    {
+        service.status.state = ServiceState::Failed;
+        Emit(ServiceEvent::Type::Failed, service, -1, std::move(error));
+        return;
+    }
+    if (!waits_->Add(&service, {service.child.handle}, &error))
+    {
+        KillChild(service.child);
+        ReapChild(&service.child);
+        service.status.state = ServiceState::Failed;
+        Emit(ServiceEvent::Type::Failed, service, -1, std::move(error));
+        return;
+    }
+
+    if (restart) ++service.status.restarts;
+    service.status.state   = ServiceState::Running;
+    service.status.pid     = service.child.pid;
+    service.started_at     = now;
+    service.stop_requested = false;
+    service.killed         = false;
+    Emit(ServiceEvent::Type::Started, service);
+}
+
+void Supervisor::OnExit(Service& service, Clock::time_point now)
+{
+    service.status.exit_code = ReapChild(&service.child);
+    service.status.pid       = 0;
+
+    const ServiceSpec& spec = service.spec;
+    bool               again = spec.restart == RestartPolicy::Always ||
+                 (spec.restart == RestartPolicy::OnFailure && service.status.exit_code != 0);
+    if (stopping_ || !again)
+    {
+        service.status.state = ServiceState::Stopped;
+        Emit(stopping_ ? ServiceEvent::Type::Stopped : ServiceEvent::Type::Exited, service);
+        return;
+    }
+
+    // 稳定运行过一段时间：视为新的一轮故障，退避从初始值重新开始
+    if (now - service.started_at >= std::chrono::milliseconds(spec.reset_after_ms)) service.failures = 0;
+
+    auto window = std::chrono::milliseconds(spec.restart_window_ms);
+    while (!service.restarts.empty() && now - service.restarts.front() > window) service.restarts.pop_front();
+    if (spec.max_restarts > 0 && service.restarts.size() >= spec.max_restarts)
+    {
+        service.status.state = ServiceState::Failed;
+        Emit(ServiceEvent::Type::Exited, service);
+        Emit(ServiceEvent::Type::Failed, service, -1,
+             std::to_string(spec.max_restarts) + " restarts within " + std::to_string(spec.restart_window_ms) + " ms");
+        return;
+    }
+
+    int64_t delay = BackoffMs(service);
+    ++service.failures;
+    service.restarts.push_back(now);
+    service.status.state = ServiceState::Backoff;
+    service.restart_at   = now + std::chrono::milliseconds(delay);
+    Emit(ServiceEvent::Type::Exited, service, delay);
+}
+
+// 逆序逐个停止：后启动的服务可能依赖先启动的，前一个退出后才处理下一个
+void Supervisor::AdvanceShutdown(Clock::time_point now)
+{
+    for (size_t i = services_.size(); i-- > 0;)
+    {
+        Service& service = services_[i];
+        switch (service.status.state)
+        {
+        case ServiceState::Running:
+            if (!service.stop_requested)
+            {
+                service.stop_requested = true;
+                service.stop_deadline  = now + std::chrono::milliseconds(service.spec.stop_timeout_ms);
+                RequestChildExit(service.child);
+            }
+            else if (!service.killed && now >= service.stop_deadline)
+            {
+                service.killed = true;
+                KillChild(service.child);
+            }
+            return;
+        case ServiceState::Pending:
+        case ServiceState::Backoff:
+            service.status.state = ServiceState::Stopped;
+            Emit(ServiceEvent::Type::Stopped, service);
+            break;
+        default: break;
+        }
+    }
+    next_start_ = services_.size();
+    for (DoneFn& fn : stop_waiters_) stop_done_.push_back(std::move(fn));
+    stop_waiters_.clear();
+}
+
+void Supervisor::Emit(ServiceEvent::Type type, const Service& service, int64_t delay_ms, std::string error)
+{
+    ServiceEvent event;
+    event.type      = type;
+    event.service   = service.spec.name;
+    event.pid       = service.child.pid;
+    event.exit_code = service.status.exit_code;
+    event.restarts  = service.status.restarts;
+    event.delay_ms  = delay_ms;
+    event.error     = std::move(error);
+    events_.push_back(std::move(event));
+}
+
+void Supervisor::Deliver(std::unique_lock<std::mutex>& lock)
+{
+    while (event_waiter_ && !events_.empty())
+    {
+        EventFn      waiter = std::move(event_waiter_);
+        ServiceEvent event  = std::move(events_.front());
+        event_waiter_       = nullptr;
+        events_.pop_front();
+        lock.unlock();
+        waiter(&event);
+        lock.lock();
+    }
+    if (stop_done_.empty()) return;
+    std::vector<DoneFn> done = std::move(stop_done_);
+    stop_done_.clear();
+    lock.unlock();
+    for (DoneFn& fn : done) fn();
+    lock.lock();
+}
+
+Supervisor::Clock::time_point Supervisor::NextDeadline() const
+{
+    Clock::time_point deadline = Clock::time_point::max();
+    if (!stopping_ && next_start_ < services_.size()) deadline = next_start_at_;
+    for (const Service& service : services_)
+    {
+        if (!stopping_ && service.status.state == ServiceState::Backoff) deadline = std::min(deadline, service.restart_at);
+        if (stopping_ && service.stop_requested && !service.killed && service.status.state == ServiceState::Running)
+        {
+            deadline = std::min(deadline, service.stop_deadline);
+        }
+    }
+    return deadline;
+}
+
+int64_t Supervisor::BackoffMs(const Service& service) const
+{
+    const ServiceSpec& spec  = service.spec;
+    double             delay = spec.backoff_initial_ms * std::pow(spec.backoff_factor, (double)service.failures);
+    delay                    = std::min(delay, (double)spec.backoff_max_ms);
+    if (spec.jitter > 0)
+    {
+        // 抖动避免多个同时崩溃的服务在同一时刻一起重启
+        thread_local std::mt19937              rng{std::random_device{}()};
+        std::uniform_real_distribution<double> dist(-spec.jitter, spec.jitter);
+        delay *= 1.0 + dist(rng);
+    }
+    return std::max<int64_t>(0, (int64_t)delay);
+}
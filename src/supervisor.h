@@ -0,0 +1,166 @@
+#pragma once
+// 多服务监督器：一张服务表，一个服务线程。
+//   - 每个子进程只有一个原生等待 (WaitSet：Linux pidfd + epoll / Windows RegisterWaitForSingleObject)，不轮询
+//   - 退出后按指数退避 + 抖动重启；运行超过 reset_after_ms 后退避归零
+//   - restart_window_ms 内重启超过 max_restarts 次的服务进入 Failed，不再重启
+//   - 按表中顺序启动 (可设 start_delay_ms 间隔)，按相反顺序停止：先请求退出，stop_timeout_ms 后强制结束
+// 事件与停止完成回调在服务线程上调用。本文件不依赖 Lua。
+
+#include "wait_set.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class RestartPolicy
+{
+    Always,
+    OnFailure,  // 只在退出码非 0 时重启
+    Never,
+};
+
+struct ServiceSpec
+{
+    std::string   name;
+    std::string   command;  // Windows: CreateProcessW 命令行；Linux: 交给 /bin/sh -c
+    std::string   working_dir;
+    RestartPolicy restart            = RestartPolicy::Always;
+    uint32_t      backoff_initial_ms = 500;
+    uint32_t      backoff_max_ms     = 30000;
+    double        backoff_factor     = 2.0;
+    double        jitter             = 0.2;  // 退避时长在 ±jitter 比例内随机浮动
+    uint32_t      reset_after_ms     = 10000;
+    uint32_t      max_restarts       = 5;  // restart_window_ms 内的重启上限，0 表示不限
+    uint32_t      restart_window_ms  = 60000;
+    uint32_t      start_delay_ms     = 0;  // 启动后等待多久再启动下一个服务
+    uint32_t      stop_timeout_ms    = 3000;
+};
+
+enum class ServiceState
+{
+    Pending,   // 尚未轮到启动
+    Running,
+    Backoff,   // 等待重启
+    Failed,    // 启动失败或超出重启频率限制
+    Stopped,
+};
+
+struct ServiceEvent
+{
+    enum class Type
+    {
+        Started,
+        Exited,
+        Failed,
+        Stopped,
+    };
+
+    Type        type;
+    std::string service;
+    uint32_t    pid       = 0;
+    int         exit_code = 0;
+    uint32_t    restarts  = 0;
+    int64_t     delay_ms  = -1;  // Exited：距下次重启的毫秒数，不再重启时为 -1
+    std::string error;           // Failed：原因
+};
+
+struct ServiceStatus
+{
+    std::string  name;
+    ServiceState state     = ServiceState::Pending;
+    uint32_t     pid       = 0;
+    uint32_t     restarts  = 0;
+    int          exit_code = 0;
+};
+
+// 平台相关的子进程操作 (supervisor_linux.cpp / supervisor_win32.cpp)
+struct ChildProcess
+{
+    uint32_t   pid    = 0;
+    WaitHandle handle = {};  // 进程退出时变为可等待状态：Linux pidfd / Windows 进程句柄
+};
+
+bool SpawnChild(const ServiceSpec& spec, ChildProcess* child, std::string* error);
+void RequestChildExit(const ChildProcess& child);  // SIGTERM 进程组 / 向进程的顶层窗口投递 WM_CLOSE
+void KillChild(const ChildProcess& child);
+int  ReapChild(ChildProcess* child);  // 取退出码并关闭句柄；Linux 上被信号终止时为 128 + 信号值
+
+class Supervisor
+{
+public:
+    using EventFn = std::function<void(const ServiceEvent* event)>;  // nullptr：监督器已销毁
+    using DoneFn  = std::function<void()>;
+
+    // 立即开始按顺序启动
+    static std::shared_ptr<Supervisor> Create(std::vector<ServiceSpec> specs);
+
+    // 强制结束仍在运行的子进程；未完成的 NextEvent / Stop 回调随之触发
+    ~Supervisor();
+
+    Supervisor(const Supervisor&)            = delete;
+    Supervisor& operator=(const Supervisor&) = delete;
+
+    // 以下可在任意线程调用
+
+    // 按相反顺序停止全部服务，全部停止后调用 done
+    void Stop(DoneFn done);
+
+    std::vector<ServiceStatus> Status() const;
+
+    // 取下一个未读事件：已有则立即回调，否则等到下一个事件
+    void NextEvent(EventFn callback);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Service
+    {
+        ServiceSpec        spec;
+        ServiceStatus      status;
+        ChildProcess       child;
+        uint32_t           failures = 0;  // 连续的短命退出次数，决定退避时长
+        Clock::time_point  started_at;
+        Clock::time_point  restart_at;
+        Clock::time_point  stop_deadline;
+        bool               stop_requested = false;
+        bool               killed         = false;
+        std::deque<Clock::time_point> restarts;  // 窗口内的重启时刻
+    };
+
+    explicit Supervisor(std::vector<ServiceSpec> specs);
+
+    void ServiceLoop();
+
+    // 以下须持有 mutex_
+    void              Launch(Service& service, Clock::time_point now);
+    void              OnExit(Service& service, Clock::time_point now);
+    void              AdvanceShutdown(Clock::time_point now);
+    void              Emit(ServiceEvent::Type type, const Service& service, int64_t delay_ms = -1, std::string error = {});
+    void              Deliver(std::unique_lock<std::mutex>& lock);  // 回调时临时解锁
+    Clock::time_point NextDeadline() const;
+    int64_t           BackoffMs(const Service& service) const;
+
+    mutable std::mutex      mutex_;
+    std::condition_variable cv_;
+    std::vector<Service>    services_;
+    size_t                  next_start_ = 0;
+    Clock::time_point       next_start_at_;
+    bool                    wakeup_   = false;
+    bool                    stopping_ = false;
+    bool                    quit_     = false;
+    std::vector<DoneFn>     stop_waiters_;
+    std::vector<DoneFn>     stop_done_;  // 已全部停止，待回调
+
+    std::deque<ServiceEvent> events_;
+    EventFn                  event_waiter_;
+
+    std::unique_ptr<WaitSet> waits_;  // 仅服务线程调用 Add / PopSignaled
+    std::thread              thread_;
+};
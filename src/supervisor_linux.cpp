@@ -0,0 +1,73 @@
+#include "supervisor.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if !defined(SYS_pidfd_open)
+#define SYS_pidfd_open 434
+#endif
+
+// 子进程自成进程组：sh -c 派生的后代也能随信号一起结束。
+// pidfd 在子进程被回收前一直有效，不受 PID 复用影响
+bool SpawnChild(const ServiceSpec& spec, ChildProcess* child, std::string* error)
+{
+    const char* command = spec.command.c_str();
+    const char* dir     = spec.working_dir.empty() ? nullptr : spec.working_dir.c_str();
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        if (error) *error = std::string("fork failed: ") + strerror(errno);
+        return false;
+    }
+    if (pid == 0)
+    {
+        // exec 之前只调用 async-signal-safe 的函数
+        setpgid(0, 0);
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        if (dir && chdir(dir) != 0) _exit(127);
+        execl("/bin/sh", "sh", "-c", command, (char*)nullptr);
+        _exit(127);
+    }
+    setpgid(pid, pid);  // 与子进程中的调用竞争，谁先都一样
+
+    int fd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (fd < 0)
+    {
+        if (error) *error = std::string("pidfd_open failed: ") + strerror(errno);
+        kill(-pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        return false;
+    }
+    child->pid    = (uint32_t)pid;
+    child->handle = fd;
+    return true;
+}
+
+void RequestChildExit(const ChildProcess& child)
+{
+    kill(-(pid_t)child.pid, SIGTERM);
+}
+
+void KillChild(const ChildProcess& child)
+{
+    kill(-(pid_t)child.pid, SIGKILL);
+}
+
+int ReapChild(ChildProcess* child)
+{
+    int status = 0;
+    while (waitpid((pid_t)child->pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+    close(child->handle);
+    child->handle = -1;
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
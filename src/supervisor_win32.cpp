@@ -0,0 +1,67 @@
+#include "supervisor.h"
+
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+
+namespace
+{
+    std::wstring Utf8ToWide(const std::string& str)
+    {
+        if (str.empty()) return {};
+        int          size = MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), NULL, 0);
+        std::wstring out((size_t)size, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), &out[0], size);
+        return out;
+    }
+
+    BOOL CALLBACK CloseProcessWindow(HWND hwnd, LPARAM pid)
+    {
+        DWORD owner = 0;
+        GetWindowThreadProcessId(hwnd, &owner);
+        if (owner == (DWORD)pid) PostMessageW(hwnd, WM_CLOSE, 0, 0);
+        return TRUE;
+    }
+}  // namespace
+
+bool SpawnChild(const ServiceSpec& spec, ChildProcess* child, std::string* error)
+{
+    std::wstring command = Utf8ToWide(spec.command);
+    std::wstring dir     = Utf8ToWide(spec.working_dir);
+
+    STARTUPINFOW        si{};
+    PROCESS_INFORMATION pi{};
+    si.cb = sizeof(si);
+    if (!CreateProcessW(NULL, &command[0], NULL, NULL, FALSE, CREATE_NEW_PROCESS_GROUP | CREATE_UNICODE_ENVIRONMENT,
+                        NULL, dir.empty() ? NULL : dir.c_str(), &si, &pi))
+    {
+        if (error) *error = "CreateProcessW failed: " + std::to_string(GetLastError());
+        return false;
+    }
+    CloseHandle(pi.hThread);
+    child->pid    = pi.dwProcessId;
+    child->handle = pi.hProcess;
+    return true;
+}
+
+// 没有 SIGTERM：向子进程的顶层窗口投递 WM_CLOSE，无窗口的进程等超时后强制结束
+void RequestChildExit(const ChildProcess& child)
+{
+    EnumWindows(CloseProcessWindow, (LPARAM)child.pid);
+}
+
+void KillChild(const ChildProcess& child)
+{
+    TerminateProcess(child.handle, 1);
+}
+
+int ReapChild(ChildProcess* child)
+{
+    DWORD code = 0;
+    WaitForSingleObject(child->handle, INFINITE);
+    GetExitCodeProcess(child->handle, &code);
+    CloseHandle(child->handle);
+    child->handle = NULL;
+    return (int)code;
+}
@@ -0,0 +1,214 @@
+#include "thread_pool.h"
+
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace
+{
+    // 当前线程所属的池与其 CPU 工作线程序号；池外线程为 nullptr
+    thread_local ThreadPool* t_pool   = nullptr;
+    thread_local size_t      t_worker = 0;
+}  // namespace
+
+ThreadPool::ThreadPool(const ThreadPoolOptions& options) : options_(options)
+{
+    size_t cpu_threads = options_.cpu_threads;
+    if (cpu_threads == 0) cpu_threads = std::max<unsigned>(1, std::thread::hardware_concurrency());
+    options_.io_max_threads = std::max<size_t>({options_.io_max_threads, options_.io_threads, 1});
+
+    for (size_t i = 0; i < cpu_threads; ++i) cpu_workers_.push_back(std::make_unique<CpuWorker>());
+    for (size_t i = 0; i < cpu_threads; ++i) cpu_workers_[i]->thread = std::thread([this, i] { CpuLoop(i); });
+
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    for (size_t i = 0; i < options_.io_threads; ++i) SpawnIoThreadLocked();
+}
+
+ThreadPool::~ThreadPool()
+{
+    Stop(true);
+}
+
+bool ThreadPool::Push(Task task, TaskLane lane)
+{
+    if (stopped_.load()) return false;
+    outstanding_.fetch_add(1);
+
+    if (lane == TaskLane::Io)
+    {
+        std::lock_guard<std::mutex> lock(io_mutex_);
+        io_tasks_.push_back(std::move(task));
+        // 空闲线程不够分时扩容，而不是让新任务排在慢速复制后面
+        if (io_tasks_.size() > io_idle_ && io_live_ < options_.io_max_threads) SpawnIoThreadLocked();
+        else io_cv_.notify_one();
+        return true;
+    }
+
+    size_t     index  = t_pool == this ? t_worker : next_worker_.fetch_add(1) % cpu_workers_.size();
+    CpuWorker& worker = *cpu_workers_[index];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    // 与 CpuLoop 中先登记 sleepers 再检查 queued 的顺序配对 (均为 seq_cst)，二者至少有一方看到对方
+    cpu_queued_.fetch_add(1);
+    if (cpu_sleepers_.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(cpu_sleep_mutex_);
+        cpu_sleep_cv_.notify_one();
+    }
+    return true;
+}
+
+// 自己的队列从队尾取，其他队列从队首窃取
+bool ThreadPool::PopCpuTask(size_t index, Task& task)
+{
+    size_t count = cpu_workers_.size();
+    for (size_t k = 0; k < count; ++k)
+    {
+        CpuWorker&                  worker = *cpu_workers_[(index + k) % count];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) continue;
+        if (k == 0)
+        {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+        }
+        cpu_queued_.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::CpuLoop(size_t index)
+{
+    t_pool   = this;
+    t_worker = index;
+    SetTraceThreadName("cpu " + std::to_string(index));
+    Task task;
+    while (true)
+    {
+        if (PopCpuTask(index, task))
+        {
+            task();
+            task = nullptr;
+            FinishTask();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(cpu_sleep_mutex_);
+        cpu_sleepers_.fetch_add(1);
+        cpu_sleep_cv_.wait(lock, [this] { return cpu_queued_.load() > 0 || stopped_.load(); });
+        cpu_sleepers_.fetch_sub(1);
+        if (stopped_.load() && cpu_queued_.load() == 0) return;
+    }
+}
+
+void ThreadPool::SpawnIoThreadLocked()
+{
+    // 顺带回收已超时退出的线程
+    for (auto it = io_threads_.begin(); it != io_threads_.end();)
+    {
+        if (!it->exited)
+        {
+            ++it;
+            continue;
+        }
+        it->thread.join();
+        it = io_threads_.erase(it);
+    }
+    io_threads_.emplace_back();
+    IoThread* self = &io_threads_.back();
+    ++io_live_;
+    self->thread = std::thread([this, self] { IoLoop(self); });
+}
+
+void ThreadPool::IoLoop(IoThread* self)
+{
+    SetTraceThreadName("io");
+    std::unique_lock<std::mutex> lock(io_mutex_);
+    while (true)
+    {
+        if (!io_tasks_.empty())
+        {
+            Task task = std::move(io_tasks_.front());
+            io_tasks_.pop_front();
+            lock.unlock();
+            task();
+            task = nullptr;
+            FinishTask();
+            lock.lock();
+            continue;
+        }
+        if (stopped_.load()) break;
+
+        ++io_idle_;
+        bool woken = io_cv_.wait_for(lock, std::chrono::milliseconds(options_.io_idle_ms),
+                                     [this] { return !io_tasks_.empty() || stopped_.load(); });
+        --io_idle_;
+        if (!woken && io_live_ > options_.io_threads) break;
+    }
+    --io_live_;
+    self->exited = true;
+}
+
+void ThreadPool::FinishTask()
+{
+    if (outstanding_.fetch_sub(1) == 1 && stopping_.load())
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        idle_cv_.notify_all();
+    }
+}
+
+size_t ThreadPool::IoThreads() const
+{
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    return io_live_;
+}
+
+void ThreadPool::Stop(bool wait_pending)
+{
+    if (stopped_.load()) return;
+    stopping_ = true;
+    if (wait_pending)
+    {
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        idle_cv_.wait(lock, [this] { return outstanding_.load() == 0; });
+    }
+    stopped_ = true;
+
+    if (!wait_pending)
+    {
+        for (auto& worker : cpu_workers_)
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            cpu_queued_.fetch_sub(worker->tasks.size());
+            outstanding_.fetch_sub(worker->tasks.size());
+            worker->tasks.clear();
+        }
+        std::lock_guard<std::mutex> lock(io_mutex_);
+        outstanding_.fetch_sub(io_tasks_.size());
+        io_tasks_.clear();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(cpu_sleep_mutex_);
+        cpu_sleep_cv_.notify_all();
+    }
+    for (auto& worker : cpu_workers_) worker->thread.join();
+
+    std::list<IoThread> io_threads;
+    {
+        std::lock_guard<std::mutex> lock(io_mutex_);
+        io_threads.swap(io_threads_);  // 节点地址不变，线程持有的 self 指针仍然有效
+        io_cv_.notify_all();
+    }
+    for (auto& t : io_threads) t.thread.join();
+}
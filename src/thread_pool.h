@@ -0,0 +1,107 @@
+#pragma once
+// 替代 CTPL 的线程池，分两条通道：
+//   - Cpu：固定线程数，每线程一个双端队列。本线程提交的任务压入自己的队尾并从队尾取 (LIFO，缓存友好)，
+//          外部线程提交的任务轮转分配；空闲线程从其他队列队首窃取
+//   - Io ：阻塞 I/O 专用的弹性通道 (CopyFileW、整文件读取、网络共享复制 ...)，
+//          没有空闲线程时按需扩容到上限，多出常驻数的线程空闲超时后退出
+// 慢速阻塞操作因此不会压住定时器、读取回调等短任务。本文件不依赖 Lua。
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class TaskLane
+{
+    Cpu,
+    Io,
+};
+
+struct ThreadPoolOptions
+{
+    size_t   cpu_threads    = 0;  // 0 = hardware_concurrency
+    size_t   io_threads     = 2;  // 常驻 I/O 线程数
+    size_t   io_max_threads = 64;
+    uint32_t io_idle_ms     = 10000;
+};
+
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(const ThreadPoolOptions& options = {});
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // 任意线程 (包括池内任务)；停止后返回 false 且任务不会执行
+    bool Push(Task task, TaskLane lane = TaskLane::Cpu);
+
+    // 仅限池外线程调用，可重复调用。
+    // wait_pending = true：与 ctpl::thread_pool::stop(true) 一致，执行完所有已排队任务
+    // (包括执行期间由任务再提交的任务) 后再回收线程；false：丢弃排队任务，只等待正在执行的任务
+    void Stop(bool wait_pending);
+
+    size_t CpuThreads() const
+    {
+        return cpu_workers_.size();
+    }
+
+    size_t IoThreads() const;
+
+    // 已提交未完成的任务数 (两条通道合计，含执行中)
+    size_t Outstanding() const
+    {
+        return outstanding_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct CpuWorker
+    {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+        std::thread      thread;
+    };
+
+    struct IoThread
+    {
+        std::thread thread;
+        bool        exited = false;
+    };
+
+    void CpuLoop(size_t index);
+    bool PopCpuTask(size_t index, Task& task);
+    void IoLoop(IoThread* self);
+    void SpawnIoThreadLocked();
+    void FinishTask();
+
+    ThreadPoolOptions                       options_;
+    std::vector<std::unique_ptr<CpuWorker>> cpu_workers_;
+    std::atomic<size_t>                     cpu_queued_{0};
+    std::atomic<size_t>                     cpu_sleepers_{0};
+    std::atomic<size_t>                     next_worker_{0};
+    std::mutex                              cpu_sleep_mutex_;
+    std::condition_variable                 cpu_sleep_cv_;
+
+    mutable std::mutex      io_mutex_;
+    std::condition_variable io_cv_;
+    std::deque<Task>        io_tasks_;
+    std::list<IoThread>     io_threads_;  // 含已退出待回收的线程，链表保证元素地址稳定
+    size_t                  io_live_ = 0;
+    size_t                  io_idle_ = 0;
+
+    std::atomic<size_t>     outstanding_{0};  // 已提交未完成的任务数 (两条通道合计)
+    std::atomic<bool>       stopping_{false};
+    std::atomic<bool>       stopped_{false};
+    std::mutex              idle_mutex_;
+    std::condition_variable idle_cv_;
+};
@@ -0,0 +1,192 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+uint64_t MonotonicNowMs()
+{
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+TimerWheel::TimerWheel(uint64_t now_ms) : current_(now_ms)
+{
+    heads_.resize(kRootSlots + (kLevels - 1) * kLevelSlots);
+    for (Node& head : heads_)
+    {
+        head.prev = head.next = &head;
+    }
+}
+
+TimerWheel::~TimerWheel()
+{
+    for (auto& [id, node] : index_) delete node;
+    for (Node* node : free_nodes_) delete node;
+}
+
+TimerWheel::Node& TimerWheel::Head(int level, uint32_t index)
+{
+    return level == 0 ? heads_[index] : heads_[kRootSlots + (level - 1) * kLevelSlots + index];
+}
+
+const TimerWheel::Node& TimerWheel::Head(int level, uint32_t index) const
+{
+    return level == 0 ? heads_[index] : heads_[kRootSlots + (level - 1) * kLevelSlots + index];
+}
+
+TimerWheel::TimerId TimerWheel::ScheduleAt(uint64_t deadline_ms, void* payload)
+{
+    Node* node;
+    if (!free_nodes_.empty())
+    {
+        node = free_nodes_.back();
+        free_nodes_.pop_back();
+    }
+    else
+    {
+        node = new Node;
+    }
+    node->id      = next_id_++;
+    node->expires = deadline_ms;
+    node->payload = payload;
+    Insert(node);
+    index_.emplace(node->id, node);
+    return node->id;
+}
+
+bool TimerWheel::Cancel(TimerId id)
+{
+    auto it = index_.find(id);
+    if (it == index_.end()) return false;
+    Unlink(it->second);
+    free_nodes_.push_back(it->second);
+    index_.erase(it);
+    return true;
+}
+
+void TimerWheel::Insert(Node* node)
+{
+    uint64_t expires = std::max(node->expires, current_);
+    uint64_t delta   = expires - current_;
+
+    int level = 0;
+    if (delta >= kRootSlots)
+    {
+        level = 1;
+        while (level < kLevels - 1 && delta >= (1ull << (Shift(level) + kLevelBits))) ++level;
+        uint64_t span = 1ull << (Shift(level) + kLevelBits);
+        if (delta >= span) expires = current_ + span - 1;  // 超出覆盖范围，先放在最远槽位，级联时重新计算
+    }
+
+    uint32_t mask = level == 0 ? kRootSlots - 1 : kLevelSlots - 1;
+    Node&    head = Head(level, (uint32_t)(expires >> Shift(level)) & mask);
+
+    node->level     = level;
+    node->next      = &head;
+    node->prev      = head.prev;
+    head.prev->next = node;
+    head.prev       = node;
+    ++level_count_[level];
+}
+
+void TimerWheel::Unlink(Node* node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = nullptr;
+    --level_count_[node->level];
+}
+
+uint32_t TimerWheel::Cascade(int level)
+{
+    uint32_t index = (uint32_t)(current_ >> Shift(level)) & (kLevelSlots - 1);
+    Node&    head  = Head(level, index);
+    while (head.next != &head)
+    {
+        Node* node = head.next;
+        Unlink(node);
+        Insert(node);
+    }
+    return index;
+}
+
+size_t TimerWheel::Advance(uint64_t now_ms, std::vector<Expired>& out)
+{
+    size_t fired = 0;
+    while (current_ <= now_ms)
+    {
+        if (index_.empty())
+        {
+            current_ = now_ms + 1;
+            break;
+        }
+
+        uint32_t index = (uint32_t)current_ & (kRootSlots - 1);
+        if (index == 0)
+        {
+            for (int level = 1; level < kLevels && Cascade(level) == 0; ++level)
+            {
+            }
+        }
+
+        Node& head = Head(0, index);
+        while (head.next != &head)
+        {
+            Node* node = head.next;
+            Unlink(node);
+            out.push_back({node->id, node->expires, node->payload});
+            index_.erase(node->id);
+            free_nodes_.push_back(node);
+            ++fired;
+        }
+        ++current_;
+
+        // 根级为空时直接跳到下一个级联边界，避免长时间空闲后逐刻度空转
+        if (level_count_[0] == 0 && (current_ & (kRootSlots - 1)) != 0)
+        {
+            uint64_t boundary = (current_ & ~(uint64_t)(kRootSlots - 1)) + kRootSlots;
+            current_          = std::min(boundary, now_ms + 1);
+        }
+    }
+    return fired;
+}
+
+int64_t TimerWheel::NextTimeoutMs(uint64_t now_ms) const
+{
+    if (index_.empty()) return -1;
+
+    uint64_t next = std::numeric_limits<uint64_t>::max();
+    if (level_count_[0] > 0)
+    {
+        for (uint32_t i = 0; i < kRootSlots; ++i)
+        {
+            const Node& head = Head(0, (uint32_t)(current_ + i) & (kRootSlots - 1));
+            if (head.next != &head)
+            {
+                next = current_ + i;
+                break;
+            }
+        }
+    }
+
+    // 高层槽位只在级联时刻才会落到根级，取最近一次非空级联作为下界
+    for (int level = 1; level < kLevels; ++level)
+    {
+        if (level_count_[level] == 0) continue;
+        int      shift = Shift(level);
+        uint64_t base  = current_ >> shift;
+        uint32_t start = (current_ & ((1ull << shift) - 1)) == 0 ? 0 : 1;
+        for (uint32_t k = start; k < start + kLevelSlots; ++k)
+        {
+            const Node& head = Head(level, (uint32_t)(base + k) & (kLevelSlots - 1));
+            if (head.next != &head)
+            {
+                next = std::min(next, (base + k) << shift);
+                break;
+            }
+        }
+    }
+
+    return next <= now_ms ? 0 : (int64_t)(next - now_ms);
+}
@@ -0,0 +1,86 @@
+#pragma once
+// 分层时间轮 (1ms 精度, 5 级, 覆盖约 49 天)。
+// 与平台无关，不持有线程：只由事件循环线程调用，到期条目由调用方负责分发。
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+uint64_t MonotonicNowMs();
+
+class TimerWheel
+{
+public:
+    using TimerId = uint64_t;
+
+    struct Expired
+    {
+        TimerId  id;
+        uint64_t deadline_ms;
+        void*    payload;
+    };
+
+    explicit TimerWheel(uint64_t now_ms = 0);
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&)            = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // 早于当前刻度的 deadline 会在下一次 Advance 中立即到期
+    TimerId ScheduleAt(uint64_t deadline_ms, void* payload);
+    TimerId Schedule(uint64_t now_ms, uint64_t delay_ms, void* payload)
+    {
+        return ScheduleAt(now_ms + delay_ms, payload);
+    }
+
+    bool Cancel(TimerId id);
+
+    // 推进到 now_ms (含)，按到期顺序把条目追加到 out，返回本次到期数量
+    size_t Advance(uint64_t now_ms, std::vector<Expired>& out);
+
+    // 距离下一次需要 Advance 的毫秒数，没有定时器时返回 -1。
+    // 远期定时器返回的是下一次级联的时间点，醒来后 Advance 即可。
+    int64_t NextTimeoutMs(uint64_t now_ms) const;
+
+    size_t Size() const
+    {
+        return index_.size();
+    }
+
+private:
+    static constexpr int      kLevels     = 5;
+    static constexpr int      kRootBits   = 8;
+    static constexpr int      kLevelBits  = 6;
+    static constexpr uint32_t kRootSlots  = 1u << kRootBits;
+    static constexpr uint32_t kLevelSlots = 1u << kLevelBits;
+
+    struct Node
+    {
+        Node*    prev;
+        Node*    next;
+        TimerId  id;
+        uint64_t expires;
+        void*    payload;
+        int      level;
+    };
+
+    static int Shift(int level)
+    {
+        return level == 0 ? 0 : kRootBits + (level - 1) * kLevelBits;
+    }
+
+    Node&       Head(int level, uint32_t index);
+    const Node& Head(int level, uint32_t index) const;
+    void        Insert(Node* node);
+    void        Unlink(Node* node);
+    uint32_t    Cascade(int level);
+
+    uint64_t                           current_;  // 下一个待处理的刻度
+    TimerId                            next_id_ = 1;
+    std::array<size_t, kLevels>        level_count_{};
+    std::vector<Node>                  heads_;
+    std::unordered_map<TimerId, Node*> index_;
+    std::vector<Node*>                 free_nodes_;
+};
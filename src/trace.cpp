@@ -0,0 +1,358 @@
+#include "trace.h"
+
+#if defined(_WIN32)
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PESH_TRACE_RDTSC 1
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace trace_detail
+{
+    std::atomic<bool> g_enabled{false};
+}
+
+namespace
+{
+    constexpr uint32_t kChunkEvents     = 4096;     // 每块 128 KB
+    constexpr size_t   kMaxThreadEvents = 1 << 20;  // 每线程最多 32 MB，超出的事件计入 dropped
+
+    enum Phase : uint8_t
+    {
+        kComplete,
+        kAsyncBegin,
+        kAsyncEnd,
+    };
+
+    struct Event
+    {
+        uint64_t ts;
+        uint64_t value;  // Complete 为时长 (刻度)，Async 为 id
+        uint64_t arg;
+        uint32_t name;
+        uint8_t  phase;
+        uint8_t  category;
+        uint16_t reserved;
+    };
+    static_assert(sizeof(Event) == 32, "trace events must stay 32 bytes");
+
+    struct Chunk
+    {
+        std::atomic<uint32_t> count{0};
+        Event                 events[kChunkEvents];
+    };
+
+    struct ThreadBuffer
+    {
+        uint64_t                            tid = 0;
+        std::mutex                          mutex;  // 保护 chunks 的增长与 name，写入事件本身不加锁
+        std::vector<std::unique_ptr<Chunk>> chunks;
+        std::string                         name;
+        Chunk*                              current = nullptr;
+        size_t                              total   = 0;
+        std::atomic<uint64_t>               dropped{0};
+    };
+
+    // 线程退出后缓冲区保留到进程结束，写出时仍能看到它的事件
+    std::mutex                                 g_buffers_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+
+    // 工作者在静态初始化期间登记名称，名称表不能依赖本翻译单元的全局对象已构造
+    struct NameTable
+    {
+        std::mutex                                     mutex;
+        std::deque<std::string>                        names;
+        std::unordered_map<std::string_view, uint32_t> ids;
+    };
+
+    NameTable& Names()
+    {
+        static NameTable table;
+        return table;
+    }
+
+    std::mutex            g_config_mutex;
+    bool                  g_forced = false;
+    bool                  g_active = false;  // 本次会话的事件要写出
+    std::filesystem::path g_output;
+    std::atomic<uint64_t> g_origin{0};  // 开始记录时的刻度
+    std::atomic<uint64_t> g_origin_ns{0};
+    std::atomic<uint64_t> g_next_id{1};
+
+    thread_local ThreadBuffer* t_buffer = nullptr;
+    thread_local std::string   t_name;
+
+    const char* kCategoryNames[] = {"boot", "lua", "worker", "queue", "resume"};
+
+    uint64_t SteadyNs()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    uint64_t CurrentThreadId()
+    {
+#if defined(_WIN32)
+        return GetCurrentThreadId();
+#else
+        return (uint64_t)syscall(SYS_gettid);
+#endif
+    }
+
+    ThreadBuffer* Buffer()
+    {
+        if (t_buffer) return t_buffer;
+        auto buffer  = std::make_unique<ThreadBuffer>();
+        buffer->tid  = CurrentThreadId();
+        buffer->name = t_name;
+        t_buffer     = buffer.get();
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        g_buffers.push_back(std::move(buffer));
+        return t_buffer;
+    }
+
+    void Append(uint8_t phase, uint32_t name, TraceCategory category, uint64_t ts, uint64_t value, uint64_t arg)
+    {
+        ThreadBuffer* buffer = Buffer();
+        Chunk*        chunk  = buffer->current;
+        uint32_t      n      = chunk ? chunk->count.load(std::memory_order_relaxed) : kChunkEvents;
+        if (n == kChunkEvents)
+        {
+            if (buffer->total >= kMaxThreadEvents)
+            {
+                buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            buffer->chunks.push_back(std::make_unique<Chunk>());
+            chunk = buffer->current = buffer->chunks.back().get();
+            n                       = 0;
+        }
+        Event& e   = chunk->events[n];
+        e.ts       = ts;
+        e.value    = value;
+        e.arg      = arg;
+        e.name     = name;
+        e.phase    = phase;
+        e.category = (uint8_t)category;
+        e.reserved = 0;
+        ++buffer->total;
+        chunk->count.store(n + 1, std::memory_order_release);
+    }
+
+    void WriteEscaped(std::ostream& out, std::string_view text)
+    {
+        static const char* kHex = "0123456789abcdef";
+        for (unsigned char c : text)
+        {
+            if (c == '"' || c == '\\') out << '\\' << (char)c;
+            else if (c < 0x20) out << "\\u00" << kHex[c >> 4] << kHex[c & 15];
+            else out << (char)c;
+        }
+    }
+
+    // 刻度换算为微秒，保留纳秒精度
+    void WriteMicros(std::ostream& out, uint64_t ticks, double ns_per_tick)
+    {
+        uint64_t ns = (uint64_t)((double)ticks * ns_per_tick);
+        char     text[32];
+        std::snprintf(text, sizeof(text), "%llu.%03u", (unsigned long long)(ns / 1000), (unsigned)(ns % 1000));
+        out << text;
+    }
+}  // namespace
+
+void StartTracing(bool forced, const std::filesystem::path& forced_path)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_config_mutex);
+        g_forced = forced;
+        g_active = true;
+        if (!forced_path.empty()) g_output = forced_path;
+    }
+    uint64_t zero = 0;
+    if (g_origin.compare_exchange_strong(zero, TraceNow())) g_origin_ns = SteadyNs();
+    trace_detail::g_enabled.store(true, std::memory_order_relaxed);
+}
+
+void ConfigureTracing(bool enabled, const std::filesystem::path& path)
+{
+    std::lock_guard<std::mutex> lock(g_config_mutex);
+    if (g_output.empty()) g_output = path;
+    if (enabled || g_forced) return;
+    g_active = false;
+    trace_detail::g_enabled.store(false, std::memory_order_relaxed);
+}
+
+void StopTracing()
+{
+    trace_detail::g_enabled.store(false, std::memory_order_relaxed);
+}
+
+std::filesystem::path WriteTrace(std::string* error)
+{
+    std::filesystem::path path;
+    {
+        std::lock_guard<std::mutex> lock(g_config_mutex);
+        if (!g_active) return {};
+        path = g_output;
+    }
+    if (path.empty()) return {};
+
+    std::vector<std::string> names;
+    {
+        NameTable&                  table = Names();
+        std::lock_guard<std::mutex> lock(table.mutex);
+        names.assign(table.names.begin(), table.names.end());
+    }
+    std::vector<ThreadBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        for (auto& buffer : g_buffers) buffers.push_back(buffer.get());
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        if (error) *error = "failed to open " + path.string();
+        return {};
+    }
+
+#if defined(_WIN32)
+    uint64_t pid = GetCurrentProcessId();
+#else
+    uint64_t pid = (uint64_t)getpid();
+#endif
+    // 与飞行记录器相同：以开始记录和写出两个时刻校准 TSC 频率
+    uint64_t origin      = g_origin.load();
+    uint64_t elapsed     = TraceNow() - origin;
+    uint64_t elapsed_ns  = SteadyNs() - g_origin_ns.load();
+    double   ns_per_tick = elapsed > 0 ? (double)elapsed_ns / (double)elapsed : 1.0;
+    uint64_t dropped     = 0;
+    out << "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+        << ",\"tid\":0,\"args\":{\"name\":\"peshell\"}}";
+    for (ThreadBuffer* buffer : buffers)
+    {
+        std::vector<Chunk*> chunks;
+        std::string         thread_name;
+        {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            for (auto& chunk : buffer->chunks) chunks.push_back(chunk.get());
+            thread_name = buffer->name;
+        }
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+        if (!thread_name.empty())
+        {
+            out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+                << ",\"args\":{\"name\":\"";
+            WriteEscaped(out, thread_name);
+            out << "\"}}";
+        }
+        for (Chunk* chunk : chunks)
+        {
+            uint32_t count = chunk->count.load(std::memory_order_acquire);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const Event& e = chunk->events[i];
+                out << ",\n{\"name\":\"";
+                WriteEscaped(out, e.name < names.size() ? std::string_view(names[e.name]) : std::string_view("?"));
+                out << "\",\"cat\":\"" << kCategoryNames[e.category] << "\",\"ph\":\""
+                    << (e.phase == kComplete ? 'X' : e.phase == kAsyncBegin ? 'b' : 'e') << "\",\"ts\":";
+                WriteMicros(out, e.ts > origin ? e.ts - origin : 0, ns_per_tick);
+                out << ",\"pid\":" << pid << ",\"tid\":" << buffer->tid;
+                if (e.phase == kComplete)
+                {
+                    out << ",\"dur\":";
+                    WriteMicros(out, e.value, ns_per_tick);
+                    if (e.arg) out << ",\"args\":{\"id\":" << e.arg << "}";
+                }
+                else
+                {
+                    out << ",\"id\":\"0x" << std::hex << e.value << std::dec << "\"";
+                }
+                out << "}";
+            }
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":" << dropped << "}}\n";
+    out.flush();
+    if (!out.good())
+    {
+        if (error) *error = "failed to write " + path.string();
+        return {};
+    }
+    return path;
+}
+
+uint64_t TraceNow()
+{
+#if defined(PESH_TRACE_RDTSC)
+    return __rdtsc();
+#else
+    return SteadyNs();
+#endif
+}
+
+uint64_t TraceNextId()
+{
+    return g_next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t TraceName(std::string_view name)
+{
+    NameTable&                  table = Names();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto it = table.ids.find(name);
+    if (it != table.ids.end()) return it->second;
+    uint32_t id = (uint32_t)table.names.size();
+    table.names.emplace_back(name);
+    table.ids.emplace(table.names.back(), id);
+    return id;
+}
+
+void SetTraceThreadName(std::string_view name)
+{
+    t_name = std::string(name);
+    if (!t_buffer) return;
+    std::lock_guard<std::mutex> lock(t_buffer->mutex);
+    t_buffer->name = t_name;
+}
+
+void TraceComplete(uint32_t name, TraceCategory category, uint64_t begin, uint64_t end, uint64_t arg)
+{
+    if (!TraceEnabled()) return;
+    Append(kComplete, name, category, begin, end > begin ? end - begin : 0, arg);
+}
+
+void TraceAsyncBegin(uint32_t name, TraceCategory category, uint64_t id, uint64_t ts)
+{
+    if (!TraceEnabled()) return;
+    Append(kAsyncBegin, name, category, ts, id, 0);
+}
+
+void TraceAsyncEnd(uint32_t name, TraceCategory category, uint64_t id, uint64_t ts)
+{
+    if (!TraceEnabled()) return;
+    Append(kAsyncEnd, name, category, ts, id, 0);
+}
@@ -0,0 +1,91 @@
+#pragma once
+// 跨语言追踪：C++ 作用域 span、Lua 的 trace_begin/trace_end 与工作者的排队 / 执行区间，
+// 结束时写出 Chrome trace-event JSON (chrome://tracing、ui.perfetto.dev 均可直接打开)。
+//   - 每个线程一个只增的事件块链表，写入只由所属线程进行：取时间戳 + 填一条记录 + 一次 release store
+//   - 时间戳为 TSC 刻度 (非 x86-64 为单调时钟纳秒)，写出时再换算为微秒
+//   - 关闭时每个埋点只有一次 relaxed load
+//   - 进程入口即开始记录，读到配置后再决定保留还是丢弃，日志初始化之前的启动阶段也在追踪中
+//   - 名称先登记为整数 id，热路径上不复制字符串
+// 本文件不依赖 Lua 与 spdlog。
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+enum class TraceCategory : uint8_t
+{
+    Boot,    // 启动与关闭阶段
+    Lua,     // 协程恢复、插件加载、Lua 手动 span
+    Worker,  // 工作者在线程池上的执行
+    Queue,   // 工作者派发后到开始执行前的排队
+    Resume,  // 完成投递后到协程在主线程上恢复前的等待
+};
+
+namespace trace_detail
+{
+    extern std::atomic<bool> g_enabled;
+}
+
+inline bool TraceEnabled()
+{
+    return trace_detail::g_enabled.load(std::memory_order_relaxed);
+}
+
+// 进程入口调用：开始记录。forced 为命令行 --trace，此时忽略配置中的 enabled，forced_path 非空时覆盖输出路径
+void StartTracing(bool forced, const std::filesystem::path& forced_path = {});
+
+// 读取配置后调用：未启用且未被命令行强制时停止记录
+void ConfigureTracing(bool enabled, const std::filesystem::path& path);
+
+// 停止记录，已记录的事件仍可写出
+void StopTracing();
+
+// 写出全部线程的事件 (写出期间其他线程可继续记录)；未启用或失败时返回空路径
+std::filesystem::path WriteTrace(std::string* error);
+
+uint64_t TraceNow();  // 追踪时钟的当前刻度，只用于传给下面的记录函数
+uint64_t TraceNextId();  // 异步 span 的进程内唯一 id
+uint32_t TraceName(std::string_view name);
+
+// 显示在追踪视图中的线程名；未设置时为线程 ID
+void SetTraceThreadName(std::string_view name);
+
+// 'X' 事件：当前线程上的 [begin, end)，arg 非 0 时作为 args.id 输出
+void TraceComplete(uint32_t name, TraceCategory category, uint64_t begin, uint64_t end, uint64_t arg = 0);
+
+// 'b' / 'e' 事件：不属于某个线程的区间，可以跨协程让出与线程
+void TraceAsyncBegin(uint32_t name, TraceCategory category, uint64_t id, uint64_t ts);
+void TraceAsyncEnd(uint32_t name, TraceCategory category, uint64_t id, uint64_t ts);
+
+class TraceScope
+{
+public:
+    TraceScope(uint32_t name, TraceCategory category, uint64_t arg = 0)
+        : name_(name), category_(category), arg_(arg), begin_(TraceEnabled() ? TraceNow() : 0)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (begin_ && TraceEnabled()) TraceComplete(name_, category_, begin_, TraceNow(), arg_);
+    }
+
+    TraceScope(const TraceScope&)            = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    uint32_t      name_;
+    TraceCategory category_;
+    uint64_t      arg_;
+    uint64_t      begin_;
+};
+
+// 当前作用域的 span，名称在首次经过时登记一次：PESH_TRACE_SCOPE("InitializeLuaState", TraceCategory::Boot);
+#define PESH_TRACE_CONCAT2(a, b) a##b
+#define PESH_TRACE_CONCAT(a, b) PESH_TRACE_CONCAT2(a, b)
+#define PESH_TRACE_SCOPE(name, category)                                                             \
+    static const uint32_t PESH_TRACE_CONCAT(pesh_trace_name_, __LINE__) = TraceName(name);          \
+    TraceScope            PESH_TRACE_CONCAT(pesh_trace_scope_, __LINE__)(                           \
+        PESH_TRACE_CONCAT(pesh_trace_name_, __LINE__), category)
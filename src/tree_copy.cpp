@@ -0,0 +1,643 @@
+#include "tree_copy.h"
+
+#include <algorithm>
+#include <new>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr size_t kBufferAlign = 4096;
+    constexpr size_t kBufferBytes = 1 << 20;
+
+    // 限速时切得更细，令牌桶的等待才足够平滑
+    constexpr uint64_t kSliceBytes          = 8 << 20;
+    constexpr uint64_t kThrottledSliceBytes = 256 << 10;
+
+    std::atomic<bool> g_kernel_copy_supported{true};
+
+#if defined(_WIN32)
+    constexpr intptr_t kInvalidFile = (intptr_t)INVALID_HANDLE_VALUE;
+
+    std::string LastErrorText(const char* what)
+    {
+        return std::string(what) + " failed: " + std::to_string(GetLastError());
+    }
+
+    intptr_t OpenSource(const fs::path& path, std::string* error)
+    {
+        HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (h == INVALID_HANDLE_VALUE) *error = LastErrorText("CreateFile(source)");
+        return (intptr_t)h;
+    }
+
+    // 预先设定目标大小，切片可以按任意顺序写入
+    intptr_t CreateDest(const fs::path& path, intptr_t source, uint64_t size, std::string* error)
+    {
+        (void)source;
+        HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (h == INVALID_HANDLE_VALUE)
+        {
+            *error = LastErrorText("CreateFile(dest)");
+            return kInvalidFile;
+        }
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)size;
+        if (!SetFilePointerEx(h, end, NULL, FILE_BEGIN) || !SetEndOfFile(h))
+        {
+            *error = LastErrorText("SetEndOfFile");
+            CloseHandle(h);
+            return kInvalidFile;
+        }
+        return (intptr_t)h;
+    }
+
+    void CopyTimes(intptr_t source, intptr_t dest)
+    {
+        FILETIME created, accessed, written;
+        if (GetFileTime((HANDLE)source, &created, &accessed, &written)) SetFileTime((HANDLE)dest, &created, &accessed, &written);
+    }
+
+    void CloseFile(intptr_t file)
+    {
+        if (file != kInvalidFile) CloseHandle((HANDLE)file);
+    }
+
+    bool ReadAt(intptr_t file, uint8_t* dst, size_t size, uint64_t offset, size_t* got, std::string* error)
+    {
+        OVERLAPPED ov{};
+        ov.Offset     = (DWORD)offset;
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD n       = 0;
+        if (!ReadFile((HANDLE)file, dst, (DWORD)size, &n, &ov) && GetLastError() != ERROR_HANDLE_EOF)
+        {
+            *error = LastErrorText("ReadFile");
+            return false;
+        }
+        *got = n;
+        return true;
+    }
+
+    bool WriteAt(intptr_t file, const uint8_t* src, size_t size, uint64_t offset, std::string* error)
+    {
+        OVERLAPPED ov{};
+        ov.Offset     = (DWORD)offset;
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD n       = 0;
+        if (!WriteFile((HANDLE)file, src, (DWORD)size, &n, &ov) || n != size)
+        {
+            *error = LastErrorText("WriteFile");
+            return false;
+        }
+        return true;
+    }
+
+    // Windows 上没有按偏移的内核拷贝，统一走缓冲区
+    bool KernelCopy(intptr_t, intptr_t, uint64_t, uint64_t, bool, uint64_t*, std::string*)
+    {
+        return false;
+    }
+#else
+    constexpr intptr_t kInvalidFile = -1;
+
+    std::string LastErrorText(const char* what)
+    {
+        return std::string(what) + " failed: " + strerror(errno);
+    }
+
+    intptr_t OpenSource(const fs::path& path, std::string* error)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) *error = LastErrorText("open(source)");
+        return fd;
+    }
+
+    intptr_t CreateDest(const fs::path& path, intptr_t source, uint64_t size, std::string* error)
+    {
+        struct stat st{};
+        mode_t      mode = fstat((int)source, &st) == 0 ? (st.st_mode & 07777) : 0644;
+        int         fd   = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+        if (fd < 0)
+        {
+            *error = LastErrorText("open(dest)");
+            return kInvalidFile;
+        }
+        if (size > 0 && ftruncate(fd, (off_t)size) != 0)
+        {
+            *error = LastErrorText("ftruncate");
+            close(fd);
+            return kInvalidFile;
+        }
+        return fd;
+    }
+
+    void CopyTimes(intptr_t source, intptr_t dest)
+    {
+        struct stat st{};
+        if (fstat((int)source, &st) != 0) return;
+        timespec times[2] = {st.st_atim, st.st_mtim};
+        futimens((int)dest, times);
+    }
+
+    void CloseFile(intptr_t file)
+    {
+        if (file != kInvalidFile) close((int)file);
+    }
+
+    bool ReadAt(intptr_t file, uint8_t* dst, size_t size, uint64_t offset, size_t* got, std::string* error)
+    {
+        ssize_t n;
+        do
+        {
+            n = pread((int)file, dst, size, (off_t)offset);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0)
+        {
+            *error = LastErrorText("pread");
+            return false;
+        }
+        *got = (size_t)n;
+        return true;
+    }
+
+    bool WriteAt(intptr_t file, const uint8_t* src, size_t size, uint64_t offset, std::string* error)
+    {
+        while (size > 0)
+        {
+            ssize_t n = pwrite((int)file, src, size, (off_t)offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0)
+            {
+                *error = LastErrorText("pwrite");
+                return false;
+            }
+            src += n;
+            size -= (size_t)n;
+            offset += (uint64_t)n;
+        }
+        return true;
+    }
+
+    // 数据不经过用户态。返回 false 且 error 为空表示当前文件系统不支持，调用方回退到缓冲区复制
+    bool KernelCopy(intptr_t in, intptr_t out, uint64_t offset, uint64_t length, bool sequential, uint64_t* copied,
+                    std::string* error)
+    {
+        *copied = 0;
+        if (g_kernel_copy_supported.load(std::memory_order_relaxed))
+        {
+            loff_t  off_in = (loff_t)offset, off_out = (loff_t)offset;
+            ssize_t n      = copy_file_range((int)in, &off_in, (int)out, &off_out, length, 0);
+            if (n >= 0)
+            {
+                *copied = (uint64_t)n;
+                return true;
+            }
+            if (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP)
+            {
+                *error = LastErrorText("copy_file_range");
+                return false;
+            }
+            if (errno == ENOSYS) g_kernel_copy_supported = false;
+        }
+        // sendfile 写入目标的当前位置，只适用于从头顺序写的整文件复制
+        if (!sequential) return false;
+        off_t   off_in = (off_t)offset;
+        ssize_t n      = sendfile((int)out, (int)in, &off_in, length);
+        if (n < 0)
+        {
+            if (errno == EINVAL || errno == ENOSYS) return false;
+            *error = LastErrorText("sendfile");
+            return false;
+        }
+        *copied = (uint64_t)n;
+        return true;
+    }
+#endif
+}  // namespace
+
+struct TreeCopyJob::Worker
+{
+    struct AlignedDelete
+    {
+        void operator()(uint8_t* p) const
+        {
+            ::operator delete[](p, std::align_val_t(kBufferAlign));
+        }
+    };
+
+    std::unique_ptr<uint8_t[], AlignedDelete> buffer{
+        static_cast<uint8_t*>(::operator new[](kBufferBytes, std::align_val_t(kBufferAlign)))};
+};
+
+struct TreeCopyJob::LargeFile
+{
+    fs::path              rel;
+    intptr_t              in  = kInvalidFile;
+    intptr_t              out = kInvalidFile;
+    std::atomic<uint64_t> remaining{0};  // 尚未完成的切片数，归零的切片负责收尾
+    std::atomic<bool>     failed{false};
+
+    ~LargeFile()
+    {
+        CloseFile(in);
+        CloseFile(out);
+    }
+};
+
+std::shared_ptr<TreeCopyJob> TreeCopyJob::Start(fs::path src, fs::path dst, TreeCopyOptions options, Executor executor,
+                                                ProgressFn on_finished)
+{
+    options.concurrency = std::max<size_t>(options.concurrency, 1);
+    options.chunk_bytes = std::max<uint64_t>(options.chunk_bytes, kBufferBytes);
+    options.batch_files = std::max<size_t>(options.batch_files, 1);
+    std::shared_ptr<TreeCopyJob> job(
+        new TreeCopyJob(std::move(src), std::move(dst), options, std::move(executor), std::move(on_finished)));
+
+    std::error_code ec;
+    if (!fs::is_directory(job->src_, ec))
+    {
+        job->Fail({}, "Source is not a directory: " + job->src_.u8string());
+        std::unique_lock<std::mutex> lock(job->mutex_);
+        job->FinishLocked(lock);
+        return job;
+    }
+    ++job->walks_pending_;
+    job->Schedule([self = job.get()](Worker&) { self->WalkDir({}); });
+    return job;
+}
+
+TreeCopyJob::TreeCopyJob(fs::path src, fs::path dst, TreeCopyOptions options, Executor executor, ProgressFn on_finished)
+    : src_(std::move(src)),
+      dst_(std::move(dst)),
+      options_(options),
+      executor_(std::move(executor)),
+      on_finished_(std::move(on_finished)),
+      started_(std::chrono::steady_clock::now()),
+      throttle_next_(started_)
+{
+}
+
+TreeCopyJob::~TreeCopyJob() = default;
+
+void TreeCopyJob::Cancel()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (finished_) return;  // 已结束的任务上无副作用
+    cancelled_ = true;
+    pending_.clear();  // 丢弃的切片任务释放对 LargeFile 的引用，文件随之关闭
+    if (in_flight_ == 0) FinishLocked(lock);
+}
+
+TreeCopyProgress TreeCopyJob::Snapshot() const
+{
+    TreeCopyProgress p;
+    p.files_done  = files_done_.load();
+    p.files_total = files_total_.load();
+    p.bytes_done  = bytes_done_.load();
+    p.bytes_total = bytes_total_.load();
+    p.dirs        = dirs_.load();
+    p.errors      = errors_.load();
+    p.scanning    = scanning_.load();
+    p.finished    = finished_.load();
+    p.cancelled   = cancelled_.load();
+    p.elapsed_ms  = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started_).count();
+    std::lock_guard<std::mutex> lock(mail_mutex_);
+    p.first_error = first_error_;
+    return p;
+}
+
+void TreeCopyJob::NextProgress(ProgressFn callback)
+{
+    std::unique_lock<std::mutex> lock(mail_mutex_);
+    if (unread_ || latest_.finished)
+    {
+        unread_               = false;
+        TreeCopyProgress snap = latest_;
+        lock.unlock();
+        callback(snap);
+        return;
+    }
+    waiter_ = std::move(callback);
+}
+
+// 周期性发布：多个工作线程竞争同一个时间片，只有 CAS 成功的一个负责发布
+void TreeCopyJob::Publish(bool force)
+{
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started_).count();
+    if (!force)
+    {
+        int64_t last = last_publish_ms_.load(std::memory_order_relaxed);
+        if (now_ms - last < (int64_t)options_.progress_interval_ms) return;
+        if (!last_publish_ms_.compare_exchange_strong(last, now_ms)) return;
+    }
+
+    TreeCopyProgress snap = Snapshot();
+    ProgressFn       waiter;
+    {
+        std::lock_guard<std::mutex> lock(mail_mutex_);
+        if (latest_.finished) return;  // 最终快照之后不再覆盖
+        latest_ = snap;
+        if (waiter_)
+        {
+            waiter  = std::move(waiter_);
+            waiter_ = nullptr;
+        }
+        else
+        {
+            unread_ = true;
+        }
+    }
+    if (waiter) waiter(snap);
+}
+
+void TreeCopyJob::Fail(const fs::path& rel, const std::string& error)
+{
+    ++errors_;
+    std::lock_guard<std::mutex> lock(mail_mutex_);
+    if (first_error_.empty()) first_error_ = rel.empty() ? error : rel.u8string() + ": " + error;
+}
+
+void TreeCopyJob::Schedule(Task task)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (cancelled_) return;
+    pending_.push_back(std::move(task));
+    Pump(lock);
+}
+
+// 在上限内派发等待中的任务；返回时 lock 已释放
+void TreeCopyJob::Pump(std::unique_lock<std::mutex>& lock)
+{
+    std::vector<Task> dispatch;
+    while (in_flight_ < options_.concurrency && !pending_.empty())
+    {
+        dispatch.push_back(std::move(pending_.front()));
+        pending_.pop_front();
+        ++in_flight_;
+    }
+    lock.unlock();
+    for (Task& task : dispatch)
+    {
+        executor_([self = shared_from_this(), task = std::move(task)] {
+            std::unique_ptr<Worker> worker = self->TakeWorker();
+            task(*worker);
+            self->TaskDone(std::move(worker));
+        });
+    }
+}
+
+// 执行中的任务各借一份复制缓冲区，用完交还，同时存在的不超过 concurrency 份
+std::unique_ptr<TreeCopyJob::Worker> TreeCopyJob::TakeWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_workers_.empty())
+        {
+            std::unique_ptr<Worker> worker = std::move(idle_workers_.back());
+            idle_workers_.pop_back();
+            return worker;
+        }
+    }
+    return std::make_unique<Worker>();
+}
+
+void TreeCopyJob::TaskDone(std::unique_ptr<Worker> worker)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_workers_.push_back(std::move(worker));
+    --in_flight_;
+    if (in_flight_ == 0 && pending_.empty()) FinishLocked(lock);
+    else Pump(lock);
+}
+
+// 返回时 lock 已释放
+void TreeCopyJob::FinishLocked(std::unique_lock<std::mutex>& lock)
+{
+    scanning_ = false;
+    finished_ = true;
+    idle_workers_.clear();
+    lock.unlock();
+    Publish(true);
+    if (on_finished_) on_finished_(Snapshot());
+}
+
+void TreeCopyJob::WalkDir(const fs::path& rel)
+{
+    std::error_code ec;
+    fs::create_directories(dst_ / rel, ec);
+    if (ec) Fail(rel, "create directory: " + ec.message());
+    else ++dirs_;
+
+    std::vector<std::pair<fs::path, uint64_t>> batch;
+    uint64_t                                   batch_bytes = 0;
+    auto flush = [&] {
+        if (batch.empty()) return;
+        Schedule([this, files = std::move(batch)](Worker& worker) { CopyBatch(worker, files); });
+        batch.clear();
+        batch_bytes = 0;
+    };
+
+    for (fs::directory_iterator it(src_ / rel, ec), end; !ec && it != end && !cancelled_; it.increment(ec))
+    {
+        fs::path        child = rel / it->path().filename();
+        std::error_code entry_ec;
+        fs::file_status status = it->symlink_status(entry_ec);
+        if (entry_ec)
+        {
+            Fail(child, entry_ec.message());
+            continue;
+        }
+
+        if (fs::is_symlink(status))
+        {
+            ++files_total_;
+            fs::copy_symlink(it->path(), dst_ / child, entry_ec);
+            if (entry_ec) Fail(child, "copy symlink: " + entry_ec.message());
+            else ++files_done_;
+        }
+        else if (fs::is_directory(status))
+        {
+            ++walks_pending_;
+            Schedule([this, child](Worker&) { WalkDir(child); });
+        }
+        else if (fs::is_regular_file(status))
+        {
+            uint64_t size = it->file_size(entry_ec);
+            ++files_total_;
+            bytes_total_ += size;
+            // 空文件没有切片可以收尾，总是随批次复制 (small_file_bytes 可能为 0)
+            if (size > 0 && size >= options_.small_file_bytes)
+            {
+                Schedule([this, child, size](Worker&) { StartLargeFile(child, size); });
+                continue;
+            }
+            batch.emplace_back(child, size);
+            batch_bytes += size;
+            if (batch.size() >= options_.batch_files || batch_bytes >= options_.batch_bytes) flush();
+        }
+    }
+    if (ec) Fail(rel, "list directory: " + ec.message());
+    flush();
+
+    if (--walks_pending_ == 0) scanning_ = false;
+    Publish(false);
+}
+
+void TreeCopyJob::CopyBatch(Worker& worker, const std::vector<std::pair<fs::path, uint64_t>>& files)
+{
+    for (const auto& [rel, size] : files)
+    {
+        if (cancelled_) return;
+        std::string error;
+#if defined(_WIN32)
+        // 小文件交给 CopyFileW：一次系统调用，同时保留属性与时间戳
+        (void)worker;
+        Throttle(size);
+        if (!CopyFileW((src_ / rel).c_str(), (dst_ / rel).c_str(), FALSE))
+        {
+            Fail(rel, LastErrorText("CopyFile"));
+            continue;
+        }
+        bytes_done_ += size;
+#else
+        intptr_t in = OpenSource(src_ / rel, &error);
+        if (in == kInvalidFile)
+        {
+            Fail(rel, error);
+            continue;
+        }
+        intptr_t out = CreateDest(dst_ / rel, in, 0, &error);
+        bool     ok  = out != kInvalidFile && CopyRange(worker, in, out, 0, size, true, &error);
+        if (ok) CopyTimes(in, out);
+        CloseFile(in);
+        CloseFile(out);
+        if (!ok)
+        {
+            Fail(rel, error);
+            continue;
+        }
+#endif
+        ++files_done_;
+        Publish(false);
+    }
+}
+
+void TreeCopyJob::StartLargeFile(const fs::path& rel, uint64_t size)
+{
+    if (cancelled_) return;
+    auto        file = std::make_shared<LargeFile>();
+    std::string error;
+    file->rel = rel;
+    file->in  = OpenSource(src_ / rel, &error);
+    if (file->in != kInvalidFile) file->out = CreateDest(dst_ / rel, file->in, size, &error);
+    if (file->out == kInvalidFile)
+    {
+        Fail(rel, error);
+        return;
+    }
+
+    uint64_t chunks = (size + options_.chunk_bytes - 1) / options_.chunk_bytes;
+    file->remaining = chunks;
+    for (uint64_t i = 0; i < chunks; ++i)
+    {
+        uint64_t offset = i * options_.chunk_bytes;
+        uint64_t length = std::min(options_.chunk_bytes, size - offset);
+        Schedule([this, file, offset, length](Worker& worker) { CopyChunk(worker, file, offset, length); });
+    }
+}
+
+void TreeCopyJob::CopyChunk(Worker& worker, const std::shared_ptr<LargeFile>& file, uint64_t offset, uint64_t length)
+{
+    if (!cancelled_ && !file->failed)
+    {
+        std::string error;
+        if (!CopyRange(worker, file->in, file->out, offset, length, false, &error) && !file->failed.exchange(true))
+        {
+            Fail(file->rel, error);
+        }
+    }
+    if (--file->remaining == 0 && !file->failed && !cancelled_)
+    {
+        CopyTimes(file->in, file->out);
+        ++files_done_;
+        Publish(false);
+    }
+}
+
+bool TreeCopyJob::CopyRange(Worker& worker, intptr_t in, intptr_t out, uint64_t offset, uint64_t length,
+                            bool sequential, std::string* error)
+{
+    const uint64_t slice_limit = options_.bandwidth_bps ? kThrottledSliceBytes : kSliceBytes;
+    uint64_t       end         = offset + length;
+    bool           kernel      = true;
+    while (offset < end)
+    {
+        if (cancelled_)
+        {
+            *error = "Cancelled";
+            return false;
+        }
+        uint64_t slice = std::min(slice_limit, end - offset);
+        Throttle(slice);
+
+        uint64_t copied = 0;
+        if (!(kernel && KernelCopy(in, out, offset, slice, sequential, &copied, error)))
+        {
+            if (!error->empty()) return false;
+            kernel = false;
+            // 回退：经由工作线程的对齐缓冲区读写
+            while (copied < slice)
+            {
+                size_t want = (size_t)std::min<uint64_t>(kBufferBytes, slice - copied);
+                size_t got  = 0;
+                if (!ReadAt(in, worker.buffer.get(), want, offset + copied, &got, error)) return false;
+                if (got == 0) break;
+                if (!WriteAt(out, worker.buffer.get(), got, offset + copied, error)) return false;
+                copied += got;
+            }
+        }
+        // 源文件在复制期间被截短：目标已按原大小预分配，剩下的部分会是零，不能当作成功
+        if (copied == 0)
+        {
+            *error = "source truncated during copy";
+            return false;
+        }
+        offset += copied;
+        bytes_done_ += copied;
+        Publish(false);
+    }
+    return true;
+}
+
+// 虚拟时钟令牌桶：每次申请把共享的"下一个可用时刻"向后推 bytes / rate，申请者睡到分配给它的时刻
+void TreeCopyJob::Throttle(uint64_t bytes)
+{
+    if (options_.bandwidth_bps == 0 || bytes == 0) return;
+    auto cost = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>((double)bytes / (double)options_.bandwidth_bps));
+
+    std::chrono::steady_clock::time_point when;
+    {
+        std::lock_guard<std::mutex> lock(throttle_mutex_);
+        when           = std::max(throttle_next_, std::chrono::steady_clock::now());
+        throttle_next_ = when + cost;
+    }
+    std::this_thread::sleep_until(when);
+}
@@ -0,0 +1,119 @@
+#pragma once
+// 并行目录树复制。
+//   - 目录遍历本身也是任务，子目录并行展开
+//   - 小文件按批次打包成一个任务，摊薄调度开销
+//   - 大文件按 chunk_bytes 切片并行复制 (Linux: copy_file_range / sendfile，回退到对齐缓冲区 pread/pwrite)
+//   - 同时执行的任务不超过 concurrency、可选带宽上限 (令牌桶)、按时间间隔发布进度快照
+// 不依赖 Lua；任务经由 Executor 提交 (peshell 中为线程池的 I/O 通道)，不占用专门的线程。
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct TreeCopyOptions
+{
+    size_t   concurrency          = 8;
+    uint64_t bandwidth_bps        = 0;  // 0 = 不限速
+    uint64_t small_file_bytes     = 1 << 20;
+    size_t   batch_files          = 64;
+    uint64_t batch_bytes          = 8 << 20;
+    uint64_t chunk_bytes          = 16 << 20;
+    uint32_t progress_interval_ms = 250;
+};
+
+struct TreeCopyProgress
+{
+    uint64_t    files_done  = 0;
+    uint64_t    files_total = 0;  // 遍历期间持续增长
+    uint64_t    bytes_done  = 0;
+    uint64_t    bytes_total = 0;
+    uint64_t    dirs        = 0;
+    uint64_t    errors      = 0;
+    uint64_t    elapsed_ms  = 0;
+    bool        scanning    = true;
+    bool        finished    = false;
+    bool        cancelled   = false;
+    std::string first_error;
+};
+
+class TreeCopyJob : public std::enable_shared_from_this<TreeCopyJob>
+{
+public:
+    using Executor   = std::function<void(std::function<void()>)>;
+    using ProgressFn = std::function<void(const TreeCopyProgress&)>;
+
+    // 立即开始复制；on_finished (可为空) 在结束或取消后以最终快照调用一次，可能在任意线程上
+    static std::shared_ptr<TreeCopyJob> Start(std::filesystem::path src, std::filesystem::path dst, TreeCopyOptions options,
+                                              Executor executor, ProgressFn on_finished = nullptr);
+
+    TreeCopyJob(const TreeCopyJob&)            = delete;
+    TreeCopyJob& operator=(const TreeCopyJob&) = delete;
+    ~TreeCopyJob();
+
+    // 任意线程；丢弃未派发的任务，已开始的文件会复制完当前切片后停止
+    void Cancel();
+
+    TreeCopyProgress Snapshot() const;
+
+    // 取下一份未读的进度快照：已有则立即回调，否则等到下一次发布；结束后总是立即返回最终快照
+    void NextProgress(ProgressFn callback);
+
+private:
+    struct Worker;
+    struct LargeFile;
+    using Task = std::function<void(Worker&)>;
+
+    TreeCopyJob(std::filesystem::path src, std::filesystem::path dst, TreeCopyOptions options, Executor executor,
+                ProgressFn on_finished);
+
+    void Schedule(Task task);
+    void Pump(std::unique_lock<std::mutex>& lock);
+    std::unique_ptr<Worker> TakeWorker();
+    void                    TaskDone(std::unique_ptr<Worker> worker);
+    void FinishLocked(std::unique_lock<std::mutex>& lock);
+    void WalkDir(const std::filesystem::path& rel);
+    void CopyBatch(Worker& worker, const std::vector<std::pair<std::filesystem::path, uint64_t>>& files);
+    void StartLargeFile(const std::filesystem::path& rel, uint64_t size);
+    void CopyChunk(Worker& worker, const std::shared_ptr<LargeFile>& file, uint64_t offset, uint64_t length);
+
+    bool CopyRange(Worker& worker, intptr_t in, intptr_t out, uint64_t offset, uint64_t length, bool sequential,
+                   std::string* error);
+    void Throttle(uint64_t bytes);
+    void Fail(const std::filesystem::path& rel, const std::string& error);
+    void Publish(bool force);
+
+    const std::filesystem::path src_;
+    const std::filesystem::path dst_;
+    const TreeCopyOptions       options_;
+    Executor                    executor_;
+    ProgressFn                  on_finished_;
+
+    std::mutex                           mutex_;
+    std::deque<Task>                     pending_;  // 等待派发的任务
+    size_t                               in_flight_ = 0;
+    std::vector<std::unique_ptr<Worker>> idle_workers_;
+
+    std::atomic<uint64_t> files_done_{0}, files_total_{0}, bytes_done_{0}, bytes_total_{0};
+    std::atomic<uint64_t> dirs_{0}, errors_{0}, walks_pending_{0};
+    std::atomic<bool>     scanning_{true}, finished_{false}, cancelled_{false};
+
+    std::chrono::steady_clock::time_point started_;
+    std::atomic<int64_t>                  last_publish_ms_{0};
+
+    std::mutex                            throttle_mutex_;
+    std::chrono::steady_clock::time_point throttle_next_;
+
+    mutable std::mutex mail_mutex_;
+    std::string        first_error_;
+    TreeCopyProgress   latest_;
+    bool               unread_ = false;
+    ProgressFn         waiter_;
+};
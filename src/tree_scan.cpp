@@ -0,0 +1,412 @@
+#include "tree_scan.h"
+
+#include "file_buffer.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct DirEntryInfo
+    {
+        fs::path    name;
+        uint64_t    size       = 0;
+        int64_t     mtime      = 0;
+        uint32_t    attributes = 0;
+        bool        is_dir     = false;
+        bool        is_regular = false;
+        bool        descend    = false;  // 真正的子目录，符号链接与联接不展开
+        std::string error;
+    };
+
+#if defined(_WIN32)
+    int64_t UnixSeconds(const FILETIME& ft)
+    {
+        uint64_t ticks = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;  // 1601 年起的 100ns
+        return (int64_t)(ticks / 10000000ull) - 11644473600ll;
+    }
+
+    // 一次 FindFirstFileEx 拿到大小、时间与属性，无需逐个 stat
+    bool ListDir(const fs::path& dir, std::vector<DirEntryInfo>* out, std::string* error)
+    {
+        WIN32_FIND_DATAW data;
+        HANDLE           find = FindFirstFileExW((dir / L"*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr,
+                                                 FIND_FIRST_EX_LARGE_FETCH);
+        if (find == INVALID_HANDLE_VALUE)
+        {
+            *error = "FindFirstFileEx failed: " + std::to_string(GetLastError());
+            return false;
+        }
+        do
+        {
+            if (wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0) continue;
+            DirEntryInfo info;
+            info.name       = data.cFileName;
+            info.attributes = data.dwFileAttributes;
+            info.mtime      = UnixSeconds(data.ftLastWriteTime);
+            bool reparse    = (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+            info.is_dir     = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+            info.is_regular = !info.is_dir && !reparse;
+            info.descend    = info.is_dir && !reparse;
+            info.size       = info.is_dir ? 0 : (((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow);
+            out->push_back(std::move(info));
+        } while (FindNextFileW(find, &data));
+        DWORD last = GetLastError();
+        FindClose(find);
+        if (last != ERROR_NO_MORE_FILES)
+        {
+            *error = "FindNextFile failed: " + std::to_string(last);
+            return false;
+        }
+        return true;
+    }
+
+    bool ReadWhole(const fs::path& path, std::vector<uint8_t>* buffer, size_t* size, std::string* error)
+    {
+        HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                               OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (h == INVALID_HANDLE_VALUE)
+        {
+            *error = "CreateFile failed: " + std::to_string(GetLastError());
+            return false;
+        }
+        *size = 0;
+        DWORD n = 0;
+        do
+        {
+            if (*size == buffer->size()) buffer->resize(buffer->size() * 2);
+            if (!ReadFile(h, buffer->data() + *size, (DWORD)(buffer->size() - *size), &n, nullptr))
+            {
+                *error = "ReadFile failed: " + std::to_string(GetLastError());
+                CloseHandle(h);
+                return false;
+            }
+            *size += n;
+        } while (n > 0);
+        CloseHandle(h);
+        return true;
+    }
+#else
+    bool ListDir(const fs::path& dir, std::vector<DirEntryInfo>* out, std::string* error)
+    {
+        int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        DIR* d = fd >= 0 ? fdopendir(fd) : nullptr;
+        if (!d)
+        {
+            *error = std::string("opendir failed: ") + strerror(errno);
+            if (fd >= 0) close(fd);
+            return false;
+        }
+        errno = 0;
+        while (dirent* ent = readdir(d))
+        {
+            if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+            DirEntryInfo info;
+            info.name = ent->d_name;
+            struct stat st{};
+            if (fstatat(dirfd(d), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+            {
+                if (errno == ENOENT) continue;  // 枚举与 stat 之间被删除
+                info.error = std::string("stat failed: ") + strerror(errno);
+            }
+            else
+            {
+                info.attributes = (uint32_t)st.st_mode;
+                info.mtime      = (int64_t)st.st_mtim.tv_sec;
+                info.is_dir     = S_ISDIR(st.st_mode);
+                info.is_regular = S_ISREG(st.st_mode);
+                info.descend    = info.is_dir;
+                info.size       = info.is_regular ? (uint64_t)st.st_size : 0;
+            }
+            out->push_back(std::move(info));
+            errno = 0;
+        }
+        bool ok = errno == 0;
+        if (!ok) *error = std::string("readdir failed: ") + strerror(errno);
+        closedir(d);
+        return ok;
+    }
+
+    bool ReadWhole(const fs::path& path, std::vector<uint8_t>* buffer, size_t* size, std::string* error)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            *error = std::string("open failed: ") + strerror(errno);
+            return false;
+        }
+        *size = 0;
+        ssize_t n;
+        do
+        {
+            if (*size == buffer->size()) buffer->resize(buffer->size() * 2);
+            n = read(fd, buffer->data() + *size, buffer->size() - *size);
+            if (n > 0) *size += (size_t)n;
+        } while (n > 0 || (n < 0 && errno == EINTR));
+        if (n < 0) *error = std::string("read failed: ") + strerror(errno);
+        close(fd);
+        return n == 0;
+    }
+#endif
+
+    // 小于此大小的文件直接读进任务的缓冲区，映射与解除映射的开销在小文件上比读取本身还大
+    constexpr uint64_t kMapThreshold = 1 << 20;
+}  // namespace
+
+std::shared_ptr<TreeScanJob> TreeScanJob::Start(fs::path root, TreeScanOptions options, Executor executor)
+{
+    options.concurrency   = std::max<size_t>(options.concurrency, 1);
+    options.batch_entries = std::max<size_t>(options.batch_entries, 1);
+    options.max_batches   = std::max<size_t>(options.max_batches, 1);
+    auto job = std::shared_ptr<TreeScanJob>(new TreeScanJob(std::move(root), options, std::move(executor)));
+
+    std::error_code ec;
+    if (!fs::is_directory(job->root_, ec))
+    {
+        job->Fail({}, "Root is not a directory: " + job->root_.u8string());
+        std::unique_lock<std::mutex> lock(job->mutex_);
+        job->FinishLocked(lock);
+        return job;
+    }
+    job->Schedule([raw = job.get()] { raw->WalkDir({}); });
+    return job;
+}
+
+TreeScanJob::TreeScanJob(fs::path root, TreeScanOptions options, Executor executor)
+    : root_(std::move(root)), options_(options), executor_(std::move(executor)), started_(std::chrono::steady_clock::now())
+{
+}
+
+void TreeScanJob::NextBatch(BatchFn callback)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!ready_.empty())
+    {
+        std::shared_ptr<Batch> batch = std::move(ready_.front());
+        ready_.pop_front();
+        Pump(lock);  // 腾出了位置，恢复因背压暂停的任务
+        callback(std::move(batch));
+        return;
+    }
+    if (finished_)
+    {
+        lock.unlock();
+        callback(nullptr);
+        return;
+    }
+    waiter_ = std::move(callback);
+}
+
+void TreeScanJob::Cancel()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (finished_) return;  // 已结束的任务上无副作用
+    cancelled_ = true;
+    stop_      = true;
+    pending_.clear();
+    ready_.clear();
+    if (in_flight_ == 0) FinishLocked(lock);
+}
+
+TreeScanSummary TreeScanJob::Summary() const
+{
+    TreeScanSummary s;
+    s.entries      = entries_.load();
+    s.files        = files_.load();
+    s.dirs         = dirs_.load();
+    s.bytes        = bytes_.load();
+    s.hashed_bytes = hashed_bytes_.load();
+    s.errors       = errors_.load();
+    int64_t done   = elapsed_ms_.load();
+    s.elapsed_ms   = done >= 0 ? (uint64_t)done
+                               : (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started_).count();
+    std::lock_guard<std::mutex> lock(mutex_);
+    s.finished    = finished_;
+    s.cancelled   = cancelled_;
+    s.first_error = first_error_;
+    return s;
+}
+
+void TreeScanJob::Schedule(Task task)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (cancelled_) return;
+    pending_.push_back(std::move(task));
+    Pump(lock);
+}
+
+// 在上限内派发等待中的任务；返回时 lock 已释放
+void TreeScanJob::Pump(std::unique_lock<std::mutex>& lock)
+{
+    std::vector<Task> dispatch;
+    while (in_flight_ < options_.concurrency && !pending_.empty() && ready_.size() < options_.max_batches)
+    {
+        dispatch.push_back(std::move(pending_.front()));
+        pending_.pop_front();
+        ++in_flight_;
+    }
+    lock.unlock();
+    for (Task& task : dispatch)
+    {
+        executor_([self = shared_from_this(), task = std::move(task)] {
+            task();
+            self->TaskDone();
+        });
+    }
+}
+
+void TreeScanJob::TaskDone()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    --in_flight_;
+    if (in_flight_ == 0 && pending_.empty()) FinishLocked(lock);
+    else Pump(lock);
+}
+
+void TreeScanJob::FinishLocked(std::unique_lock<std::mutex>& lock)
+{
+    finished_ = true;
+    elapsed_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started_).count();
+    BatchFn waiter;
+    if (ready_.empty()) waiter = std::move(waiter_);
+    waiter_ = nullptr;
+    lock.unlock();
+    if (waiter) waiter(nullptr);
+}
+
+void TreeScanJob::Deliver(std::shared_ptr<Batch> batch)
+{
+    if (batch->empty()) return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (cancelled_) return;
+    entries_ += batch->size();
+    if (!waiter_)
+    {
+        ready_.push_back(std::move(batch));
+        return;
+    }
+    BatchFn waiter = std::move(waiter_);
+    waiter_        = nullptr;
+    lock.unlock();
+    waiter(std::move(batch));
+}
+
+void TreeScanJob::Fail(const std::string& rel, const std::string& error)
+{
+    ++errors_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (first_error_.empty()) first_error_ = rel.empty() ? error : rel + ": " + error;
+}
+
+void TreeScanJob::WalkDir(const fs::path& rel)
+{
+    if (stop_) return;
+    std::vector<DirEntryInfo> infos;
+    std::string               error;
+    if (!ListDir(root_ / rel, &infos, &error)) Fail(rel.u8string(), error);  // 已列出的部分照常交出
+
+    auto     batch = std::make_shared<Batch>();
+    FileList to_hash;
+    uint64_t to_hash_bytes = 0;
+    auto flush = [&] {
+        Deliver(std::move(batch));
+        batch = std::make_shared<Batch>();
+    };
+    auto flush_hash = [&] {
+        if (to_hash.empty()) return;
+        Schedule([this, files = std::move(to_hash)]() mutable { HashFiles(std::move(files)); });
+        to_hash.clear();
+        to_hash_bytes = 0;
+    };
+
+    for (DirEntryInfo& info : infos)
+    {
+        if (stop_) return;
+        fs::path child = rel / info.name;
+        if (!info.error.empty())
+        {
+            Fail(child.u8string(), info.error);
+            continue;
+        }
+
+        TreeScanEntry entry;
+        entry.path       = child.u8string();
+        entry.size       = info.size;
+        entry.mtime      = info.mtime;
+        entry.attributes = info.attributes;
+        entry.is_dir     = info.is_dir;
+        if (info.is_dir)
+        {
+            ++dirs_;
+            if (info.descend) Schedule([this, child] { WalkDir(child); });
+        }
+        else
+        {
+            ++files_;
+            bytes_ += info.size;
+        }
+
+        if (options_.hash != ContentHash::None && info.is_regular)
+        {
+            to_hash_bytes += info.size;
+            to_hash.push_back(std::move(entry));
+            if (to_hash.size() >= options_.batch_entries || to_hash_bytes >= options_.hash_batch_bytes) flush_hash();
+            continue;
+        }
+        batch->push_back(std::move(entry));
+        if (batch->size() >= options_.batch_entries) flush();
+    }
+    flush();
+    flush_hash();
+}
+
+void TreeScanJob::HashFiles(FileList files)
+{
+    std::vector<uint8_t> buffer(64 << 10);
+    for (TreeScanEntry& entry : files)
+    {
+        if (stop_) return;
+        fs::path    path = root_ / fs::u8path(entry.path);
+        std::string error;
+        if (entry.size < kMapThreshold)
+        {
+            size_t size = 0;
+            if (!ReadWhole(path, &buffer, &size, &error))
+            {
+                Fail(entry.path, error);
+                continue;  // 条目照常交出，只是没有校验和
+            }
+            entry.hash = ComputeContentHash(options_.hash, buffer.data(), size);
+            hashed_bytes_ += size;
+        }
+        else
+        {
+            pesh_buffer* mapped = MapFileBuffer(path, &error);
+            if (!mapped)
+            {
+                Fail(entry.path, error);
+                continue;
+            }
+            entry.hash = ComputeContentHash(options_.hash, mapped->data, mapped->size);
+            hashed_bytes_ += mapped->size;
+            mapped->release(mapped);
+        }
+        entry.hashed = true;
+    }
+    Deliver(std::make_shared<Batch>(std::move(files)));
+}
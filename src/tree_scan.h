@@ -0,0 +1,118 @@
+#pragma once
+// 并行目录扫描。
+//   - 每个目录的枚举是一个任务，子目录并行展开 (Windows: FindFirstFileEx 大块读取 / Linux: readdir + fstatat)
+//   - 条目 (相对路径、大小、修改时间、属性) 按批次交给调用方，扫描期间即可逐批处理
+//   - 可选内容校验和 (src/content_hash.h)：文件按批打包成哈希任务，小文件整个读入、大文件映射后计算
+//   - 同时执行的任务不超过 concurrency；未取走的批次达到 max_batches 时暂停派发新任务 (背压)，
+//     已在执行的任务仍会交出当前目录的条目
+// 不跟随符号链接与目录联接。不依赖 Lua；任务经由 Executor 提交 (peshell 中为线程池的 I/O 通道)。
+
+#include "content_hash.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct TreeScanOptions
+{
+    size_t      concurrency      = 8;
+    size_t      batch_entries    = 512;
+    size_t      max_batches      = 64;
+    uint64_t    hash_batch_bytes = 8 << 20;  // 一个哈希任务累计的文件大小上限 (单个大文件独占一个任务)
+    ContentHash hash             = ContentHash::None;
+};
+
+struct TreeScanEntry
+{
+    std::string path;  // 相对根目录，UTF-8
+    uint64_t    size       = 0;
+    int64_t     mtime      = 0;  // Unix 秒
+    uint32_t    attributes = 0;  // Windows: FILE_ATTRIBUTE_*；Linux: st_mode
+    bool        is_dir     = false;
+    bool        hashed     = false;  // 计算了校验和 (普通文件且读取成功)
+    uint64_t    hash       = 0;
+};
+
+struct TreeScanSummary
+{
+    uint64_t    entries      = 0;  // 已交出的条目数
+    uint64_t    files        = 0;
+    uint64_t    dirs         = 0;
+    uint64_t    bytes        = 0;
+    uint64_t    hashed_bytes = 0;
+    uint64_t    errors       = 0;
+    uint64_t    elapsed_ms   = 0;
+    bool        finished     = false;
+    bool        cancelled    = false;
+    std::string first_error;
+};
+
+class TreeScanJob : public std::enable_shared_from_this<TreeScanJob>
+{
+public:
+    using Batch    = std::vector<TreeScanEntry>;
+    using Executor = std::function<void(std::function<void()>)>;
+    // batch 为 nullptr 表示扫描结束 (或已取消)；可能在任意线程上调用
+    using BatchFn = std::function<void(std::shared_ptr<Batch> batch)>;
+
+    // 立即开始扫描 root
+    static std::shared_ptr<TreeScanJob> Start(std::filesystem::path root, TreeScanOptions options, Executor executor);
+
+    TreeScanJob(const TreeScanJob&)            = delete;
+    TreeScanJob& operator=(const TreeScanJob&) = delete;
+
+    // 同一时刻至多一个未完成的 NextBatch；已有批次时回调在当前线程立即执行
+    void NextBatch(BatchFn callback);
+
+    // 任意线程；丢弃未取走的批次与未派发的任务，执行中的任务结束后以 nullptr 回调挂起的 NextBatch
+    void Cancel();
+
+    TreeScanSummary Summary() const;
+
+    ContentHash Hash() const
+    {
+        return options_.hash;
+    }
+
+private:
+    using Task     = std::function<void()>;
+    using FileList = std::vector<TreeScanEntry>;
+
+    TreeScanJob(std::filesystem::path root, TreeScanOptions options, Executor executor);
+
+    void Schedule(Task task);
+    void Pump(std::unique_lock<std::mutex>& lock);
+    void TaskDone();
+    void Deliver(std::shared_ptr<Batch> batch);
+    void FinishLocked(std::unique_lock<std::mutex>& lock);
+
+    void WalkDir(const std::filesystem::path& rel);
+    void HashFiles(FileList files);
+    void Fail(const std::string& rel, const std::string& error);
+
+    const std::filesystem::path root_;
+    const TreeScanOptions       options_;
+    Executor                    executor_;
+
+    mutable std::mutex                 mutex_;
+    std::deque<Task>                   pending_;  // 等待派发的任务
+    size_t                             in_flight_ = 0;
+    std::deque<std::shared_ptr<Batch>> ready_;
+    BatchFn                            waiter_;
+    std::string                        first_error_;
+    bool                               finished_  = false;
+    bool                               cancelled_ = false;
+
+    std::atomic<uint64_t> entries_{0}, files_{0}, dirs_{0}, bytes_{0}, hashed_bytes_{0}, errors_{0};
+    std::atomic<bool>     stop_{false};  // 执行中的任务尽早放弃
+
+    const std::chrono::steady_clock::time_point started_;
+    std::atomic<int64_t>                        elapsed_ms_{-1};
+};
@@ -0,0 +1,21 @@
+#pragma once
+// Linux 抽象 Unix 套接字的公用函数，查询通道 (stats_server_linux.cpp) 与命令转发通道 (command_channel_linux.cpp) 共用。
+// 抽象名字空间不在文件系统中留下残留，但也不受文件权限保护：两端都应以 PeerIsSameUser 检查对端。
+// 本文件不依赖 Lua。
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <string>
+
+// sun_path[0] 为 0，地址长度只覆盖实际名称 (过长时截断)
+socklen_t AbstractSocketAddress(const std::string& name, sockaddr_un* addr);
+
+// 对端进程与本进程运行在同一 uid 下 (SO_PEERCRED)
+bool PeerIsSameUser(int fd);
+
+// 接收 / 发送超时 (毫秒)，负数表示不设置；卡住的对端不会无限拖住服务线程或客户端
+void SetSocketTimeouts(int fd, int recv_ms, int send_ms);
+
+// 写完整个 data，被信号打断时继续；对端已关闭时返回 false 而不触发 SIGPIPE
+bool SendAll(int fd, const std::string& data);
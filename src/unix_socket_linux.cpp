@@ -0,0 +1,52 @@
+#include "unix_socket.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+socklen_t AbstractSocketAddress(const std::string& name, sockaddr_un* addr)
+{
+    std::memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    size_t len       = std::min(name.size(), sizeof(addr->sun_path) - 1);
+    std::memcpy(addr->sun_path + 1, name.data(), len);
+    return (socklen_t)(offsetof(sockaddr_un, sun_path) + 1 + len);
+}
+
+bool PeerIsSameUser(int fd)
+{
+    ucred     cred{};
+    socklen_t cred_len = sizeof(cred);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == 0 && cred.uid == getuid();
+}
+
+void SetSocketTimeouts(int fd, int recv_ms, int send_ms)
+{
+    if (recv_ms >= 0)
+    {
+        timeval tv{recv_ms / 1000, (recv_ms % 1000) * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+    if (send_ms >= 0)
+    {
+        timeval tv{send_ms / 1000, (send_ms % 1000) * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+}
+
+bool SendAll(int fd, const std::string& data)
+{
+    size_t done = 0;
+    while (done < data.size())
+    {
+        ssize_t n = send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += (size_t)n;
+    }
+    return true;
+}
@@ -0,0 +1,30 @@
+#include "wait_set.h"
+
+void WaitSet::Signal(Registration* reg)
+{
+    Operation* op       = reg->op;
+    int        expected = 0;
+    if (!op->signaled_index.compare_exchange_strong(expected, reg->index, std::memory_order_acq_rel)) return;
+    if (op->owner->signaled_.Push(op)) op->owner->wake_();
+}
+
+bool WaitSet::PopSignaled(void** context, int* index)
+{
+    while (Operation* op = signaled_.Pop())
+    {
+        bool cancelled = op->cancelled;
+        *context       = op->context;
+        *index         = op->signaled_index.load(std::memory_order_acquire);
+        Release(op);
+        if (!cancelled) return true;
+    }
+    return false;
+}
+
+// 注册中途失败：若尚未有句柄触发则直接回收，否则交给 PopSignaled 丢弃
+void WaitSet::Abandon(Operation* op)
+{
+    int expected = 0;
+    if (op->signaled_index.compare_exchange_strong(expected, -1, std::memory_order_acq_rel)) Release(op);
+    else op->cancelled = true;
+}
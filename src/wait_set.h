@@ -0,0 +1,91 @@
+#pragma once
+// 可扩展的内核对象等待集合，替代 MsgWaitForMultipleObjects 的 64 句柄上限。
+//   Windows: 每个句柄一个线程池等待注册 (RegisterWaitForSingleObject)
+//   Linux:   一个 epoll 等待线程，句柄为任意可读 fd (pidfd / eventfd / pipe ...)
+// 一次等待操作的所有句柄共享同一条记录，注册上下文直接指向它，触发时 O(1) 定位。
+// 首个触发的句柄胜出，操作被推入 MPSC 就绪队列并唤醒事件循环；
+// 事件循环线程 PopSignaled 后再增量注销其余句柄，无需重建任何句柄表。
+
+#include "mpsc_queue.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#if defined(_WIN32)
+using WaitHandle = void*;
+#else
+using WaitHandle = int;
+#endif
+
+class WaitSet
+{
+public:
+    using WakeFn = std::function<void()>;
+
+    // wake 在就绪队列由空变为非空时被调用 (任意线程)
+    explicit WaitSet(WakeFn wake);
+    ~WaitSet();
+
+    WaitSet(const WaitSet&)            = delete;
+    WaitSet& operator=(const WaitSet&) = delete;
+
+    // 以下仅限事件循环线程调用
+
+    // 任一句柄触发即完成，context 原样交还给 PopSignaled
+    bool Add(void* context, const std::vector<WaitHandle>& handles, std::string* error);
+
+    // index 为触发句柄在 handles 中的序号 (从 1 开始)
+    bool PopSignaled(void** context, int* index);
+
+    bool HasSignaled() const
+    {
+        return !signaled_.Empty();
+    }
+
+    size_t Size() const
+    {
+        return active_.size();
+    }
+
+private:
+    struct Operation;
+
+    struct Registration
+    {
+        Operation* op;
+        int        index;
+        WaitHandle native;  // Windows: 等待注册句柄；Linux: dup 出的 fd
+    };
+
+    struct Operation
+    {
+        WaitSet*                  owner;
+        void*                     context;
+        std::vector<Registration> regs;
+        std::atomic<int>          signaled_index{0};  // 0 = 未触发, -1 = 已取消
+        bool                      cancelled = false;  // 仅事件循环线程读写
+        Operation*                mpsc_next = nullptr;
+    };
+
+    static void Signal(Registration* reg);
+    void        Release(Operation* op);
+    void        Abandon(Operation* op);
+
+    WakeFn                         wake_;
+    MpscQueue<Operation>           signaled_;
+    std::unordered_set<Operation*> active_;
+
+#if !defined(_WIN32)
+    void WaiterLoop();
+
+    int                  epoll_fd_   = -1;
+    int                  control_fd_ = -1;
+    std::atomic<bool>    stopping_{false};
+    MpscQueue<Operation> retired_;  // 由等待线程在批次边界回收，避免与同批事件竞争
+    std::thread          waiter_;
+#endif
+};
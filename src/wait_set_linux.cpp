@@ -0,0 +1,120 @@
+#include "wait_set.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+WaitSet::WaitSet(WakeFn wake) : wake_(std::move(wake))
+{
+    epoll_fd_   = epoll_create1(EPOLL_CLOEXEC);
+    control_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    epoll_event ev{};
+    ev.events   = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, control_fd_, &ev);
+
+    waiter_ = std::thread(&WaitSet::WaiterLoop, this);
+}
+
+WaitSet::~WaitSet()
+{
+    stopping_ = true;
+    uint64_t one = 1;
+    (void)!write(control_fd_, &one, sizeof(one));
+    if (waiter_.joinable()) waiter_.join();
+
+    auto destroy = [](Operation* op) {
+        for (Registration& reg : op->regs)
+        {
+            if (reg.native >= 0) close(reg.native);
+        }
+        delete op;
+    };
+    while (Operation* op = retired_.Pop()) destroy(op);
+    for (Operation* op : active_) destroy(op);
+    active_.clear();
+
+    close(control_fd_);
+    close(epoll_fd_);
+}
+
+// 每个注册使用 dup 出的 fd：同一个句柄可以被多个操作同时等待
+bool WaitSet::Add(void* context, const std::vector<WaitHandle>& handles, std::string* error)
+{
+    auto* op    = new Operation;
+    op->owner   = this;
+    op->context = context;
+    op->regs.resize(handles.size());
+    for (size_t i = 0; i < handles.size(); ++i) op->regs[i] = {op, (int)i + 1, -1};
+    active_.insert(op);
+
+    for (Registration& reg : op->regs)
+    {
+        int fd = fcntl(handles[reg.index - 1], F_DUPFD_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            if (error) *error = std::string("dup failed: ") + strerror(errno);
+            Abandon(op);
+            return false;
+        }
+        reg.native = fd;
+
+        epoll_event ev{};
+        ev.events   = EPOLLIN | EPOLLONESHOT;
+        ev.data.ptr = &reg;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            if (error) *error = std::string("epoll_ctl failed: ") + strerror(errno);
+            Abandon(op);
+            return false;
+        }
+    }
+    return true;
+}
+
+// 同一批 epoll 事件里可能还引用着这条记录，所以交给等待线程在批次之间释放
+void WaitSet::Release(Operation* op)
+{
+    active_.erase(op);
+    if (retired_.Push(op))
+    {
+        uint64_t one = 1;
+        (void)!write(control_fd_, &one, sizeof(one));
+    }
+}
+
+void WaitSet::WaiterLoop()
+{
+    epoll_event events[128];
+    while (!stopping_)
+    {
+        int n = epoll_wait(epoll_fd_, events, 128, -1);
+        if (n < 0 && errno != EINTR) break;
+
+        for (int i = 0; i < n; ++i)
+        {
+            if (events[i].data.ptr == nullptr)
+            {
+                uint64_t value;
+                (void)!read(control_fd_, &value, sizeof(value));
+                continue;
+            }
+            Signal(static_cast<Registration*>(events[i].data.ptr));
+        }
+
+        while (Operation* op = retired_.Pop())
+        {
+            for (Registration& reg : op->regs)
+            {
+                if (reg.native < 0) continue;
+                epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, reg.native, nullptr);
+                close(reg.native);
+            }
+            delete op;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#include "wait_set.h"
+
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+
+WaitSet::WaitSet(WakeFn wake) : wake_(std::move(wake)) {}
+
+WaitSet::~WaitSet()
+{
+    for (Operation* op : std::vector<Operation*>(active_.begin(), active_.end())) Release(op);
+}
+
+bool WaitSet::Add(void* context, const std::vector<WaitHandle>& handles, std::string* error)
+{
+    auto* op    = new Operation;
+    op->owner   = this;
+    op->context = context;
+    op->regs.resize(handles.size());
+    active_.insert(op);
+
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        Registration& reg = op->regs[i];
+        reg.op            = op;
+        reg.index         = (int)i + 1;
+        reg.native        = NULL;
+
+        HANDLE wait = NULL;
+        if (!RegisterWaitForSingleObject(
+                &wait, handles[i],
+                [](PVOID param, BOOLEAN) { Signal(static_cast<Registration*>(param)); }, &reg, INFINITE,
+                WT_EXECUTEONLYONCE | WT_EXECUTEINWAITTHREAD))
+        {
+            if (error) *error = "RegisterWaitForSingleObject failed: " + std::to_string(GetLastError());
+            Abandon(op);
+            return false;
+        }
+        reg.native = wait;
+    }
+    return true;
+}
+
+// INVALID_HANDLE_VALUE 会等待正在执行的回调结束，之后记录可以安全释放
+void WaitSet::Release(Operation* op)
+{
+    active_.erase(op);
+    for (Registration& reg : op->regs)
+    {
+        if (reg.native) UnregisterWaitEx(reg.native, INVALID_HANDLE_VALUE);
+    }
+    delete op;
+}
@@ -0,0 +1,270 @@
+#include "worker_registry.h"
+
+#include "file_buffer.h"
+#include "flight_recorder.h"
+#include "runtime_metrics.h"
+#include "trace.h"
+
+WorkerValue WorkerValue::Boolean(bool v)
+{
+    WorkerValue value;
+    value.type    = WorkerValueType::Boolean;
+    value.boolean = v;
+    return value;
+}
+
+WorkerValue WorkerValue::Integer(int64_t v)
+{
+    WorkerValue value;
+    value.type    = WorkerValueType::Integer;
+    value.integer = v;
+    return value;
+}
+
+WorkerValue WorkerValue::Number(double v)
+{
+    WorkerValue value;
+    value.type   = WorkerValueType::Number;
+    value.number = v;
+    return value;
+}
+
+WorkerValue WorkerValue::String(std::string v)
+{
+    WorkerValue value;
+    value.type   = WorkerValueType::String;
+    value.string = std::move(v);
+    return value;
+}
+
+WorkerValue WorkerValue::Numbers(std::vector<double> v)
+{
+    WorkerValue value;
+    value.type    = WorkerValueType::Numbers;
+    value.numbers = std::move(v);
+    return value;
+}
+
+WorkerValue WorkerValue::Buffer(pesh_buffer* v)
+{
+    WorkerValue value;
+    value.type   = WorkerValueType::Buffer;
+    value.buffer = v;
+    return value;
+}
+
+WorkerValue WorkerValue::Pointer(void* v, void (*release)(void*))
+{
+    WorkerValue value;
+    value.type    = WorkerValueType::Pointer;
+    value.pointer = v;
+    value.release = release;
+    return value;
+}
+
+void WorkerValue::Release()
+{
+    if (type == WorkerValueType::Buffer && buffer) buffer->release(buffer);
+    if (type == WorkerValueType::Pointer && pointer && release) release(pointer);
+    buffer  = nullptr;
+    pointer = nullptr;
+    type    = WorkerValueType::Nil;
+}
+
+WorkerResult WorkerResult::Ok(WorkerValue value)
+{
+    WorkerResult result;
+    result.value = std::move(value);
+    return result;
+}
+
+WorkerResult WorkerResult::Fail(int code, std::string message)
+{
+    WorkerResult result;
+    result.ok         = false;
+    result.error_code = code;
+    result.error      = std::move(message);
+    return result;
+}
+
+WorkerRegistry& WorkerRegistry::Instance()
+{
+    static WorkerRegistry registry;
+    return registry;
+}
+
+int WorkerRegistry::Register(const std::string& name, std::vector<WorkerValueType> signature, WorkerFn fn,
+                             TaskLane lane)
+{
+    return Add({name, std::move(signature), std::move(fn), nullptr, lane});
+}
+
+int WorkerRegistry::RegisterInline(const std::string& name, std::vector<WorkerValueType> signature, InlineFn fn)
+{
+    return Add({name, std::move(signature), nullptr, std::move(fn), TaskLane::Cpu});
+}
+
+int WorkerRegistry::Add(Def def)
+{
+    std::lock_guard<std::mutex> lock(defs_mutex_);
+    if (by_name_.count(def.name)) return -1;
+    int id         = (int)defs_.size();
+    def.id         = id;
+    def.trace_name = TraceName(def.name);
+    by_name_.emplace(def.name, id);
+    defs_.push_back(std::make_unique<Def>(std::move(def)));
+    return id;
+}
+
+int WorkerRegistry::Find(const std::string& name) const
+{
+    std::lock_guard<std::mutex> lock(defs_mutex_);
+    auto it = by_name_.find(name);
+    return it == by_name_.end() ? -1 : it->second;
+}
+
+const std::vector<WorkerValueType>* WorkerRegistry::Signature(int id) const
+{
+    std::lock_guard<std::mutex> lock(defs_mutex_);
+    if (id < 0 || id >= (int)defs_.size()) return nullptr;
+    return &defs_[id]->signature;
+}
+
+void WorkerRegistry::SetHooks(Executor executor, CompleteFn complete)
+{
+    executor_ = std::move(executor);
+    complete_ = std::move(complete);
+}
+
+uint64_t WorkerRegistry::Dispatch(int id, WorkerArgs args, int priority, void* waiter)
+{
+    const Def* def;
+    {
+        std::lock_guard<std::mutex> lock(defs_mutex_);
+        def = defs_[id].get();  // Def 只增不删，指针在进程生命周期内有效
+    }
+    if (def->inline_fn)
+    {
+        FlightRecord(FlightEvent::WorkerDispatch, (uint8_t)def->lane, (uint32_t)id, 0);
+        def->inline_fn(args, waiter);
+        return 0;
+    }
+
+    uint64_t dispatch_at = TraceNow();
+    auto* op     = new Op;
+    op->def      = def;
+    op->args     = std::move(args);
+    op->priority = priority;
+    op->waiter      = waiter;
+    op->dispatch_at = dispatch_at;
+    Metrics().workers_dispatched.fetch_add(1, std::memory_order_relaxed);
+    uint64_t op_id;
+    {
+        std::lock_guard<std::mutex> lock(ops_mutex_);
+        op_id = op->id = next_op_id_++;
+        queued_[(int)def->lane].insert(op);
+        ops_.emplace(op_id, op);
+    }
+    // 每个操作对应一次线程池执行，但执行时取的是同通道当前优先级最高的排队操作；op 此后可能已被释放
+    TaskLane lane = def->lane;
+    FlightRecordAt(dispatch_at, FlightEvent::WorkerDispatch, (uint8_t)lane, (uint32_t)id, op_id);
+    executor_([this, lane] { RunNext(lane); }, lane);
+    return op_id;
+}
+
+void WorkerRegistry::RunNext(TaskLane lane)
+{
+    Op* op;
+    {
+        std::lock_guard<std::mutex> lock(ops_mutex_);
+        auto& queued = queued_[(int)lane];
+        if (queued.empty()) return;  // 对应的操作已在排队时被取消
+        op = *queued.begin();
+        queued.erase(queued.begin());
+        op->running = true;
+    }
+
+    // 排队 (派发 -> 开始执行) 与执行分开统计；追踪中前者为异步区间，不属于任何线程
+    RuntimeMetrics& metrics = Metrics();
+    uint64_t        run_at  = TraceNow();
+    FlightRecordAt(run_at, FlightEvent::WorkerRun, 0, (uint32_t)op->def->id, op->id);
+    metrics.workers_started.fetch_add(1, std::memory_order_relaxed);
+    metrics.worker_queue_wait.Record(run_at - op->dispatch_at);
+    if (TraceEnabled())
+    {
+        TraceAsyncBegin(op->def->trace_name, TraceCategory::Queue, op->id, op->dispatch_at);
+        TraceAsyncEnd(op->def->trace_name, TraceCategory::Queue, op->id, run_at);
+    }
+    WorkerResult result = op->def->fn(op->args, WorkerContext(&op->cancelled));
+    uint64_t     end_at = TraceNow();
+    metrics.worker_exec.Record(end_at - run_at);
+    if (TraceEnabled()) TraceComplete(op->def->trace_name, TraceCategory::Worker, run_at, end_at, op->id);
+    // 已取消但工作者照常完成：结果不再交出，映射缓冲区等资源在这里释放
+    if (op->cancelled.load() && result.ok)
+    {
+        result.value.Release();
+        result = WorkerResult::Fail(kWorkerCancelled, "Cancelled");
+    }
+    if (!result.ok) metrics.workers_failed.fetch_add(1, std::memory_order_relaxed);
+    metrics.workers_finished.fetch_add(1, std::memory_order_relaxed);
+    FlightRecordAt(end_at, FlightEvent::WorkerComplete, result.ok, (uint32_t)result.error_code, op->id);
+
+    {
+        std::lock_guard<std::mutex> lock(ops_mutex_);
+        ops_.erase(op->id);
+    }
+    complete_(op->waiter, std::move(result));
+    delete op;
+}
+
+bool WorkerRegistry::Cancel(uint64_t op_id)
+{
+    void* waiter = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(ops_mutex_);
+        auto it = ops_.find(op_id);
+        if (it == ops_.end()) return false;
+        Op* op = it->second;
+        if (op->running)
+        {
+            op->cancelled = 1;
+            return true;
+        }
+        queued_[(int)op->def->lane].erase(op);
+        ops_.erase(it);
+        Metrics().workers_cancelled_queued.fetch_add(1, std::memory_order_relaxed);
+        if (TraceEnabled())
+        {
+            TraceAsyncBegin(op->def->trace_name, TraceCategory::Queue, op_id, op->dispatch_at);
+            TraceAsyncEnd(op->def->trace_name, TraceCategory::Queue, op_id, TraceNow());
+        }
+        waiter = op->waiter;
+        delete op;
+    }
+    FlightRecord(FlightEvent::WorkerComplete, 0, (uint32_t)kWorkerCancelled, op_id);
+    complete_(waiter, WorkerResult::Fail(kWorkerCancelled, "Cancelled"));
+    return true;
+}
+
+size_t WorkerRegistry::Pending() const
+{
+    std::lock_guard<std::mutex> lock(ops_mutex_);
+    return ops_.size();
+}
+
+extern "C" PESH_EXPORT int pesh_register_native_worker(const char* name, pesh_native_worker_fn fn, void* userdata)
+{
+    if (!name || !fn) return -1;
+    return WorkerRegistry::Instance().Register(
+        name, {WorkerValueType::String}, [fn, userdata](const WorkerArgs& args, const WorkerContext& ctx) {
+            // WorkerContext 只暴露只读视图，C 调用方需要的是取消标志本身的地址
+            const volatile int* cancelled    = reinterpret_cast<const volatile int*>(ctx.Flag());
+            int64_t             value        = 0;
+            char                message[512] = {0};
+            const std::string&  arg          = args[0].string;
+            int code = fn(userdata, arg.c_str(), arg.size(), &value, message, sizeof(message) - 1, cancelled);
+            if (code != 0) return WorkerResult::Fail(code, message[0] ? message : "Native worker failed");
+            return WorkerResult::Ok(WorkerValue::Integer(value));
+        },
+        TaskLane::Io);
+}
@@ -0,0 +1,215 @@
+#pragma once
+// 原生工作者注册表，替代 pesh_dispatch_worker 中的 strcmp 分支链。
+//   - 各模块用 PESH_REGISTER_WORKER 静态注册，FFI 加载的动态库经 C ABI pesh_register_native_worker 运行时注册
+//   - Lua 端按名称解析一次得到整数 id，之后按 id 派发；参数按签名在主线程上一次性解析为 WorkerArgs
+//   - 结果带类型 (整数 / 数值数组 / 缓冲区 ...)，失败带错误码
+//   - 每个操作有优先级 (数值大者先执行) 和取消：排队中的立即以 kWorkerCancelled 完成，执行中的置位取消标志
+//   - 工作者声明所属的线程池通道，阻塞 I/O 类走 TaskLane::Io，各通道分别按优先级排队
+// 本文件不依赖 Lua，线程池与完成投递由宿主通过 SetHooks 注入。
+
+#include "thread_pool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct pesh_buffer;
+
+enum class WorkerValueType
+{
+    Nil,
+    Boolean,
+    Integer,
+    Number,
+    String,
+    Numbers,  // 数值数组，Lua 端为顺序表
+    Buffer,   // pesh_buffer*，Lua 端为 lightuserdata，由 fs_async 包装为 cdata
+    Pointer,  // lightuserdata；带 release 时结果被丢弃 (如取消) 由注册表释放，交给 Lua 后归调用方
+};
+
+struct WorkerValue
+{
+    WorkerValueType     type    = WorkerValueType::Nil;
+    bool                boolean = false;
+    int64_t             integer = 0;
+    double              number  = 0;
+    std::string         string;
+    std::vector<double> numbers;
+    pesh_buffer*        buffer  = nullptr;
+    void*               pointer = nullptr;
+    void (*release)(void*)      = nullptr;  // Pointer 的释放函数，可为空
+
+    static WorkerValue Boolean(bool v);
+    static WorkerValue Integer(int64_t v);
+    static WorkerValue Number(double v);
+    static WorkerValue String(std::string v);
+    static WorkerValue Numbers(std::vector<double> v);
+    static WorkerValue Buffer(pesh_buffer* v);
+    static WorkerValue Pointer(void* v, void (*release)(void*) = nullptr);
+
+    // 结果没有交给 Lua 就被丢弃时调用：释放 Buffer 与带释放函数的 Pointer
+    void Release();
+};
+
+using WorkerArgs = std::vector<WorkerValue>;
+
+// 负值为注册表自身的错误码，正值为系统错误码 (GetLastError / errno)
+constexpr int kWorkerCancelled = -1;
+constexpr int kWorkerFailed    = -2;
+
+struct WorkerResult
+{
+    bool        ok         = true;
+    WorkerValue value;
+    int         error_code = 0;
+    std::string error;
+
+    static WorkerResult Ok(WorkerValue value = {});
+    static WorkerResult Fail(int code, std::string message);
+};
+
+class WorkerContext
+{
+public:
+    explicit WorkerContext(const std::atomic<int>* cancelled) : cancelled_(cancelled) {}
+
+    // 长任务应在循环中检查，尽早放弃
+    bool Cancelled() const
+    {
+        return cancelled_ && cancelled_->load(std::memory_order_relaxed) != 0;
+    }
+
+    const std::atomic<int>* Flag() const
+    {
+        return cancelled_;
+    }
+
+private:
+    const std::atomic<int>* cancelled_;
+};
+
+class WorkerRegistry
+{
+public:
+    using WorkerFn   = std::function<WorkerResult(const WorkerArgs&, const WorkerContext&)>;
+    using InlineFn   = std::function<void(const WorkerArgs&, void* waiter)>;
+    using Executor   = std::function<void(std::function<void()>, TaskLane)>;
+    using CompleteFn = std::function<void(void* waiter, WorkerResult result)>;
+
+    static WorkerRegistry& Instance();
+
+    // 返回 id；重名返回 -1
+    int Register(const std::string& name, std::vector<WorkerValueType> signature, WorkerFn fn,
+                 TaskLane lane = TaskLane::Cpu);
+
+    // 在派发线程 (主线程) 上直接执行、自行负责完成的操作，例如由事件循环时间轮驱动的定时器
+    int RegisterInline(const std::string& name, std::vector<WorkerValueType> signature, InlineFn fn);
+
+    // 未知名称返回 -1
+    int Find(const std::string& name) const;
+
+    // 无效 id 返回 nullptr
+    const std::vector<WorkerValueType>* Signature(int id) const;
+
+    // executor 在线程池上执行任务；complete 在工作线程上被调用，负责把结果投递回 waiter
+    void SetHooks(Executor executor, CompleteFn complete);
+
+    // 返回操作 id (内联操作返回 0)
+    uint64_t Dispatch(int id, WorkerArgs args, int priority, void* waiter);
+
+    // 任意线程；操作已完成或不存在时返回 false
+    bool Cancel(uint64_t op_id);
+
+    size_t Pending() const;
+
+private:
+    struct Def
+    {
+        std::string                  name;
+        std::vector<WorkerValueType> signature;
+        WorkerFn                     fn;
+        InlineFn                     inline_fn;
+        TaskLane                     lane;
+        int                          id         = -1;
+        uint32_t                     trace_name = 0;
+    };
+
+    struct Op
+    {
+        uint64_t         id;
+        const Def*       def;
+        WorkerArgs       args;
+        int              priority;
+        void*            waiter;
+        std::atomic<int> cancelled{0};
+        bool             running     = false;
+        uint64_t         dispatch_at = 0;  // 派发时的追踪时钟刻度
+    };
+
+    struct OpOrder
+    {
+        bool operator()(const Op* a, const Op* b) const
+        {
+            return a->priority != b->priority ? a->priority > b->priority : a->id < b->id;
+        }
+    };
+
+    int  Add(Def def);
+    void RunNext(TaskLane lane);
+
+    mutable std::mutex                   defs_mutex_;
+    std::vector<std::unique_ptr<Def>>    defs_;
+    std::unordered_map<std::string, int> by_name_;
+
+    Executor   executor_;
+    CompleteFn complete_;
+
+    mutable std::mutex                ops_mutex_;
+    std::set<Op*, OpOrder>            queued_[2];  // 按 TaskLane 分开
+    std::unordered_map<uint64_t, Op*> ops_;
+    uint64_t                          next_op_id_ = 1;
+};
+
+struct WorkerRegistrar
+{
+    WorkerRegistrar(const char* name, std::vector<WorkerValueType> signature, WorkerRegistry::WorkerFn fn,
+                    TaskLane lane)
+    {
+        WorkerRegistry::Instance().Register(name, std::move(signature), std::move(fn), lane);
+    }
+};
+
+// 在任意翻译单元中静态注册一个工作者，函数体在线程池上执行：
+//   PESH_REGISTER_WORKER(hash, {WorkerValueType::String}) { ... return WorkerResult::Ok(...); }
+// 会长时间阻塞在系统调用上的工作者用 PESH_REGISTER_IO_WORKER，放到弹性 I/O 通道
+#define PESH_REGISTER_WORKER(name, ...) PESH_REGISTER_WORKER_ON(name, TaskLane::Cpu, __VA_ARGS__)
+#define PESH_REGISTER_IO_WORKER(name, ...) PESH_REGISTER_WORKER_ON(name, TaskLane::Io, __VA_ARGS__)
+
+#define PESH_REGISTER_WORKER_ON(name, lane, ...)                                                             \
+    static WorkerResult    pesh_worker_##name(const WorkerArgs& args, const WorkerContext& ctx);              \
+    static WorkerRegistrar pesh_worker_reg_##name(#name, std::vector<WorkerValueType> __VA_ARGS__,            \
+                                                  pesh_worker_##name, lane);                                   \
+    static WorkerResult    pesh_worker_##name(const WorkerArgs& args, const WorkerContext& ctx)
+
+// FFI 动态库的 C ABI：单个字符串参数、整数结果，运行在 I/O 通道。返回 0 表示成功，否则为错误码并可写入 message
+#if defined(_WIN32)
+#define PESH_EXPORT __declspec(dllexport)
+#else
+#define PESH_EXPORT __attribute__((visibility("default")))
+#endif
+
+extern "C"
+{
+    typedef int (*pesh_native_worker_fn)(void* userdata, const char* arg, size_t arg_len, int64_t* result,
+                                         char* message, size_t message_size, const volatile int* cancelled);
+
+    // 返回工作者 id，重名返回 -1
+    PESH_EXPORT int pesh_register_native_worker(const char* name, pesh_native_worker_fn fn, void* userdata);
+}
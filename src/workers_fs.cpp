@@ -0,0 +1,87 @@
+// 文件系统类原生工作者。参数均为 UTF-8 路径，在线程池的 I/O 通道上执行。
+
+#include "file_buffer.h"
+#include "worker_registry.h"
+
+#if defined(_WIN32)
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+#endif
+
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+// 返回 true；失败码为 GetLastError / errno
+PESH_REGISTER_IO_WORKER(file_copy, {WorkerValueType::String, WorkerValueType::String})
+{
+    (void)ctx;
+    const std::string& src_path = args[0].string;
+    const std::string& dst_path = args[1].string;
+    spdlog::debug("WORKER: Async copy '{}' -> '{}'", src_path, dst_path);
+#if defined(_WIN32)
+    if (!CopyFileW(fs::u8path(src_path).c_str(), fs::u8path(dst_path).c_str(), FALSE))
+    {
+        DWORD error = GetLastError();
+        return WorkerResult::Fail((int)error, "Copy failed: " + std::to_string(error));
+    }
+#else
+    std::error_code ec;
+    fs::copy_file(fs::u8path(src_path), fs::u8path(dst_path), fs::copy_options::overwrite_existing, ec);
+    if (ec) return WorkerResult::Fail(ec.value(), "Copy failed: " + ec.message());
+#endif
+    return WorkerResult::Ok(WorkerValue::Boolean(true));
+}
+
+// 返回文件内容字符串；大文件请用 file_map
+PESH_REGISTER_IO_WORKER(file_read, {WorkerValueType::String})
+{
+    (void)ctx;
+    const std::string& filepath = args[0].string;
+    spdlog::debug("WORKER: Async read '{}'", filepath);
+    std::ifstream file(fs::u8path(filepath), std::ios::binary | std::ios::ate);
+    if (!file) return WorkerResult::Fail(kWorkerFailed, "File open failed: " + filepath);
+    std::streamsize size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    std::string buffer(size, '\0');
+    if (!file.read(&buffer[0], size)) return WorkerResult::Fail(kWorkerFailed, "File read failed: " + filepath);
+    return WorkerResult::Ok(WorkerValue::String(std::move(buffer)));
+}
+
+// 零拷贝读取：返回映射缓冲区，由 Lua 端的 cdata 持有
+PESH_REGISTER_IO_WORKER(file_map, {WorkerValueType::String})
+{
+    (void)ctx;
+    const std::string& filepath = args[0].string;
+    spdlog::debug("WORKER: Async map '{}'", filepath);
+    std::string  error;
+    pesh_buffer* buffer = MapFileBuffer(fs::u8path(filepath), &error);
+    if (!buffer) return WorkerResult::Fail(kWorkerFailed, "File map failed: " + filepath + " (" + error + ")");
+    return WorkerResult::Ok(WorkerValue::Buffer(buffer));
+}
+
+// 返回 { size, mtime (Unix 秒), is_dir (0/1) }
+PESH_REGISTER_IO_WORKER(file_stat, {WorkerValueType::String})
+{
+    (void)ctx;
+    std::error_code ec;
+    fs::path        path   = fs::u8path(args[0].string);
+    fs::file_status status = fs::status(path, ec);
+    if (ec) return WorkerResult::Fail(ec.value(), "Stat failed: " + ec.message());
+
+    bool     is_dir = fs::is_directory(status);
+    uint64_t size   = is_dir ? 0 : fs::file_size(path, ec);
+    auto     mtime  = fs::last_write_time(path, ec);
+    if (ec) return WorkerResult::Fail(ec.value(), "Stat failed: " + ec.message());
+
+    // C++17 的 file_time_type 纪元因实现而异，按当前时刻换算到 system_clock
+    auto sys_mtime = std::chrono::system_clock::now() + (mtime - fs::file_time_type::clock::now());
+    auto seconds   = std::chrono::duration_cast<std::chrono::seconds>(sys_mtime.time_since_epoch()).count();
+    return WorkerResult::Ok(WorkerValue::Numbers({(double)size, (double)seconds, is_dir ? 1.0 : 0.0}));
+}
@@ -0,0 +1,548 @@
+#include "write_behind.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(_WIN32)
+// clang-format off
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// clang-format on
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    std::atomic<uint64_t> g_temp_serial{0};
+
+    // 小追加复制进末尾的数据块 (一次 memcpy)，大追加直接移入成为新块 (不复制)。
+    // 每行一块时 writev 要逐块拷贝零散的小缓冲区，写入端开销约为打包后的 5 倍
+    constexpr size_t kPackBelow     = 4 << 10;
+    constexpr size_t kPackedChunkMax = 64 << 10;
+
+    // 已是规整的绝对路径 (最常见的情形) 时不必走 lexically_normal：它要拆分并重组整条路径，比一次追加的其余开销还高
+    bool IsNormalAbsolute(const fs::path& path)
+    {
+        const fs::path::string_type& s = path.native();
+#if defined(_WIN32)
+        // 只认盘符路径 "C:\..."；含正斜杠、UNC 等一律走完整规整
+        constexpr wchar_t kSep = L'\\';
+        if (s.size() < 3 || s[1] != L':' || s[2] != kSep || s.find(L'/') != s.npos) return false;
+#else
+        constexpr char kSep = '/';
+        if (s.empty() || s[0] != kSep) return false;
+#endif
+        for (size_t i = 0; i < s.size(); ++i)
+        {
+            if (s[i] != kSep || i + 1 == s.size()) continue;
+            size_t next = i + 1;
+            if (s[next] == kSep) return false;
+            if (s[next] != '.') continue;
+            size_t after = next + 1;
+            if (after == s.size() || s[after] == kSep) return false;  // "/."
+            if (s[after] == '.' && (after + 1 == s.size() || s[after + 1] == kSep)) return false;  // "/.."
+        }
+        return true;
+    }
+
+    // 同一文件的不同写法 (相对路径、"./"、"..") 必须落到同一个状态上，否则两个写入任务会打乱追加顺序。
+    // 只做词法规整，不解析符号链接：每次追加都查询文件系统代价太高
+    void Normalize(fs::path& path)
+    {
+        if (IsNormalAbsolute(path)) return;
+        std::error_code ec;
+        fs::path        absolute = fs::absolute(path, ec);
+        path                     = (ec ? path : absolute).lexically_normal();
+    }
+
+    // 替换只能整块写出；只有一块时直接移走
+    std::string Join(std::vector<std::string>& chunks)
+    {
+        if (chunks.size() == 1) return std::move(chunks[0]);
+        size_t total = 0;
+        for (const std::string& chunk : chunks) total += chunk.size();
+        std::string joined;
+        joined.reserve(total);
+        for (const std::string& chunk : chunks) joined += chunk;
+        return joined;
+    }
+
+#if defined(_WIN32)
+    std::string LastErrorText(const char* what)
+    {
+        return std::string(what) + " failed: " + std::to_string(GetLastError());
+    }
+
+    // 临时文件与目标同目录，改名才不会跨卷
+    fs::path TempPath(const fs::path& path)
+    {
+        fs::path temp = path;
+        temp += L".tmp-" + std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring(++g_temp_serial);
+        return temp;
+    }
+
+    bool WriteAll(HANDLE file, const std::string& data, std::string* error)
+    {
+        size_t offset = 0;
+        while (offset < data.size())
+        {
+            DWORD chunk   = (DWORD)std::min<size_t>(data.size() - offset, 1u << 30);
+            DWORD written = 0;
+            if (!WriteFile(file, data.data() + offset, chunk, &written, nullptr))
+            {
+                *error = LastErrorText("WriteFile");
+                return false;
+            }
+            offset += written;
+        }
+        return true;
+    }
+
+    // 一个写入任务内连续的追加批次共用一次打开
+    class AppendHandle
+    {
+    public:
+        ~AppendHandle()
+        {
+            Close();
+        }
+
+        // 多块在写入线程上拼成一块：FILE_APPEND_DATA 下一次 WriteFile 整块落在末尾
+        bool Append(const fs::path& path, std::vector<std::string>& chunks, bool sync, std::string* error)
+        {
+            bool ok = Open(path, true, error) && WriteAll(file_, Join(chunks), error) && (!sync || Sync(path, error));
+            if (!ok) Close();
+            return ok;
+        }
+
+        bool Sync(const fs::path& path, std::string* error)
+        {
+            if (!Open(path, false, error)) return false;
+            if (FlushFileBuffers(file_)) return true;
+            *error = LastErrorText("FlushFileBuffers");
+            return false;
+        }
+
+        void Close()
+        {
+            if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+            file_ = INVALID_HANDLE_VALUE;
+        }
+
+    private:
+        bool Open(const fs::path& path, bool create, std::string* error)
+        {
+            if (file_ != INVALID_HANDLE_VALUE) return true;
+            // FILE_APPEND_DATA：每次写入都落在文件末尾，与其他追加者交错时也不互相覆盖
+            file_ = CreateFileW(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file_ != INVALID_HANDLE_VALUE) return true;
+            *error = LastErrorText("CreateFile");
+            return false;
+        }
+
+        HANDLE file_ = INVALID_HANDLE_VALUE;
+    };
+
+    // NTFS 的改名记在元数据日志中，没有单独刷写目录项的接口；同步替换用 MOVEFILE_WRITE_THROUGH
+    void SyncParentDir(const fs::path&) {}
+
+    bool ReplaceContents(const fs::path& path, const std::string& data, bool sync, std::string* error)
+    {
+        fs::path temp = TempPath(path);
+        HANDLE   file = CreateFileW(temp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            *error = LastErrorText("CreateFile");
+            return false;
+        }
+        bool ok = WriteAll(file, data, error);
+        if (ok && sync && !FlushFileBuffers(file))
+        {
+            *error = LastErrorText("FlushFileBuffers");
+            ok     = false;
+        }
+        CloseHandle(file);
+        // MOVEFILE_WRITE_THROUGH：改名本身落盘后才返回
+        if (ok && !MoveFileExW(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | (sync ? MOVEFILE_WRITE_THROUGH : 0)))
+        {
+            *error = LastErrorText("MoveFileEx");
+            ok     = false;
+        }
+        if (!ok) DeleteFileW(temp.c_str());
+        return ok;
+    }
+#else
+    std::string ErrnoText(const char* what)
+    {
+        return std::string(what) + " failed: " + strerror(errno);
+    }
+
+    fs::path TempPath(const fs::path& path)
+    {
+        fs::path temp = path;
+        temp += ".tmp-" + std::to_string(getpid()) + "-" + std::to_string(++g_temp_serial);
+        return temp;
+    }
+
+    bool WriteAll(int fd, const std::string& data, std::string* error)
+    {
+        size_t offset = 0;
+        while (offset < data.size())
+        {
+            ssize_t n = ::write(fd, data.data() + offset, data.size() - offset);
+            if (n < 0)
+            {
+                if (errno == EINTR) continue;
+                *error = ErrnoText("write");
+                return false;
+            }
+            offset += (size_t)n;
+        }
+        return true;
+    }
+
+    // 一次 writev 写出一批数据块 (每次至多 IOV_MAX 块)，部分写入时从断点继续
+    bool WriteChunks(int fd, const std::vector<std::string>& chunks, std::string* error)
+    {
+        iovec  iov[IOV_MAX];
+        size_t index = 0, offset = 0;  // 第一个未写完的块，及其中已写出的字节数
+        while (index < chunks.size())
+        {
+            int count = 0;
+            for (size_t i = index; i < chunks.size() && count < IOV_MAX; ++i, ++count)
+            {
+                size_t skip = i == index ? offset : 0;
+                iov[count]  = {const_cast<char*>(chunks[i].data()) + skip, chunks[i].size() - skip};
+            }
+            ssize_t n = ::writev(fd, iov, count);
+            if (n < 0)
+            {
+                if (errno == EINTR) continue;
+                *error = ErrnoText("writev");
+                return false;
+            }
+            size_t left = (size_t)n;
+            while (index < chunks.size() && left >= chunks[index].size() - offset)
+            {
+                left -= chunks[index].size() - offset;
+                offset = 0;
+                ++index;
+            }
+            offset += left;
+        }
+        return true;
+    }
+
+    class AppendHandle
+    {
+    public:
+        ~AppendHandle()
+        {
+            Close();
+        }
+
+        bool Append(const fs::path& path, std::vector<std::string>& chunks, bool sync, std::string* error)
+        {
+            bool ok = Open(path, true, error) && WriteChunks(fd_, chunks, error) && (!sync || Sync(path, error));
+            if (!ok) Close();
+            return ok;
+        }
+
+        // 追加改变了文件长度，fdatasync 会一并写回长度
+        bool Sync(const fs::path& path, std::string* error)
+        {
+            if (!Open(path, false, error)) return false;
+            if (::fdatasync(fd_) == 0) return true;
+            *error = ErrnoText("fdatasync");
+            return false;
+        }
+
+        void Close()
+        {
+            if (fd_ >= 0) ::close(fd_);
+            fd_ = -1;
+        }
+
+    private:
+        bool Open(const fs::path& path, bool create, std::string* error)
+        {
+            if (fd_ >= 0) return true;
+            fd_ = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+            if (fd_ >= 0) return true;
+            *error = ErrnoText("open");
+            return false;
+        }
+
+        int fd_ = -1;
+    };
+
+    // 改名后目录项也须落盘，否则掉电后可能仍指向旧文件
+    void SyncParentDir(const fs::path& path)
+    {
+        fs::path dir = path.parent_path();
+        int      dfd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dfd < 0) return;
+        ::fsync(dfd);
+        ::close(dfd);
+    }
+
+    bool ReplaceContents(const fs::path& path, const std::string& data, bool sync, std::string* error)
+    {
+        fs::path temp = TempPath(path);
+        int      fd   = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            *error = ErrnoText("open");
+            return false;
+        }
+        struct stat st;
+        if (::stat(path.c_str(), &st) == 0) ::fchmod(fd, st.st_mode & 07777);  // 保留原文件的权限位
+        bool ok = WriteAll(fd, data, error);
+        if (ok && sync && ::fsync(fd) != 0)
+        {
+            *error = ErrnoText("fsync");
+            ok     = false;
+        }
+        if (::close(fd) != 0 && ok)
+        {
+            *error = ErrnoText("close");
+            ok     = false;
+        }
+        if (ok && ::rename(temp.c_str(), path.c_str()) != 0)
+        {
+            *error = ErrnoText("rename");
+            ok     = false;
+        }
+        if (!ok)
+        {
+            ::unlink(temp.c_str());
+            return false;
+        }
+        if (sync) SyncParentDir(path);
+        return true;
+    }
+#endif
+}  // namespace
+
+WriteBehind::WriteBehind(Executor executor, ErrorFn on_error) : executor_(std::move(executor)), on_error_(std::move(on_error)) {}
+
+WriteBehind::~WriteBehind()
+{
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_cv_.wait(lock, [this] { return busy_files_ == 0; });
+}
+
+WriteBehind::Shard& WriteBehind::ShardOf(const fs::path& path)
+{
+    return shards_[std::hash<Key>{}(path.native()) % kShards];
+}
+
+std::shared_ptr<WriteBehind::FileState>& WriteBehind::StateLocked(Shard& shard, const fs::path& path)
+{
+    std::shared_ptr<FileState>& state = shard.files[path.native()];
+    if (!state)
+    {
+        state        = std::make_shared<FileState>();
+        state->path  = path;
+        state->shard = &shard;
+    }
+    return state;
+}
+
+bool WriteBehind::EnqueueLocked(FileState& state, bool sync, DoneFn done)
+{
+    ++state.shard->stats.requests;
+    state.sync |= sync;
+    if (done) state.waiters.push_back(std::move(done));
+    else state.orphans = true;
+    if (state.busy) return false;
+    state.busy = true;
+    ++busy_files_;
+    return true;
+}
+
+void WriteBehind::Append(fs::path path, std::string data, bool sync, DoneFn done)
+{
+    Normalize(path);
+    Shard&                     shard = ShardOf(path);
+    std::shared_ptr<FileState> submit;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        std::shared_ptr<FileState>& state = StateLocked(shard, path);
+        shard.stats.pending_bytes += data.size();
+        // 替换排队中时接在新内容后面
+        state->bytes += data.size();
+        if (data.size() < kPackBelow && !state->chunks.empty() && state->chunks.back().size() < kPackedChunkMax)
+            state->chunks.back() += data;
+        else state->chunks.push_back(std::move(data));
+        if (EnqueueLocked(*state, sync, std::move(done))) submit = state;
+    }
+    if (submit) Submit(std::move(submit));
+}
+
+void WriteBehind::Replace(fs::path path, std::string data, bool sync, DoneFn done)
+{
+    Normalize(path);
+    Shard&                     shard = ShardOf(path);
+    std::shared_ptr<FileState> submit;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        std::shared_ptr<FileState>& state = StateLocked(shard, path);
+        shard.stats.pending_bytes += data.size();
+        shard.stats.pending_bytes -= state->bytes;
+        state->bytes = data.size();
+        state->chunks.clear();
+        state->chunks.push_back(std::move(data));
+        state->has_replace = true;
+        if (EnqueueLocked(*state, sync, std::move(done))) submit = state;
+    }
+    if (submit) Submit(std::move(submit));
+}
+
+void WriteBehind::Flush(DoneFn done)
+{
+    // 计数从 1 开始，遍历完所有分片后才释放这一份：遍历期间先登记的文件写完也不会提前回调
+    struct Countdown
+    {
+        std::mutex  mutex;
+        size_t      left = 1;
+        std::string error;
+        DoneFn      done;
+    };
+    auto countdown  = std::make_shared<Countdown>();
+    countdown->done = std::move(done);
+    auto arrive     = [countdown](bool ok, std::string error) {
+        std::unique_lock<std::mutex> lock(countdown->mutex);
+        if (!ok && countdown->error.empty()) countdown->error = std::move(error);
+        if (--countdown->left > 0) return;
+        lock.unlock();
+        if (countdown->done) countdown->done(countdown->error.empty(), countdown->error);
+    };
+
+    std::vector<std::shared_ptr<FileState>> submit;
+    for (Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& entry : shard.files)
+        {
+            FileState& state = *entry.second;
+            // 写入任务已在收尾、没有需要同步的内容
+            if (!state.writing && !state.unsynced && !state.has_replace && state.chunks.empty() && !state.sync) continue;
+            {
+                std::lock_guard<std::mutex> count(countdown->mutex);
+                ++countdown->left;
+            }
+            state.sync = true;
+            state.waiters.push_back(arrive);
+            if (!state.busy)
+            {
+                state.busy = true;
+                ++busy_files_;
+                submit.push_back(entry.second);
+            }
+        }
+    }
+    for (auto& state : submit) Submit(std::move(state));
+    arrive(true, "");
+}
+
+WriteBehind::Stats WriteBehind::GetStats() const
+{
+    Stats total;
+    for (const Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total.requests += shard.stats.requests;
+        total.batches += shard.stats.batches;
+        total.bytes += shard.stats.bytes;
+        total.syncs += shard.stats.syncs;
+        total.errors += shard.stats.errors;
+        total.pending_bytes += shard.stats.pending_bytes;
+    }
+    return total;
+}
+
+void WriteBehind::Submit(std::shared_ptr<FileState> state)
+{
+    executor_([this, state] { Drain(state); });
+}
+
+// 一个文件的写入任务：取走排队的内容写出，写入期间又有请求到达则继续下一批
+void WriteBehind::Drain(const std::shared_ptr<FileState>& state)
+{
+    Shard&       shard = *state->shard;
+    AppendHandle handle;
+    while (true)
+    {
+        bool                     replace = false, sync = false, dir_unsynced = false, orphans = false;
+        uint64_t                 bytes   = 0;
+        std::vector<std::string> chunks;
+        std::vector<DoneFn>      waiters;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (!state->has_replace && state->chunks.empty() && !state->sync)
+            {
+                state->busy = false;
+                if (!state->unsynced) shard.files.erase(state->path.native());
+                break;
+            }
+            replace      = state->has_replace;
+            sync         = state->sync;
+            dir_unsynced = state->dir_unsynced;
+            orphans      = state->orphans;
+            bytes        = state->bytes;
+            chunks.swap(state->chunks);
+            waiters.swap(state->waiters);
+            state->has_replace = false;
+            state->sync        = false;
+            state->orphans     = false;
+            state->bytes       = 0;
+            state->writing     = !chunks.empty();
+            shard.stats.pending_bytes -= bytes;
+        }
+
+        std::string error;
+        bool        ok;
+        if (replace)
+        {
+            handle.Close();  // 旧文件即将被换掉
+            ok = ReplaceContents(state->path, Join(chunks), sync, &error);
+        }
+        else
+        {
+            if (!chunks.empty()) ok = handle.Append(state->path, chunks, sync, &error);
+            else ok = handle.Sync(state->path, &error);  // 只有 Flush 的同步请求
+            // 之前未同步的替换：文件内容随本次同步落盘，改名所在的目录项也要补上
+            if (ok && sync && dir_unsynced) SyncParentDir(state->path);
+        }
+        if (!ok) error = state->path.u8string() + ": " + error;
+
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            ++shard.stats.batches;
+            if (ok) shard.stats.bytes += bytes;
+            else ++shard.stats.errors;
+            if (ok && sync) ++shard.stats.syncs;
+            // 同步成功才算落盘；失败时之前写入的内容与本批可能已写出的部分仍待同步
+            state->unsynced = (state->unsynced || state->writing) && !(ok && sync);
+            if (replace && ok) state->dir_unsynced = !sync;
+            else if (ok && sync) state->dir_unsynced = false;
+            state->writing = false;
+        }
+        if (!ok && orphans && on_error_) on_error_(error);
+        for (DoneFn& done : waiters) done(ok, error);
+    }
+    // 对本对象的最后一次访问：析构函数在计数归零并拿到这把锁之后才继续
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    if (--busy_files_ == 0) idle_cv_.notify_all();
+}
@@ -0,0 +1,103 @@
+#pragma once
+// 合并写入 (write-behind)。
+//   - Append：同一文件排队中的追加合成一次写入 (Linux: writev；大块直接移入、不复制)；该文件的写入任务执行期间到达的追加攒到下一批
+//   - Replace：写入同目录的临时文件后改名替换目标 (Linux: rename / Windows: MoveFileEx)，读者只会看到旧内容或新内容；
+//     排队中的多次替换只写最后一份，其后排队的追加接在它后面一起写入，被覆盖的请求随这一批完成
+//   - 持久化：要求 sync 的请求在所在批次结束时随文件做一次 fsync / FlushFileBuffers，同批请求共用这一次；
+//     Flush 对所有写过但尚未同步的文件各同步一次 (未同步的替换连同所在目录)
+//   - 每个文件同一时刻至多一个写入任务，不同文件的任务并行
+// 不依赖 Lua；任务经由 Executor 提交 (peshell 中为线程池的 I/O 通道)。
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class WriteBehind
+{
+public:
+    using Executor = std::function<void(std::function<void()>)>;
+    // 所在批次写完 (要求 sync 时为同步完) 后在执行写入的线程上回调
+    using DoneFn = std::function<void(bool ok, std::string error)>;
+    // 批次失败且其中有不带回调的请求时调用一次 (error 含路径)
+    using ErrorFn = std::function<void(const std::string& error)>;
+
+    struct Stats
+    {
+        uint64_t requests      = 0;  // Append + Replace 次数
+        uint64_t batches       = 0;  // 实际执行的写入批次 (含只做同步的批次)
+        uint64_t bytes         = 0;  // 实际写入的字节数 (被覆盖的替换与追加不计)
+        uint64_t syncs         = 0;
+        uint64_t errors        = 0;  // 失败的批次
+        uint64_t pending_bytes = 0;  // 排队未写的字节数
+    };
+
+    explicit WriteBehind(Executor executor, ErrorFn on_error = nullptr);
+    // 等待执行中的批次结束；Executor 须仍在执行已提交的任务 (peshell 中线程池先 Stop(true))
+    ~WriteBehind();
+
+    WriteBehind(const WriteBehind&)            = delete;
+    WriteBehind& operator=(const WriteBehind&) = delete;
+
+    // 文件不存在时创建；done 可为空 (失败交给 on_error)。path 按绝对路径规整后区分文件 (不解析符号链接)
+    void Append(std::filesystem::path path, std::string data, bool sync, DoneFn done);
+
+    // 整体替换 path 的内容；排队中尚未写出的追加被丢弃 (它们的回调随本次替换完成)
+    void Replace(std::filesystem::path path, std::string data, bool sync, DoneFn done);
+
+    // 已提交的全部请求写完并同步后回调 (有失败时 ok 为 false，error 为第一个错误)；没有待写内容时立即回调
+    void Flush(DoneFn done);
+
+    Stats GetStats() const;
+
+private:
+    struct Shard;
+
+    struct FileState
+    {
+        std::filesystem::path    path;
+        Shard*                   shard        = nullptr;
+        bool                     busy         = false;  // 已提交写入任务
+        bool                     writing      = false;  // 正在写出一批数据 (尚未计入 unsynced)
+        bool                     has_replace  = false;
+        std::vector<std::string> chunks;                // 待写的数据块，按到达顺序；has_replace 时首块为替换后的完整内容
+        uint64_t                 bytes        = 0;      // chunks 的总字节数
+        bool                     sync         = false;  // 本批须同步
+        bool                     unsynced     = false;  // 写过但尚未同步
+        bool                     dir_unsynced = false;  // 未同步的替换：改名后的目录项尚未落盘
+        bool                     orphans      = false;  // 本批含不带回调的请求
+        std::vector<DoneFn>      waiters;
+    };
+    using Key = std::filesystem::path::string_type;
+
+    // 按路径分片加锁：不同文件的调用方与写入任务互不争用同一把锁
+    struct Shard
+    {
+        mutable std::mutex                                   mutex;
+        std::unordered_map<Key, std::shared_ptr<FileState>> files;  // 有排队、执行中或未同步内容的文件
+        Stats                                                stats;
+    };
+    static constexpr size_t kShards = 16;
+
+    // path 须已规整为绝对路径；调用方持有该分片的锁
+    std::shared_ptr<FileState>& StateLocked(Shard& shard, const std::filesystem::path& path);
+    Shard& ShardOf(const std::filesystem::path& path);
+    // 锁内登记请求；文件尚无写入任务、需要提交时返回 true
+    bool EnqueueLocked(FileState& state, bool sync, DoneFn done);
+    void Submit(std::shared_ptr<FileState> state);
+    void Drain(const std::shared_ptr<FileState>& state);
+
+    Executor executor_;
+    ErrorFn  on_error_;
+    Shard    shards_[kShards];
+
+    std::mutex              idle_mutex_;
+    std::condition_variable idle_cv_;
+    std::atomic<size_t>     busy_files_{0};
+};